@@ -0,0 +1,701 @@
+/*
+ * Multiqueue block IO submission
+ *
+ * Requests are staged on a per-cpu software queue and dispatched to one
+ * of the driver's hardware contexts, bypassing q->queue_lock and the IO
+ * scheduler entirely.  Each hardware context owns a fixed set of
+ * preallocated requests, indexed by tag, so the submission path does not
+ * touch the request mempool either.
+ *
+ * There is no merging, no IO scheduler and no request timeout handling;
+ * this is meant for devices that do not benefit from any of them (ram
+ * backed devices, paravirtual disks, fast flash).
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/completion.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+
+static struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q)
+{
+	return per_cpu_ptr(q->queue_ctx, get_cpu());
+}
+
+static void blk_mq_put_ctx(struct blk_mq_ctx *ctx)
+{
+	put_cpu();
+}
+
+static struct request *blk_mq_tag_to_rq(struct blk_mq_hw_ctx *hctx,
+					unsigned int tag)
+{
+	return hctx->rqs + tag * hctx->rq_size;
+}
+
+static struct request *blk_mq_get_tag(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(hctx->tag_map, hctx->queue_depth);
+		if (tag >= hctx->queue_depth)
+			return NULL;
+	} while (test_and_set_bit_lock(tag, hctx->tag_map));
+
+	return blk_mq_tag_to_rq(hctx, tag);
+}
+
+static void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	clear_bit_unlock(tag, hctx->tag_map);
+
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&hctx->tag_wait))
+		wake_up(&hctx->tag_wait);
+}
+
+static bool blk_mq_hctx_busy(struct blk_mq_hw_ctx *hctx)
+{
+	return !bitmap_empty(hctx->tag_map, hctx->queue_depth);
+}
+
+static void blk_mq_rq_init(struct request_queue *q, struct blk_mq_ctx *ctx,
+			   struct request *rq, int rw_flags)
+{
+	int tag = rq->tag;
+
+	blk_rq_init(q, rq);
+	rq->mq_ctx = ctx;
+	rq->tag = tag;
+	rq->cmd_flags = rw_flags;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+}
+
+/*
+ * Grab a free request from the hardware context the current cpu maps to.
+ * Sleeps for a tag to be freed if @gfp allows it.
+ */
+static struct request *__blk_mq_alloc_request(struct request_queue *q,
+					      int rw_flags, gfp_t gfp)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	DEFINE_WAIT(wait);
+
+	for (;;) {
+		if (unlikely(blk_queue_dying(q)))
+			return NULL;
+
+		ctx = blk_mq_get_ctx(q);
+		hctx = ctx->hctx;
+		rq = blk_mq_get_tag(hctx);
+		blk_mq_put_ctx(ctx);
+		if (rq)
+			break;
+
+		if (!(gfp & __GFP_WAIT))
+			return NULL;
+
+		prepare_to_wait(&hctx->tag_wait, &wait, TASK_UNINTERRUPTIBLE);
+		rq = blk_mq_get_tag(hctx);
+		if (!rq) {
+			/* make sure whatever is holding the tags gets going */
+			blk_mq_run_queues(q, false);
+			io_schedule();
+		}
+		finish_wait(&hctx->tag_wait, &wait);
+		if (rq)
+			break;
+	}
+
+	blk_mq_rq_init(q, ctx, rq, rw_flags);
+	return rq;
+}
+
+/**
+ * blk_mq_alloc_request - allocate a request for a non-fs command
+ * @q:		the multiqueue request queue
+ * @rw:		%READ or %WRITE
+ * @gfp:	whether the caller may sleep waiting for a free tag
+ *
+ * The request is initialised like blk_get_request() would and must be
+ * released with blk_mq_free_request(), or blk_put_request().
+ */
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp)
+{
+	return __blk_mq_alloc_request(q, rw, gfp);
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	/* this is a bio leak */
+	WARN_ON(rq->bio != NULL);
+
+	rq->mq_ctx = NULL;
+	blk_mq_put_tag(ctx->hctx, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/**
+ * blk_mq_end_io - complete a multiqueue request
+ * @rq:		the request being completed
+ * @error:	%0 for success, < %0 for error
+ *
+ * Ends all bios attached to @rq and then either calls ->end_io or frees
+ * the request.  May be called from interrupt context.
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	blk_account_io_done(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void blk_mq_requeue_list(struct blk_mq_hw_ctx *hctx,
+				struct list_head *list)
+{
+	spin_lock(&hctx->lock);
+	list_splice(list, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+}
+
+/*
+ * Pull everything off the software queues mapped to @hctx, plus anything
+ * left over from an earlier BUSY, and hand it to the driver.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit, ret;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	while (!list_empty(&rq_list)) {
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		trace_block_rq_issue(q, rq);
+		rq->cmd_flags |= REQ_STARTED;
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		switch (ret) {
+		case BLK_MQ_RQ_QUEUE_OK:
+			continue;
+		case BLK_MQ_RQ_QUEUE_BUSY:
+			/*
+			 * The driver is out of resources and has stopped the
+			 * queue; it restarts it once something completes.
+			 */
+			rq->cmd_flags &= ~REQ_STARTED;
+			list_add(&rq->queuelist, &rq_list);
+			blk_mq_requeue_list(hctx, &rq_list);
+
+			/* raced with a restart from the completion side */
+			if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+				blk_mq_run_hw_queue(hctx, true);
+			return;
+		default:
+			pr_err("blk-mq: bad return on queue: %d\n", ret);
+			/* fall through */
+		case BLK_MQ_RQ_QUEUE_ERROR:
+			blk_mq_end_io(rq, rq->errors ? rq->errors : -EIO);
+			break;
+		}
+	}
+}
+
+static void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (async)
+		kblockd_schedule_delayed_work(hctx->queue, &hctx->run_work, 0);
+	else
+		__blk_mq_run_hw_queue(hctx);
+}
+
+static void blk_mq_run_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work.work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_run_hw_queue(hctx, async);
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	cancel_delayed_work(&hctx->run_work);
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+/**
+ * blk_mq_start_stopped_hw_queues - restart stopped hardware contexts
+ * @q:		the multiqueue request queue
+ * @async:	run the queues from kblockd; must be set in interrupt context
+ */
+void blk_mq_start_stopped_hw_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_and_clear_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void __blk_mq_insert_request(struct blk_mq_ctx *ctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_hw_ctx *hctx = ctx->hctx;
+
+	trace_block_rq_insert(rq->q, rq);
+
+	spin_lock(&ctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	spin_unlock(&ctx->lock);
+
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+/**
+ * blk_mq_insert_request - queue a request for execution
+ * @q:		the multiqueue request queue
+ * @rq:		request allocated with blk_mq_alloc_request()
+ * @at_head:	insert at the head of the software queue
+ *
+ * Used by blk_execute_rq_nowait() for passthrough commands.  Must be
+ * called from process context.
+ */
+void blk_mq_insert_request(struct request_queue *q, struct request *rq,
+			   bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	if (unlikely(blk_queue_dying(q))) {
+		rq->errors = -ENXIO;
+		blk_mq_end_io(rq, -ENXIO);
+		return;
+	}
+
+	__blk_mq_insert_request(ctx, rq, at_head);
+	blk_mq_run_hw_queue(ctx->hctx, false);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+struct blk_mq_flush_wait {
+	struct completion	done;
+	int			error;
+};
+
+static void blk_mq_flush_rq_end_io(struct request *rq, int error)
+{
+	struct blk_mq_flush_wait *wait = rq->end_io_data;
+
+	wait->error = error;
+	blk_mq_free_request(rq);
+	complete(&wait->done);
+}
+
+static int blk_mq_issue_flush(struct request_queue *q)
+{
+	struct blk_mq_flush_wait wait;
+	struct request *rq;
+
+	rq = __blk_mq_alloc_request(q, WRITE_FLUSH, GFP_NOIO);
+	if (!rq)
+		return -ENODEV;
+
+	rq->cmd_type = REQ_TYPE_FS;
+	rq->end_io = blk_mq_flush_rq_end_io;
+	rq->end_io_data = &wait;
+	init_completion(&wait.done);
+
+	blk_mq_insert_request(q, rq, false);
+	wait_for_completion(&wait.done);
+	return wait.error;
+}
+
+static void blk_mq_flush_bio_end_io(struct bio *bio, int error)
+{
+	struct blk_mq_flush_wait *wait = bio->bi_private;
+
+	wait->error = error;
+	complete(&wait->done);
+}
+
+static void blk_mq_bio_to_request(struct request_queue *q, struct bio *bio);
+
+/*
+ * There is no flush state machine here: a flush with data is turned into
+ * an empty flush, the data write and, if the device lacks FUA, a second
+ * flush, issued one after the other from the submitter's context.  A
+ * pure flush goes straight to the driver like any other request.
+ */
+static void blk_mq_flush_sequence(struct request_queue *q, struct bio *bio,
+				  unsigned int fflags)
+{
+	bio_end_io_t *end_io = bio->bi_end_io;
+	void *private = bio->bi_private;
+	struct blk_mq_flush_wait wait;
+	bool post_flush;
+	int error = 0;
+
+	post_flush = (bio->bi_rw & REQ_FUA) && !(fflags & REQ_FUA);
+
+	if (bio->bi_rw & REQ_FLUSH) {
+		error = blk_mq_issue_flush(q);
+		if (error)
+			goto out;
+		bio->bi_rw &= ~REQ_FLUSH;
+	}
+
+	if (!post_flush) {
+		blk_mq_bio_to_request(q, bio);
+		return;
+	}
+
+	bio->bi_rw &= ~REQ_FUA;
+	init_completion(&wait.done);
+	bio->bi_end_io = blk_mq_flush_bio_end_io;
+	bio->bi_private = &wait;
+	blk_mq_bio_to_request(q, bio);
+	wait_for_completion(&wait.done);
+
+	bio->bi_end_io = end_io;
+	bio->bi_private = private;
+	error = wait.error;
+	if (!error)
+		error = blk_mq_issue_flush(q);
+out:
+	bio_endio(bio, error);
+}
+
+static void blk_mq_bio_to_request(struct request_queue *q, struct bio *bio)
+{
+	struct request *rq;
+	int rw_flags;
+
+	rw_flags = bio_data_dir(bio);
+	if (bio->bi_rw & REQ_SYNC)
+		rw_flags |= REQ_SYNC;
+
+	rq = __blk_mq_alloc_request(q, rw_flags, GFP_NOIO);
+	if (unlikely(!rq)) {
+		bio_endio(bio, -ENODEV);	/* @q is dying */
+		return;
+	}
+
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+
+	/*
+	 * Always queue on the context the tag came from, even if we slept
+	 * for it and woke up elsewhere, so the request is dispatched on the
+	 * hardware queue that owns its tag.
+	 */
+	__blk_mq_insert_request(rq->mq_ctx, rq, false);
+	blk_mq_run_hw_queue(rq->mq_ctx->hctx, false);
+}
+
+static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	blk_queue_bounce(q, &bio);
+
+	if (bio_integrity_enabled(bio) && bio_integrity_prep(bio)) {
+		bio_endio(bio, -EIO);
+		return;
+	}
+
+	if (unlikely(bio->bi_rw & (REQ_FLUSH | REQ_FUA))) {
+		unsigned int fflags = q->flush_flags;	/* may change, cache */
+
+		/*
+		 * As in blk_insert_flush(): without a write-back cache there
+		 * is nothing to flush, and an empty flush left with nothing
+		 * to do completes right here instead of reaching the driver.
+		 */
+		if (!(fflags & REQ_FLUSH))
+			bio->bi_rw &= ~(REQ_FLUSH | REQ_FUA);
+		if (!bio->bi_size) {
+			if (!(bio->bi_rw & REQ_FLUSH)) {
+				bio_endio(bio, 0);
+				return;
+			}
+			bio->bi_rw &= ~REQ_FUA;
+		} else {
+			blk_mq_flush_sequence(q, bio, fflags);
+			return;
+		}
+	}
+
+	blk_mq_bio_to_request(q, bio);
+}
+
+/**
+ * blk_mq_drain_queue - wait for all requests on a dying queue to complete
+ * @q:		the multiqueue request queue
+ *
+ * New requests fail once the queue is marked dying, so this only waits
+ * for the ones already owning a tag.
+ */
+void blk_mq_drain_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	bool busy;
+	int i;
+
+	for (;;) {
+		busy = false;
+		queue_for_each_hw_ctx(q, hctx, i) {
+			wake_up_all(&hctx->tag_wait);
+			if (blk_mq_hctx_busy(hctx))
+				busy = true;
+		}
+		if (!busy)
+			break;
+
+		blk_mq_run_queues(q, false);
+		msleep(10);
+	}
+}
+
+static void blk_mq_free_hw_ctx(struct blk_mq_hw_ctx *hctx)
+{
+	kfree(hctx->rqs);
+	kfree(hctx->tag_map);
+	kfree(hctx->ctx_map);
+	kfree(hctx->ctxs);
+	free_cpumask_var(hctx->cpumask);
+	kfree(hctx);
+}
+
+static struct blk_mq_hw_ctx *blk_mq_alloc_hw_ctx(struct request_queue *q,
+						 struct blk_mq_reg *reg,
+						 unsigned int queue_num)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+	int node = reg->numa_node;
+
+	hctx = kzalloc_node(sizeof(*hctx), GFP_KERNEL, node);
+	if (!hctx)
+		return NULL;
+
+	spin_lock_init(&hctx->lock);
+	INIT_LIST_HEAD(&hctx->dispatch);
+	INIT_DELAYED_WORK(&hctx->run_work, blk_mq_run_work_fn);
+	init_waitqueue_head(&hctx->tag_wait);
+	hctx->queue = q;
+	hctx->queue_num = queue_num;
+	hctx->queue_depth = reg->queue_depth;
+	hctx->numa_node = node;
+	hctx->rq_size = ALIGN(sizeof(struct request) + reg->cmd_size,
+			      cache_line_size());
+
+	if (!zalloc_cpumask_var_node(&hctx->cpumask, GFP_KERNEL, node))
+		goto err;
+	hctx->ctxs = kcalloc_node(nr_cpu_ids, sizeof(void *), GFP_KERNEL, node);
+	hctx->ctx_map = kcalloc_node(BITS_TO_LONGS(nr_cpu_ids),
+				     sizeof(unsigned long), GFP_KERNEL, node);
+	hctx->tag_map = kcalloc_node(BITS_TO_LONGS(hctx->queue_depth),
+				     sizeof(unsigned long), GFP_KERNEL, node);
+	hctx->rqs = kcalloc_node(hctx->queue_depth, hctx->rq_size,
+				 GFP_KERNEL, node);
+	if (!hctx->ctxs || !hctx->ctx_map || !hctx->tag_map || !hctx->rqs)
+		goto err;
+
+	for (i = 0; i < hctx->queue_depth; i++)
+		blk_mq_tag_to_rq(hctx, i)->tag = i;
+
+	return hctx;
+err:
+	blk_mq_free_hw_ctx(hctx);
+	return NULL;
+}
+
+/*
+ * cpus are spread round robin over the hardware queues; with as many
+ * hardware queues as cpus every cpu gets its own.
+ */
+static void blk_mq_map_swqueues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ctx = per_cpu_ptr(q->queue_ctx, cpu);
+		hctx = q->queue_hw_ctx[cpu % q->nr_hw_queues];
+
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = cpu;
+		ctx->queue = q;
+		ctx->hctx = hctx;
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+		cpumask_set_cpu(cpu, hctx->cpumask);
+	}
+}
+
+/**
+ * blk_mq_init_queue - set up a multiqueue request queue
+ * @reg:	queue geometry and driver operations
+ * @driver_data: passed to ->init_hctx() for each hardware context
+ *
+ * Returns the new queue or an ERR_PTR.  The queue is released like any
+ * other with blk_cleanup_queue().
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct request_queue *q;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->queue_depth || reg->queue_depth > BLK_MQ_MAX_DEPTH)
+		return ERR_PTR(-EINVAL);
+
+	if (reg->nr_hw_queues > nr_cpu_ids)
+		reg->nr_hw_queues = nr_cpu_ids;
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		return ERR_PTR(-ENOMEM);
+
+	q->queue_ctx = alloc_percpu(struct blk_mq_ctx);
+	if (!q->queue_ctx)
+		goto err_queue;
+
+	q->queue_hw_ctx = kcalloc_node(reg->nr_hw_queues, sizeof(void *),
+				       GFP_KERNEL, reg->numa_node);
+	if (!q->queue_hw_ctx)
+		goto err_ctx;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		q->queue_hw_ctx[i] = blk_mq_alloc_hw_ctx(q, reg, i);
+		if (!q->queue_hw_ctx[i])
+			goto err_hctxs;
+	}
+	q->nr_hw_queues = reg->nr_hw_queues;
+
+	blk_mq_map_swqueues(q);
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->mq_ops = reg->ops;
+	q->queue_flags |= QUEUE_FLAG_DEFAULT;
+	q->nr_requests = reg->queue_depth * reg->nr_hw_queues;
+	blk_queue_congestion_threshold(q);
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (reg->ops->init_hctx &&
+		    reg->ops->init_hctx(hctx, driver_data, i))
+			goto err_exit;
+	}
+
+	return q;
+
+err_exit:
+	while (i--) {
+		if (reg->ops->exit_hctx)
+			reg->ops->exit_hctx(q->queue_hw_ctx[i], i);
+	}
+	q->mq_ops = NULL;
+	i = q->nr_hw_queues;
+err_hctxs:
+	while (i--)
+		blk_mq_free_hw_ctx(q->queue_hw_ctx[i]);
+	kfree(q->queue_hw_ctx);
+	q->queue_hw_ctx = NULL;
+	q->nr_hw_queues = 0;
+err_ctx:
+	free_percpu(q->queue_ctx);
+	q->queue_ctx = NULL;
+err_queue:
+	blk_cleanup_queue(q);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Called from blk_release_queue() once the last reference is gone.
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+		blk_mq_free_hw_ctx(hctx);
+	}
+
+	kfree(q->queue_hw_ctx);
+	free_percpu(q->queue_ctx);
+	q->queue_hw_ctx = NULL;
+	q->nr_hw_queues = 0;
+	q->mq_ops = NULL;
+}
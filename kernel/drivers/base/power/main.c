@@ -27,10 +27,12 @@
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <linux/async.h>
+#include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
 #include <linux/aee.h>
+#include <linux/pmprof.h>
 
 #include "../base.h"
 #include "power.h"
@@ -78,6 +80,22 @@ struct dpm_watchdog {
 
 static int async_error;
 
+/*
+ * Suspend/resume ordering between devices that are not parent and child.
+ * A supplier is resumed before, and suspended after, each of its consumers,
+ * so that either of them can be handled asynchronously.
+ */
+struct dpm_dependency {
+	struct list_head	node;
+	struct device		*consumer;
+	struct device		*supplier;
+};
+
+static LIST_HEAD(dpm_dependencies);
+static DEFINE_MUTEX(dpm_dependencies_mtx);
+
+static void device_pm_remove_dependencies(struct device *dev);
+
 /**
  * device_pm_sleep_init - Initialize system suspend-related device fields.
  * @dev: Device object being initialized.
@@ -136,6 +154,7 @@ void device_pm_remove(struct device *dev)
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
 	mutex_unlock(&dpm_list_mtx);
+	device_pm_remove_dependencies(dev);
 	device_wakeup_disable(dev);
 	pm_runtime_remove(dev);
 }
@@ -181,25 +200,25 @@ void device_pm_move_last(struct device *dev)
 
 static ktime_t initcall_debug_start(struct device *dev)
 {
-	ktime_t calltime = ktime_set(0, 0);
-
 	if (pm_print_times_enabled) {
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 			dev_name(dev), task_pid_nr(current),
 			dev->parent ? dev_name(dev->parent) : "none");
-		calltime = ktime_get();
 	}
 
-	return calltime;
+	/* Always taken, the per-device table in pmprof needs it */
+	return ktime_get();
 }
 
 static void initcall_debug_report(struct device *dev, ktime_t calltime,
-				  int error)
+				  int error, pm_message_t state, char *info)
 {
 	ktime_t delta, rettime;
 
+	rettime = ktime_get();
+	log_pm_dev(dev, state, info, calltime, rettime, error);
+
 	if (pm_print_times_enabled) {
-		rettime = ktime_get();
 		delta = ktime_sub(rettime, calltime);
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
 			error, (unsigned long long)ktime_to_ns(delta) >> 10);
@@ -231,6 +250,47 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+/**
+ * dpm_wait_for_dependencies - Wait for a device's suppliers or consumers.
+ * @dev: Device to handle.
+ * @async: If unset, wait only for devices handled asynchronously.
+ * @suppliers: Wait for the suppliers of @dev if set, its consumers if not.
+ *
+ * The list lock is dropped while waiting, so that a callback may still
+ * remove devices; each wait therefore rescans past the ones already done.
+ */
+static void dpm_wait_for_dependencies(struct device *dev, bool async,
+				      bool suppliers)
+{
+	struct dpm_dependency *dep;
+	struct device *other;
+	unsigned int done = 0, n;
+
+	for (;;) {
+		other = NULL;
+		n = 0;
+
+		mutex_lock(&dpm_dependencies_mtx);
+		list_for_each_entry(dep, &dpm_dependencies, node) {
+			if ((suppliers ? dep->consumer : dep->supplier) != dev)
+				continue;
+			if (n++ < done)
+				continue;
+			other = get_device(suppliers ? dep->supplier :
+					   dep->consumer);
+			break;
+		}
+		mutex_unlock(&dpm_dependencies_mtx);
+
+		if (!other)
+			return;
+
+		dpm_wait(other, async);
+		put_device(other);
+		done++;
+	}
+}
+
 /**
  * pm_op - Return the PM operation appropriate for given PM event.
  * @ops: PM operations to choose from.
@@ -384,6 +444,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 	hib_log("PM: %s%s%s of devices complete after %ld.%03ld msecs\n",
 		info ?: "", info ? " " : "", pm_verb(state.event),
 		usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
+	log_pm_phase(state, info, starttime, calltime);
 }
 
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
@@ -401,7 +462,7 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 	error = cb(dev);
 	suspend_report_result(cb, error);
 
-	initcall_debug_report(dev, calltime, error);
+	initcall_debug_report(dev, calltime, error, state, info);
 
 	return error;
 }
@@ -654,6 +715,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 		goto Complete;
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_dependencies(dev, async, true);
 	device_lock(dev);
 
 	/*
@@ -1168,7 +1230,7 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 	error = cb(dev, state);
 	suspend_report_result(cb, error);
 
-	initcall_debug_report(dev, calltime, error);
+	initcall_debug_report(dev, calltime, error, state, "legacy ");
 
 	return error;
 }
@@ -1187,6 +1249,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	struct dpm_watchdog wd;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_dependencies(dev, async, false);
 
 	if (async_error)
 		goto Complete;
@@ -1521,6 +1584,7 @@ int dpm_suspend_start(pm_message_t state)
 {
 	int error;
 
+	pmprof_start();
 	error = dpm_prepare(state);
 	if (error) {
 		suspend_stats.failed_prepare++;
@@ -1550,6 +1614,102 @@ int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
 
+static int dpm_move_child_to_tail(struct device *dev, void *data)
+{
+	list_move_tail(&dev->power.entry, &dpm_list);
+	device_for_each_child(dev, NULL, dpm_move_child_to_tail);
+	return 0;
+}
+
+/**
+ * device_pm_add_dependency - Order system suspend/resume of two devices.
+ * @consumer: Device that must be suspended first and resumed last.
+ * @supplier: Device that @consumer relies on.
+ *
+ * Lets @consumer, @supplier or both use async suspend although neither is
+ * the parent of the other. If @consumer comes before @supplier in dpm_list
+ * it is moved to the end, with its children, so that a synchronous walk of
+ * the list can never wait for a device it has not reached yet. Must not be
+ * called during a system transition.
+ */
+int device_pm_add_dependency(struct device *consumer, struct device *supplier)
+{
+	struct dpm_dependency *dep;
+	struct device *dev;
+
+	if (!consumer || !supplier || consumer == supplier)
+		return -EINVAL;
+
+	dep = kzalloc(sizeof(*dep), GFP_KERNEL);
+	if (!dep)
+		return -ENOMEM;
+
+	dep->consumer = consumer;
+	dep->supplier = supplier;
+
+	mutex_lock(&dpm_list_mtx);
+	if (list_empty(&consumer->power.entry) ||
+	    list_empty(&supplier->power.entry) ||
+	    consumer->power.is_prepared || supplier->power.is_prepared) {
+		mutex_unlock(&dpm_list_mtx);
+		kfree(dep);
+		return -EBUSY;
+	}
+
+	/* Does the consumer come before the supplier? */
+	dev = consumer;
+	list_for_each_entry_continue(dev, &dpm_list, power.entry)
+		if (dev == supplier) {
+			dpm_move_child_to_tail(consumer, NULL);
+			break;
+		}
+
+	mutex_lock(&dpm_dependencies_mtx);
+	list_add_tail(&dep->node, &dpm_dependencies);
+	mutex_unlock(&dpm_dependencies_mtx);
+	mutex_unlock(&dpm_list_mtx);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(device_pm_add_dependency);
+
+/**
+ * device_pm_remove_dependency - Undo device_pm_add_dependency().
+ * @consumer: Device that was suspended first and resumed last.
+ * @supplier: Device that @consumer relied on.
+ */
+void device_pm_remove_dependency(struct device *consumer,
+				 struct device *supplier)
+{
+	struct dpm_dependency *dep, *tmp;
+
+	mutex_lock(&dpm_dependencies_mtx);
+	list_for_each_entry_safe(dep, tmp, &dpm_dependencies, node)
+		if (dep->consumer == consumer && dep->supplier == supplier) {
+			list_del(&dep->node);
+			kfree(dep);
+		}
+	mutex_unlock(&dpm_dependencies_mtx);
+}
+EXPORT_SYMBOL_GPL(device_pm_remove_dependency);
+
+/**
+ * device_pm_remove_dependencies - Drop every dependency involving a device.
+ * @dev: Device being removed from the PM core's list.
+ */
+static void device_pm_remove_dependencies(struct device *dev)
+{
+	struct dpm_dependency *dep, *tmp;
+
+	mutex_lock(&dpm_dependencies_mtx);
+	list_for_each_entry_safe(dep, tmp, &dpm_dependencies, node)
+		if (dep->consumer == dev || dep->supplier == dev) {
+			list_del(&dep->node);
+			kfree(dep);
+		}
+	mutex_unlock(&dpm_dependencies_mtx);
+}
+
 /**
  * dpm_for_each_dev - device iterator.
  * @data: data for the callback.
@@ -342,7 +342,8 @@ static ssize_t wakeup_count_show(struct device *dev,
 
 	spin_lock_irq(&dev->power.lock);
 	if (dev->power.wakeup) {
-		count = dev->power.wakeup->event_count;
+		count = dev->power.wakeup->event_count +
+			atomic_read(&dev->power.wakeup->fast_events);
 		enabled = true;
 	}
 	spin_unlock_irq(&dev->power.lock);
@@ -377,7 +378,8 @@ static ssize_t wakeup_abort_count_show(struct device *dev,
 
 	spin_lock_irq(&dev->power.lock);
 	if (dev->power.wakeup) {
-		count = dev->power.wakeup->wakeup_count;
+		count = dev->power.wakeup->wakeup_count +
+			atomic_read(&dev->power.wakeup->fast_wakeups);
 		enabled = true;
 	}
 	spin_unlock_irq(&dev->power.lock);
@@ -16,6 +16,7 @@
 #include <linux/suspend.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/percpu.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -38,21 +39,29 @@ EXPORT_SYMBOL_GPL(count_enable);
 ///@}
 
 /*
- * Combined counters of registered wakeup events and wakeup events in progress.
- * They need to be modified together atomically, so it's better to use one
- * atomic variable to hold them both.
+ * Registered wakeup events are counted per CPU, so that ending one does not
+ * bounce a shared cache line; the sum is only needed when the wakeup count is
+ * read or saved.  The number of wakeup events in progress has to be exact at
+ * all times, so it stays a single atomic that only changes when a wakeup
+ * source is activated or deactivated.
+ *
+ * wakeup_source_deactivate() bumps the registered count before it drops the
+ * in-progress count and split_counters() reads them in the opposite order, so
+ * a reader that sees no events in progress also sees every finished event.
  */
-static atomic_t combined_event_count = ATOMIC_INIT(0);
-
-#define IN_PROGRESS_BITS	(sizeof(int) * 4)
-#define MAX_IN_PROGRESS		((1 << IN_PROGRESS_BITS) - 1)
+static DEFINE_PER_CPU(unsigned int, registered_events);
+static atomic_t events_in_progress = ATOMIC_INIT(0);
 
 static void split_counters(unsigned int *cnt, unsigned int *inpr)
 {
-	unsigned int comb = atomic_read(&combined_event_count);
-
-	*cnt = (comb >> IN_PROGRESS_BITS);
-	*inpr = comb & MAX_IN_PROGRESS;
+	unsigned int sum = 0;
+	int cpu;
+
+	*inpr = atomic_read(&events_in_progress);
+	smp_rmb();
+	for_each_possible_cpu(cpu)
+		sum += per_cpu(registered_events, cpu);
+	*cnt = sum;
 }
 
 /* A preserved old value of the events counter. */
@@ -414,7 +423,7 @@ EXPORT_SYMBOL_GPL(device_set_wakeup_enable);
  */
 static void wakeup_source_activate(struct wakeup_source *ws)
 {
-	unsigned int cec;
+	unsigned int inpr;
 
 	/*
 	 * active wakeup source should bring the system
@@ -433,9 +442,9 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 	}
 
 	/* Increment the counter of events in progress. */
-	cec = atomic_inc_return(&combined_event_count);
+	inpr = atomic_inc_return(&events_in_progress);
 
-	trace_wakeup_source_activate(ws->name, cec);
+	trace_wakeup_source_activate(ws->name, inpr);
 }
 
 /**
@@ -456,6 +465,67 @@ static void wakeup_source_report_event(struct wakeup_source *ws)
 		wakeup_source_activate(ws);
 }
 
+/**
+ * wakeup_source_extend_timeout - Push the end of a pending timeout out.
+ * @ws: Wakeup source to handle.
+ * @expires: New expiration time, in jiffies.
+ *
+ * Move @ws->timer_expires forward to @expires without touching the timer;
+ * pm_wakeup_timer_fn() re-arms it when it finds the expiration time moved.
+ * Return false if @ws has no timeout pending, in which case the caller has to
+ * set one up under @ws->lock.
+ */
+static bool wakeup_source_extend_timeout(struct wakeup_source *ws,
+					 unsigned long expires)
+{
+	unsigned long old = ACCESS_ONCE(ws->timer_expires);
+	unsigned long prev;
+
+	while (old && time_after(expires, old)) {
+		prev = cmpxchg(&ws->timer_expires, old, expires);
+		if (prev == old)
+			return true;
+		old = prev;
+	}
+
+	return old != 0;
+}
+
+/**
+ * wakeup_source_report_fast - Report an event for an active wakeup source.
+ * @ws: Wakeup source to report the event for.
+ * @expires: End of the "no suspend" period, or 0 for no timeout.
+ *
+ * Drivers that report an event per packet or per sample mostly find their
+ * wakeup source already active, and then the event only has to be counted and
+ * the pending timeout, if any, extended.  Do that without taking @ws->lock or
+ * modifying the timer.  The counts are folded into @ws by
+ * wakeup_source_deactivate().
+ *
+ * A report racing with the deactivation of @ws behaves as if it had come just
+ * before it.  Return false if the slow path has to be taken instead.
+ */
+static bool wakeup_source_report_fast(struct wakeup_source *ws,
+				      unsigned long expires)
+{
+	if (!ws->active || count_enable)
+		return false;
+
+	if (expires) {
+		if (!wakeup_source_extend_timeout(ws, expires))
+			return false;
+	} else if (ACCESS_ONCE(ws->timer_expires)) {
+		/* __pm_stay_awake() has to cancel the timeout */
+		return false;
+	}
+
+	atomic_inc(&ws->fast_events);
+	/* This is racy, but the counter is approximate anyway. */
+	if (events_check_enabled)
+		atomic_inc(&ws->fast_wakeups);
+	return true;
+}
+
 /**
  * __pm_stay_awake - Notify the PM core of a wakeup event.
  * @ws: Wakeup source object associated with the source of the event.
@@ -472,6 +542,9 @@ void __pm_stay_awake(struct wakeup_source *ws)
 	//<20130327> <marc.huang> add wakeup source dubug log
 	wakeup_log("ws->name: %s\n", ws->name);
 
+	if (wakeup_source_report_fast(ws, 0))
+		return;
+
 	spin_lock_irqsave(&ws->lock, flags);
 
 	wakeup_source_report_event(ws);
@@ -517,6 +590,16 @@ static inline void update_prevent_sleep_time(struct wakeup_source *ws,
 					     ktime_t now) {}
 #endif
 
+static unsigned int wakeup_hold_bucket(ktime_t duration)
+{
+	s64 ms = ktime_to_ms(duration);
+
+	if (ms <= 0)
+		return 0;
+
+	return min_t(unsigned int, ilog2(ms) + 1, WAKEUP_HOLD_BUCKETS - 1);
+}
+
 /**
  * wakup_source_deactivate - Mark given wakeup source as inactive.
  * @ws: Wakeup source to handle.
@@ -527,7 +610,7 @@ static inline void update_prevent_sleep_time(struct wakeup_source *ws,
  */
 static void wakeup_source_deactivate(struct wakeup_source *ws)
 {
-	unsigned int cnt, inpr, cec;
+	unsigned int inpr;
 	ktime_t duration;
 	ktime_t now;
 
@@ -554,6 +637,14 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	if (ktime_to_ns(duration) > ktime_to_ns(ws->max_time))
 		ws->max_time = duration;
 
+	ws->hold_hist[wakeup_hold_bucket(duration)]++;
+
+	/* Fold in what wakeup_source_report_fast() counted meanwhile. */
+	if (atomic_read(&ws->fast_events)) {
+		ws->event_count += atomic_xchg(&ws->fast_events, 0);
+		ws->wakeup_count += atomic_xchg(&ws->fast_wakeups, 0);
+	}
+
 	ws->last_time = now;
 	del_timer(&ws->timer);
 	ws->timer_expires = 0;
@@ -566,15 +657,14 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	}
 
 	/*
-	 * Increment the counter of registered wakeup events and decrement the
-	 * couter of wakeup events in progress simultaneously.
+	 * Increment the counter of registered wakeup events before decrementing
+	 * the counter of wakeup events in progress, see split_counters().  The
+	 * value-returning atomic orders the two.
 	 */
-    // FIXME: CHECK BUG here ??? if combined_event_count = 0x????0000, then atomic_add_return(...) --> 0x????ffff
-    //        , which is not the expected result !!!
-	cec = atomic_add_return(MAX_IN_PROGRESS, &combined_event_count);
-	trace_wakeup_source_deactivate(ws->name, cec);
+	this_cpu_inc(registered_events);
+	inpr = atomic_dec_return(&events_in_progress);
+	trace_wakeup_source_deactivate(ws->name, inpr);
 
-	split_counters(&cnt, &inpr);
 	if (!inpr && waitqueue_active(&wakeup_count_wait_queue))
 		wake_up(&wakeup_count_wait_queue);
 }
@@ -630,19 +720,28 @@ EXPORT_SYMBOL_GPL(pm_relax);
  *
  * Call wakeup_source_deactivate() for the wakeup source whose address is stored
  * in @data if it is currently active and its timer has not been canceled and
- * the expiration time of the timer is not in future.
+ * the expiration time of the timer is not in future.  If the expiration time
+ * has been pushed out by wakeup_source_extend_timeout(), re-arm the timer.
  */
 static void pm_wakeup_timer_fn(unsigned long data)
 {
 	struct wakeup_source *ws = (struct wakeup_source *)data;
 	unsigned long flags;
+	unsigned long expires;
 
 	spin_lock_irqsave(&ws->lock, flags);
 
-	if (ws->active && ws->timer_expires
-	    && time_after_eq(jiffies, ws->timer_expires)) {
-		wakeup_source_deactivate(ws);
-		ws->expire_count++;
+	while (ws->active && (expires = ACCESS_ONCE(ws->timer_expires))) {
+		if (time_before(jiffies, expires)) {
+			mod_timer(&ws->timer, expires);
+			break;
+		}
+		/* Lost against an extension?  Look at the new value. */
+		if (cmpxchg(&ws->timer_expires, expires, 0) == expires) {
+			wakeup_source_deactivate(ws);
+			ws->expire_count++;
+			break;
+		}
 	}
 
 	spin_unlock_irqrestore(&ws->lock, flags);
@@ -671,6 +770,13 @@ void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
 	//<20130327> <marc.huang> add wakeup source dubug log
 	wakeup_log("ws->name: %s\n", ws->name);
 
+	expires = jiffies + msecs_to_jiffies(msec);
+	if (!expires)
+		expires = 1;
+
+	if (msec && wakeup_source_report_fast(ws, expires))
+		return;
+
 	spin_lock_irqsave(&ws->lock, flags);
 
 	wakeup_source_report_event(ws);
@@ -680,11 +786,8 @@ void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
 		goto unlock;
 	}
 
-	expires = jiffies + msecs_to_jiffies(msec);
-	if (!expires)
-		expires = 1;
-
-	if (!ws->timer_expires || time_after(expires, ws->timer_expires)) {
+	/* Nothing but this path arms the timer, and only under ws->lock. */
+	if (!wakeup_source_extend_timeout(ws, expires)) {
 		mod_timer(&ws->timer, expires);
 		ws->timer_expires = expires;
 	}
@@ -880,6 +983,8 @@ static int print_wakeup_source_stats(struct seq_file *m,
 	ktime_t total_time;
 	ktime_t max_time;
 	unsigned long active_count;
+	unsigned long event_count;
+	unsigned long wakeup_count;
 	ktime_t active_time;
 	ktime_t prevent_sleep_time;
 	int ret;
@@ -890,6 +995,8 @@ static int print_wakeup_source_stats(struct seq_file *m,
 	max_time = ws->max_time;
 	prevent_sleep_time = ws->prevent_sleep_time;
 	active_count = ws->active_count;
+	event_count = ws->event_count + atomic_read(&ws->fast_events);
+	wakeup_count = ws->wakeup_count + atomic_read(&ws->fast_wakeups);
 	if (ws->active) {
 		ktime_t now = ktime_get();
 
@@ -907,8 +1014,8 @@ static int print_wakeup_source_stats(struct seq_file *m,
 
 	ret = seq_printf(m, "%-12s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t"
 			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
-			ws->name, active_count, ws->event_count,
-			ws->wakeup_count, ws->expire_count,
+			ws->name, active_count, event_count,
+			wakeup_count, ws->expire_count,
 			ktime_to_ms(active_time), ktime_to_ms(total_time),
 			ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
 			ktime_to_ms(prevent_sleep_time));
@@ -951,10 +1058,65 @@ static const struct file_operations wakeup_sources_stats_fops = {
 	.release = single_release,
 };
 
+/**
+ * wakeup_sources_hist_show - Print how long wakeup sources stay active.
+ * @m: seq_file to print the histograms into.
+ *
+ * One line per wakeup source that has been deactivated at least once, with the
+ * number of active periods that ended in each power of two bucket.
+ */
+static int wakeup_sources_hist_show(struct seq_file *m, void *unused)
+{
+	unsigned int hist[WAKEUP_HOLD_BUCKETS];
+	struct wakeup_source *ws;
+	unsigned long relax_count;
+	unsigned long flags;
+	int i;
+
+	seq_puts(m, "name\t");
+	for (i = 0; i < WAKEUP_HOLD_BUCKETS - 1; i++)
+		seq_printf(m, "\t<%ums", 1U << i);
+	seq_printf(m, "\t>=%ums\n", 1U << (WAKEUP_HOLD_BUCKETS - 2));
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		relax_count = ws->relax_count;
+		memcpy(hist, ws->hold_hist, sizeof(hist));
+		spin_unlock_irqrestore(&ws->lock, flags);
+
+		if (!relax_count)
+			continue;
+
+		seq_printf(m, "%-12s", ws->name);
+		for (i = 0; i < WAKEUP_HOLD_BUCKETS; i++)
+			seq_printf(m, "\t%u", hist[i]);
+		seq_putc(m, '\n');
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int wakeup_sources_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_sources_hist_show, NULL);
+}
+
+static const struct file_operations wakeup_sources_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakeup_sources_debugfs_init(void)
 {
 	wakeup_sources_stats_dentry = debugfs_create_file("wakeup_sources",
 			S_IRUGO, NULL, NULL, &wakeup_sources_stats_fops);
+	debugfs_create_file("wakeup_sources_hist", S_IRUGO, NULL, NULL,
+			    &wakeup_sources_hist_fops);
 	return 0;
 }
 
@@ -85,6 +85,9 @@ static DEFINE_MUTEX(loop_index_mutex);
 static int max_part;
 static int part_shift;
 
+/* Clones for LO_FLAGS_DIRECT_IO remapping onto a backing block device */
+static struct bio_set *loop_bio_set;
+
 /*
  * Transfer functions
  */
@@ -465,6 +468,128 @@ out:
 	return ret;
 }
 
+/*
+ * Direct I/O mode.
+ *
+ * In buffered mode every block of the loop device ends up cached twice, once
+ * for the loop device itself and once in the backing page cache, and
+ * lo_thread services one bio at a time. With LO_FLAGS_DIRECT_IO on a backing
+ * block device, lo_thread only remaps each bio onto it and submits it
+ * asynchronously, so nothing is copied or cached by loop at all and any
+ * number of bios are in flight.
+ */
+static int loop_flush(struct loop_device *lo);
+static int loop_dio_enter(struct loop_device *lo);
+
+struct loop_dio {
+	struct loop_device	*lo;
+	struct bio		*bio;
+};
+
+static void loop_dio_done(struct loop_device *lo, struct loop_dio *ld)
+{
+	kfree(ld);
+	if (atomic_dec_and_test(&lo->lo_dio_inflight))
+		wake_up(&lo->lo_dio_wait);
+}
+
+/* Wait for all bios handed off in direct I/O mode to complete */
+static void loop_dio_drain(struct loop_device *lo)
+{
+	wait_event(lo->lo_dio_wait, !atomic_read(&lo->lo_dio_inflight));
+}
+
+static void loop_dio_remap_endio(struct bio *clone, int error)
+{
+	struct loop_dio *ld = clone->bi_private;
+
+	bio_put(clone);
+	bio_endio(ld->bio, error);
+	loop_dio_done(ld->lo, ld);
+}
+
+/*
+ * Hand @bio off for direct I/O. Returns 0 if it was, otherwise the caller
+ * has to service it synchronously.
+ */
+static int loop_dio_submit(struct loop_device *lo, struct bio *bio)
+{
+	struct inode *inode = lo->lo_backing_file->f_mapping->host;
+	struct loop_dio *ld;
+	struct bio *clone;
+
+	ld = kmalloc(sizeof(*ld), GFP_NOIO);
+	if (!ld)
+		return -ENOMEM;
+	ld->lo = lo;
+	ld->bio = bio;
+
+	atomic_inc(&lo->lo_dio_inflight);
+	atomic64_inc(&lo->lo_dio_bios);
+
+	clone = bio_clone_bioset(bio, GFP_NOIO, loop_bio_set);
+	if (!clone) {
+		loop_dio_done(lo, ld);
+		return -ENOMEM;
+	}
+	clone->bi_bdev = inode->i_bdev;
+	clone->bi_sector += lo->lo_offset >> 9;
+	clone->bi_end_io = loop_dio_remap_endio;
+	clone->bi_private = ld;
+	generic_make_request(clone);
+	return 0;
+}
+
+/*
+ * Direct I/O needs the data to go through untransformed, sector aligned,
+ * to a backing block device. 3.10's ->direct_IO only takes user iovecs,
+ * so a backing file has no way to bypass its page cache for bio pages.
+ */
+static bool loop_dio_supported(struct loop_device *lo)
+{
+	struct inode *inode = lo->lo_backing_file->f_mapping->host;
+
+	if (lo->transfer != transfer_none)
+		return false;
+	return S_ISBLK(inode->i_mode) && !(lo->lo_offset & 511);
+}
+
+static int loop_set_dio(struct loop_device *lo, unsigned long arg)
+{
+	struct address_space *mapping;
+	int err;
+
+	if (lo->lo_state != Lo_bound)
+		return -ENXIO;
+	if (!!arg == !!(lo->lo_flags & LO_FLAGS_DIRECT_IO))
+		return 0;
+
+	mapping = lo->lo_backing_file->f_mapping;
+	if (arg) {
+		if (!loop_dio_supported(lo))
+			return -EINVAL;
+		/*
+		 * Remapped bios bypass the backing page cache, so it must not
+		 * hold anything a buffered bio put there. Finish the queued
+		 * bios and empty the cache here, then do it again (cheaply)
+		 * from lo_thread while switching, so no buffered bio can slip
+		 * in between.
+		 */
+		err = loop_flush(lo);
+		if (err)
+			return err;
+		err = filemap_write_and_wait(mapping);
+		if (err)
+			return err;
+		invalidate_mapping_pages(mapping, 0, -1);
+		return loop_dio_enter(lo);
+	}
+
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	/* lo_thread may have picked up the old mode: push a barrier through */
+	return loop_flush(lo);
+}
+
 /*
  * Add bio to back of pending list
  */
@@ -514,6 +639,8 @@ out:
 
 struct switch_request {
 	struct file *file;
+	bool enter_dio;
+	int error;
 	struct completion wait;
 };
 
@@ -522,8 +649,12 @@ static void do_loop_switch(struct loop_device *, struct switch_request *);
 static inline void loop_handle_bio(struct loop_device *lo, struct bio *bio)
 {
 	if (unlikely(!bio->bi_bdev)) {
+		loop_dio_drain(lo);
 		do_loop_switch(lo, bio->bi_private);
 		bio_put(bio);
+	} else if ((lo->lo_flags & LO_FLAGS_DIRECT_IO) &&
+		   !loop_dio_submit(lo, bio)) {
+		return;
 	} else {
 		int ret = do_bio_filebacked(lo, bio);
 		bio_endio(bio, ret);
@@ -575,7 +706,8 @@ static int loop_thread(void *data)
  * First it needs to flush existing IO, it does this by sending a magic
  * BIO down the pipe. The completion of this BIO does the actual switch.
  */
-static int loop_switch(struct loop_device *lo, struct file *file)
+static int __loop_switch(struct loop_device *lo, struct file *file,
+			 bool enter_dio)
 {
 	struct switch_request w;
 	struct bio *bio = bio_alloc(GFP_KERNEL, 0);
@@ -583,11 +715,27 @@ static int loop_switch(struct loop_device *lo, struct file *file)
 		return -ENOMEM;
 	init_completion(&w.wait);
 	w.file = file;
+	w.enter_dio = enter_dio;
+	w.error = 0;
 	bio->bi_private = &w;
 	bio->bi_bdev = NULL;
 	loop_make_request(lo->lo_queue, bio);
 	wait_for_completion(&w.wait);
-	return 0;
+	return w.error;
+}
+
+static int loop_switch(struct loop_device *lo, struct file *file)
+{
+	return __loop_switch(lo, file, false);
+}
+
+/*
+ * Turn on LO_FLAGS_DIRECT_IO from lo_thread, once every bio queued before
+ * it has been serviced and the backing page cache emptied.
+ */
+static int loop_dio_enter(struct loop_device *lo)
+{
+	return __loop_switch(lo, NULL, true);
 }
 
 /*
@@ -611,6 +759,16 @@ static void do_loop_switch(struct loop_device *lo, struct switch_request *p)
 	struct file *old_file = lo->lo_backing_file;
 	struct address_space *mapping;
 
+	if (p->enter_dio) {
+		mapping = old_file->f_mapping;
+		p->error = filemap_write_and_wait(mapping);
+		if (!p->error) {
+			invalidate_mapping_pages(mapping, 0, -1);
+			lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+		}
+		goto out;
+	}
+
 	/* if no new file, only flush of queued bios requested */
 	if (!file)
 		goto out;
@@ -673,6 +831,9 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 	if (error)
 		goto out_putf;
 
+	if ((lo->lo_flags & LO_FLAGS_DIRECT_IO) && !loop_dio_supported(lo))
+		loop_set_dio(lo, 0);
+
 	fput(old_file);
 	if (lo->lo_flags & LO_FLAGS_PARTSCAN)
 		ioctl_by_bdev(bdev, BLKRRPART, 0);
@@ -758,11 +919,27 @@ static ssize_t loop_attr_partscan_show(struct loop_device *lo, char *buf)
 	return sprintf(buf, "%s\n", partscan ? "1" : "0");
 }
 
+static ssize_t loop_attr_dio_show(struct loop_device *lo, char *buf)
+{
+	int dio = (lo->lo_flags & LO_FLAGS_DIRECT_IO);
+
+	return sprintf(buf, "%s\n", dio ? "1" : "0");
+}
+
+static ssize_t loop_attr_dio_stat_show(struct loop_device *lo, char *buf)
+{
+	return sprintf(buf, "%llu %d\n",
+		       (unsigned long long)atomic64_read(&lo->lo_dio_bios),
+		       atomic_read(&lo->lo_dio_inflight));
+}
+
 LOOP_ATTR_RO(backing_file);
 LOOP_ATTR_RO(offset);
 LOOP_ATTR_RO(sizelimit);
 LOOP_ATTR_RO(autoclear);
 LOOP_ATTR_RO(partscan);
+LOOP_ATTR_RO(dio);
+LOOP_ATTR_RO(dio_stat);
 
 static struct attribute *loop_attrs[] = {
 	&loop_attr_backing_file.attr,
@@ -770,6 +947,8 @@ static struct attribute *loop_attrs[] = {
 	&loop_attr_sizelimit.attr,
 	&loop_attr_autoclear.attr,
 	&loop_attr_partscan.attr,
+	&loop_attr_dio.attr,
+	&loop_attr_dio_stat.attr,
 	NULL,
 };
 
@@ -889,6 +1068,7 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	lo->ioctl = NULL;
 	lo->lo_sizelimit = 0;
 	lo->lo_bio_count = 0;
+	atomic64_set(&lo->lo_dio_bios, 0);
 	lo->old_gfp_mask = mapping_gfp_mask(mapping);
 	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
 
@@ -1015,6 +1195,8 @@ static int loop_clr_fd(struct loop_device *lo)
 
 	kthread_stop(lo->lo_thread);
 
+	loop_dio_drain(lo);
+
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_backing_file = NULL;
 	spin_unlock_irq(&lo->lo_lock);
@@ -1063,7 +1245,7 @@ static int loop_clr_fd(struct loop_device *lo)
 }
 
 static int
-loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
+__loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 {
 	int err;
 	struct loop_func_table *xfer;
@@ -1137,6 +1319,30 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	return 0;
 }
 
+/*
+ * A new transfer function or offset may rule out direct I/O: leave it
+ * while the status changes, so no remapped bio sees a half-updated device,
+ * and only return to it if it is still supported.
+ */
+static int
+loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
+{
+	bool dio = lo->lo_flags & LO_FLAGS_DIRECT_IO;
+	int err;
+
+	if (dio) {
+		err = loop_set_dio(lo, 0);
+		if (err)
+			return err;
+	}
+
+	err = __loop_set_status(lo, info);
+
+	if (dio && lo->lo_state == Lo_bound && loop_dio_supported(lo))
+		loop_set_dio(lo, 1);
+	return err;
+}
+
 static int
 loop_get_status(struct loop_device *lo, struct loop_info64 *info)
 {
@@ -1327,6 +1533,11 @@ static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
 			err = loop_set_capacity(lo, bdev);
 		break;
+	case LOOP_SET_DIRECT_IO:
+		err = -EPERM;
+		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
+			err = loop_set_dio(lo, arg);
+		break;
 	default:
 		err = lo->ioctl ? lo->ioctl(lo, cmd, arg) : -EINVAL;
 	}
@@ -1481,6 +1692,7 @@ static int lo_compat_ioctl(struct block_device *bdev, fmode_t mode,
 		arg = (unsigned long) compat_ptr(arg);
 	case LOOP_SET_FD:
 	case LOOP_CHANGE_FD:
+	case LOOP_SET_DIRECT_IO:
 		err = lo_ioctl(bdev, mode, cmd, arg);
 		break;
 	default:
@@ -1666,6 +1878,8 @@ static int loop_add(struct loop_device **l, int i)
 	lo->lo_thread		= NULL;
 	init_waitqueue_head(&lo->lo_event);
 	init_waitqueue_head(&lo->lo_req_wait);
+	init_waitqueue_head(&lo->lo_dio_wait);
+	atomic_set(&lo->lo_dio_inflight, 0);
 	spin_lock_init(&lo->lo_lock);
 	disk->major		= LOOP_MAJOR;
 	disk->first_minor	= i << part_shift;
@@ -1824,9 +2038,13 @@ static int __init loop_init(void)
 	struct loop_device *lo;
 	int err;
 
+	loop_bio_set = bioset_create(BIO_POOL_SIZE, 0);
+	if (!loop_bio_set)
+		return -ENOMEM;
+
 	err = misc_register(&loop_misc);
 	if (err < 0)
-		return err;
+		goto bioset_out;
 
 	part_shift = 0;
 	if (max_part > 0) {
@@ -1888,6 +2106,8 @@ static int __init loop_init(void)
 
 misc_out:
 	misc_deregister(&loop_misc);
+bioset_out:
+	bioset_free(loop_bio_set);
 	return err;
 }
 
@@ -1912,6 +2132,7 @@ static void __exit loop_exit(void)
 	unregister_blkdev(LOOP_MAJOR, "loop");
 
 	misc_deregister(&loop_misc);
+	bioset_free(loop_bio_set);
 }
 
 module_init(loop_init);
@@ -2,6 +2,7 @@
 #include <linux/spinlock.h>
 #include <linux/slab.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/hdreg.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -17,6 +18,10 @@
 static bool use_bio;
 module_param(use_bio, bool, S_IRUGO);
 
+static bool use_mq;
+module_param(use_mq, bool, S_IRUGO);
+MODULE_PARM_DESC(use_mq, "Submit through per-cpu software queues (blk-mq)");
+
 static int major;
 static DEFINE_IDA(vd_index_ida);
 
@@ -231,6 +236,12 @@ static inline void virtblk_request_done(struct virtblk_req *vbr)
 		req->errors = (error != 0);
 	}
 
+	/* with blk-mq the vbr lives in the request itself */
+	if (use_mq) {
+		blk_mq_end_io(req, error);
+		return;
+	}
+
 	__blk_end_request_all(req, error);
 	mempool_free(vbr, vblk->pool);
 }
@@ -294,25 +305,20 @@ static void virtblk_done(struct virtqueue *vq)
 		}
 	} while (!virtqueue_enable_cb(vq));
 	/* In case queue is stopped waiting for more buffers. */
-	if (req_done)
-		blk_start_queue(vblk->disk->queue);
+	if (req_done) {
+		if (use_mq)
+			blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
+		else
+			blk_start_queue(vblk->disk->queue);
+	}
 	spin_unlock_irqrestore(vblk->disk->queue->queue_lock, flags);
 
 	if (bio_done)
 		wake_up(&vblk->queue_wait);
 }
 
-static bool do_req(struct request_queue *q, struct virtio_blk *vblk,
-		   struct request *req)
+static void virtblk_prep_hdr(struct virtblk_req *vbr, struct request *req)
 {
-	unsigned int num;
-	struct virtblk_req *vbr;
-
-	vbr = virtblk_alloc_req(vblk, GFP_ATOMIC);
-	if (!vbr)
-		/* When another request finishes we'll try again. */
-		return false;
-
 	vbr->req = req;
 	vbr->bio = NULL;
 	if (req->cmd_flags & REQ_FLUSH) {
@@ -341,6 +347,20 @@ static bool do_req(struct request_queue *q, struct virtio_blk *vblk,
 			BUG();
 		}
 	}
+}
+
+static bool do_req(struct request_queue *q, struct virtio_blk *vblk,
+		   struct request *req)
+{
+	unsigned int num;
+	struct virtblk_req *vbr;
+
+	vbr = virtblk_alloc_req(vblk, GFP_ATOMIC);
+	if (!vbr)
+		/* When another request finishes we'll try again. */
+		return false;
+
+	virtblk_prep_hdr(vbr, req);
 
 	num = blk_rq_map_sg(q, vbr->req, vblk->sg);
 	if (num) {
@@ -381,6 +401,51 @@ static void virtblk_request(struct request_queue *q)
 		virtqueue_kick(vblk->vq);
 }
 
+/*
+ * blk-mq entry point.  ->queue_rq() runs concurrently on several cpus, so
+ * unlike virtblk_request() each request maps its data into its own sg
+ * table, and only the virtqueue itself is serialised on the queue lock.
+ */
+static int virtblk_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *req)
+{
+	struct virtio_blk *vblk = hctx->queue->queuedata;
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	spinlock_t *lock = vblk->disk->queue->queue_lock;
+	unsigned long flags;
+	unsigned int num;
+
+	BUG_ON(req->nr_phys_segments + 2 > vblk->sg_elems);
+
+	vbr->vblk = vblk;
+	virtblk_prep_hdr(vbr, req);
+
+	sg_init_table(vbr->sg, vblk->sg_elems);
+	num = blk_rq_map_sg(hctx->queue, req, vbr->sg);
+	if (num) {
+		if (rq_data_dir(req) == WRITE)
+			vbr->out_hdr.type |= VIRTIO_BLK_T_OUT;
+		else
+			vbr->out_hdr.type |= VIRTIO_BLK_T_IN;
+	}
+
+	spin_lock_irqsave(lock, flags);
+	if (__virtblk_add_req(vblk->vq, vbr, vbr->sg, num) < 0) {
+		/* virtblk_done() restarts us once the ring drains */
+		virtqueue_kick(vblk->vq);
+		blk_mq_stop_hw_queue(hctx);
+		spin_unlock_irqrestore(lock, flags);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+	virtqueue_kick(vblk->vq);
+	spin_unlock_irqrestore(lock, flags);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static struct blk_mq_ops virtio_mq_ops = {
+	.queue_rq	= virtblk_queue_rq,
+};
+
 static void virtblk_make_request(struct request_queue *q, struct bio *bio)
 {
 	struct virtio_blk *vblk = q->queuedata;
@@ -745,13 +810,32 @@ static int virtblk_probe(struct virtio_device *vdev)
 		goto out_mempool;
 	}
 
-	q = vblk->disk->queue = blk_init_queue(virtblk_request, NULL);
+	if (use_mq) {
+		struct blk_mq_reg reg = {
+			.ops		= &virtio_mq_ops,
+			.nr_hw_queues	= 1,
+			.numa_node	= NUMA_NO_NODE,
+		};
+
+		/* one virtqueue, so one hardware context as deep as the ring */
+		reg.queue_depth = min_t(unsigned int,
+					virtqueue_get_vring_size(vblk->vq),
+					BLK_MQ_MAX_DEPTH);
+		reg.cmd_size = sizeof(struct virtblk_req) +
+			sizeof(struct scatterlist) * sg_elems;
+		q = blk_mq_init_queue(&reg, vblk);
+		if (IS_ERR(q))
+			q = NULL;
+	} else {
+		q = blk_init_queue(virtblk_request, NULL);
+	}
+	vblk->disk->queue = q;
 	if (!q) {
 		err = -ENOMEM;
 		goto out_put_disk;
 	}
 
-	if (use_bio)
+	if (use_bio && !use_mq)
 		blk_queue_make_request(q, virtblk_make_request);
 	q->queuedata = vblk;
 
@@ -914,9 +998,17 @@ static int virtblk_freeze(struct virtio_device *vdev)
 
 	flush_work(&vblk->config_work);
 
-	spin_lock_irq(vblk->disk->queue->queue_lock);
-	blk_stop_queue(vblk->disk->queue);
-	spin_unlock_irq(vblk->disk->queue->queue_lock);
+	if (use_mq) {
+		struct blk_mq_hw_ctx *hctx;
+		int i;
+
+		queue_for_each_hw_ctx(vblk->disk->queue, hctx, i)
+			blk_mq_stop_hw_queue(hctx);
+	} else {
+		spin_lock_irq(vblk->disk->queue->queue_lock);
+		blk_stop_queue(vblk->disk->queue);
+		spin_unlock_irq(vblk->disk->queue->queue_lock);
+	}
 	blk_sync_queue(vblk->disk->queue);
 
 	vdev->config->del_vqs(vdev);
@@ -930,7 +1022,9 @@ static int virtblk_restore(struct virtio_device *vdev)
 
 	vblk->config_enable = true;
 	ret = init_vq(vdev->priv);
-	if (!ret) {
+	if (!ret && use_mq) {
+		blk_mq_start_stopped_hw_queues(vblk->disk->queue, false);
+	} else if (!ret) {
 		spin_lock_irq(vblk->disk->queue->queue_lock);
 		blk_start_queue(vblk->disk->queue);
 		spin_unlock_irq(vblk->disk->queue->queue_lock);
@@ -96,12 +96,34 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 	dev->last_residency = (int) diff;
 
 	if (entered_state >= 0) {
+		struct cpuidle_state_usage *su = &dev->states_usage[entered_state];
+		int i;
+
 		/* Update cpuidle counters */
 		/* This can be moved to within driver enter routine
 		 * but that results in multiple copies of same code.
 		 */
-		dev->states_usage[entered_state].time += dev->last_residency;
-		dev->states_usage[entered_state].usage++;
+		su->time += dev->last_residency;
+		su->usage++;
+
+		/*
+		 * Count the misses: idle periods too short for the state
+		 * entered, and ones long enough for the next deeper state.
+		 */
+		if (dev->last_residency <
+				drv->states[entered_state].target_residency) {
+			su->above++;
+		} else {
+			for (i = entered_state + 1; i < drv->state_count; i++) {
+				if (drv->states[i].disabled ||
+						dev->states_usage[i].disable)
+					continue;
+				if (dev->last_residency >=
+						drv->states[i].target_residency)
+					su->below++;
+				break;
+			}
+		}
 	} else {
 		dev->last_residency = 0;
 	}
@@ -0,0 +1,632 @@
+/*
+ * predict.c - the predictive idle governor
+ *
+ * The next timer event bounds how long a CPU can stay idle, but on a
+ * phone most idle periods are cut short by something else: device
+ * interrupts, IPIs, the modem.  Going by the timer alone picks deep
+ * states that are left again before they pay off.
+ *
+ * This governor splits wakeups into the ones the timer caused and the
+ * early ones, and learns both per CPU.  Each idle state has a bin
+ * covering the durations from its target residency up to the next
+ * state's; the bins keep decaying counts of timer hits and early
+ * wakeups.  When early wakeups below the state the timer allows have
+ * recently outnumbered the periods that lasted long enough for it, the
+ * shallower state most of them ended in is chosen instead.  On top of
+ * that the last few idle durations are checked for a repeating interval,
+ * as the menu governor does.
+ *
+ * The last idle periods of each CPU can be read back from debugfs and
+ * replayed through the same code against the current driver's states,
+ * to compare the energy and exit latency it would cost with a timer-only
+ * choice and with the ideal one:
+ *
+ *   cat /sys/kernel/debug/cpuidle_predict/trace > trace.txt
+ *   cat trace.txt > /sys/kernel/debug/cpuidle_predict/replay
+ *   cat /sys/kernel/debug/cpuidle_predict/replay
+ *
+ * A trace is one "<cpu> <us to next timer> <us idle>" line per period.
+ *
+ * This code is licenced under the GPL.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#define PRED_INTERVALS		8
+#define PRED_DECAY_SHIFT	3
+#define PRED_PULSE		1024
+#define PRED_MAX_INTERVAL	USEC_PER_SEC
+#define PRED_TRACE_LEN		256
+
+struct pred_bin {
+	unsigned int	hits;		/* idle periods ended by the timer */
+	unsigned int	early;		/* idle periods ended by anything else */
+};
+
+struct pred_data {
+	struct pred_bin	bins[CPUIDLE_STATE_MAX];
+	unsigned int	intervals[PRED_INTERVALS];
+	int		interval_ptr;
+	unsigned int	sleep_us;	/* time to the next timer at select */
+	int		last_state_idx;
+	int		needs_update;
+};
+
+struct pred_sample {
+	unsigned int	sleep_us;
+	unsigned int	idle_us;
+};
+
+struct pred_device {
+	struct pred_data	data;
+	struct pred_sample	trace[PRED_TRACE_LEN];
+	unsigned int		trace_ptr;
+};
+
+static DEFINE_PER_CPU(struct pred_device, pred_devices);
+
+static bool pred_state_enabled(struct cpuidle_driver *drv,
+			       struct cpuidle_device *dev, int i)
+{
+	if (drv->states[i].disabled)
+		return false;
+	return !dev || !dev->states_usage[i].disable;
+}
+
+/* the bin of a duration is the deepest state it pays off */
+static int pred_bin_of(struct cpuidle_driver *drv, unsigned int us)
+{
+	int i;
+
+	for (i = drv->state_count - 1; i > 0; i--)
+		if (us >= drv->states[i].target_residency)
+			break;
+	return i;
+}
+
+/*
+ * Try detecting repeating patterns in the last few idle periods: if
+ * their standard deviation is small, leaving out at most a quarter of
+ * them as outliers on the upside, their average is what comes next.
+ * Returns 0 when there is no such pattern.
+ */
+static unsigned int pred_typical_interval(struct pred_data *data)
+{
+	unsigned int thresh = UINT_MAX, max, divisor;
+	u64 avg, variance;
+	int i;
+
+again:
+	max = divisor = 0;
+	avg = variance = 0;
+	for (i = 0; i < PRED_INTERVALS; i++) {
+		unsigned int value = data->intervals[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	do_div(avg, divisor);
+
+	for (i = 0; i < PRED_INTERVALS; i++) {
+		unsigned int value = data->intervals[i];
+
+		if (value <= thresh) {
+			s64 diff = (s64)value - (s64)avg;
+
+			variance += diff * diff;
+		}
+	}
+	do_div(variance, divisor);
+
+	/* standard deviation below a sixth of the average, or below 20us */
+	if (avg * avg > variance * 36 || variance <= 400)
+		return avg;
+
+	if (divisor * 4 > PRED_INTERVALS * 3) {
+		thresh = max - 1;
+		goto again;
+	}
+	return 0;
+}
+
+/**
+ * pred_update - learns from the idle period that just ended
+ * @drv: cpuidle driver containing state data
+ * @data: prediction state of the CPU
+ * @measured_us: time from entering the state to the wakeup event
+ */
+static void pred_update(struct cpuidle_driver *drv, struct pred_data *data,
+			unsigned int measured_us)
+{
+	int i;
+
+	for (i = 0; i < drv->state_count; i++) {
+		data->bins[i].hits -= data->bins[i].hits >> PRED_DECAY_SHIFT;
+		data->bins[i].early -= data->bins[i].early >> PRED_DECAY_SHIFT;
+	}
+
+	/* within 1/32 of the timer event it was the timer */
+	if (measured_us + (data->sleep_us >> 5) >= data->sleep_us)
+		data->bins[pred_bin_of(drv, data->sleep_us)].hits += PRED_PULSE;
+	else
+		data->bins[pred_bin_of(drv, measured_us)].early += PRED_PULSE;
+
+	data->intervals[data->interval_ptr++] =
+		min_t(unsigned int, measured_us, PRED_MAX_INTERVAL);
+	if (data->interval_ptr >= PRED_INTERVALS)
+		data->interval_ptr = 0;
+}
+
+/**
+ * pred_select_state - picks the state for the coming idle period
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU, or NULL when replaying a trace
+ * @data: prediction state of the CPU
+ * @sleep_us: time to the next timer event
+ * @latency_req: exit latency the system tolerates
+ */
+static int pred_select_state(struct cpuidle_driver *drv,
+			     struct cpuidle_device *dev,
+			     struct pred_data *data,
+			     unsigned int sleep_us, int latency_req)
+{
+	unsigned int early = 0, hits = 0, max_early = 0, typical;
+	int i, idx = 0, cand = 0;
+
+	data->sleep_us = sleep_us;
+
+	/* the deepest state the timer and the latency limit allow */
+	for (i = 0; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (!pred_state_enabled(drv, dev, i))
+			continue;
+		if (s->target_residency > sleep_us)
+			break;
+		if (s->exit_latency > latency_req)
+			continue;
+		cand = i;
+	}
+
+	/*
+	 * Periods that went on at least as long as the candidate needs
+	 * against the ones that ended early, shallower than that.  If the
+	 * early ones win, take the state most of them ended in.
+	 */
+	for (i = 0; i < drv->state_count; i++) {
+		if (i < cand)
+			early += data->bins[i].early;
+		else
+			hits += data->bins[i].hits + data->bins[i].early;
+	}
+
+	idx = cand;
+	if (early > hits) {
+		for (i = 0; i < cand; i++) {
+			if (data->bins[i].early > max_early) {
+				max_early = data->bins[i].early;
+				idx = i;
+			}
+		}
+	}
+
+	/* a repeating interval shorter than that wins too */
+	typical = pred_typical_interval(data);
+	if (typical && typical < drv->states[idx].target_residency)
+		idx = pred_bin_of(drv, typical);
+
+	while (idx > 0 && !pred_state_enabled(drv, dev, idx))
+		idx--;
+
+	return idx;
+}
+
+static void pred_record(struct pred_device *pd, unsigned int measured_us)
+{
+	struct pred_sample *sample;
+
+	sample = &pd->trace[pd->trace_ptr++ % PRED_TRACE_LEN];
+	sample->sleep_us = pd->data.sleep_us;
+	sample->idle_us = measured_us;
+}
+
+/**
+ * pred_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int pred_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct pred_device *pd = &__get_cpu_var(pred_devices);
+	struct pred_data *data = &pd->data;
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	s64 sleep_us;
+
+	if (data->needs_update) {
+		struct cpuidle_state *s = &drv->states[data->last_state_idx];
+		unsigned int measured_us = cpuidle_get_last_residency(dev);
+
+		/*
+		 * Without a residency measurement assume the whole
+		 * predicted time; the exit latency follows the wakeup.
+		 */
+		if (unlikely(!(s->flags & CPUIDLE_FLAG_TIME_VALID)))
+			measured_us = data->sleep_us;
+		else if (measured_us > s->exit_latency)
+			measured_us -= s->exit_latency;
+		else
+			measured_us = 0;
+
+		pred_update(drv, data, measured_us);
+		pred_record(pd, measured_us);
+		data->needs_update = 0;
+	}
+
+	sleep_us = ktime_to_us(tick_nohz_get_sleep_length());
+	if (sleep_us > UINT_MAX)
+		sleep_us = UINT_MAX;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0)) {
+		data->sleep_us = sleep_us;
+		data->last_state_idx = 0;
+		return 0;
+	}
+
+	data->last_state_idx = pred_select_state(drv, dev, data, sleep_us,
+						 latency_req);
+	return data->last_state_idx;
+}
+
+/**
+ * pred_reflect - records that data structures need update
+ * @dev: the CPU
+ * @index: the index of actual entered state
+ *
+ * The update is left to the next pred_select(), so as not to add to the
+ * exit latency here.
+ */
+static void pred_reflect(struct cpuidle_device *dev, int index)
+{
+	struct pred_data *data = &__get_cpu_var(pred_devices).data;
+
+	data->last_state_idx = index;
+	if (index >= 0)
+		data->needs_update = 1;
+}
+
+static int pred_enable_device(struct cpuidle_driver *drv,
+			      struct cpuidle_device *dev)
+{
+	struct pred_device *pd = &per_cpu(pred_devices, dev->cpu);
+
+	memset(pd, 0, sizeof(*pd));
+	return 0;
+}
+
+static struct cpuidle_governor pred_governor = {
+	.name =		"predict",
+	.rating =	30,
+	.enable =	pred_enable_device,
+	.select =	pred_select,
+	.reflect =	pred_reflect,
+	.owner =	THIS_MODULE,
+};
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Trace replay.  Every idle period is run through three choices: this
+ * governor, the deepest state the timer allows and the deepest state
+ * the actual idle time would have paid off.  Entering state s for t us
+ * is charged as power(s) * t plus the break-even cost of the state,
+ * (power(0) - power(s)) * target_residency(s), in the driver's mW.
+ */
+enum {
+	PRED_POLICY_PREDICT,
+	PRED_POLICY_TIMER,
+	PRED_POLICY_IDEAL,
+	PRED_NR_POLICIES,
+};
+
+static const char *pred_policy_name[PRED_NR_POLICIES] = {
+	"predict",
+	"timer",
+	"ideal",
+};
+
+struct pred_result {
+	s64			energy_nj;
+	u64			exit_us;
+	unsigned long		above;
+	unsigned long		below;
+	unsigned long		usage[CPUIDLE_STATE_MAX];
+};
+
+struct pred_replay {
+	struct cpuidle_driver	*drv;
+	int			latency_req;
+	unsigned long		samples;
+	struct pred_result	result[PRED_NR_POLICIES];
+	struct pred_data	*data;		/* one per possible CPU */
+	char			line[64];
+	int			len;
+};
+
+static DEFINE_MUTEX(pred_report_lock);
+static char *pred_report;
+static size_t pred_report_len;
+
+static int pred_deepest_state(struct cpuidle_driver *drv, unsigned int us,
+			      int latency_req)
+{
+	int i, idx = 0;
+
+	for (i = 0; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (s->disabled || s->exit_latency > latency_req)
+			continue;
+		if (s->target_residency > us)
+			break;
+		idx = i;
+	}
+	return idx;
+}
+
+static void pred_account(struct cpuidle_driver *drv, struct pred_result *r,
+			 int idx, unsigned int idle_us)
+{
+	struct cpuidle_state *s = &drv->states[idx];
+	int i;
+
+	r->energy_nj += (s64)s->power_usage * idle_us +
+		(s64)(drv->states[0].power_usage - s->power_usage) *
+		s->target_residency;
+	r->exit_us += s->exit_latency;
+	r->usage[idx]++;
+
+	if (idle_us < s->target_residency) {
+		r->above++;
+		return;
+	}
+	for (i = idx + 1; i < drv->state_count; i++) {
+		if (drv->states[i].disabled)
+			continue;
+		if (idle_us >= drv->states[i].target_residency)
+			r->below++;
+		break;
+	}
+}
+
+static void pred_replay_line(struct pred_replay *rp, const char *line)
+{
+	struct cpuidle_driver *drv = rp->drv;
+	unsigned int cpu, sleep_us, idle_us;
+	struct pred_data *data;
+	int idx;
+
+	if (sscanf(line, "%u %u %u", &cpu, &sleep_us, &idle_us) != 3 ||
+	    cpu >= nr_cpu_ids)
+		return;
+
+	data = &rp->data[cpu];
+	idx = pred_select_state(drv, NULL, data, sleep_us, rp->latency_req);
+	pred_account(drv, &rp->result[PRED_POLICY_PREDICT], idx, idle_us);
+	pred_update(drv, data, idle_us);
+
+	idx = pred_deepest_state(drv, sleep_us, rp->latency_req);
+	pred_account(drv, &rp->result[PRED_POLICY_TIMER], idx, idle_us);
+
+	idx = pred_deepest_state(drv, idle_us, rp->latency_req);
+	pred_account(drv, &rp->result[PRED_POLICY_IDEAL], idx, idle_us);
+
+	rp->samples++;
+}
+
+static void pred_replay_report(struct pred_replay *rp)
+{
+	struct cpuidle_driver *drv = rp->drv;
+	size_t size = PAGE_SIZE, len = 0;
+	char *buf;
+	int p, i;
+
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	len += scnprintf(buf + len, size - len,
+			 "samples %lu, driver %s\n"
+			 "policy   energy_uJ  exit_us/period  above  below"
+			 "  usage per state\n", rp->samples, drv->name);
+	for (p = 0; p < PRED_NR_POLICIES; p++) {
+		struct pred_result *r = &rp->result[p];
+		u64 exit_avg = r->exit_us;
+
+		if (rp->samples)
+			do_div(exit_avg, rp->samples);
+		len += scnprintf(buf + len, size - len,
+				 "%-8s %10lld  %14llu  %5lu  %5lu ",
+				 pred_policy_name[p],
+				 div_s64(r->energy_nj, 1000), exit_avg,
+				 r->above, r->below);
+		for (i = 0; i < drv->state_count; i++)
+			len += scnprintf(buf + len, size - len, " %s:%lu",
+					 drv->states[i].name, r->usage[i]);
+		len += scnprintf(buf + len, size - len, "\n");
+	}
+
+	mutex_lock(&pred_report_lock);
+	kfree(pred_report);
+	pred_report = buf;
+	pred_report_len = len;
+	mutex_unlock(&pred_report_lock);
+}
+
+static int pred_replay_open(struct inode *inode, struct file *file)
+{
+	struct pred_replay *rp;
+
+	if (!(file->f_mode & FMODE_WRITE))
+		return 0;
+
+	rp = kzalloc(sizeof(*rp), GFP_KERNEL);
+	if (!rp)
+		return -ENOMEM;
+	rp->drv = cpuidle_get_driver();
+	if (!rp->drv) {
+		kfree(rp);
+		return -ENODEV;
+	}
+	rp->data = kcalloc(nr_cpu_ids, sizeof(*rp->data), GFP_KERNEL);
+	if (!rp->data) {
+		kfree(rp);
+		return -ENOMEM;
+	}
+	rp->latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	file->private_data = rp;
+	return 0;
+}
+
+static ssize_t pred_replay_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct pred_replay *rp = file->private_data;
+	size_t done;
+	char c;
+
+	if (!rp)
+		return -EBADF;
+
+	/* lines may be split across writes, keep the partial one */
+	for (done = 0; done < count; done++) {
+		if (get_user(c, ubuf + done))
+			return done ? done : -EFAULT;
+		if (c != '\n') {
+			if (rp->len < sizeof(rp->line) - 1)
+				rp->line[rp->len++] = c;
+			continue;
+		}
+		rp->line[rp->len] = '\0';
+		pred_replay_line(rp, rp->line);
+		rp->len = 0;
+	}
+	return count;
+}
+
+static ssize_t pred_replay_read(struct file *file, char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&pred_report_lock);
+	ret = simple_read_from_buffer(ubuf, count, ppos, pred_report,
+				      pred_report_len);
+	mutex_unlock(&pred_report_lock);
+	return ret;
+}
+
+static int pred_replay_release(struct inode *inode, struct file *file)
+{
+	struct pred_replay *rp = file->private_data;
+
+	if (!rp)
+		return 0;
+
+	if (rp->len) {
+		rp->line[rp->len] = '\0';
+		pred_replay_line(rp, rp->line);
+	}
+	pred_replay_report(rp);
+	kfree(rp->data);
+	kfree(rp);
+	return 0;
+}
+
+static const struct file_operations pred_replay_fops = {
+	.open		= pred_replay_open,
+	.read		= pred_replay_read,
+	.write		= pred_replay_write,
+	.release	= pred_replay_release,
+	.llseek		= default_llseek,
+};
+
+static int pred_trace_show(struct seq_file *m, void *v)
+{
+	unsigned int i, n;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct pred_device *pd = &per_cpu(pred_devices, cpu);
+		unsigned int end = ACCESS_ONCE(pd->trace_ptr);
+
+		n = min_t(unsigned int, end, PRED_TRACE_LEN);
+		for (i = end - n; i != end; i++) {
+			struct pred_sample *s = &pd->trace[i % PRED_TRACE_LEN];
+
+			seq_printf(m, "%d %u %u\n", cpu, s->sleep_us,
+				   s->idle_us);
+		}
+	}
+	return 0;
+}
+
+static int pred_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pred_trace_show, NULL);
+}
+
+static const struct file_operations pred_trace_fops = {
+	.open		= pred_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init pred_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpuidle_predict", NULL);
+	if (!dir)
+		return;
+	debugfs_create_file("trace", 0444, dir, NULL, &pred_trace_fops);
+	debugfs_create_file("replay", 0644, dir, NULL, &pred_replay_fops);
+}
+#else
+static inline void pred_debugfs_init(void) { }
+#endif /* CONFIG_DEBUG_FS */
+
+/**
+ * init_pred - initializes the governor
+ */
+static int __init init_pred(void)
+{
+	pred_debugfs_init();
+	return cpuidle_register_governor(&pred_governor);
+}
+
+/**
+ * exit_pred - exits the governor
+ */
+static void __exit exit_pred(void)
+{
+	cpuidle_unregister_governor(&pred_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_pred);
+module_exit(exit_pred);
@@ -272,8 +272,11 @@ static ssize_t show_state_##_name(struct cpuidle_state *state, \
 
 define_show_state_function(exit_latency)
 define_show_state_function(power_usage)
+define_show_state_function(target_residency)
 define_show_state_ull_function(usage)
 define_show_state_ull_function(time)
+define_show_state_ull_function(above)
+define_show_state_ull_function(below)
 define_show_state_str_function(name)
 define_show_state_str_function(desc)
 define_show_state_ull_function(disable)
@@ -283,8 +286,11 @@ define_one_state_ro(name, show_state_name);
 define_one_state_ro(desc, show_state_desc);
 define_one_state_ro(latency, show_state_exit_latency);
 define_one_state_ro(power, show_state_power_usage);
+define_one_state_ro(residency, show_state_target_residency);
 define_one_state_ro(usage, show_state_usage);
 define_one_state_ro(time, show_state_time);
+define_one_state_ro(above, show_state_above);
+define_one_state_ro(below, show_state_below);
 define_one_state_rw(disable, show_state_disable, store_state_disable);
 
 static struct attribute *cpuidle_state_default_attrs[] = {
@@ -292,8 +298,11 @@ static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_desc.attr,
 	&attr_latency.attr,
 	&attr_power.attr,
+	&attr_residency.attr,
 	&attr_usage.attr,
 	&attr_time.attr,
+	&attr_above.attr,
+	&attr_below.attr,
 	&attr_disable.attr,
 	NULL
 };
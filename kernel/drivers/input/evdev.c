@@ -14,6 +14,7 @@
 #define EVDEV_MINORS		32
 #define EVDEV_MIN_BUFFER_SIZE	64U
 #define EVDEV_BUF_PACKETS	8
+#define EVDEV_MAX_RING_SIZE	16384U
 
 #include <linux/poll.h>
 #include <linux/sched.h>
@@ -27,6 +28,7 @@
 #include <linux/device.h>
 #include <linux/cdev.h>
 #include <linux/wakelock.h>
+#include <linux/eventfd.h>
 #include "input-compat.h"
 
 struct evdev {
@@ -54,13 +56,88 @@ struct evdev_client {
 	struct evdev *evdev;
 	struct list_head node;
 	int clkid;
+	struct input_mmap_ring *ring; /* replaces buffer once set */
+	unsigned int ring_size;
+	unsigned int ring_head;
+	unsigned int ring_packet_head;
+	bool ring_overflow;
+	struct eventfd_ctx *eventfd;
 	unsigned int bufsize;
 	struct input_event buffer[];
 };
 
+/*
+ * The positions in the shared ring are free-running; only the kernel
+ * copies of head and packet_head are trusted, tail is whatever the
+ * reader last stored.
+ */
+static bool evdev_client_empty(struct evdev_client *client)
+{
+	struct input_mmap_ring *ring = ACCESS_ONCE(client->ring);
+	unsigned int avail;
+
+	if (!ring)
+		return client->packet_head == client->tail;
+
+	avail = client->ring_packet_head - ACCESS_ONCE(ring->tail);
+	return !avail || avail > client->ring_size;
+}
+
+static void __pass_ring_event(struct evdev_client *client,
+			      const struct input_event *event)
+{
+	struct input_mmap_ring *ring = client->ring;
+	unsigned int mask = client->ring_size - 1;
+	unsigned int tail = ACCESS_ONCE(ring->tail);
+	bool report = event->type == EV_SYN && event->code == SYN_REPORT;
+	struct input_event *slot;
+
+	if (unlikely(client->ring_overflow)) {
+		/*
+		 * Skip the rest of the lost packet, then report the loss
+		 * in place of its SYN_REPORT once the reader made room.
+		 */
+		if (!report || client->ring_head - tail >= client->ring_size)
+			return;
+
+		slot = &ring->buffer[client->ring_head++ & mask];
+		slot->time = event->time;
+		slot->type = EV_SYN;
+		slot->code = SYN_DROPPED;
+		slot->value = 0;
+		client->ring_overflow = false;
+	} else if (unlikely(client->ring_head - tail >= client->ring_size)) {
+		/* The reader cannot see past packet_head, so just rewind. */
+		client->ring_head = client->ring_packet_head;
+		client->ring_overflow = true;
+		ring->head = client->ring_head;
+		ring->dropped++;
+		return;
+	} else {
+		ring->buffer[client->ring_head++ & mask] = *event;
+	}
+
+	ring->head = client->ring_head;
+
+	if (report) {
+		/* Publish the events before the position covering them. */
+		smp_wmb();
+		client->ring_packet_head = client->ring_head;
+		ring->packet_head = client->ring_packet_head;
+		if (client->use_wake_lock)
+			wake_lock(&client->wake_lock);
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	}
+}
+
 static void __pass_event(struct evdev_client *client,
 			 const struct input_event *event)
 {
+	if (client->ring) {
+		__pass_ring_event(client, event);
+		return;
+	}
+
 	client->buffer[client->head++] = *event;
 	client->head &= client->bufsize - 1;
 
@@ -113,6 +190,9 @@ static void evdev_pass_values(struct evdev_client *client,
 			wakeup = true;
 	}
 
+	if (wakeup && client->eventfd)
+		eventfd_signal(client->eventfd, 1);
+
 	spin_unlock(&client->buffer_lock);
 
 	if (wakeup)
@@ -301,6 +381,9 @@ static int evdev_release(struct inode *inode, struct file *file)
 	evdev_detach_client(evdev, client);
 	if (client->use_wake_lock)
 		wake_lock_destroy(&client->wake_lock);
+	if (client->eventfd)
+		eventfd_ctx_put(client->eventfd);
+	vfree(client->ring);
 
 	if (is_vmalloc_addr(client))
 		vfree(client);
@@ -395,6 +478,42 @@ static ssize_t evdev_write(struct file *file, const char __user *buffer,
 	return retval;
 }
 
+/*
+ * The kernel does not see a ring reader consume events, so the wake lock
+ * taken for a packet is dropped once poll() or read() finds the ring
+ * drained.  An eventfd reader calls neither, which is why eventfd and
+ * suspend blocking cannot be combined on one client.
+ */
+static void evdev_ring_idle(struct evdev_client *client)
+{
+	spin_lock_irq(&client->buffer_lock);
+	if (client->use_wake_lock && evdev_client_empty(client))
+		wake_unlock(&client->wake_lock);
+	spin_unlock_irq(&client->buffer_lock);
+}
+
+/*
+ * read() keeps working on a client that switched to the shared ring, it
+ * simply consumes from the ring on behalf of the reader.
+ */
+static int evdev_fetch_ring_event(struct evdev_client *client,
+				  struct input_event *event)
+{
+	struct input_mmap_ring *ring = client->ring;
+	unsigned int tail = ACCESS_ONCE(ring->tail);
+	unsigned int avail = client->ring_packet_head - tail;
+
+	if (!avail || avail > client->ring_size)
+		return 0;
+
+	*event = ring->buffer[tail & (client->ring_size - 1)];
+	ring->tail = tail + 1;
+	if (client->use_wake_lock && avail == 1)
+		wake_unlock(&client->wake_lock);
+
+	return 1;
+}
+
 static int evdev_fetch_next_event(struct evdev_client *client,
 				  struct input_event *event)
 {
@@ -402,13 +521,17 @@ static int evdev_fetch_next_event(struct evdev_client *client,
 
 	spin_lock_irq(&client->buffer_lock);
 
-	have_event = client->packet_head != client->tail;
-	if (have_event) {
-		*event = client->buffer[client->tail++];
-		client->tail &= client->bufsize - 1;
-		if (client->use_wake_lock &&
-		    client->packet_head == client->tail)
-			wake_unlock(&client->wake_lock);
+	if (client->ring) {
+		have_event = evdev_fetch_ring_event(client, event);
+	} else {
+		have_event = client->packet_head != client->tail;
+		if (have_event) {
+			*event = client->buffer[client->tail++];
+			client->tail &= client->bufsize - 1;
+			if (client->use_wake_lock &&
+			    client->packet_head == client->tail)
+				wake_unlock(&client->wake_lock);
+		}
 	}
 
 	spin_unlock_irq(&client->buffer_lock);
@@ -432,7 +555,10 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 		if (!evdev->exist)
 			return -ENODEV;
 
-		if (client->packet_head == client->tail &&
+		if (client->ring && client->use_wake_lock)
+			evdev_ring_idle(client);
+
+		if (evdev_client_empty(client) &&
 		    (file->f_flags & O_NONBLOCK))
 			return -EAGAIN;
 
@@ -457,7 +583,7 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 
 		if (!(file->f_flags & O_NONBLOCK)) {
 			error = wait_event_interruptible(evdev->wait,
-					client->packet_head != client->tail ||
+					!evdev_client_empty(client) ||
 					!evdev->exist);
 			if (error)
 				return error;
@@ -477,12 +603,25 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &evdev->wait, wait);
 
 	mask = evdev->exist ? POLLOUT | POLLWRNORM : POLLHUP | POLLERR;
-	if (client->packet_head != client->tail)
+	if (!evdev_client_empty(client))
 		mask |= POLLIN | POLLRDNORM;
+	else if (client->ring && client->use_wake_lock)
+		evdev_ring_idle(client);
 
 	return mask;
 }
 
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+	struct input_mmap_ring *ring = ACCESS_ONCE(client->ring);
+
+	if (!ring || vma->vm_pgoff)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring, 0);
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -703,10 +842,14 @@ static int evdev_enable_suspend_block(struct evdev *evdev,
 	if (client->use_wake_lock)
 		return 0;
 
+	/* Nothing would release the wake lock, see evdev_ring_idle() */
+	if (client->eventfd)
+		return -EINVAL;
+
 	spin_lock_irq(&client->buffer_lock);
 	wake_lock_init(&client->wake_lock, WAKE_LOCK_SUSPEND, client->name);
 	client->use_wake_lock = true;
-	if (client->packet_head != client->tail)
+	if (!evdev_client_empty(client))
 		wake_lock(&client->wake_lock);
 	spin_unlock_irq(&client->buffer_lock);
 	return 0;
@@ -726,6 +869,95 @@ static int evdev_disable_suspend_block(struct evdev *evdev,
 	return 0;
 }
 
+static int evdev_enable_mmap(struct evdev_client *client, u32 __user *p)
+{
+	struct input_mmap_ring *ring;
+	unsigned int bufsize, i, n;
+	size_t size;
+	u32 nevents;
+
+	/* The ring holds native events, there is no compat layout. */
+	if (input_event_size() != sizeof(struct input_event))
+		return -EINVAL;
+
+	if (client->ring)
+		return -EBUSY;
+
+	if (get_user(nevents, p))
+		return -EFAULT;
+
+	if (nevents > EVDEV_MAX_RING_SIZE)
+		return -EINVAL;
+
+	bufsize = client->bufsize;
+	if (nevents > bufsize)
+		bufsize = roundup_pow_of_two(nevents);
+
+	size = PAGE_ALIGN(sizeof(*ring) +
+			  bufsize * sizeof(struct input_event));
+	ring = vmalloc_user(size);
+	if (!ring)
+		return -ENOMEM;
+
+	ring->version = EV_MMAP_VERSION;
+	ring->bufsize = bufsize;
+
+	spin_lock_irq(&client->buffer_lock);
+
+	/* Move whatever read() has not consumed yet over to the ring. */
+	n = 0;
+	for (i = client->tail; i != client->head;
+	     i = (i + 1) & (client->bufsize - 1)) {
+		if (i == client->packet_head)
+			client->ring_packet_head = n;
+		ring->buffer[n++] = client->buffer[i];
+	}
+	if (i == client->packet_head)
+		client->ring_packet_head = n;
+
+	client->tail = client->packet_head = client->head;
+	client->ring_head = n;
+	client->ring_size = bufsize;
+	ring->head = client->ring_head;
+	ring->packet_head = client->ring_packet_head;
+
+	smp_wmb();
+	client->ring = ring;
+
+	spin_unlock_irq(&client->buffer_lock);
+
+	return put_user(size, p);
+}
+
+static int evdev_set_eventfd(struct evdev_client *client, int __user *p)
+{
+	struct eventfd_ctx *ctx = NULL, *old;
+	int fd;
+
+	if (get_user(fd, p))
+		return -EFAULT;
+
+	/* Nothing would release the wake lock, see evdev_ring_idle() */
+	if (fd >= 0 && client->use_wake_lock)
+		return -EINVAL;
+
+	if (fd >= 0) {
+		ctx = eventfd_ctx_fdget(fd);
+		if (IS_ERR(ctx))
+			return PTR_ERR(ctx);
+	}
+
+	spin_lock_irq(&client->buffer_lock);
+	old = client->eventfd;
+	client->eventfd = ctx;
+	spin_unlock_irq(&client->buffer_lock);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
 static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 			   void __user *p, int compat_mode)
 {
@@ -796,6 +1028,12 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 		client->clkid = i;
 		return 0;
 
+	case EVIOCSMMAP:
+		return evdev_enable_mmap(client, p);
+
+	case EVIOCSEVENTFD:
+		return evdev_set_eventfd(client, ip);
+
 	case EVIOCGKEYCODE:
 		return evdev_handle_get_keycode(dev, p);
 
@@ -968,6 +1206,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
@@ -296,9 +296,194 @@ exit:
 	mutex_unlock(&thermal_list_lock);
 }
 
+/*
+ * Coalesced polling.
+ *
+ * Every zone used to arm its own poll_queue timer, so a platform with a
+ * dozen sensors took a dozen unaligned wakeups per period.  With
+ * coalescing, set_polling only records when the zone wants its next
+ * reading, and a single deferrable timer kicks the poll_queue of every zone
+ * that is due, or within a quarter period of being due, in one batch.
+ *
+ * The delay is also scaled by the temperature slope (poll_scale is in
+ * halves of the nominal delay): a steep slope halves it, a flat zone far
+ * from its trips is stretched step by step up to THERMAL_POLL_MAX_SCALE.
+ */
+static bool coalesce_polling = true;
+module_param(coalesce_polling, bool, 0444);
+MODULE_PARM_DESC(coalesce_polling, "Poll all thermal zones from one timer");
+
+#define THERMAL_POLL_MAX_SCALE		8	/* 4x nominal */
+#define THERMAL_POLL_FLAT_SLOPE		100	/* mC/s */
+#define THERMAL_POLL_STEEP_SLOPE	1000	/* mC/s */
+#define THERMAL_POLL_TRIP_MARGIN	5000	/* mC */
+
+static void thermal_poll_batch(struct work_struct *work);
+
+static DEFINE_SPINLOCK(thermal_poll_lock);
+static DECLARE_DEFERRABLE_WORK(thermal_poll_work, thermal_poll_batch);
+static unsigned long thermal_poll_next;
+static bool thermal_poll_armed;
+static unsigned long thermal_poll_since;
+static unsigned long thermal_poll_batches;
+static unsigned long thermal_poll_reads;
+static unsigned long thermal_poll_nominal;	/* in 1/1000 wakeups */
+
+/* thermal_poll_lock must be held */
+static void thermal_poll_arm(unsigned long due)
+{
+	if (thermal_poll_armed && !time_before(due, thermal_poll_next))
+		return;
+
+	thermal_poll_next = due;
+	thermal_poll_armed = true;
+	mod_delayed_work(system_freezable_wq, &thermal_poll_work,
+			 time_after(due, jiffies) ? due - jiffies : 0);
+}
+
+static void thermal_poll_batch(struct work_struct *work)
+{
+	struct thermal_zone_device *tz;
+	unsigned long now = jiffies, next = 0;
+	unsigned long nominal;
+	bool pending = false;
+	int reads = 0;
+
+	mutex_lock(&thermal_list_lock);
+	spin_lock(&thermal_poll_lock);
+	thermal_poll_armed = false;
+
+	list_for_each_entry(tz, &thermal_tz_list, node) {
+		if (!tz->poll_delay)
+			continue;
+
+		if (time_before_eq(tz->poll_next, now + tz->poll_slack)) {
+			/* the zone waited this long on a poll_queue of its own */
+			nominal = jiffies_to_msecs(now - tz->poll_start);
+			thermal_poll_nominal += nominal * 1000 / tz->poll_delay;
+
+			/* re-armed by set_polling once the update has run */
+			tz->poll_delay = 0;
+			mod_delayed_work(system_freezable_wq, &tz->poll_queue, 0);
+			reads++;
+		} else if (!pending || time_before(tz->poll_next, next)) {
+			next = tz->poll_next;
+			pending = true;
+		}
+	}
+
+	if (pending)
+		thermal_poll_arm(next);
+	if (reads) {
+		thermal_poll_batches++;
+		thermal_poll_reads += reads;
+	}
+
+	spin_unlock(&thermal_poll_lock);
+	mutex_unlock(&thermal_list_lock);
+}
+
+/**
+ * thermal_poll_get_stats() - report coalesced polling counters
+ * @batches:	number of timer wakeups that read at least one zone
+ * @reads:	number of zone reads issued from those wakeups
+ * @nominal:	wakeups the zones would have taken on their own timers at
+ *		their nominal delay, in 1/1000 units
+ * @elapsed_ms:	time the counters cover
+ *
+ * Return: false if coalesced polling is disabled.
+ */
+bool thermal_poll_get_stats(unsigned long *batches, unsigned long *reads,
+			    unsigned long *nominal, unsigned long *elapsed_ms)
+{
+	if (!coalesce_polling)
+		return false;
+
+	spin_lock(&thermal_poll_lock);
+	*batches = thermal_poll_batches;
+	*reads = thermal_poll_reads;
+	*nominal = thermal_poll_nominal;
+	*elapsed_ms = jiffies_to_msecs(jiffies - thermal_poll_since);
+	spin_unlock(&thermal_poll_lock);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(thermal_poll_get_stats);
+
+static void thermal_zone_poll_adapt(struct thermal_zone_device *tz)
+{
+	unsigned long now = jiffies;
+	unsigned int elapsed;
+	long slope, trip_temp;
+	bool near_trip = false;
+	int scale, count;
+
+	if (!coalesce_polling)
+		return;
+
+	for (count = 0; count < tz->trips; count++) {
+		if (tz->ops->get_trip_temp(tz, count, &trip_temp))
+			continue;
+		if (tz->temperature + THERMAL_POLL_TRIP_MARGIN >= trip_temp) {
+			near_trip = true;
+			break;
+		}
+	}
+
+	mutex_lock(&tz->lock);
+
+	elapsed = jiffies_to_msecs(now - tz->poll_last);
+	if (!tz->poll_last || !elapsed) {
+		tz->poll_last = now;
+		goto out;
+	}
+	tz->poll_last = now;
+
+	slope = abs(tz->temperature - tz->last_temperature) * 1000L / elapsed;
+	scale = tz->poll_scale;
+
+	if (slope >= THERMAL_POLL_STEEP_SLOPE)
+		scale = 1;
+	else if (slope > THERMAL_POLL_FLAT_SLOPE || tz->passive || near_trip)
+		scale = 2;
+	else if (scale < THERMAL_POLL_MAX_SCALE)
+		scale = max(scale, 2) + 1;
+
+	tz->poll_scale = scale;
+out:
+	mutex_unlock(&tz->lock);
+}
+
 static void thermal_zone_device_set_polling(struct thermal_zone_device *tz,
 					    int delay)
 {
+	unsigned long due, span;
+
+	if (coalesce_polling) {
+		spin_lock(&thermal_poll_lock);
+		tz->poll_delay = delay;
+		if (delay) {
+			span = msecs_to_jiffies(delay) * tz->poll_scale / 2;
+			span = max(span, 1UL);
+			due = jiffies + span;
+			if (delay >= 1000)
+				due = round_jiffies(due);
+
+			/* join an armed batch rather than wake up early */
+			tz->poll_slack = span / 4;
+			if (thermal_poll_armed &&
+			    time_after(thermal_poll_next, due) &&
+			    thermal_poll_next - due <= tz->poll_slack)
+				due = thermal_poll_next;
+
+			tz->poll_next = due;
+			tz->poll_start = jiffies;
+			thermal_poll_arm(due);
+		}
+		spin_unlock(&thermal_poll_lock);
+		return;
+	}
+
 	if (delay > 1000)
 		mod_delayed_work(system_freezable_wq, &tz->poll_queue,
 				 round_jiffies(msecs_to_jiffies(delay)));
@@ -442,6 +627,7 @@ void thermal_zone_device_update(struct thermal_zone_device *tz)
 	int count;
 
 	update_temperature(tz);
+	thermal_zone_poll_adapt(tz);
 
 	for (count = 0; count < tz->trips; count++)
 		handle_thermal_trip(tz, count);
@@ -1648,6 +1834,7 @@ struct thermal_zone_device *thermal_zone_device_register(const char *type,
 	tz->trips = trips;
 	tz->passive_delay = passive_delay;
 	tz->polling_delay = polling_delay;
+	tz->poll_scale = 2;
 
 	dev_set_name(&tz->device, "thermal_zone%d", tz->id);
 	result = device_register(&tz->device);
@@ -1784,6 +1971,9 @@ void thermal_zone_device_unregister(struct thermal_zone_device *tz)
 
 	mutex_unlock(&thermal_list_lock);
 
+	/* a poll batch may have kicked the zone before it left the list */
+	cancel_delayed_work_sync(&tz->poll_queue);
+
     //mutex_lock(&tz->lock); // avoid destroy a locked mutex
 	//thermal_zone_device_set_polling(tz, 0);
 
@@ -1984,6 +2174,7 @@ static int __init thermal_init(void)
 	if (result)
 		goto unregister_class;
 
+	thermal_poll_since = jiffies;
 	return 0;
 
 unregister_governors:
@@ -2001,6 +2192,7 @@ error:
 
 static void __exit thermal_exit(void)
 {
+	cancel_delayed_work_sync(&thermal_poll_work);
 	genetlink_exit();
 	class_unregister(&thermal_class);
 	thermal_unregister_governors();
@@ -648,7 +648,7 @@ static int dummy_queue(struct usb_ep *_ep, struct usb_request *_req,
 	if (ep->desc && (ep->desc->bEndpointAddress & USB_DIR_IN) &&
 			list_empty(&dum->fifo_req.queue) &&
 			list_empty(&ep->queue) &&
-			_req->length <= FIFO_SIZE) {
+			_req->length <= FIFO_SIZE && !_req->num_sgs) {
 		req = &dum->fifo_req;
 		req->req = *_req;
 		req->req.buf = dum->fifo_buf;
@@ -977,6 +977,7 @@ static int dummy_udc_probe(struct platform_device *pdev)
 	dum->gadget.name = gadget_name;
 	dum->gadget.ops = &dummy_ops;
 	dum->gadget.max_speed = USB_SPEED_SUPER;
+	dum->gadget.sg_supported = 1;
 
 	dum->gadget.dev.parent = &pdev->dev;
 	init_dummy_udc_hw(dum);
@@ -1218,26 +1219,58 @@ static int dummy_urb_dequeue(struct usb_hcd *hcd, struct urb *urb, int status)
 	return rc;
 }
 
+/* copy between a host buffer and a gadget request at byte offset @off */
+static void dummy_req_copy(struct dummy_request *req, u32 off, void *ubuf,
+		u32 len, int to_host)
+{
+	struct sg_mapping_iter miter;
+	u32 this_sg;
+
+	if (!req->req.num_sgs) {
+		if (to_host)
+			memcpy(ubuf, req->req.buf + off, len);
+		else
+			memcpy(req->req.buf + off, ubuf, len);
+		return;
+	}
+
+	/* scatter-gather request from a function driver */
+	sg_miter_start(&miter, req->req.sg, req->req.num_sgs, SG_MITER_ATOMIC |
+			(to_host ? SG_MITER_FROM_SG : SG_MITER_TO_SG));
+	while (len && sg_miter_next(&miter)) {
+		if (off >= miter.length) {
+			off -= miter.length;
+			continue;
+		}
+		this_sg = min_t(u32, len, miter.length - off);
+		if (to_host)
+			memcpy(ubuf, miter.addr + off, this_sg);
+		else
+			memcpy(miter.addr + off, ubuf, this_sg);
+		ubuf += this_sg;
+		len -= this_sg;
+		off = 0;
+	}
+	sg_miter_stop(&miter);
+}
+
 static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 		u32 len)
 {
-	void *ubuf, *rbuf;
+	void *ubuf;
 	struct urbp *urbp = urb->hcpriv;
 	int to_host;
 	struct sg_mapping_iter *miter = &urbp->miter;
+	u32 off = req->req.actual;
 	u32 trans = 0;
 	u32 this_sg;
 	bool next_sg;
 
 	to_host = usb_pipein(urb->pipe);
-	rbuf = req->req.buf + req->req.actual;
 
 	if (!urb->num_sgs) {
 		ubuf = urb->transfer_buffer + urb->actual_length;
-		if (to_host)
-			memcpy(ubuf, rbuf, len);
-		else
-			memcpy(rbuf, ubuf, len);
+		dummy_req_copy(req, off, ubuf, len, to_host);
 		return len;
 	}
 
@@ -1261,12 +1294,9 @@ static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 		ubuf = miter->addr;
 		this_sg = min_t(u32, len, miter->length);
 		miter->consumed = this_sg;
-		trans += this_sg;
 
-		if (to_host)
-			memcpy(ubuf, rbuf, this_sg);
-		else
-			memcpy(rbuf, ubuf, this_sg);
+		dummy_req_copy(req, off + trans, ubuf, this_sg, to_host);
+		trans += this_sg;
 		len -= this_sg;
 
 		if (!len)
@@ -1276,8 +1306,6 @@ static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 			WARN_ON_ONCE(1);
 			return -EINVAL;
 		}
-
-		rbuf += this_sg;
 	} while (1);
 
 	sg_miter_stop(miter);
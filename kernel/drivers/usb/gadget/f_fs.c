@@ -22,6 +22,10 @@
 #include <linux/pagemap.h>
 #include <linux/export.h>
 #include <linux/hid.h>
+#include <linux/aio.h>
+#include <linux/mmu_context.h>
+#include <linux/scatterlist.h>
+#include <linux/uio.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -739,6 +743,190 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+/*
+ * Transfers of at least this size on a scatter-gather capable UDC are
+ * done straight from/to the pinned user pages.  Below it the copy is
+ * cheaper than pinning.
+ */
+#define FFS_ZERO_COPY_MIN	(4 * PAGE_SIZE)
+
+static bool ffs_zero_copy = true;
+module_param(ffs_zero_copy, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ffs_zero_copy,
+		 "Map user buffers into SG requests on SG capable UDCs");
+
+/*
+ * One read or write on an endpoint file.  read(2) and write(2) keep it on
+ * the stack and wait for the request; an AIO submission hands it to the
+ * request, and ffs_epfile_io_worker() completes the kiocb and frees it.
+ */
+struct ffs_io_data {
+	bool aio;
+	bool read;
+
+	struct kiocb *kiocb;
+	const struct iovec *iovec;
+	unsigned long nr_segs;
+	size_t len;
+
+	/* bounce buffer, or NULL when the request maps the user pages */
+	char *buf;
+	struct page **pages;
+	unsigned n_pages;
+	struct sg_table sgt;
+
+	struct mm_struct *mm;
+	struct work_struct work;
+
+	struct ffs_epfile *epfile;
+	struct usb_ep *ep;
+	struct usb_request *req;	/* P: ffs->eps_lock while queued */
+};
+
+/* Pin the user buffers and describe them with a scatterlist. */
+static int ffs_io_map_user(struct ffs_io_data *io_data)
+{
+	struct scatterlist *sg;
+	unsigned long i, start, end;
+	unsigned n = 0, p;
+	int ret;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		start = (unsigned long)io_data->iovec[i].iov_base;
+		end = start + io_data->iovec[i].iov_len;
+		if (io_data->iovec[i].iov_len)
+			n += DIV_ROUND_UP(end, PAGE_SIZE) - start / PAGE_SIZE;
+	}
+
+	io_data->pages = kcalloc(n, sizeof(*io_data->pages), GFP_KERNEL);
+	if (unlikely(!io_data->pages))
+		return -ENOMEM;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		start = (unsigned long)io_data->iovec[i].iov_base;
+		end = start + io_data->iovec[i].iov_len;
+		if (!io_data->iovec[i].iov_len)
+			continue;
+
+		p = DIV_ROUND_UP(end, PAGE_SIZE) - start / PAGE_SIZE;
+		ret = get_user_pages_fast(start & PAGE_MASK, p, io_data->read,
+					  io_data->pages + io_data->n_pages);
+		if (ret > 0)
+			io_data->n_pages += ret;
+		if (ret != p)
+			goto error;
+	}
+
+	ret = sg_alloc_table(&io_data->sgt, n, GFP_KERNEL);
+	if (unlikely(ret))
+		goto error;
+
+	sg = io_data->sgt.sgl;
+	p = 0;
+	for (i = 0; i < io_data->nr_segs; i++) {
+		start = (unsigned long)io_data->iovec[i].iov_base;
+		end = start + io_data->iovec[i].iov_len;
+
+		while (start < end) {
+			unsigned off = offset_in_page(start);
+			unsigned len = min_t(unsigned long, PAGE_SIZE - off,
+					     end - start);
+
+			sg_set_page(sg, io_data->pages[p++], len, off);
+			sg = sg_next(sg);
+			start += len;
+		}
+	}
+	return 0;
+
+error:
+	while (io_data->n_pages)
+		put_page(io_data->pages[--io_data->n_pages]);
+	kfree(io_data->pages);
+	io_data->pages = NULL;
+	return -EFAULT;
+}
+
+/*
+ * Set up the data side of a transfer: user pages on SG capable UDCs,
+ * otherwise a kernel buffer, filled here for writes.
+ */
+static int ffs_io_prepare(struct ffs_io_data *io_data, struct usb_gadget *gadget)
+{
+	size_t pos = 0;
+	unsigned long i;
+
+	if (ffs_zero_copy && gadget->sg_supported &&
+	    io_data->len >= FFS_ZERO_COPY_MIN &&
+	    !ffs_io_map_user(io_data))
+		return 0;
+
+	io_data->buf = kmalloc(io_data->len, GFP_KERNEL);
+	if (unlikely(!io_data->buf))
+		return -ENOMEM;
+
+	if (io_data->read)
+		return 0;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		if (unlikely(copy_from_user(io_data->buf + pos,
+					    io_data->iovec[i].iov_base,
+					    io_data->iovec[i].iov_len)))
+			return -EFAULT;
+		pos += io_data->iovec[i].iov_len;
+	}
+	return 0;
+}
+
+/* Copy what a read brought in back out of the bounce buffer. */
+static ssize_t ffs_io_copy_to_user(struct ffs_io_data *io_data, size_t actual)
+{
+	size_t pos = 0, len;
+	unsigned long i;
+
+	for (i = 0; i < io_data->nr_segs && pos < actual; i++) {
+		len = min_t(size_t, io_data->iovec[i].iov_len, actual - pos);
+		if (unlikely(copy_to_user(io_data->iovec[i].iov_base,
+					  io_data->buf + pos, len)))
+			return pos ? pos : -EFAULT;
+		pos += len;
+	}
+	return pos;
+}
+
+static void ffs_io_release(struct ffs_io_data *io_data)
+{
+	if (io_data->pages) {
+		while (io_data->n_pages) {
+			struct page *page = io_data->pages[--io_data->n_pages];
+
+			if (io_data->read)
+				set_page_dirty_lock(page);
+			put_page(page);
+		}
+		sg_free_table(&io_data->sgt);
+		kfree(io_data->pages);
+		io_data->pages = NULL;
+	}
+	kfree(io_data->buf);
+	io_data->buf = NULL;
+}
+
+static void ffs_io_set_req(struct ffs_io_data *io_data,
+			   struct usb_request *req)
+{
+	if (io_data->pages) {
+		req->buf     = NULL;
+		req->sg      = io_data->sgt.sgl;
+		req->num_sgs = io_data->sgt.nents;
+	} else {
+		req->buf     = io_data->buf;
+		req->sg      = NULL;
+		req->num_sgs = 0;
+	}
+	req->length = io_data->len;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -749,12 +937,52 @@ static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 	}
 }
 
-static ssize_t ffs_epfile_io(struct file *file,
-			     char __user *buf, size_t len, int read)
+static void ffs_epfile_io_worker(struct work_struct *work)
+{
+	struct ffs_io_data *io_data =
+		container_of(work, struct ffs_io_data, work);
+	struct usb_request *req = io_data->req;
+	struct kiocb *kiocb = io_data->kiocb;
+	ssize_t ret = req->actual ? req->actual : req->status;
+
+	ENTER();
+
+	if (io_data->read && io_data->buf && req->actual) {
+		use_mm(io_data->mm);
+		ret = ffs_io_copy_to_user(io_data, req->actual);
+		unuse_mm(io_data->mm);
+	}
+	ffs_io_release(io_data);
+
+	/* from here on ffs_aio_cancel() leaves the request alone */
+	spin_lock_irq(&io_data->epfile->ffs->eps_lock);
+	kiocb->private = NULL;
+	io_data->req = NULL;
+	spin_unlock_irq(&io_data->epfile->ffs->eps_lock);
+
+	usb_ep_free_request(io_data->ep, req);
+	kfree(io_data);
+
+	/* completing the iocb can drop the ctx and mm, don't touch mm after */
+	aio_complete(kiocb, ret, ret);
+}
+
+static void ffs_epfile_async_io_complete(struct usb_ep *_ep,
+					 struct usb_request *req)
+{
+	struct ffs_io_data *io_data = req->context;
+
+	ENTER();
+
+	/* unpinning and copying out may sleep */
+	schedule_work(&io_data->work);
+}
+
+static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 {
 	struct ffs_epfile *epfile = file->private_data;
 	struct ffs_ep *ep;
-	char *data = NULL;
+	bool prepared = false;
 	ssize_t ret;
 	int halt;
 
@@ -786,23 +1014,18 @@ first_try:
 		}
 
 		/* Do we halt? */
-		halt = !read == !epfile->in;
+		halt = !io_data->read == !epfile->in;
 		if (halt && epfile->isoc) {
 			ret = -EINVAL;
 			goto error;
 		}
 
-		/* Allocate & copy */
-		if (!halt && !data) {
-			data = kzalloc(len, GFP_KERNEL);
-			if (unlikely(!data))
-				return -ENOMEM;
-
-			if (!read &&
-			    unlikely(__copy_from_user(data, buf, len))) {
-				ret = -EFAULT;
+		/* Map or allocate & copy */
+		if (!halt && !prepared) {
+			ret = ffs_io_prepare(io_data, epfile->ffs->gadget);
+			if (unlikely(ret))
 				goto error;
-			}
+			prepared = true;
 		}
 
 		/* We will be using request */
@@ -829,6 +1052,33 @@ first_try:
 			usb_ep_set_halt(ep->ep);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 		ret = -EBADMSG;
+	} else if (io_data->aio) {
+		/*
+		 * Each kiocb gets its own request, so any number of them
+		 * can be in flight; epfile->mutex only covers queueing.
+		 */
+		struct usb_request *req;
+
+		req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+		if (unlikely(!req)) {
+			ret = -ENOMEM;
+		} else {
+			ffs_io_set_req(io_data, req);
+			req->context  = io_data;
+			req->complete = ffs_epfile_async_io_complete;
+
+			io_data->ep = ep->ep;
+			io_data->req = req;
+
+			ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+			if (unlikely(ret)) {
+				io_data->req = NULL;
+				usb_ep_free_request(ep->ep, req);
+			} else {
+				ret = -EIOCBQUEUED;
+			}
+		}
+		spin_unlock_irq(&epfile->ffs->eps_lock);
 	} else {
 		/* Fire the request */
 		DECLARE_COMPLETION_ONSTACK(done);
@@ -836,8 +1086,7 @@ first_try:
 		struct usb_request *req = ep->req;
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
-		req->buf      = data;
-		req->length   = len;
+		ffs_io_set_req(io_data, req);
 
 		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
 
@@ -850,15 +1099,16 @@ first_try:
 			usb_ep_dequeue(ep->ep, req);
 		} else {
 			ret = ep->status;
-			if (read && ret > 0 &&
-			    unlikely(copy_to_user(buf, data, ret)))
-				ret = -EFAULT;
+			if (io_data->read && io_data->buf && ret > 0)
+				ret = ffs_io_copy_to_user(io_data, ret);
 		}
 	}
 
 	mutex_unlock(&epfile->mutex);
+	if (ret == -EIOCBQUEUED)
+		return ret;
 error:
-	kfree(data);
+	ffs_io_release(io_data);
 	return ret;
 }
 
@@ -866,17 +1116,112 @@ static ssize_t
 ffs_epfile_write(struct file *file, const char __user *buf, size_t len,
 		 loff_t *ptr)
 {
+	struct iovec iov = { .iov_base = (char __user *)buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.read = false, .iovec = &iov, .nr_segs = 1, .len = len,
+	};
+
 	ENTER();
 
-	return ffs_epfile_io(file, (char __user *)buf, len, 0);
+	return ffs_epfile_io(file, &io_data);
 }
 
 static ssize_t
 ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
 {
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.read = true, .iovec = &iov, .nr_segs = 1, .len = len,
+	};
+
 	ENTER();
 
-	return ffs_epfile_io(file, buf, len, 1);
+	return ffs_epfile_io(file, &io_data);
+}
+
+static int ffs_aio_cancel(struct kiocb *kiocb, struct io_event *e)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_io_data *io_data;
+	int value;
+
+	ENTER();
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	io_data = kiocb->private;
+	if (likely(io_data && io_data->req))
+		value = usb_ep_dequeue(io_data->ep, io_data->req);
+	else
+		value = -EINVAL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio_put_req(kiocb);
+	return value;
+}
+
+static ssize_t ffs_epfile_aio_rw(struct kiocb *kiocb, const struct iovec *iovec,
+				 unsigned long nr_segs, bool read)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_io_data *io_data;
+	ssize_t ret;
+
+	ENTER();
+
+	/*
+	 * readv(2) and writev(2) come here with a sync kiocb, which the aio
+	 * core waits for uninterruptibly and can't cancel. Do them like
+	 * read(2) and write(2) instead, so a signal still gets them out.
+	 */
+	if (is_sync_kiocb(kiocb)) {
+		struct ffs_io_data sync_io_data = {
+			.read = read, .iovec = iovec, .nr_segs = nr_segs,
+			.len = iov_length(iovec, nr_segs),
+		};
+
+		return ffs_epfile_io(kiocb->ki_filp, &sync_io_data);
+	}
+
+	io_data = kzalloc(sizeof(*io_data), GFP_KERNEL);
+	if (unlikely(!io_data))
+		return -ENOMEM;
+
+	/* the iovec lives in the kiocb until aio_complete() */
+	io_data->aio = true;
+	io_data->read = read;
+	io_data->kiocb = kiocb;
+	io_data->iovec = iovec;
+	io_data->nr_segs = nr_segs;
+	io_data->len = iov_length(iovec, nr_segs);
+	io_data->mm = current->mm; /* mm teardown waits for iocbs in exit_aio() */
+	io_data->epfile = epfile;
+	INIT_WORK(&io_data->work, ffs_epfile_io_worker);
+
+	kiocb->private = io_data;
+	kiocb_set_cancel_fn(kiocb, ffs_aio_cancel);
+
+	ret = ffs_epfile_io(kiocb->ki_filp, io_data);
+	if (ret != -EIOCBQUEUED) {
+		spin_lock_irq(&epfile->ffs->eps_lock);
+		kiocb->private = NULL;
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+		kfree(io_data);
+	}
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_write(struct kiocb *kiocb,
+				    const struct iovec *iovec,
+				    unsigned long nr_segs, loff_t loff)
+{
+	return ffs_epfile_aio_rw(kiocb, iovec, nr_segs, false);
+}
+
+static ssize_t ffs_epfile_aio_read(struct kiocb *kiocb,
+				   const struct iovec *iovec,
+				   unsigned long nr_segs, loff_t loff)
+{
+	return ffs_epfile_aio_rw(kiocb, iovec, nr_segs, true);
 }
 
 static int
@@ -951,6 +1296,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
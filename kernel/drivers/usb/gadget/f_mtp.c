@@ -28,6 +28,8 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -45,6 +47,9 @@
 #include <linux/time.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_TX_BUFFER_INIT_SIZE    (256 * 1024)
+#define MTP_RX_BUFFER_INIT_SIZE    (256 * 1024)
+#define MTP_BUFFER_MAX_SIZE        (1024 * 1024)
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -61,10 +66,33 @@
 //Added Modification for ALPS00255822, bug from WHQL test
 
 /* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define TX_REQ_MAX 8
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/*
+ * File transfers move mtp_{tx,rx}_req_len bytes per request and keep up
+ * to mtp_{tx,rx}_reqs requests queued, so the file I/O for one buffer
+ * overlaps the USB transfer of the others.  Both take effect on the next
+ * bind; a buffer size that cannot be allocated is halved down to
+ * MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_req_len = MTP_TX_BUFFER_INIT_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "Buffer size of each MTP bulk IN request");
+
+static unsigned int mtp_tx_reqs = 4;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP bulk IN requests (max 8)");
+
+static unsigned int mtp_rx_req_len = MTP_RX_BUFFER_INIT_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "Buffer size of each MTP bulk OUT request");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP bulk OUT requests (max 8)");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -151,6 +179,13 @@ struct mtp_dev {
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	/* set while mtp_rx_drain() cancels reads after a normal receive */
+	int rx_draining;
+	/* request sizes and counts in use, fixed at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	int tx_reqs;
+	int rx_reqs;
 	///MEIZU_BSP{@
 	struct completion done;
 	///@}
@@ -672,14 +707,25 @@ static inline struct mtp_dev *func_to_mtp(struct usb_function *f)
 	return container_of(f, struct mtp_dev, function);
 }
 
+/*
+ * Round a requested bulk buffer size to a multiple of MTP_BULK_BUFFER_SIZE,
+ * which keeps OUT requests a whole number of max-size packets.
+ */
+static unsigned mtp_buffer_size(unsigned len)
+{
+	len = clamp_t(unsigned, len, MTP_BULK_BUFFER_SIZE, MTP_BUFFER_MAX_SIZE);
+	return rounddown(len, MTP_BULK_BUFFER_SIZE);
+}
+
 static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 {
 	struct usb_request *req = usb_ep_alloc_request(ep, GFP_KERNEL);
 	if (!req)
 		return NULL;
 
-	/* now allocate buffers for the requests */
-	req->buf = kmalloc(buffer_size, GFP_KERNEL);
+	/* now allocate buffers for the requests; big ones may fall back */
+	req->buf = kmalloc(buffer_size, buffer_size > MTP_BULK_BUFFER_SIZE ?
+			GFP_KERNEL | __GFP_NOWARN : GFP_KERNEL);
 	if (!req->buf) {
 		usb_ep_free_request(ep, req);
 		return NULL;
@@ -759,7 +805,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0)
+	/* reads cancelled by mtp_rx_drain() are not transfer errors */
+	if (req->status != 0 &&
+	    !(dev->rx_draining && req->status == -ECONNRESET))
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -817,20 +865,43 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = mtp_buffer_size(mtp_tx_req_len);
+	dev->tx_reqs = clamp_t(int, mtp_tx_reqs, 1, TX_REQ_MAX);
+retry_tx_alloc:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = mtp_buffer_size(dev->tx_req_len / 2);
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+
+	dev->rx_req_len = mtp_buffer_size(mtp_rx_req_len);
+	dev->rx_reqs = clamp_t(int, mtp_rx_reqs, 1, RX_REQ_MAX);
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = mtp_buffer_size(dev->rx_req_len / 2);
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
+	DBG(cdev, "tx %d x %u bytes, rx %d x %u bytes\n",
+		dev->tx_reqs, dev->tx_req_len, dev->rx_reqs, dev->rx_req_len);
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -908,7 +979,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%zu)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 //Added Modification for ALPS00354386
@@ -1133,8 +1204,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE) {
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len) {
+			xfer = dev->tx_req_len;
 		} else {
 			xfer = count;
 			/* let udc driver to send zlp */
@@ -1183,6 +1254,24 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * Sequential readahead hint for a file we are about to send, like
+ * POSIX_FADV_SEQUENTIAL but with a window at least as deep as the IN
+ * queue, so vfs_read() of the next buffer finds its pages already cached.
+ */
+static void mtp_file_readahead_hint(struct mtp_dev *dev, struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+	unsigned long window;
+
+	window = ((unsigned long)dev->tx_req_len * dev->tx_reqs)
+			>> PAGE_CACHE_SHIFT;
+	filp->f_ra.ra_pages = max(bdi->ra_pages * 2, window);
+	spin_lock(&filp->f_lock);
+	filp->f_mode &= ~FMODE_RANDOM;
+	spin_unlock(&filp->f_lock);
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -1211,6 +1300,8 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	mtp_file_readahead_hint(dev, filp);
+
 	if (dev->xfer_file_length >= 10 * 1024 * 1024) {
 		msdc_ungate_clock(mtk_msdc_host[0]);
 	}
@@ -1253,8 +1344,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE) {
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len) {
+			xfer = dev->tx_req_len;
 		} else {
 			xfer = count;
 			/* let udc driver to send zlp */
@@ -1363,17 +1454,46 @@ static void send_file_work(struct work_struct *data)
 	///@}
 }
 
+/*
+ * Cancel the reads still queued on the OUT endpoint when a receive ends
+ * early: a short packet ended an unknown-length transfer, the host
+ * cancelled, or a queue or file error.  Newest first, so the UDC does not
+ * start a request we are about to throw away.  After a normal end the
+ * -ECONNRESET completions must not flag the endpoint as failed.
+ */
+static void mtp_rx_drain(struct mtp_dev *dev, int head, int queued)
+{
+	struct usb_request *req;
+	int i;
+
+	dev->rx_draining = (dev->state == STATE_BUSY);
+	smp_wmb();
+	for (i = queued - 1; i >= 0; i--) {
+		req = dev->rx_req[(head + i) % dev->rx_reqs];
+		usb_ep_dequeue(dev->ep_out, req);
+	}
+	for (i = 0; i < queued; i++) {
+		req = dev->rx_req[(head + i) % dev->rx_reqs];
+		wait_event_timeout(dev->read_wq, req->status != -EINPROGRESS,
+			msecs_to_jiffies(1000));
+		//Add for RX mode 1
+		req->short_not_ok = 0;
+		//Add for RX mode 1
+	}
+	dev->rx_draining = 0;
+}
+
 /* read from USB and write to a local file */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *read_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue;
+	int ret, head = 0, queued = 0;
 	int r = 0;
 	//Modification for ALPS00434059 begin
 #if defined(MTK_SHARED_SDCARD)
@@ -1403,6 +1523,7 @@ static void receive_file_work(struct work_struct *data)
 	filp = dev->xfer_file;
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
+	to_queue = count;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
@@ -1410,14 +1531,18 @@ static void receive_file_work(struct work_struct *data)
 		msdc_ungate_clock(mtk_msdc_host[0]);
 	}
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/*
+	 * Keep up to rx_reqs reads queued so the host streams into the next
+	 * buffers while we write the oldest one to the file.  Requests on an
+	 * endpoint complete in order, so rx_req[head] always finishes first.
+	 */
+	while (count > 0) {
+		/* top up the OUT queue */
+		while (to_queue > 0 && queued < dev->rx_reqs) {
+			read_req = dev->rx_req[(head + queued) % dev->rx_reqs];
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
+			read_req->length = (to_queue > dev->rx_req_len
+					? dev->rx_req_len : to_queue);
 
 		//Modification for ALPS00434059 begin
 		//This might be modified TBD,
@@ -1445,6 +1570,7 @@ static void receive_file_work(struct work_struct *data)
 		#endif
 		//Modification for ALPS00434059 end
 			dev->rx_done = 0;
+			read_req->status = -EINPROGRESS;
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
@@ -1473,145 +1599,148 @@ static void receive_file_work(struct work_struct *data)
 				}
 				//ALPS00428998
 				//Added Modification for ALPS00279812/279484
+				read_req->short_not_ok = 0;
 				break;
 			}
-		}
-
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			do_gettimeofday(&tv_begin);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			do_gettimeofday(&tv_end);
-			DBG(cdev, "vfs_write %d\n", ret);
-			{
-				//ignore the difference under msec
-				int pos = -1;
-				int time_msec = (tv_end.tv_sec * 1000 + tv_end.tv_usec / 1000)
-					- (tv_begin.tv_sec * 1000 + tv_begin.tv_usec / 1000);
-				for (i = 0; i < IOMAXNUM; ++i){
-					if (time_msec > iotimeMax[i])
-						pos = i;
-					else
-						break;
-				}
-				if (pos > 0){
-					for (i = 1; i <= pos; ++i){
-						iotimeMax[i-1] = iotimeMax[i];
-					}
-				}
-				if (pos != -1)
-					iotimeMax[pos] = time_msec;
-			}
-
-
-			if (ret != write_req->actual) {
-				r = -EIO;
-				//dev->state = STATE_ERROR;		//Linux original source code
-				//Added Modification for ALPS00279812/279484
-				xlog_printk(ANDROID_LOG_ERROR, "USB", "%s, line %d: EIO, dev->dev_disconnected = %d, file write error \n", __func__, __LINE__, dev->dev_disconnected);
-				//ALPS00428998
-				if(dev->dev_disconnected)	//USB SW disconnected
-				{
-					dev->state = STATE_OFFLINE;
-				}
-				else	//ex: Might be SD card plug-out with USB connected
-				{
-				dev->state = STATE_ERROR;
-					#if 0
-					//Added Modification for ALPS00354386
-					//dev->state = STATE_OFFLINE;
-					usb_ep_set_halt(dev->ep_out);
-					dev->epOut_halt = 1;
-					usb_ep_fifo_flush(dev->ep_out);
-					//Added Modification for ALPS00354386
-					#else
-					mtp_ueventToDisconnect(dev);
-					#endif
-				}
-				//ALPS00428998
-				//Added Modification for ALPS00279812/279484
-				break;
-			}
-			write_req = NULL;
-		}
-
-          	//Added for MTP Develpment debug, more log for more debuging help
-		DBG(dev->cdev,		"%s, line %d: Wait for read_req = %p!! \n", __func__, __LINE__, read_req);
-          	//Added for MTP Develpment debug, more log for more debuging help
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				//Added for MTP Develpment debug, more log for more debuging help
-				xlog_printk(ANDROID_LOG_ERROR, "USB", "%s, line %d: dev->state = %d, get cancel command !! Cancel it!! rx_done = %d\n", __func__, __LINE__, dev->state, dev->rx_done);
-				//Added for USB Develpment debug, more log for more debuging help
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			//Added Modification for ALPS00255822, bug from WHQL test
-			if (dev->state == STATE_RESET) {
-				//Added for MTP Develpment debug, more log for more debuging help
-				DBG(dev->cdev,      "%s: dev->state = %d, get reset command !! Cancel it!! rx_done = %d\n", __func__, dev->state, dev->rx_done);
-				//Added for USB Develpment debug, more log for more debuging help
-				r = -ECANCELED;
-				//if (!dev->rx_done)	//marked for WHQL
-				//Added for MTP Develpment debug, more log for more debuging help
-				DBG(dev->cdev,      "%s, %d: request to usb_ep_dequeue!! \n", __func__, __LINE__);
-				//Added for USB Develpment debug, more log for more debuging help
-				usb_ep_dequeue(dev->ep_out, read_req);
-				break;
+			queued++;
 
-			}
-			//Added Modification for ALPS00255822, bug from WHQL test
 			/* if xfer_file_length is 0xFFFFFFFF, then we read until
 			 * we get a zero length packet
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-
-		//Modification for ALPS00434059 begin
+			if (to_queue != 0xFFFFFFFF)
+				to_queue -= read_req->length;
 		#if defined(MTK_SHARED_SDCARD)
-			total_size += read_req->actual;
-			DBG(cdev, "%s, line %d: count = %lld, total_size = %lld, read_req->actual = %d, read_req->length= %d\n", __func__, __LINE__, count, total_size, read_req->actual, read_req->length);
+			total_size += read_req->length;
 		#endif
-		//Modification for ALPS00434059 begin
+		}
+		if (r)
+			break;
 
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		read_req = dev->rx_req[head];
+          	//Added for MTP Develpment debug, more log for more debuging help
+		DBG(dev->cdev,		"%s, line %d: Wait for read_req = %p, %d queued!! \n", __func__, __LINE__, read_req, queued);
+          	//Added for MTP Develpment debug, more log for more debuging help
 
-			//Add for RX mode 1
-			read_req->short_not_ok = 0;
-			//Add for RX mode 1
+		/* wait for the oldest read to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+			read_req->status != -EINPROGRESS ||
+			dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
 			//Added for MTP Develpment debug, more log for more debuging help
-			DBG(dev->cdev,      "%s, line %d: dev->state = %d, NEXT!!\n", __func__, __LINE__, dev->state);
+			xlog_printk(ANDROID_LOG_ERROR, "USB", "%s, line %d: dev->state = %d, get cancel command !! Cancel it!! rx_done = %d\n", __func__, __LINE__, dev->state, dev->rx_done);
 			//Added for USB Develpment debug, more log for more debuging help
+			r = -ECANCELED;
+			break;
+		}
+		//Added Modification for ALPS00255822, bug from WHQL test
+		if (dev->state == STATE_RESET) {
+			//Added for MTP Develpment debug, more log for more debuging help
+			DBG(dev->cdev,      "%s: dev->state = %d, get reset command !! Cancel it!! rx_done = %d\n", __func__, dev->state, dev->rx_done);
+			//Added for USB Develpment debug, more log for more debuging help
+			r = -ECANCELED;
+			break;
 
-			write_req = read_req;
-			read_req = NULL;
 		}
-	}
+		//Added Modification for ALPS00255822, bug from WHQL test
+		if (read_req->status != 0) {
+			DBG(cdev, "%s, line %d: read_req status %d, dev->state = %d\n", __func__, __LINE__, read_req->status, dev->state);
+			r = -EIO;
+			break;
+		}
+		head = (head + 1) % dev->rx_reqs;
+		queued--;
 
-	//Added Modification for ALPS00354386
-	if(dev->state == STATE_ERROR || dev->state == STATE_OFFLINE)
-	{
-		//Added for MTP Develpment debug, more log for more debuging help
-		DBG(dev->cdev,      "%s, line %d: read_req = %p \n", __func__, __LINE__, read_req);
-		//Added for USB Develpment debug, more log for more debuging help
-		if(read_req)
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= read_req->actual;
+
+	//Modification for ALPS00434059 begin
+	#if defined(MTK_SHARED_SDCARD)
+		DBG(cdev, "%s, line %d: count = %lld, total_size = %lld, read_req->actual = %d, read_req->length= %d\n", __func__, __LINE__, count, total_size, read_req->actual, read_req->length);
+	#endif
+	//Modification for ALPS00434059 begin
+
+		if (read_req->actual < read_req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
+			 */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+		}
+
+		//Add for RX mode 1
+		read_req->short_not_ok = 0;
+		//Add for RX mode 1
+
+		/* the rest of the queue keeps receiving while we write */
+		DBG(cdev, "rx %p %d\n", read_req, read_req->actual);
+		do_gettimeofday(&tv_begin);
+		ret = vfs_write(filp, read_req->buf, read_req->actual,
+			&offset);
+		do_gettimeofday(&tv_end);
+		DBG(cdev, "vfs_write %d\n", ret);
 		{
-			read_req->short_not_ok = 0;
+			//ignore the difference under msec
+			int pos = -1;
+			int time_msec = (tv_end.tv_sec * 1000 + tv_end.tv_usec / 1000)
+				- (tv_begin.tv_sec * 1000 + tv_begin.tv_usec / 1000);
+			for (i = 0; i < IOMAXNUM; ++i){
+				if (time_msec > iotimeMax[i])
+					pos = i;
+				else
+					break;
+			}
+			if (pos > 0){
+				for (i = 1; i <= pos; ++i){
+					iotimeMax[i-1] = iotimeMax[i];
+				}
+			}
+			if (pos != -1)
+				iotimeMax[pos] = time_msec;
+		}
+
+		if (ret != read_req->actual) {
+			r = -EIO;
+			//dev->state = STATE_ERROR;		//Linux original source code
+			//Added Modification for ALPS00279812/279484
+			xlog_printk(ANDROID_LOG_ERROR, "USB", "%s, line %d: EIO, dev->dev_disconnected = %d, file write error \n", __func__, __LINE__, dev->dev_disconnected);
+			//ALPS00428998
+			if(dev->dev_disconnected)	//USB SW disconnected
+			{
+				dev->state = STATE_OFFLINE;
+			}
+			else	//ex: Might be SD card plug-out with USB connected
+			{
+			dev->state = STATE_ERROR;
+				#if 0
+				//Added Modification for ALPS00354386
+				//dev->state = STATE_OFFLINE;
+				usb_ep_set_halt(dev->ep_out);
+				dev->epOut_halt = 1;
+				usb_ep_fifo_flush(dev->ep_out);
+				//Added Modification for ALPS00354386
+				#else
+				mtp_ueventToDisconnect(dev);
+				#endif
+			}
+			//ALPS00428998
+			//Added Modification for ALPS00279812/279484
+			break;
 		}
+		//Added for MTP Develpment debug, more log for more debuging help
+		DBG(dev->cdev,      "%s, line %d: dev->state = %d, NEXT!!\n", __func__, __LINE__, dev->state);
+		//Added for USB Develpment debug, more log for more debuging help
 	}
+
+	//Added Modification for ALPS00354386
+	//Added for MTP Develpment debug, more log for more debuging help
+	DBG(dev->cdev,      "%s, line %d: %d reads still queued, dev->state = %d \n", __func__, __LINE__, queued, dev->state);
+	//Added for USB Develpment debug, more log for more debuging help
+	if (queued)
+		mtp_rx_drain(dev, head, queued);
 	//Added Modification for ALPS00354386
 
 	if (dev->xfer_file_length >= 10 * 1024 * 1024) {
@@ -2276,8 +2405,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -2416,6 +2547,9 @@ static int mtp_setup(void)
 	atomic_set(&dev->ioctl_excl, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
+	/* until the first bind sizes the real buffers */
+	dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+	dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
 
 	dev->wq = create_singlethread_workqueue("f_mtp");
 	if (!dev->wq) {
@@ -42,6 +42,7 @@ handle_t *__ext4_journal_start_sb(struct super_block *sb, unsigned int line,
 				  int type, int nblocks)
 {
 	journal_t *journal;
+	handle_t *handle;
 
 	might_sleep();
 
@@ -62,7 +63,10 @@ handle_t *__ext4_journal_start_sb(struct super_block *sb, unsigned int line,
 		ext4_abort(sb, "Detected aborted journal");
 		return ERR_PTR(-EROFS);
 	}
-	return jbd2__journal_start(journal, nblocks, GFP_NOFS, type, line);
+	handle = jbd2__journal_start(journal, nblocks, GFP_NOFS, type, line);
+	if (!IS_ERR(handle))
+		ext4_fc_start_handle(sb, handle, type);
+	return handle;
 }
 
 int __ext4_journal_stop(const char *where, unsigned int line, handle_t *handle)
@@ -264,6 +268,7 @@ int __ext4_handle_dirty_super(const char *where, unsigned int line,
 
 	ext4_superblock_csum_set(sb);
 	if (ext4_handle_valid(handle)) {
+		ext4_fc_mark_ineligible(sb, handle);
 		err = jbd2_journal_dirty_metadata(handle, bh);
 		if (err)
 			ext4_journal_abort_handle(where, line, __func__,
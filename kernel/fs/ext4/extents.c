@@ -229,6 +229,8 @@ ext4_ext_new_meta_block(handle_t *handle, struct inode *inode,
 {
 	ext4_fsblk_t goal, newblock;
 
+	/* Fast commits only log blocks of the existing tree */
+	ext4_fc_mark_ineligible(inode->i_sb, handle);
 	goal = ext4_ext_find_goal(inode, path, le32_to_cpu(ex->ee_block));
 	newblock = ext4_new_meta_blocks(handle, inode, goal, flags,
 					NULL, err);
@@ -2042,6 +2044,62 @@ cleanup:
 	return err;
 }
 
+/*
+ * ext4_ext_walk_tree_blocks:
+ * calls @fn once for each index and leaf block on the way to the extents
+ * mapping [@start, @end), i.e. for each tree block a change to the
+ * mapping of the range can have touched.  Stops at the first error.
+ */
+int ext4_ext_walk_tree_blocks(struct inode *inode, ext4_lblk_t start,
+			      ext4_lblk_t end,
+			      int (*fn)(struct buffer_head *, void *),
+			      void *data)
+{
+	struct ext4_ext_path *path = NULL, *npath;
+	ext4_fsblk_t *seen;
+	ext4_lblk_t next;
+	int depth, i, err = 0;
+
+	down_read(&EXT4_I(inode)->i_data_sem);
+	depth = ext_depth(inode);
+	if (!depth)
+		goto out;
+
+	seen = kcalloc(depth + 1, sizeof(*seen), GFP_NOFS);
+	if (!seen) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	while (start < end) {
+		npath = ext4_ext_find_extent(inode, start, path);
+		if (IS_ERR(npath)) {
+			err = PTR_ERR(npath);
+			break;
+		}
+		path = npath;
+
+		for (i = 1; i <= depth && !err; i++) {
+			if (path[i].p_bh->b_blocknr == seen[i])
+				continue;
+			seen[i] = path[i].p_bh->b_blocknr;
+			err = fn(path[i].p_bh, data);
+		}
+
+		next = ext4_ext_next_leaf_block(path);
+		ext4_ext_drop_refs(path);
+		if (err || next == EXT_MAX_BLOCKS || next <= start)
+			break;
+		start = next;
+	}
+
+	kfree(path);
+	kfree(seen);
+out:
+	up_read(&EXT4_I(inode)->i_data_sem);
+	return err;
+}
+
 static int ext4_fill_fiemap_extents(struct inode *inode,
 				    ext4_lblk_t block, ext4_lblk_t num,
 				    struct fiemap_extent_info *fieinfo)
@@ -0,0 +1,608 @@
+/*
+ *  fs/ext4/fast_commit.c
+ *
+ * Fast commits: make an fsync durable by logging just the inode being
+ * synced instead of committing the whole running transaction.
+ *
+ * A fast commit is only attempted when everything the running transaction
+ * holds for the inode can be redone from
+ *
+ *  - the extents now mapping the logical blocks allocated or converted in
+ *    the transaction (i_fc_lblk_start/len),
+ *  - the extent tree blocks on the way to those extents, and
+ *  - the raw on-disk inode.
+ *
+ * Anything else, such as directory changes, freeing blocks, growing the
+ * extent tree, xattrs or quota, marks the transaction ineligible and the
+ * fsync falls back to a full commit.  So does running out of room in the
+ * fast commit area, which is reused after every full commit.
+ *
+ * Fast commits only count on top of the transaction before the one they
+ * were made in: recovery replays those with the tid of the first
+ * transaction it did not find committed in the log, after replaying the
+ * log itself.
+ */
+
+#include <linux/crc32.h>
+#include <asm/unaligned.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+struct ext4_fc_write_state {
+	journal_t *journal;
+	struct buffer_head *bh;
+	int off;
+	u32 crc;
+};
+
+/*
+ * Called for every handle started: only handles of types that are known
+ * to change nothing but the inode, its extents and the block bitmaps may
+ * be part of a transaction a fast commit covers.
+ */
+void ext4_fc_start_handle(struct super_block *sb, handle_t *handle, int type)
+{
+	switch (type) {
+	case EXT4_HT_INODE:
+	case EXT4_HT_WRITE_PAGE:
+	case EXT4_HT_MAP_BLOCKS:
+		return;
+	default:
+		ext4_fc_mark_ineligible(sb, handle);
+	}
+}
+
+void ext4_fc_mark_ineligible(struct super_block *sb, handle_t *handle)
+{
+	if (!ext4_handle_valid(handle))
+		return;
+	EXT4_SB(sb)->s_fc_ineligible_tid = handle->h_transaction->t_tid;
+}
+
+/*
+ * Record that [lblk, lblk + len) of @inode was mapped in the transaction
+ * of @handle.  Called with i_data_sem held for writing.
+ */
+void ext4_fc_track_range(handle_t *handle, struct inode *inode,
+			 ext4_lblk_t lblk, ext4_lblk_t len)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	ext4_lblk_t end;
+	tid_t tid;
+
+	if (!ext4_handle_valid(handle) ||
+	    !test_opt(inode->i_sb, JOURNAL_FAST_COMMIT))
+		return;
+
+	tid = handle->h_transaction->t_tid;
+	if (ei->i_fc_tid != tid || !ei->i_fc_lblk_len) {
+		ei->i_fc_tid = tid;
+		ei->i_fc_lblk_start = lblk;
+		ei->i_fc_lblk_len = len;
+		return;
+	}
+
+	end = max(ei->i_fc_lblk_start + ei->i_fc_lblk_len, lblk + len);
+	ei->i_fc_lblk_start = min(ei->i_fc_lblk_start, lblk);
+	ei->i_fc_lblk_len = end - ei->i_fc_lblk_start;
+}
+
+static bool ext4_fc_inode_eligible(struct inode *inode)
+{
+	return S_ISREG(inode->i_mode) &&
+		ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) &&
+		!ext4_has_inline_data(inode) &&
+		!ext4_should_journal_data(inode);
+}
+
+/*
+ * Get room for a record with a @len byte value in the current block, or
+ * the next one if it does not fit, and fill in its header.  Returns the
+ * value area, for the caller to fill in before ext4_fc_end_tlv().
+ */
+static void *ext4_fc_begin_tlv(struct ext4_fc_write_state *s, int tag,
+			       int len, int *err)
+{
+	int bsize = s->journal->j_blocksize;
+	struct ext4_fc_tl *tl;
+
+	if (s->bh && s->off + sizeof(*tl) + len > bsize) {
+		/* Pad out the rest of the block */
+		if (s->off < bsize) {
+			tl = (struct ext4_fc_tl *)(s->bh->b_data + s->off);
+			tl->fc_tag = cpu_to_le16(EXT4_FC_TAG_PAD);
+			tl->fc_len = cpu_to_le16(bsize - s->off - sizeof(*tl));
+			memset(tl + 1, 0, bsize - s->off - sizeof(*tl));
+			s->crc = crc32_be(s->crc, (u8 *)tl, bsize - s->off);
+		}
+		s->bh = NULL;
+	}
+
+	if (!s->bh) {
+		*err = jbd2_fc_get_buf(s->journal, &s->bh);
+		if (*err)
+			return NULL;
+		s->off = 0;
+	}
+
+	tl = (struct ext4_fc_tl *)(s->bh->b_data + s->off);
+	tl->fc_tag = cpu_to_le16(tag);
+	tl->fc_len = cpu_to_le16(len);
+	return tl + 1;
+}
+
+static void ext4_fc_end_tlv(struct ext4_fc_write_state *s, int len)
+{
+	len += sizeof(struct ext4_fc_tl);
+	s->crc = crc32_be(s->crc, (u8 *)s->bh->b_data + s->off, len);
+	s->off += len;
+}
+
+static int ext4_fc_add_range(struct ext4_fc_write_state *s,
+			     struct inode *inode, struct ext4_map_blocks *map)
+{
+	struct ext4_fc_add_range *range;
+	struct ext4_extent ex;
+	int err;
+
+	range = ext4_fc_begin_tlv(s, EXT4_FC_TAG_ADD_RANGE, sizeof(*range),
+				  &err);
+	if (!range)
+		return err;
+
+	ex.ee_block = cpu_to_le32(map->m_lblk);
+	ex.ee_len = cpu_to_le16(map->m_len);
+	ext4_ext_store_pblock(&ex, map->m_pblk);
+	if (map->m_flags & EXT4_MAP_UNWRITTEN)
+		ext4_ext_mark_uninitialized(&ex);
+
+	range->fc_ino = cpu_to_le32(inode->i_ino);
+	memcpy(range->fc_ex, &ex, sizeof(ex));
+	ext4_fc_end_tlv(s, sizeof(*range));
+	return 0;
+}
+
+/* Log the extents now mapping the blocks tracked for the transaction */
+static int ext4_fc_write_ranges(struct ext4_fc_write_state *s,
+				struct inode *inode)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	ext4_lblk_t lblk = ei->i_fc_lblk_start;
+	ext4_lblk_t end = lblk + ei->i_fc_lblk_len;
+	struct ext4_map_blocks map;
+	struct extent_status es;
+	int ret;
+
+	while (lblk < end) {
+		map.m_lblk = lblk;
+		map.m_len = min_t(ext4_lblk_t, end - lblk, EXT_UNINIT_MAX_LEN);
+		ret = ext4_map_blocks(NULL, inode, &map, 0);
+		if (ret < 0)
+			return ret;
+		if (!ret) {
+			/* Skip the hole, or delayed extent, in one go */
+			if (ext4_es_lookup_extent(inode, lblk, &es) &&
+			    es.es_lblk + es.es_len > lblk)
+				lblk = es.es_lblk + es.es_len;
+			else
+				lblk++;
+			continue;
+		}
+
+		map.m_len = ret;
+		ret = ext4_fc_add_range(s, inode, &map);
+		if (ret)
+			return ret;
+		lblk += map.m_len;
+	}
+	return 0;
+}
+
+/* Log the contents of an extent tree block, in as many pieces as needed */
+static int ext4_fc_add_block(struct buffer_head *bh, void *data)
+{
+	struct ext4_fc_write_state *s = data;
+	int bsize = s->journal->j_blocksize;
+	int hdr = sizeof(struct ext4_fc_tl) + sizeof(struct ext4_fc_block);
+	struct ext4_fc_block *blk;
+	int off, len, err;
+
+	for (off = 0; off < bsize; off += len) {
+		len = s->bh ? bsize - s->off - hdr : 0;
+		/* Not worth splitting for a sliver of a block */
+		if (len < 64)
+			len = bsize - hdr;
+		len = min(len, bsize - off);
+
+		blk = ext4_fc_begin_tlv(s, EXT4_FC_TAG_BLOCK,
+					sizeof(*blk) + len, &err);
+		if (!blk)
+			return err;
+		put_unaligned_le64(bh->b_blocknr, &blk->fc_blk);
+		blk->fc_off = cpu_to_le32(off);
+		blk->fc_reserved = 0;
+		memcpy(blk->fc_data, bh->b_data + off, len);
+		ext4_fc_end_tlv(s, sizeof(*blk) + len);
+	}
+	return 0;
+}
+
+static int ext4_fc_write_inode(struct ext4_fc_write_state *s,
+			       struct inode *inode)
+{
+	int inode_len = EXT4_INODE_SIZE(inode->i_sb);
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_iloc iloc;
+	int err;
+
+	err = ext4_get_inode_loc(inode, &iloc);
+	if (err)
+		return err;
+
+	fc_inode = ext4_fc_begin_tlv(s, EXT4_FC_TAG_INODE,
+				     sizeof(*fc_inode) + inode_len, &err);
+	if (fc_inode) {
+		fc_inode->fc_ino = cpu_to_le32(inode->i_ino);
+		memcpy(fc_inode->fc_raw_inode, ext4_raw_inode(&iloc),
+		       inode_len);
+		ext4_fc_end_tlv(s, sizeof(*fc_inode) + inode_len);
+	}
+	brelse(iloc.bh);
+	return err;
+}
+
+static int ext4_fc_write(journal_t *journal, struct inode *inode, tid_t tid)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_fc_write_state s = {
+		.journal = journal,
+		.crc = ~0,
+	};
+	struct ext4_fc_head *head;
+	struct ext4_fc_tail *tail;
+	int err;
+
+	head = ext4_fc_begin_tlv(&s, EXT4_FC_TAG_HEAD, sizeof(*head), &err);
+	if (!head)
+		return err;
+	head->fc_features = 0;
+	head->fc_tid = cpu_to_le32(tid);
+	ext4_fc_end_tlv(&s, sizeof(*head));
+
+	if (ei->i_fc_tid == tid && ei->i_fc_lblk_len) {
+		err = ext4_fc_write_ranges(&s, inode);
+		if (!err)
+			err = ext4_ext_walk_tree_blocks(inode,
+					ei->i_fc_lblk_start,
+					ei->i_fc_lblk_start + ei->i_fc_lblk_len,
+					ext4_fc_add_block, &s);
+		if (err)
+			return err;
+	}
+
+	err = ext4_fc_write_inode(&s, inode);
+	if (err)
+		return err;
+
+	/* The tail is not covered by the crc it carries */
+	tail = ext4_fc_begin_tlv(&s, EXT4_FC_TAG_TAIL, sizeof(*tail), &err);
+	if (!tail)
+		return err;
+	tail->fc_tid = cpu_to_le32(tid);
+	tail->fc_crc = cpu_to_le32(s.crc);
+	s.off += sizeof(struct ext4_fc_tl) + sizeof(*tail);
+	memset(s.bh->b_data + s.off, 0, journal->j_blocksize - s.off);
+	return 0;
+}
+
+/*
+ * Make what transaction @tid holds for @inode durable with a fast commit.
+ *
+ * Returns 0 on success.  Otherwise the caller has to wait for @tid to be
+ * committed as usual: either it already is committing, or a fast commit
+ * cannot cover it.
+ */
+int ext4_fc_commit(journal_t *journal, struct inode *inode, tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	int err;
+
+	if (!ext4_fc_inode_eligible(inode) ||
+	    ACCESS_ONCE(sbi->s_fc_ineligible_tid) == tid ||
+	    tid_geq(journal->j_commit_sequence, tid))
+		return -EINVAL;
+
+	/*
+	 * No handle can change anything while we look at it.  Lock out
+	 * updates before starting the fast commit, the same order as
+	 * freezing, which holds the barrier while waiting for a commit
+	 * that in turn waits for any fast commit in progress.
+	 */
+	jbd2_journal_lock_updates(journal);
+	err = jbd2_fc_begin_commit(journal, tid);
+	if (err) {
+		jbd2_journal_unlock_updates(journal);
+		return err;
+	}
+
+	if (!ext4_fc_inode_eligible(inode) || sbi->s_fc_ineligible_tid == tid) {
+		err = -EINVAL;
+	} else {
+		/*
+		 * The data of blocks allocated in the transaction has to be
+		 * on disk before a fast commit makes them part of the file.
+		 */
+		err = filemap_fdatawait(inode->i_mapping);
+		if (!err)
+			err = ext4_fc_write(journal, inode, tid);
+	}
+	jbd2_journal_unlock_updates(journal);
+
+	if (!err && journal->j_fs_dev != journal->j_dev &&
+	    (journal->j_flags & JBD2_BARRIER))
+		err = blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL);
+
+	if (err) {
+		jbd2_fc_end_commit_fallback(journal);
+		return err;
+	}
+	return jbd2_fc_end_commit(journal);
+}
+
+/* Mark [pblk, pblk + len) in use in the block bitmaps */
+static int ext4_fc_replay_mark_used(struct super_block *sb,
+				    ext4_fsblk_t pblk, unsigned int len)
+{
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh, *gd_bh;
+	ext4_group_t group;
+	ext4_grpblk_t off;
+	unsigned int n, i, free;
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, pblk, &group, &off);
+		n = min_t(unsigned int, len, EXT4_BLOCKS_PER_GROUP(sb) - off);
+
+		gdp = ext4_get_group_desc(sb, group, &gd_bh);
+		if (!gdp)
+			return -EIO;
+
+		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+			bh = sb_getblk(sb, ext4_block_bitmap(sb, gdp));
+			if (!bh)
+				return -ENOMEM;
+			lock_buffer(bh);
+			ext4_init_block_bitmap(sb, bh, group, gdp);
+			set_buffer_uptodate(bh);
+			unlock_buffer(bh);
+			gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+			ext4_free_group_clusters_set(sb, gdp,
+				ext4_free_clusters_after_init(sb, group, gdp));
+		} else {
+			bh = sb_bread(sb, ext4_block_bitmap(sb, gdp));
+			if (!bh)
+				return -EIO;
+		}
+
+		free = ext4_free_group_clusters(sb, gdp);
+		for (i = 0; i < n; i++)
+			if (!ext4_test_and_set_bit(off + i, bh->b_data))
+				free--;
+		ext4_free_group_clusters_set(sb, gdp, free);
+		ext4_block_bitmap_csum_set(sb, group, gdp, bh);
+		ext4_group_desc_csum_set(sb, group, gdp);
+		mark_buffer_dirty(bh);
+		mark_buffer_dirty(gd_bh);
+		brelse(bh);
+
+		pblk += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static bool ext4_fc_replay_blk_valid(struct super_block *sb,
+				     ext4_fsblk_t pblk, unsigned int len)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+
+	return pblk >= le32_to_cpu(es->s_first_data_block) && len &&
+		pblk + len > pblk && pblk + len <= ext4_blocks_count(es);
+}
+
+static int ext4_fc_replay_add_range(struct super_block *sb, void *val,
+				    int len)
+{
+	struct ext4_fc_add_range *range = val;
+	struct ext4_extent ex;
+	ext4_fsblk_t pblk;
+	unsigned int ex_len;
+
+	if (len != sizeof(*range))
+		return -EIO;
+	memcpy(&ex, range->fc_ex, sizeof(ex));
+	pblk = ext4_ext_pblock(&ex);
+	ex_len = ext4_ext_get_actual_len(&ex);
+	if (!ext4_fc_replay_blk_valid(sb, pblk, ex_len))
+		return -EIO;
+	return ext4_fc_replay_mark_used(sb, pblk, ex_len);
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, void *val, int len)
+{
+	struct ext4_fc_inode *fc_inode = val;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long ino = le32_to_cpu(fc_inode->fc_ino);
+	unsigned long offset;
+	ext4_fsblk_t block;
+
+	if (len != sizeof(*fc_inode) + EXT4_INODE_SIZE(sb) || ino < 1 ||
+	    ino > le32_to_cpu(EXT4_SB(sb)->s_es->s_inodes_count))
+		return -EIO;
+
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return -EIO;
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * EXT4_INODE_SIZE(sb);
+	block = ext4_inode_table(sb, gdp) + offset / sb->s_blocksize;
+
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data + offset % sb->s_blocksize, fc_inode->fc_raw_inode,
+	       EXT4_INODE_SIZE(sb));
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+static int ext4_fc_replay_block(struct super_block *sb, void *val, int len)
+{
+	struct ext4_fc_block *blk = val;
+	struct buffer_head *bh;
+	ext4_fsblk_t pblk = get_unaligned_le64(&blk->fc_blk);
+	unsigned int off = le32_to_cpu(blk->fc_off);
+
+	len -= sizeof(*blk);
+	if (len <= 0 || off + len > sb->s_blocksize ||
+	    !ext4_fc_replay_blk_valid(sb, pblk, 1))
+		return -EIO;
+
+	bh = sb_bread(sb, pblk);
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data + off, blk->fc_data, len);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/*
+ * Recovery callback, called for each block of the fast commit area in
+ * turn.  The scan pass finds how many records are covered by fast commits
+ * of @expected_tid with a good tail; the replay pass applies those.
+ * Returns JBD2_FC_REPLAY_CONTINUE for the next block, JBD2_FC_REPLAY_STOP
+ * when done, or a negative error.
+ */
+int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+		   enum passtype pass, int off, tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_replay_state *state = &EXT4_SB(sb)->s_fc_replay_state;
+	int bsize = journal->j_blocksize;
+	struct ext4_fc_tl *tl;
+	struct ext4_fc_tail *tail;
+	int pos, tag, len, err = 0;
+	void *val;
+
+	if (!off) {
+		if (pass == PASS_SCAN) {
+			memset(state, 0, sizeof(*state));
+			state->fc_crc = ~0;
+		} else {
+			state->fc_cur_tag = 0;
+		}
+	}
+	if (pass == PASS_REPLAY &&
+	    state->fc_cur_tag >= state->fc_replay_num_tags)
+		return JBD2_FC_REPLAY_STOP;
+
+	for (pos = 0; pos + sizeof(*tl) <= bsize;
+	     pos += sizeof(*tl) + len) {
+		tl = (struct ext4_fc_tl *)(bh->b_data + pos);
+		tag = le16_to_cpu(tl->fc_tag);
+		len = le16_to_cpu(tl->fc_len);
+		val = tl + 1;
+		if (pos + sizeof(*tl) + len > bsize)
+			return JBD2_FC_REPLAY_STOP;
+
+		if (pass == PASS_SCAN) {
+			switch (tag) {
+			case EXT4_FC_TAG_HEAD:
+				if (state->fc_in_commit ||
+				    len != sizeof(struct ext4_fc_head) ||
+				    le32_to_cpu(((struct ext4_fc_head *)val)->
+						fc_tid) != expected_tid)
+					return JBD2_FC_REPLAY_STOP;
+				state->fc_in_commit = 1;
+				break;
+			case EXT4_FC_TAG_ADD_RANGE:
+			case EXT4_FC_TAG_INODE:
+			case EXT4_FC_TAG_BLOCK:
+			case EXT4_FC_TAG_PAD:
+				if (!state->fc_in_commit)
+					return JBD2_FC_REPLAY_STOP;
+				break;
+			case EXT4_FC_TAG_TAIL:
+				tail = val;
+				if (!state->fc_in_commit ||
+				    len != sizeof(*tail) ||
+				    le32_to_cpu(tail->fc_tid) != expected_tid ||
+				    le32_to_cpu(tail->fc_crc) != state->fc_crc)
+					return JBD2_FC_REPLAY_STOP;
+				state->fc_cur_tag++;
+				state->fc_replay_num_tags = state->fc_cur_tag;
+				state->fc_in_commit = 0;
+				state->fc_crc = ~0;
+				/* The next fast commit starts a new block */
+				return JBD2_FC_REPLAY_CONTINUE;
+			default:
+				return JBD2_FC_REPLAY_STOP;
+			}
+			state->fc_crc = crc32_be(state->fc_crc, (u8 *)tl,
+						 sizeof(*tl) + len);
+			state->fc_cur_tag++;
+			continue;
+		}
+
+		if (state->fc_cur_tag >= state->fc_replay_num_tags)
+			return JBD2_FC_REPLAY_STOP;
+		state->fc_cur_tag++;
+
+		switch (tag) {
+		case EXT4_FC_TAG_ADD_RANGE:
+			err = ext4_fc_replay_add_range(sb, val, len);
+			break;
+		case EXT4_FC_TAG_INODE:
+			err = ext4_fc_replay_inode(sb, val, len);
+			break;
+		case EXT4_FC_TAG_BLOCK:
+			err = ext4_fc_replay_block(sb, val, len);
+			break;
+		case EXT4_FC_TAG_TAIL:
+			return JBD2_FC_REPLAY_CONTINUE;
+		}
+		if (err)
+			return err;
+	}
+	return JBD2_FC_REPLAY_CONTINUE;
+}
+
+/*
+ * Set up fast commits at mount time.  They cover the fsync of a file
+ * whose new data went to blocks allocated at writeback time and which is
+ * on disk once writeback is done, so delalloc is required and the modes
+ * that defer or journal data writes are not supported.
+ */
+int ext4_fc_init(struct super_block *sb, journal_t *journal)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	if (sb->s_flags & MS_RDONLY)
+		return -EROFS;
+
+	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA ||
+	    !test_opt(sb, DELALLOC) || test_opt(sb, DIOREAD_NOLOCK) ||
+	    sbi->s_cluster_ratio > 1) {
+		ext4_msg(sb, KERN_WARNING, "fast_commit needs delalloc and "
+			 "does not support data=journal, dioread_nolock or "
+			 "bigalloc");
+		return -EINVAL;
+	}
+
+	sbi->s_fc_ineligible_tid = journal->j_commit_sequence;
+	return jbd2_fc_init(journal, 0);
+}
@@ -0,0 +1,71 @@
+/*
+ *  fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commits.
+ */
+
+#ifndef _EXT4_FAST_COMMIT_H
+#define _EXT4_FAST_COMMIT_H
+
+/*
+ * A fast commit is a run of tag-length-value records in the fast commit
+ * area of the journal, starting on a block boundary:
+ *
+ *   HEAD, { ADD_RANGE | BLOCK | PAD }*, INODE, TAIL
+ *
+ * Every record starts 4 byte aligned and never crosses a block boundary;
+ * a record that does not fit is preceded by a PAD filling the rest of the
+ * block.  The TAIL carries a crc32 of all records of the fast commit
+ * before it; whatever follows the TAIL in its block is ignored.
+ */
+#define EXT4_FC_TAG_HEAD	0x0001
+#define EXT4_FC_TAG_ADD_RANGE	0x0002
+#define EXT4_FC_TAG_INODE	0x0003
+#define EXT4_FC_TAG_BLOCK	0x0004
+#define EXT4_FC_TAG_PAD		0x0005
+#define EXT4_FC_TAG_TAIL	0x0006
+
+struct ext4_fc_tl {
+	__le16 fc_tag;
+	__le16 fc_len;			/* of the value that follows */
+};
+
+struct ext4_fc_head {
+	__le32 fc_features;
+	__le32 fc_tid;
+};
+
+/* Blocks of the extent are in use by the inode */
+struct ext4_fc_add_range {
+	__le32 fc_ino;
+	__u8 fc_ex[12];			/* struct ext4_extent */
+};
+
+/* Raw on-disk inode, EXT4_INODE_SIZE() bytes */
+struct ext4_fc_inode {
+	__le32 fc_ino;
+	__u8 fc_raw_inode[0];
+};
+
+/* Part of the new contents of an extent tree block */
+struct ext4_fc_block {
+	__le64 fc_blk;			/* only 4 byte aligned */
+	__le32 fc_off;
+	__le32 fc_reserved;
+	__u8 fc_data[0];
+};
+
+struct ext4_fc_tail {
+	__le32 fc_tid;
+	__le32 fc_crc;
+};
+
+/* Filled in by the scan pass of recovery, used by the replay pass */
+struct ext4_fc_replay_state {
+	int fc_replay_num_tags;		/* records covered by a valid tail */
+	int fc_cur_tag;
+	int fc_in_commit;
+	u32 fc_crc;
+};
+
+#endif /* _EXT4_FAST_COMMIT_H */
@@ -746,6 +746,8 @@ found:
 	}
 
 has_zeroout:
+	if (retval > 0)
+		ext4_fc_track_range(handle, inode, map->m_lblk, retval);
 	up_write((&EXT4_I(inode)->i_data_sem));
 	if (retval > 0 && map->m_flags & EXT4_MAP_MAPPED) {
 		int ret = check_block_validity(inode, map);
@@ -2532,6 +2532,9 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	J_ASSERT((S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 		  S_ISLNK(inode->i_mode)) || inode->i_nlink == 0);
 
+	/* The orphan list links other inodes, fast commits log just one */
+	ext4_fc_mark_ineligible(sb, handle);
+
 	BUFFER_TRACE(EXT4_SB(sb)->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, EXT4_SB(sb)->s_sbh);
 	if (err)
@@ -2613,6 +2616,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 	if (!handle)
 		goto out;
 
+	ext4_fc_mark_ineligible(inode->i_sb, handle);
 	err = ext4_reserve_inode_write(handle, inode, &iloc);
 	if (err)
 		goto out_err;
@@ -45,6 +45,9 @@ static void __set_data_blkaddr(struct dnode_of_data *dn, block_t new_addr)
 	addr_array = blkaddr_in_node(rn);
 	addr_array[ofs_in_node] = cpu_to_le32(new_addr);
 	set_page_dirty(node_page);
+
+	/* the next fsync has to log this node block */
+	set_inode_flag(F2FS_I(dn->inode), FI_DIRTY_DNODE);
 }
 
 int reserve_new_block(struct dnode_of_data *dn)
@@ -447,6 +450,14 @@ static int get_data_block_ro(struct inode *inode, sector_t iblock,
 
 static int f2fs_read_data_page(struct file *file, struct page *page)
 {
+	struct inode *inode = page->mapping->host;
+	int ret;
+
+	if (f2fs_has_inline_data(inode)) {
+		ret = f2fs_read_inline_data(inode, page);
+		unlock_page(page);
+		return ret;
+	}
 	return mpage_readpage(page, get_data_block_ro);
 }
 
@@ -454,6 +465,10 @@ static int f2fs_read_data_pages(struct file *file,
 			struct address_space *mapping,
 			struct list_head *pages, unsigned nr_pages)
 {
+	/* inline data is read by ->readpage() on demand */
+	if (f2fs_has_inline_data(mapping->host))
+		return 0;
+
 	return mpage_readpages(mapping, pages, nr_pages, get_data_block_ro);
 }
 
@@ -485,6 +500,7 @@ int do_write_data_page(struct page *page)
 				need_inplace_update(inode)) {
 		rewrite_data_page(F2FS_SB(inode->i_sb), page,
 						old_blk_addr);
+		set_inode_flag(F2FS_I(inode), FI_UPDATE_WRITE);
 	} else {
 		write_data_page(inode, page, &dn,
 				old_blk_addr, &new_blk_addr);
@@ -537,7 +553,10 @@ write:
 		err = do_write_data_page(page);
 	} else {
 		int ilock = mutex_lock_op(sbi);
-		err = do_write_data_page(page);
+		if (f2fs_has_inline_data(inode))
+			err = f2fs_write_inline_data(inode, page);
+		else
+			err = do_write_data_page(page);
 		mutex_unlock_op(sbi, ilock);
 		need_balance_fs = true;
 	}
@@ -623,12 +642,28 @@ static int f2fs_write_begin(struct file *file, struct address_space *mapping,
 	*fsdata = NULL;
 
 	f2fs_balance_fs(sbi);
+
+	err = f2fs_convert_inline_data(inode, pos + len);
+	if (err)
+		return err;
 repeat:
 	page = grab_cache_page_write_begin(mapping, index, flags);
 	if (!page)
 		return -ENOMEM;
 	*pagep = page;
 
+	/* the first page of an inline file is backed by the inode block */
+	if (f2fs_has_inline_data(inode)) {
+		if (PageUptodate(page))
+			return 0;
+		err = f2fs_read_inline_data(inode, page);
+		if (err) {
+			f2fs_put_page(page, 1);
+			return err;
+		}
+		goto out;
+	}
+
 	ilock = mutex_lock_op(sbi);
 
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -693,6 +728,10 @@ static ssize_t f2fs_direct_IO(int rw, struct kiocb *iocb,
 	if (rw == WRITE)
 		return 0;
 
+	/* fall back to buffered reads for inline data */
+	if (f2fs_has_inline_data(inode))
+		return 0;
+
 	/* Needs synchronization with the cleaner */
 	return blockdev_direct_IO(rw, iocb, inode, iov, offset, nr_segs,
 						  get_data_block_ro);
@@ -731,6 +770,9 @@ static int f2fs_set_data_page_dirty(struct page *page)
 
 static sector_t f2fs_bmap(struct address_space *mapping, sector_t block)
 {
+	if (f2fs_has_inline_data(mapping->host))
+		return 0;
+
 	return generic_block_bmap(mapping, block, get_data_block_ro);
 }
 
@@ -41,6 +41,11 @@ static int f2fs_vm_page_mkwrite(struct vm_area_struct *vma,
 
 	sb_start_pagefault(inode->i_sb);
 
+	/* mmapped pages are written back as blocks */
+	err = f2fs_convert_inline_data(inode, MAX_INLINE_DATA + 1);
+	if (err)
+		goto out;
+
 	/* block allocation */
 	ilock = mutex_lock_op(sbi);
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -105,6 +110,7 @@ static const struct vm_operations_struct f2fs_file_vm_ops = {
 int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 {
 	struct inode *inode = file->f_mapping->host;
+	struct f2fs_inode_info *fi = F2FS_I(inode);
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	int ret = 0;
 	bool need_cp = false;
@@ -118,7 +124,11 @@ int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		return 0;
 
 	trace_f2fs_sync_file_enter(inode);
+
+	/* the data written here may go in place, see need_inplace_update() */
+	set_inode_flag(fi, FI_NEED_IPU);
 	ret = filemap_write_and_wait_range(inode->i_mapping, start, end);
+	clear_inode_flag(fi, FI_NEED_IPU);
 	if (ret) {
 		trace_f2fs_sync_file_exit(inode, need_cp, datasync, ret);
 		return ret;
@@ -129,8 +139,22 @@ int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 
 	mutex_lock(&inode->i_mutex);
 
-	if (datasync && !(inode->i_state & I_DIRTY_DATASYNC))
-		goto out;
+	/*
+	 * Data rewritten in place is still found through the block addresses
+	 * logged before, so if none of them changed there is no node block
+	 * to write for roll-forward, only the device cache to flush.
+	 */
+	if (datasync && !(inode->i_state & I_DIRTY_DATASYNC) &&
+			!is_inode_flag_set(fi, FI_DIRTY_DNODE)) {
+		if (!is_inode_flag_set(fi, FI_UPDATE_WRITE))
+			goto out;
+		clear_inode_flag(fi, FI_UPDATE_WRITE);
+		goto flush_out;
+	}
+
+	/* anything written from now on is left for the next fsync */
+	clear_inode_flag(fi, FI_DIRTY_DNODE);
+	clear_inode_flag(fi, FI_UPDATE_WRITE);
 
 	if (!S_ISREG(inode->i_mode) || inode->i_nlink != 1)
 		need_cp = true;
@@ -153,9 +177,12 @@ int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		}
 		filemap_fdatawait_range(sbi->node_inode->i_mapping,
 							0, LONG_MAX);
+flush_out:
 		ret = blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
 	}
 out:
+	if (ret)
+		set_inode_flag(fi, FI_DIRTY_DNODE);
 	mutex_unlock(&inode->i_mutex);
 	trace_f2fs_sync_file_exit(inode, need_cp, datasync, ret);
 	return ret;
@@ -190,6 +217,7 @@ static int truncate_data_blocks_range(struct dnode_of_data *dn, int count)
 	}
 	if (nr_free) {
 		set_page_dirty(dn->node_page);
+		set_inode_flag(F2FS_I(dn->inode), FI_DIRTY_DNODE);
 		sync_inode_page(dn);
 	}
 	dn->ofs_in_node = ofs;
@@ -242,6 +270,13 @@ static int truncate_blocks(struct inode *inode, u64 from)
 			((from + blocksize - 1) >> (sbi->log_blocksize));
 
 	ilock = mutex_lock_op(sbi);
+
+	if (f2fs_has_inline_data(inode)) {
+		err = truncate_inline_data(inode, from);
+		mutex_unlock_op(sbi, ilock);
+		goto out;
+	}
+
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
 	err = get_dnode_of_data(&dn, free_from, LOOKUP_NODE);
 	if (err) {
@@ -269,7 +304,7 @@ static int truncate_blocks(struct inode *inode, u64 from)
 free_next:
 	err = truncate_inode_blocks(inode, free_from);
 	mutex_unlock_op(sbi, ilock);
-
+out:
 	/* lastly zero out the first data page */
 	truncate_partial_data_page(inode, from);
 
@@ -343,6 +378,10 @@ int f2fs_setattr(struct dentry *dentry, struct iattr *attr)
 
 	if ((attr->ia_valid & ATTR_SIZE) &&
 			attr->ia_size != i_size_read(inode)) {
+		err = f2fs_convert_inline_data(inode, attr->ia_size);
+		if (err)
+			return err;
+
 		truncate_setsize(inode, attr->ia_size);
 		f2fs_truncate(inode);
 		f2fs_balance_fs(F2FS_SB(inode->i_sb));
@@ -541,6 +580,11 @@ static long f2fs_fallocate(struct file *file, int mode,
 	if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
 		return -EOPNOTSUPP;
 
+	/* both paths work on block addresses */
+	ret = f2fs_convert_inline_data(inode, MAX_INLINE_DATA + 1);
+	if (ret)
+		return ret;
+
 	if (mode & FALLOC_FL_PUNCH_HOLE)
 		ret = punch_hole(inode, offset, len, mode);
 	else
@@ -0,0 +1,544 @@
+/*
+ * fs/f2fs/inline.c
+ *
+ * Small files and directories kept in the inode block.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+
+#include "f2fs.h"
+#include "node.h"
+
+/*
+ * Regular files created while inline_data is enabled start out with their
+ * data in the inode block.  They are converted to a normal data block once
+ * they grow past MAX_INLINE_DATA or get mmapped for writing or fallocated,
+ * and never go back, which keeps recovery simple.
+ */
+bool f2fs_may_inline(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+
+	if (!test_opt(sbi, INLINE_DATA))
+		return false;
+
+	return S_ISREG(inode->i_mode);
+}
+
+/*
+ * Fill the locked page from the inode block.  The page stays locked.
+ */
+int f2fs_read_inline_data(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *ipage;
+	void *src_addr, *dst_addr;
+
+	if (page->index) {
+		zero_user_segment(page, 0, PAGE_CACHE_SIZE);
+		goto out;
+	}
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	zero_user_segment(page, MAX_INLINE_DATA, PAGE_CACHE_SIZE);
+
+	src_addr = inline_data_addr(ipage);
+	dst_addr = kmap_atomic(page);
+	memcpy(dst_addr, src_addr, MAX_INLINE_DATA);
+	kunmap_atomic(dst_addr);
+	f2fs_put_page(ipage, 1);
+out:
+	SetPageUptodate(page);
+	return 0;
+}
+
+/*
+ * Copy the first data page into the inode block.
+ *
+ * Caller should grab and release a mutex by calling mutex_lock_op() and
+ * mutex_unlock_op().
+ */
+int f2fs_write_inline_data(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *ipage;
+	void *src_addr, *dst_addr;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	wait_on_page_writeback(ipage);
+
+	src_addr = kmap_atomic(page);
+	dst_addr = inline_data_addr(ipage);
+	memcpy(dst_addr, src_addr, MAX_INLINE_DATA);
+	kunmap_atomic(src_addr);
+
+	/* keep i_size in step with the data it describes */
+	update_inode(inode, ipage);
+	set_inode_flag(F2FS_I(inode), FI_DIRTY_DNODE);
+	f2fs_put_page(ipage, 1);
+	return 0;
+}
+
+static int __f2fs_convert_inline_data(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct dnode_of_data dn;
+	block_t new_blk_addr;
+	void *src_addr, *dst_addr;
+	int err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, 0, ALLOC_NODE);
+	if (err)
+		return err;
+
+	/*
+	 * An uptodate page may hold data that was not written back yet,
+	 * otherwise the inode block has the latest copy.
+	 */
+	if (!PageUptodate(page)) {
+		zero_user_segment(page, MAX_INLINE_DATA, PAGE_CACHE_SIZE);
+		src_addr = inline_data_addr(dn.inode_page);
+		dst_addr = kmap_atomic(page);
+		memcpy(dst_addr, src_addr, MAX_INLINE_DATA);
+		kunmap_atomic(dst_addr);
+		SetPageUptodate(page);
+	}
+
+	/* i_addr[0] is not used for inline data */
+	if (dn.data_blkaddr == NULL_ADDR) {
+		err = reserve_new_block(&dn);
+		if (err) {
+			f2fs_put_dnode(&dn);
+			return err;
+		}
+	}
+
+	/*
+	 * Write the block before dropping the inline copy, so that neither a
+	 * checkpoint nor an fsync can persist an inode pointing at a block
+	 * that was never written.
+	 */
+	wait_on_page_writeback(page);
+	clear_page_dirty_for_io(page);
+	set_page_writeback(page);
+	write_data_page(inode, page, &dn, dn.data_blkaddr, &new_blk_addr);
+	update_extent_cache(new_blk_addr, &dn);
+	f2fs_submit_bio(sbi, DATA, true);
+	wait_on_page_writeback(page);
+
+	wait_on_page_writeback(dn.inode_page);
+	memset(inline_data_addr(dn.inode_page), 0, MAX_INLINE_DATA);
+	clear_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+	sync_inode_page(&dn);
+	f2fs_put_dnode(&dn);
+	return 0;
+}
+
+/*
+ * Move inline data to a data block if the file is going to need more than
+ * MAX_INLINE_DATA bytes.
+ */
+int f2fs_convert_inline_data(struct inode *inode, loff_t to_size)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *page;
+	int err = 0, ilock;
+
+	if (!f2fs_has_inline_data(inode) || to_size <= MAX_INLINE_DATA)
+		return 0;
+
+	page = grab_cache_page(inode->i_mapping, 0);
+	if (!page)
+		return -ENOMEM;
+
+	ilock = mutex_lock_op(sbi);
+	/* somebody may have converted it while we waited for the page */
+	if (f2fs_has_inline_data(inode))
+		err = __f2fs_convert_inline_data(inode, page);
+	mutex_unlock_op(sbi, ilock);
+
+	f2fs_put_page(page, 1);
+	return err;
+}
+
+/*
+ * Caller should grab and release a mutex by calling mutex_lock_op() and
+ * mutex_unlock_op().
+ */
+int truncate_inline_data(struct inode *inode, u64 from)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	if (from < MAX_INLINE_DATA) {
+		wait_on_page_writeback(ipage);
+		memset(inline_data_addr(ipage) + from, 0,
+					MAX_INLINE_DATA - from);
+		set_page_dirty(ipage);
+	}
+	f2fs_put_page(ipage, 1);
+	return 0;
+}
+
+/*
+ * Roll forward the inline data of an fsynced inode into its current inode
+ * block @ipage.  Returns true if the logged inode @npage was inline, so its
+ * i_addr must not be replayed as block addresses.
+ */
+bool recover_inline_data(struct inode *inode, struct page *ipage,
+						struct page *npage)
+{
+	struct f2fs_node *rn = (struct f2fs_node *)page_address(npage);
+	bool logged_inline = rn->i.i_inline & F2FS_INLINE_DATA;
+
+	/* files never become inline again once converted */
+	if (!f2fs_has_inline_data(inode))
+		return logged_inline;
+
+	wait_on_page_writeback(ipage);
+	if (logged_inline) {
+		memcpy(inline_data_addr(ipage), inline_data_addr(npage),
+						MAX_INLINE_DATA);
+		return true;
+	}
+
+	/* converted after the last checkpoint, recover the blocks instead */
+	memset(inline_data_addr(ipage), 0, MAX_INLINE_DATA);
+	clear_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+	return false;
+}
+
+struct f2fs_dir_entry *find_in_inline_dir(struct inode *dir,
+			struct qstr *name, struct page **res_page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *inline_dentry;
+	struct f2fs_dir_entry *de;
+	unsigned long bit_pos = 0;
+	f2fs_hash_t namehash;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return NULL;
+
+	namehash = f2fs_dentry_hash(name->name, name->len);
+	inline_dentry = inline_data_addr(ipage);
+	while (bit_pos < NR_INLINE_DENTRY) {
+		bit_pos = find_next_bit_le(&inline_dentry->dentry_bitmap,
+						NR_INLINE_DENTRY, bit_pos);
+		if (bit_pos >= NR_INLINE_DENTRY)
+			break;
+
+		de = &inline_dentry->dentry[bit_pos];
+		if (le16_to_cpu(de->name_len) == name->len &&
+				de->hash_code == namehash &&
+				!memcmp(inline_dentry->filename[bit_pos],
+						name->name, name->len)) {
+			kmap(ipage);
+			unlock_page(ipage);
+			*res_page = ipage;
+			return de;
+		}
+		bit_pos += GET_DENTRY_SLOTS(le16_to_cpu(de->name_len));
+	}
+
+	f2fs_put_page(ipage, 1);
+	return NULL;
+}
+
+struct f2fs_dir_entry *f2fs_parent_inline_dir(struct inode *dir,
+							struct page **p)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *inline_dentry;
+	struct f2fs_dir_entry *de;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return NULL;
+
+	kmap(ipage);
+	inline_dentry = inline_data_addr(ipage);
+	de = &inline_dentry->dentry[1];
+	*p = ipage;
+	unlock_page(ipage);
+	return de;
+}
+
+int make_empty_inline_dir(struct inode *inode, struct inode *parent)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inline_dentry *dentry_blk;
+	struct f2fs_dir_entry *de;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	wait_on_page_writeback(ipage);
+	dentry_blk = inline_data_addr(ipage);
+
+	de = &dentry_blk->dentry[0];
+	de->name_len = cpu_to_le16(1);
+	de->hash_code = 0;
+	de->ino = cpu_to_le32(inode->i_ino);
+	memcpy(dentry_blk->filename[0], ".", 1);
+	set_de_type(de, inode);
+
+	de = &dentry_blk->dentry[1];
+	de->hash_code = 0;
+	de->name_len = cpu_to_le16(2);
+	de->ino = cpu_to_le32(parent->i_ino);
+	memcpy(dentry_blk->filename[1], "..", 2);
+	set_de_type(de, inode);
+
+	test_and_set_bit_le(0, &dentry_blk->dentry_bitmap);
+	test_and_set_bit_le(1, &dentry_blk->dentry_bitmap);
+
+	/* lookups skip directories without any size */
+	if (i_size_read(inode) < MAX_INLINE_DATA)
+		i_size_write(inode, MAX_INLINE_DATA);
+
+	update_inode(inode, ipage);
+	f2fs_put_page(ipage, 1);
+	return 0;
+}
+
+/*
+ * Move the inline dentries into the first dentry block.  Slot numbers stay
+ * the same, so readdir positions remain valid across the conversion.
+ *
+ * Caller should grab and release a mutex by calling mutex_lock_op() and
+ * mutex_unlock_op().
+ */
+static int f2fs_convert_inline_dir(struct inode *dir)
+{
+	struct f2fs_inline_dentry *inline_dentry;
+	struct f2fs_dentry_block *dentry_blk;
+	struct dnode_of_data dn;
+	struct page *page;
+	int err;
+
+	page = grab_cache_page(dir->i_mapping, 0);
+	if (!page)
+		return -ENOMEM;
+
+	set_new_dnode(&dn, dir, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, 0, ALLOC_NODE);
+	if (err)
+		goto out;
+
+	if (dn.data_blkaddr == NULL_ADDR) {
+		err = reserve_new_block(&dn);
+		if (err) {
+			f2fs_put_dnode(&dn);
+			goto out;
+		}
+	}
+
+	wait_on_page_writeback(page);
+	zero_user_segment(page, 0, PAGE_CACHE_SIZE);
+
+	inline_dentry = inline_data_addr(dn.inode_page);
+	dentry_blk = kmap_atomic(page);
+	memcpy(dentry_blk->dentry_bitmap, inline_dentry->dentry_bitmap,
+					INLINE_DENTRY_BITMAP_SIZE);
+	memcpy(dentry_blk->dentry, inline_dentry->dentry,
+			sizeof(struct f2fs_dir_entry) * NR_INLINE_DENTRY);
+	memcpy(dentry_blk->filename, inline_dentry->filename,
+					NR_INLINE_DENTRY * F2FS_SLOT_LEN);
+	kunmap_atomic(dentry_blk);
+
+	SetPageUptodate(page);
+	set_page_dirty(page);
+
+	wait_on_page_writeback(dn.inode_page);
+	memset(inline_dentry, 0, MAX_INLINE_DATA);
+	clear_inode_flag(F2FS_I(dir), FI_INLINE_DENTRY);
+
+	/* everything now sits in the only bucket of level 0 */
+	F2FS_I(dir)->i_current_depth = 1;
+	if (i_size_read(dir) < PAGE_CACHE_SIZE)
+		i_size_write(dir, PAGE_CACHE_SIZE);
+
+	sync_inode_page(&dn);
+	f2fs_put_dnode(&dn);
+out:
+	f2fs_put_page(page, 1);
+	return err;
+}
+
+/*
+ * Returns -EAGAIN once the directory has been converted to dentry blocks
+ * because the name did not fit.
+ *
+ * Caller should grab and release a mutex by calling mutex_lock_op() and
+ * mutex_unlock_op().
+ */
+int f2fs_add_inline_entry(struct inode *dir, const struct qstr *name,
+						struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *inline_dentry;
+	int slots = GET_DENTRY_SLOTS(name->len);
+	struct f2fs_dir_entry *de;
+	unsigned int bit_pos;
+	struct page *ipage;
+	int err, i;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	inline_dentry = inline_data_addr(ipage);
+	bit_pos = room_for_filename(&inline_dentry->dentry_bitmap,
+						slots, NR_INLINE_DENTRY);
+	if (bit_pos >= NR_INLINE_DENTRY) {
+		f2fs_put_page(ipage, 1);
+		err = f2fs_convert_inline_dir(dir);
+		return err ? err : -EAGAIN;
+	}
+
+	err = init_inode_metadata(inode, dir, name);
+	if (err)
+		goto out;
+
+	wait_on_page_writeback(ipage);
+
+	de = &inline_dentry->dentry[bit_pos];
+	de->hash_code = f2fs_dentry_hash(name->name, name->len);
+	de->name_len = cpu_to_le16(name->len);
+	memcpy(inline_dentry->filename[bit_pos], name->name, name->len);
+	de->ino = cpu_to_le32(inode->i_ino);
+	set_de_type(de, inode);
+	for (i = 0; i < slots; i++)
+		test_and_set_bit_le(bit_pos + i, &inline_dentry->dentry_bitmap);
+	set_page_dirty(ipage);
+
+	/* update parent inode number before releasing dentry page */
+	F2FS_I(inode)->i_pino = dir->i_ino;
+	f2fs_put_page(ipage, 1);
+
+	/* needs the inode block of dir, so only after it was released */
+	update_parent_metadata(dir, inode, F2FS_I(dir)->i_current_depth);
+	return 0;
+out:
+	f2fs_put_page(ipage, 1);
+	return err;
+}
+
+void f2fs_delete_inline_entry(struct f2fs_dir_entry *dentry, struct page *page,
+					struct inode *dir, struct inode *inode)
+{
+	struct f2fs_inline_dentry *inline_dentry;
+	int slots = GET_DENTRY_SLOTS(le16_to_cpu(dentry->name_len));
+	unsigned int bit_pos;
+	int i;
+
+	lock_page(page);
+	wait_on_page_writeback(page);
+
+	inline_dentry = inline_data_addr(page);
+	bit_pos = dentry - inline_dentry->dentry;
+	for (i = 0; i < slots; i++)
+		test_and_clear_bit_le(bit_pos + i,
+				&inline_dentry->dentry_bitmap);
+
+	kunmap(page); /* kunmap - pair of f2fs_find_entry */
+	set_page_dirty(page);
+
+	dir->i_ctime = dir->i_mtime = CURRENT_TIME;
+
+	if (inode)
+		f2fs_drop_nlink(dir, inode, page);
+	else
+		mark_inode_dirty(dir);
+
+	f2fs_put_page(page, 1);
+}
+
+bool f2fs_empty_inline_dir(struct inode *dir)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *inline_dentry;
+	unsigned int bit_pos;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return false;
+
+	inline_dentry = inline_data_addr(ipage);
+	bit_pos = find_next_bit_le(&inline_dentry->dentry_bitmap,
+					NR_INLINE_DENTRY, 2);
+	f2fs_put_page(ipage, 1);
+
+	return bit_pos >= NR_INLINE_DENTRY;
+}
+
+int f2fs_read_inline_dir(struct file *file, void *dirent, filldir_t filldir)
+{
+	struct inode *inode = file_inode(file);
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inline_dentry *inline_dentry;
+	unsigned int bit_pos;
+	unsigned char d_type;
+	struct f2fs_dir_entry *de;
+	struct page *ipage;
+	int over;
+
+	if (file->f_pos >= NR_INLINE_DENTRY)
+		return 0;
+	bit_pos = file->f_pos;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	/* i_mutex keeps the entries stable, don't hold the lock in filldir */
+	unlock_page(ipage);
+
+	inline_dentry = inline_data_addr(ipage);
+	while (bit_pos < NR_INLINE_DENTRY) {
+		bit_pos = find_next_bit_le(&inline_dentry->dentry_bitmap,
+						NR_INLINE_DENTRY, bit_pos);
+		if (bit_pos >= NR_INLINE_DENTRY)
+			break;
+
+		de = &inline_dentry->dentry[bit_pos];
+		d_type = DT_UNKNOWN;
+		if (de->file_type < F2FS_FT_MAX)
+			d_type = f2fs_filetype_table[de->file_type];
+
+		over = filldir(dirent, inline_dentry->filename[bit_pos],
+				le16_to_cpu(de->name_len), bit_pos,
+				le32_to_cpu(de->ino), d_type);
+		if (over)
+			goto out;
+
+		bit_pos += GET_DENTRY_SLOTS(le16_to_cpu(de->name_len));
+	}
+	bit_pos = NR_INLINE_DENTRY;
+out:
+	file->f_pos = bit_pos;
+	f2fs_put_page(ipage, 0);
+	return 0;
+}
@@ -57,6 +57,11 @@ static struct inode *f2fs_new_inode(struct inode *dir, umode_t mode)
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;
 	inode->i_generation = sbi->s_next_generation++;
 
+	if (f2fs_may_inline(inode))
+		set_inode_flag(F2FS_I(inode), FI_INLINE_DATA);
+	if (test_opt(sbi, INLINE_DENTRY) && S_ISDIR(inode->i_mode))
+		set_inode_flag(F2FS_I(inode), FI_INLINE_DENTRY);
+
 	err = insert_inode_locked(inode);
 	if (err) {
 		err = -EINVAL;
@@ -255,7 +260,7 @@ static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
 	}
 
 	ilock = mutex_lock_op(sbi);
-	f2fs_delete_entry(de, page, inode);
+	f2fs_delete_entry(de, page, dir, inode);
 	mutex_unlock_op(sbi, ilock);
 
 	/* In order to evict this inode,  we set it dirty */
@@ -445,10 +450,31 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 			add_orphan_inode(sbi, new_inode->i_ino);
 		update_inode_page(new_inode);
 	} else {
+		bool old_inline = f2fs_has_inline_dentry(old_dir);
+
 		err = f2fs_add_link(new_dentry, old_inode);
 		if (err)
 			goto out_dir;
 
+		/*
+		 * Adding the new name may have moved the entries of old_dir
+		 * out of its inode block, look the old one up again.
+		 */
+		if (old_inline && !f2fs_has_inline_dentry(old_dir)) {
+			kunmap(old_page);
+			f2fs_put_page(old_page, 0);
+			old_entry = f2fs_find_entry(old_dir,
+					&old_dentry->d_name, &old_page);
+			if (!old_entry) {
+				/* gone under i_mutex: old_dir is corrupted */
+				set_ckpt_flags(F2FS_CKPT(sbi), CP_ERROR_FLAG);
+				sb->s_flags |= MS_RDONLY;
+				old_page = NULL;
+				err = -EIO;
+				goto out_dir;
+			}
+		}
+
 		if (old_dir_entry) {
 			inc_nlink(new_dir);
 			update_inode_page(new_dir);
@@ -458,7 +484,7 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	old_inode->i_ctime = CURRENT_TIME;
 	mark_inode_dirty(old_inode);
 
-	f2fs_delete_entry(old_entry, old_page, NULL);
+	f2fs_delete_entry(old_entry, old_page, old_dir, NULL);
 
 	if (old_dir_entry) {
 		if (old_dir != new_dir) {
@@ -482,8 +508,10 @@ out_dir:
 	}
 	mutex_unlock_op(sbi, ilock);
 out_old:
-	kunmap(old_page);
-	f2fs_put_page(old_page, 0);
+	if (old_page) {
+		kunmap(old_page);
+		f2fs_put_page(old_page, 0);
+	}
 out:
 	return err;
 }
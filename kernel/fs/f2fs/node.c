@@ -684,6 +684,7 @@ int truncate_inode_blocks(struct inode *inode, pgoff_t from)
 
 	trace_f2fs_truncate_inode_blocks_enter(inode, from);
 
+	set_inode_flag(F2FS_I(inode), FI_DIRTY_DNODE);
 	level = get_node_path(from, offset, noffset);
 restart:
 	page = get_node_page(sbi, inode->i_ino);
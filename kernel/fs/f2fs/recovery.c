@@ -269,6 +269,9 @@ static int do_recover_data(struct f2fs_sb_info *sbi, struct inode *inode,
 	BUG_ON(ni.ino != ino_of_node(page));
 	BUG_ON(ofs_of_node(dn.node_page) != ofs_of_node(page));
 
+	if (IS_INODE(page) && recover_inline_data(inode, dn.node_page, page))
+		goto write_node;
+
 	for (; start < end; start++) {
 		block_t src, dest;
 
@@ -294,6 +297,7 @@ static int do_recover_data(struct f2fs_sb_info *sbi, struct inode *inode,
 		dn.ofs_in_node++;
 	}
 
+write_node:
 	/* write node page in place */
 	set_summary(&sum, dn.nid, 0, 0);
 	if (IS_INODE(dn.node_page))
@@ -1683,6 +1683,8 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	sm_info->ovp_segments = le32_to_cpu(ckpt->overprov_segment_count);
 	sm_info->main_segments = le32_to_cpu(raw_super->segment_count_main);
 	sm_info->ssa_blkaddr = le32_to_cpu(raw_super->ssa_blkaddr);
+	sm_info->ipu_policy = DEF_IPU_POLICY;
+	sm_info->min_ipu_util = DEF_MIN_IPU_UTIL;
 
 	err = build_sit_info(sbi);
 	if (err)
@@ -475,18 +475,51 @@ static inline int utilization(struct f2fs_sb_info *sbi)
 
 /*
  * Sometimes f2fs may be better to drop out-of-place update policy.
- * So, if fs utilization is over MIN_IPU_UTIL, then f2fs tries to write
- * data in the original place likewise other traditional file systems.
- * But, currently set 100 in percentage, which means it is disabled.
- * See below need_inplace_update().
+ * Rewriting data in its original place, like other traditional file
+ * systems do, leaves the node blocks untouched, so an fsync has no node
+ * chain to log and cleaning has less to move.  The policy is a bitmap
+ * of the conditions below, set through /sys/fs/f2fs/<dev>/ipu_policy:
+ * F2FS_IPU_FORCE - all the time,
+ * F2FS_IPU_SSR - if SSR mode is activated,
+ * F2FS_IPU_UTIL - if FS utilization is over min_ipu_util,
+ * F2FS_IPU_SSR_UTIL - if SSR mode is activated and FS utilization is over
+ *                     min_ipu_util,
+ * F2FS_IPU_FSYNC - for the data written back by fsync.
+ * Otherwise, f2fs writes data out of place as a log.
  */
-#define MIN_IPU_UTIL		100
+enum {
+	F2FS_IPU_FORCE,
+	F2FS_IPU_SSR,
+	F2FS_IPU_UTIL,
+	F2FS_IPU_SSR_UTIL,
+	F2FS_IPU_FSYNC,
+	F2FS_IPU_MAX,
+};
+
+#define DEF_IPU_POLICY		(1 << F2FS_IPU_FSYNC)
+#define DEF_MIN_IPU_UTIL	70
+
 static inline bool need_inplace_update(struct inode *inode)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	unsigned int policy = SM_I(sbi)->ipu_policy;
+
+	/* IPU can be done only for the user data */
 	if (S_ISDIR(inode->i_mode))
 		return false;
-	if (need_SSR(sbi) && utilization(sbi) > MIN_IPU_UTIL)
+
+	if (policy & (1 << F2FS_IPU_FORCE))
+		return true;
+	if (policy & (1 << F2FS_IPU_SSR) && need_SSR(sbi))
+		return true;
+	if (policy & (1 << F2FS_IPU_UTIL) &&
+			utilization(sbi) > SM_I(sbi)->min_ipu_util)
+		return true;
+	if (policy & (1 << F2FS_IPU_SSR_UTIL) && need_SSR(sbi) &&
+			utilization(sbi) > SM_I(sbi)->min_ipu_util)
+		return true;
+	if (policy & (1 << F2FS_IPU_FSYNC) &&
+			is_inode_flag_set(F2FS_I(inode), FI_NEED_IPU))
 		return true;
 	return false;
 }
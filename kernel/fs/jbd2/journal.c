@@ -963,6 +963,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	if (s->journal->j_fc_wbuf)
+		seq_printf(seq, "%lu fast commits (%lu blocks), "
+			   "%lu fell back to a full commit\n",
+			   s->journal->j_fc_commits, s->journal->j_fc_blocks,
+			   s->journal->j_fc_fallbacks);
 	return 0;
 }
 
@@ -1067,6 +1072,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_checkpoint);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1265,6 +1271,9 @@ static int journal_reset(journal_t *journal)
 
 	first = be32_to_cpu(sb->s_first);
 	last = be32_to_cpu(sb->s_maxlen);
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		last = journal->j_fc_first;
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD2: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1555,6 +1564,39 @@ out:
  * journal_t.
  */
 
+/*
+ * Carve the fast commit area out of the end of the journal, as recorded in
+ * the superblock.  The log proper then ends where the area starts.
+ */
+static int journal_fc_layout(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long maxlen = be32_to_cpu(sb->s_maxlen);
+	unsigned int num = be32_to_cpu(sb->s_num_fc_blks);
+
+	if (!num)
+		num = JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+	if (num > JBD2_MAX_FAST_COMMIT_BLOCKS ||
+	    be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS + num > maxlen) {
+		printk(KERN_ERR "JBD2: invalid fast commit area of %u blocks "
+		       "in a journal of %lu\n", num, maxlen);
+		return -EINVAL;
+	}
+
+	if (!journal->j_fc_wbuf) {
+		journal->j_fc_wbuf = kcalloc(num, sizeof(struct buffer_head *),
+					     GFP_KERNEL);
+		if (!journal->j_fc_wbuf)
+			return -ENOMEM;
+	}
+
+	journal->j_fc_last = maxlen;
+	journal->j_fc_first = maxlen - num;
+	journal->j_fc_off = 0;
+	journal->j_last = journal->j_fc_first;
+	return 0;
+}
+
 static int load_superblock(journal_t *journal)
 {
 	int err;
@@ -1572,6 +1614,10 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return journal_fc_layout(journal);
+
 	return 0;
 }
 
@@ -1642,6 +1688,275 @@ recovery_error:
 	return -EIO;
 }
 
+/**
+ * int jbd2_fc_init() - Set up a fast commit area.
+ * @journal: Journal to act on.
+ * @num_fc_blks: Size of the area in blocks, 0 for the default.
+ *
+ * Reserve @num_fc_blks at the end of a freshly loaded (and so empty)
+ * journal for fast commits.  A journal that already has an area keeps it.
+ * The area, and the feature flag that makes older kernels refuse the
+ * journal, stay until the journal is cleanly destroyed.
+ */
+int jbd2_fc_init(journal_t *journal, unsigned int num_fc_blks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	int err;
+
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+
+	if (journal->j_running_transaction ||
+	    journal->j_free != journal->j_last - journal->j_first)
+		return -EBUSY;
+
+	if (!jbd2_journal_set_features(journal, 0, 0,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EINVAL;
+
+	sb->s_num_fc_blks = cpu_to_be32(num_fc_blks ? :
+					JBD2_DEFAULT_FAST_COMMIT_BLOCKS);
+	err = journal_fc_layout(journal);
+	if (err) {
+		jbd2_journal_clear_features(journal, 0, 0,
+					    JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+		sb->s_num_fc_blks = 0;
+		return err;
+	}
+
+	write_lock(&journal->j_state_lock);
+	journal->j_free = journal->j_last - journal->j_first;
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * Get the layout to disk, and with it a non-zero s_start: recovery
+	 * does not look at a journal marked empty, and so would never see
+	 * fast commits made before the first full commit.
+	 */
+	mutex_lock(&journal->j_checkpoint_mutex);
+	jbd2_journal_update_sb_log_tail(journal, journal->j_tail_sequence,
+					journal->j_tail, WRITE_FUA);
+	mutex_unlock(&journal->j_checkpoint_mutex);
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_init);
+
+/**
+ * int jbd2_fc_begin_commit() - Start a fast commit.
+ * @journal: Journal to act on.
+ * @tid: Running transaction the fast commit is made on top of.
+ *
+ * Waits for any full commit or other fast commit in progress first.  While
+ * the fast commit is ongoing the commit of @tid cannot start.
+ *
+ * Returns 0 if the caller may go on with jbd2_fc_get_buf(), -EALREADY if
+ * @tid is already committed or committing, so that waiting for it is all
+ * that is left to do, and another negative error if the caller has to fall
+ * back to a full commit.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *commit;
+	tid_t commit_tid;
+
+	if (!journal->j_fc_wbuf)
+		return -EOPNOTSUPP;
+
+	/* Do we need to erase the effects of a prior jbd2_journal_flush? */
+	if (journal->j_flags & JBD2_FLUSHED) {
+		mutex_lock(&journal->j_checkpoint_mutex);
+		jbd2_journal_update_sb_log_tail(journal,
+						journal->j_tail_sequence,
+						journal->j_tail,
+						WRITE_SYNC);
+		mutex_unlock(&journal->j_checkpoint_mutex);
+	}
+
+	write_lock(&journal->j_state_lock);
+	for (;;) {
+		if (is_journal_aborted(journal)) {
+			write_unlock(&journal->j_state_lock);
+			return -EIO;
+		}
+		if (tid_geq(journal->j_commit_sequence, tid)) {
+			write_unlock(&journal->j_state_lock);
+			return -EALREADY;
+		}
+
+		/*
+		 * A fast commit only counts on top of a committed previous
+		 * transaction, so let an earlier commit finish first.
+		 */
+		commit = journal->j_committing_transaction;
+		if (commit) {
+			commit_tid = commit->t_tid;
+			write_unlock(&journal->j_state_lock);
+			if (commit_tid == tid)
+				return -EALREADY;
+			jbd2_log_wait_commit(journal, commit_tid);
+			write_lock(&journal->j_state_lock);
+			continue;
+		}
+
+		if (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+			DEFINE_WAIT(wait);
+
+			prepare_to_wait(&journal->j_fc_wait, &wait,
+					TASK_UNINTERRUPTIBLE);
+			write_unlock(&journal->j_state_lock);
+			schedule();
+			write_lock(&journal->j_state_lock);
+			finish_wait(&journal->j_fc_wait, &wait);
+			continue;
+		}
+		break;
+	}
+
+	if (!journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid) {
+		write_unlock(&journal->j_state_lock);
+		return -EALREADY;
+	}
+
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	journal->j_fc_nbufs = 0;
+	write_unlock(&journal->j_state_lock);
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+/**
+ * int jbd2_fc_get_buf() - Get the next block of the fast commit area.
+ * @journal: Journal to act on.
+ * @bh_out: Returns the buffer, to be filled in by the caller.
+ *
+ * The buffer is written out, and released, by jbd2_fc_end_commit().
+ * Returns -ENOSPC once the area is full; the caller then has to fall back
+ * to a full commit, which frees the area again.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	struct buffer_head *bh;
+	int err;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last)
+		return -ENOSPC;
+
+	err = jbd2_journal_bmap(journal,
+				journal->j_fc_first + journal->j_fc_off, &pblock);
+	if (err)
+		return err;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	journal->j_fc_off++;
+	journal->j_fc_wbuf[journal->j_fc_nbufs++] = bh;
+	*bh_out = bh;
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+
+static void jbd2_fc_submit_buf(struct buffer_head *bh, int write_op)
+{
+	lock_buffer(bh);
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(write_op, bh);
+}
+
+static void jbd2_fc_finish(journal_t *journal, int nbufs)
+{
+	int i;
+
+	for (i = 0; i < journal->j_fc_nbufs; i++) {
+		brelse(journal->j_fc_wbuf[i]);
+		journal->j_fc_wbuf[i] = NULL;
+	}
+
+	write_lock(&journal->j_state_lock);
+	if (nbufs) {
+		journal->j_fc_commits++;
+		journal->j_fc_blocks += nbufs;
+	} else {
+		/* Blocks handed out but not committed are reused */
+		journal->j_fc_off -= journal->j_fc_nbufs;
+		journal->j_fc_fallbacks++;
+	}
+	journal->j_fc_nbufs = 0;
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/**
+ * int jbd2_fc_end_commit() - Write out a fast commit.
+ * @journal: Journal to act on.
+ *
+ * Writes the buffers obtained since jbd2_fc_begin_commit() and waits for
+ * them.  The last one, which is expected to carry whatever the filesystem
+ * uses to tell a complete fast commit from a torn one, goes out after all
+ * the others, with a cache flush if the journal uses barriers.
+ *
+ * On error the caller has to fall back to a full commit.
+ */
+int jbd2_fc_end_commit(journal_t *journal)
+{
+	int nbufs = journal->j_fc_nbufs;
+	int write_op = WRITE_SYNC;
+	int i, err = 0;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	if (!nbufs) {
+		jbd2_fc_finish(journal, 0);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < nbufs - 1; i++)
+		jbd2_fc_submit_buf(journal->j_fc_wbuf[i], WRITE_SYNC);
+	for (i = 0; i < nbufs - 1; i++) {
+		wait_on_buffer(journal->j_fc_wbuf[i]);
+		if (unlikely(!buffer_uptodate(journal->j_fc_wbuf[i])))
+			err = -EIO;
+	}
+
+	if (!err) {
+		if (journal->j_flags & JBD2_BARRIER)
+			write_op = WRITE_FLUSH_FUA;
+		jbd2_fc_submit_buf(journal->j_fc_wbuf[nbufs - 1], write_op);
+		wait_on_buffer(journal->j_fc_wbuf[nbufs - 1]);
+		if (unlikely(!buffer_uptodate(journal->j_fc_wbuf[nbufs - 1])))
+			err = -EIO;
+	}
+
+	jbd2_fc_finish(journal, err ? 0 : nbufs);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
+/**
+ * void jbd2_fc_end_commit_fallback() - Abandon a fast commit.
+ * @journal: Journal to act on.
+ *
+ * Releases the buffers obtained since jbd2_fc_begin_commit() without
+ * writing them, after which the caller does a full commit instead.
+ */
+void jbd2_fc_end_commit_fallback(journal_t *journal)
+{
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	jbd2_fc_finish(journal, 0);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit_fallback);
+
 /**
  * void jbd2_journal_destroy() - Release a journal_t structure.
  * @journal: Journal to act on.
@@ -1682,6 +1997,18 @@ int jbd2_journal_destroy(journal_t *journal)
 		if (!is_journal_aborted(journal)) {
 			mutex_lock(&journal->j_checkpoint_mutex);
 			jbd2_mark_journal_empty(journal);
+			/*
+			 * The fast commit area is dead weight in an empty
+			 * journal: drop the feature so that tools which do not
+			 * know about it can still handle a clean filesystem.
+			 */
+			if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+				jbd2_journal_clear_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+				journal->j_superblock->s_num_fc_blks = 0;
+				jbd2_write_superblock(journal, WRITE_FUA);
+			}
 			mutex_unlock(&journal->j_checkpoint_mutex);
 		} else
 			err = -EIO;
@@ -1697,6 +2024,7 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_chksum_driver)
 		crypto_free_shash(journal->j_chksum_driver);
 	kfree(journal->j_wbuf);
+	kfree(journal->j_fc_wbuf);
 	kfree(journal);
 
 	return err;
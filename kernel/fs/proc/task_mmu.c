@@ -881,6 +881,165 @@ const struct file_operations proc_clear_refs_operations = {
 	.llseek		= noop_llseek,
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+struct reclaim_param {
+	struct vm_area_struct *vma;
+	struct list_head page_list;
+	int nr_isolated;
+	unsigned long nr_reclaimed;
+	unsigned long nr_skipped;
+};
+
+static void reclaim_isolated(struct reclaim_param *rp)
+{
+	unsigned long reclaimed;
+
+	reclaimed = reclaim_pages_from_list(&rp->page_list);
+	rp->nr_reclaimed += reclaimed;
+	rp->nr_skipped += rp->nr_isolated - reclaimed;
+	rp->nr_isolated = 0;
+}
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_param *rp = walk->private;
+	struct vm_area_struct *vma = rp->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+cont:
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/* Pages shared with other processes are left to kswapd. */
+		if (page_mapcount(page) != 1 || isolate_lru_page(page)) {
+			rp->nr_skipped++;
+			continue;
+		}
+
+		list_add(&page->lru, &rp->page_list);
+		if (++rp->nr_isolated == SWAP_CLUSTER_MAX) {
+			pte++;
+			addr += PAGE_SIZE;
+			break;
+		}
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	/*
+	 * Reclaim in small batches: shrink_page_list() needs the pte lock
+	 * to unmap, and a short list keeps the time pages spend isolated,
+	 * and unaccounted in NR_ISOLATED_*, bounded.
+	 */
+	if (rp->nr_isolated == SWAP_CLUSTER_MAX) {
+		reclaim_isolated(rp);
+		if (addr != end)
+			goto cont;
+	}
+
+	cond_resched();
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[PROC_NUMBUF];
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	enum reclaim_type type;
+	char *type_buf;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	type_buf = strstrip(buffer);
+	if (!strcmp(type_buf, "file"))
+		type = RECLAIM_FILE;
+	else if (!strcmp(type_buf, "anon"))
+		type = RECLAIM_ANON;
+	else if (!strcmp(type_buf, "all"))
+		type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+
+	task = get_proc_task(file_inode(file));
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		struct reclaim_param rp = {
+			.page_list = LIST_HEAD_INIT(rp.page_list),
+		};
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rp,
+		};
+
+		/* pages still sitting in this cpu's pagevecs can't be isolated */
+		lru_add_drain();
+
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP))
+				continue;
+			if (type == RECLAIM_ANON && vma->vm_file)
+				continue;
+			if (type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+
+			rp.vma = vma;
+			walk_page_range(vma->vm_start, vma->vm_end,
+					&reclaim_walk);
+			if (fatal_signal_pending(current))
+				break;
+		}
+		if (rp.nr_isolated)
+			reclaim_isolated(&rp);
+		flush_tlb_mm(mm);
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+
+		count_vm_events(PGSKIP_PROC, rp.nr_skipped);
+		pr_debug("reclaim: pid %d reclaimed %lu skipped %lu pages\n",
+			 task_pid_nr(task), rp.nr_reclaimed, rp.nr_skipped);
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif
+
 typedef struct {
 	u64 pme;
 } pagemap_entry_t;
@@ -0,0 +1,124 @@
+#ifndef BLK_MQ_H
+#define BLK_MQ_H
+
+#include <linux/blkdev.h>
+
+struct blk_mq_hw_ctx;
+
+/*
+ * Per-cpu software submission queue.  Submitters only ever touch the
+ * context of the cpu they run on, so ->lock is effectively uncontended.
+ */
+struct blk_mq_ctx {
+	spinlock_t		lock;
+	struct list_head	rq_list;
+
+	unsigned int		cpu;
+	unsigned int		index_hw;	/* bit in hctx->ctx_map */
+	struct blk_mq_hw_ctx	*hctx;
+
+	struct request_queue	*queue;
+} ____cacheline_aligned_in_smp;
+
+/*
+ * Hardware dispatch context.  One or more software queues map onto each
+ * hardware context; requests are allocated from its tag space, so the
+ * queue depth the driver registers is per hardware queue.
+ */
+struct blk_mq_hw_ctx {
+	struct {
+		spinlock_t		lock;
+		struct list_head	dispatch;	/* requeued on BUSY */
+	} ____cacheline_aligned_in_smp;
+
+	unsigned long		state;		/* BLK_MQ_S_* flags */
+	struct delayed_work	run_work;
+	cpumask_var_t		cpumask;
+
+	struct request_queue	*queue;
+	void			*driver_data;
+
+	unsigned int		nr_ctx;
+	struct blk_mq_ctx	**ctxs;
+	unsigned long		*ctx_map;	/* ctxs with pending requests */
+
+	unsigned int		queue_num;
+	unsigned int		queue_depth;
+	unsigned int		rq_size;
+	void			*rqs;		/* queue_depth preallocated rqs */
+	unsigned long		*tag_map;
+	wait_queue_head_t	tag_wait;
+
+	unsigned int		numa_node;
+};
+
+typedef int (queue_rq_fn)(struct blk_mq_hw_ctx *, struct request *);
+typedef int (init_hctx_fn)(struct blk_mq_hw_ctx *, void *, unsigned int);
+typedef void (exit_hctx_fn)(struct blk_mq_hw_ctx *, unsigned int);
+
+struct blk_mq_ops {
+	/*
+	 * Queue request to the hardware.  May be called concurrently for
+	 * the same hardware context from different cpus.
+	 */
+	queue_rq_fn		*queue_rq;
+
+	/*
+	 * Called once per hardware context when the queue is set up and
+	 * torn down, e.g. to bind a driver queue to ->driver_data.
+	 */
+	init_hctx_fn		*init_hctx;
+	exit_hctx_fn		*exit_hctx;
+};
+
+struct blk_mq_reg {
+	struct blk_mq_ops	*ops;
+	unsigned int		nr_hw_queues;
+	unsigned int		queue_depth;	/* per hardware queue */
+	unsigned int		cmd_size;	/* per-request driver payload */
+	int			numa_node;
+};
+
+enum {
+	BLK_MQ_RQ_QUEUE_OK	= 0,	/* queued fine */
+	BLK_MQ_RQ_QUEUE_BUSY	= 1,	/* requeue IO for later */
+	BLK_MQ_RQ_QUEUE_ERROR	= 2,	/* end IO with error */
+
+	BLK_MQ_S_STOPPED	= 0,
+
+	BLK_MQ_MAX_DEPTH	= 2048,
+};
+
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *, void *);
+void blk_mq_free_queue(struct request_queue *);
+void blk_mq_drain_queue(struct request_queue *);
+
+void blk_mq_insert_request(struct request_queue *, struct request *, bool);
+struct request *blk_mq_alloc_request(struct request_queue *, int, gfp_t);
+void blk_mq_free_request(struct request *);
+
+void blk_mq_end_io(struct request *, int);
+
+void blk_mq_run_queues(struct request_queue *, bool);
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *);
+void blk_mq_start_stopped_hw_queues(struct request_queue *, bool);
+
+/*
+ * Driver command data is immediately after the request. So subtract request
+ * size to get back to the original request.
+ */
+static inline void *blk_mq_rq_to_pdu(struct request *rq)
+{
+	return (void *) rq + sizeof(*rq);
+}
+
+static inline struct request *blk_mq_rq_from_pdu(void *pdu)
+{
+	return pdu - sizeof(struct request);
+}
+
+#define queue_for_each_hw_ctx(q, hctx, i)				\
+	for ((i) = 0; (i) < (q)->nr_hw_queues &&			\
+	     ({ hctx = (q)->queue_hw_ctx[i]; 1; }); (i)++)
+
+#endif
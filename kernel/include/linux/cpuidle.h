@@ -35,6 +35,8 @@ struct cpuidle_state_usage {
 	unsigned long long	disable;
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	above; /* woke before target_residency */
+	unsigned long long	below; /* a deeper state would have fit */
 };
 
 struct cpuidle_state {
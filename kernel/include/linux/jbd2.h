@@ -265,7 +265,9 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+/* 0x0054 */
+	__be32	s_num_fc_blks;		/* Number of fast commit blocks */
+	__u32	s_padding[41];
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -289,6 +291,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000020
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
@@ -296,7 +299,20 @@ typedef struct journal_superblock_s
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V2)
+					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
+
+/*
+ * Fast commit area: blocks at the end of the journal, outside the
+ * circular log, that the filesystem can append small self-describing
+ * commits to without closing the running transaction.
+ */
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS	256
+#define JBD2_MAX_FAST_COMMIT_BLOCKS	4096
+
+/* Return values of j_fc_replay_callback */
+#define JBD2_FC_REPLAY_STOP	0
+#define JBD2_FC_REPLAY_CONTINUE	1
 
 #ifdef __KERNEL__
 
@@ -306,6 +322,9 @@ typedef struct journal_superblock_s
 
 #define J_ASSERT(assert)	BUG_ON(!(assert))
 
+/* Recovery passes, also seen by the fast commit replay callback */
+enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
+
 #define J_ASSERT_BH(bh, expr)	J_ASSERT(expr)
 #define J_ASSERT_JH(jh, expr)	J_ASSERT(expr)
 
@@ -829,6 +848,26 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area: the first block and one beyond the last block
+	 * of the area, and the offset of the next free block in it.  Only
+	 * set up when JBD2_FEATURE_INCOMPAT_FAST_COMMIT is, in which case
+	 * j_last == j_fc_first.  [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+
+	/*
+	 * Buffers of the fast commit in progress, in the order they were
+	 * handed out by jbd2_fc_get_buf().  [JBD2_FAST_COMMIT_ONGOING]
+	 */
+	struct buffer_head	**j_fc_wbuf;
+	int			j_fc_nbufs;
+
+	/* Wait queue for the fast commit in progress to finish */
+	wait_queue_head_t	j_fc_wait;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -942,6 +981,23 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Called during recovery for each block of the fast commit area,
+	 * first for all of them in PASS_SCAN and then again in PASS_REPLAY,
+	 * until it returns JBD2_FC_REPLAY_STOP or an error.  @tid is the
+	 * transaction the fast commits must belong to, the one after the
+	 * last one recovered from the log.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *journal,
+						struct buffer_head *bh,
+						enum passtype pass, int off,
+						tid_t tid);
+
+	/* Fast commit statistics */
+	unsigned long		j_fc_commits;
+	unsigned long		j_fc_blocks;
+	unsigned long		j_fc_fallbacks;
+
 	/*
 	 * Journal statistics
 	 */
@@ -977,6 +1033,8 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* A fast commit is writing
+						 * to the fast commit area */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1115,6 +1173,11 @@ extern int	   jbd2_journal_destroy    (journal_t *);
 extern int	   jbd2_journal_recover    (journal_t *journal);
 extern int	   jbd2_journal_wipe       (journal_t *, int);
 extern int	   jbd2_journal_skip_recovery	(journal_t *);
+extern int	   jbd2_fc_init		(journal_t *, unsigned int);
+extern int	   jbd2_fc_begin_commit	(journal_t *, tid_t);
+extern int	   jbd2_fc_get_buf	(journal_t *, struct buffer_head **);
+extern int	   jbd2_fc_end_commit	(journal_t *);
+extern void	   jbd2_fc_end_commit_fallback	(journal_t *);
 extern void	   jbd2_journal_update_sb_errno(journal_t *);
 extern void	   jbd2_journal_update_sb_log_tail	(journal_t *, tid_t,
 				unsigned long, int);
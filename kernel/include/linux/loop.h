@@ -61,6 +61,14 @@ struct loop_device {
 	/* wait queue for incoming requests */
 	wait_queue_head_t	lo_req_wait;
 
+	/*
+	 * LO_FLAGS_DIRECT_IO: bios remapped to the backing bdev by lo_thread
+	 * and not yet completed.
+	 */
+	atomic_t		lo_dio_inflight;
+	wait_queue_head_t	lo_dio_wait;
+	atomic64_t		lo_dio_bios;
+
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 };
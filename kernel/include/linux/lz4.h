@@ -0,0 +1,75 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ * LZ4 Kernel Interface
+ *
+ * LZ4 is a byte-oriented LZ77 format by Yann Collet; see
+ * https://github.com/lz4/lz4 for the block format description.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define LZ4_MEM_COMPRESS	(4096 * sizeof(unsigned char *))
+#define LZ4HC_MEM_COMPRESS	(65538 * sizeof(unsigned char *))
+
+/*
+ * lz4_compressbound()
+ * Provides the maximum size that LZ4 may output in a "worst case" scenario
+ * (input data not compressible)
+ */
+static inline size_t lz4_compressbound(size_t isize)
+{
+	return isize + (isize / 255) + 16;
+}
+
+/*
+ * lz4_compress()
+ *	src	: source address of the original data
+ *	src_len	: size of the original data
+ *	dst	: output buffer address of the compressed data
+ *	dst_len	: in: size of the output buffer; out: compressed size.
+ *		  The buffer need not be lz4_compressbound() bytes; -1 is
+ *		  returned if the data won't fit.
+ *	wrkmem	: address of the working memory.
+ *		  This requires 'wrkmem' of size LZ4_MEM_COMPRESS.
+ *	return	: Success if return 0
+ *		  Error if return (< 0)
+ */
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * lz4hc_compress()
+ *	As lz4_compress(), but searching hash chains for the longest match:
+ *	slower to compress, smaller output, equally fast to decompress.
+ *	This requires 'wrkmem' of size LZ4HC_MEM_COMPRESS.
+ */
+int lz4hc_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * lz4_decompress()
+ *	src	: source address of the compressed data
+ *	src_len	: in: size of the compressed data; out: bytes consumed
+ *	dest	: output buffer address of the decompressed data
+ *	actual_dest_len: the exact size of the original data
+ *	return	: Success if return 0
+ *		  Error if return (< 0)
+ */
+int lz4_decompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t actual_dest_len);
+
+/*
+ * lz4_decompress_unknownoutputsize()
+ *	src	: source address of the compressed data
+ *	src_len	: is the input size, therefore the compressed size
+ *	dest	: output buffer address of the decompressed data
+ *	dest_len: in: size of the output buffer; out: decompressed size
+ *	return	: Success if return 0
+ *		  Error if return (< 0)
+ */
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len);
+#endif
@@ -652,6 +652,10 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 	} while (0)
 
 extern int device_pm_wait_for_dev(struct device *sub, struct device *dev);
+extern int device_pm_add_dependency(struct device *consumer,
+				    struct device *supplier);
+extern void device_pm_remove_dependency(struct device *consumer,
+					struct device *supplier);
 extern void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *));
 
 extern int pm_generic_prepare(struct device *dev);
@@ -692,6 +696,17 @@ static inline int device_pm_wait_for_dev(struct device *a, struct device *b)
 	return 0;
 }
 
+static inline int device_pm_add_dependency(struct device *consumer,
+					   struct device *supplier)
+{
+	return 0;
+}
+
+static inline void device_pm_remove_dependency(struct device *consumer,
+					       struct device *supplier)
+{
+}
+
 static inline void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *))
 {
 }
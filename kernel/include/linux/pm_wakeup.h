@@ -28,6 +28,9 @@
 
 #include <linux/types.h>
 
+/* <1ms, <2ms, ... <16384ms, >=16384ms */
+#define WAKEUP_HOLD_BUCKETS	16
+
 /**
  * struct wakeup_source - Representation of wakeup sources
  *
@@ -40,6 +43,9 @@
  * @relax_count: Number of times the wakeup sorce was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
+ * @fast_events: Events reported while active, not yet added to @event_count.
+ * @fast_wakeups: Same for @wakeup_count.
+ * @hold_hist: Active periods by length, in power of two milliseconds.
  * @active: Status of the wakeup source.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
@@ -62,6 +68,9 @@ struct wakeup_source {
 	///MEIZU_BSP{@	
 	unsigned long		wakeup_times;  /* add for statics standby wake times by chenshb */
 	///@}
+	atomic_t		fast_events;
+	atomic_t		fast_wakeups;
+	unsigned int		hold_hist[WAKEUP_HOLD_BUCKETS];
 	bool			active:1;
 	bool			autosleep_enabled:1;
 };
@@ -1119,6 +1119,20 @@ struct thread_group_info_t {
 
 #endif
 
+#ifdef CONFIG_MT_PRIO_TRACER
+/*
+ * Latest priority settings of a thread, see prio_tracer.c. Updated without
+ * locks; readers use @done to get a consistent copy.
+ */
+struct prio_tracer {
+	atomic_t count[2];	/* updates from user / kernel and binder */
+	atomic_t change[2];	/* updates that changed prio or policy */
+	atomic_t done;		/* updates completed */
+	u32 ps[4];		/* two latest user, then kernel settings */
+	int prio_binder;	/* binder inherited prio + 1, 0 if none */
+};
+#endif
+
 #ifdef CONFIG_MT_SCHED_NOTICE
   #ifdef CONFIG_MT_SCHED_DEBUG
 #define mt_sched_printf(x...) \
@@ -1184,6 +1198,9 @@ struct task_struct {
 	unsigned int policy;
 	int nr_cpus_allowed;
 	cpumask_t cpus_allowed;
+#ifdef CONFIG_MT_PRIO_TRACER
+	struct prio_tracer prio_tracer;
+#endif
 
 #ifdef CONFIG_PREEMPT_RCU
 	int rcu_read_lock_nesting;
@@ -182,6 +182,14 @@ struct thermal_zone_device {
 	struct mutex lock; /* protect thermal_instances list */
 	struct list_head node;
 	struct delayed_work poll_queue;
+	/* coalesced polling, protected by the core's poll lock */
+	unsigned long poll_next;
+	unsigned long poll_slack;
+	unsigned long poll_start;
+	int poll_delay;
+	/* slope adaptation, protected by lock */
+	unsigned long poll_last;
+	int poll_scale;
 };
 
 /* Structure that holds thermal governor information */
@@ -249,6 +257,8 @@ struct thermal_instance *get_thermal_instance(struct thermal_zone_device *,
 		struct thermal_cooling_device *, int);
 void thermal_cdev_update(struct thermal_cooling_device *);
 void thermal_notify_framework(struct thermal_zone_device *, int);
+bool thermal_poll_get_stats(unsigned long *batches, unsigned long *reads,
+			    unsigned long *nominal, unsigned long *elapsed_ms);
 
 #ifdef CONFIG_NET
 extern int thermal_generate_netlink_event(struct thermal_zone_device *tz,
@@ -158,6 +158,47 @@ struct input_keymap_entry {
 
 #define EVIOCSCLOCKID		_IOW('E', 0xa0, int)			/* Set clockid to be used for timestamps */
 
+/**
+ * struct input_mmap_ring - shared event ring of an evdev client
+ * @version: layout version, EV_MMAP_VERSION
+ * @bufsize: number of entries in @buffer, always a power of two
+ * @head: producer position, written by the kernel
+ * @packet_head: end of the last complete packet, written by the kernel
+ * @tail: consumer position, written by the reader
+ * @dropped: number of packets lost because the ring was full
+ * @buffer: the events themselves
+ *
+ * EVIOCSMMAP switches a client from its private read() queue to this
+ * ring; the ring is then mapped with mmap() at offset 0. All positions
+ * are free-running counters, an entry lives at buffer[pos & (bufsize - 1)].
+ * Events in [tail, packet_head) are complete packets and may be consumed;
+ * the reader must read packet_head before the events it covers and must
+ * be done with the events before storing the new tail. When the ring
+ * overflows the kernel discards the packet in progress and queues
+ * EV_SYN/SYN_DROPPED once there is room again, just like read().
+ */
+struct input_mmap_ring {
+	__u32 version;
+	__u32 bufsize;
+	__u32 head;
+	__u32 packet_head;
+	__u32 tail;
+	__u32 dropped;
+	__u32 reserved[10];
+	struct input_event buffer[];
+};
+
+#define EV_MMAP_VERSION		0x000001
+
+/*
+ * EVIOCSMMAP takes the wanted number of ring entries (0 for the default)
+ * and returns the length to pass to mmap(). EVIOCSEVENTFD registers an
+ * eventfd that is signalled with every complete packet, -1 removes it.
+ * A client cannot have both an eventfd and EVIOCSSUSPENDBLOCK enabled.
+ */
+#define EVIOCSMMAP		_IOWR('E', 0xa1, __u32)			/* Switch to a mmap()able event ring */
+#define EVIOCSEVENTFD		_IOW('E', 0xa2, int)			/* Set eventfd signalled on new packets */
+
 /*
  * Device properties and quirks
  */
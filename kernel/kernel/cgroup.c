@@ -1912,6 +1912,13 @@ int cgroup_taskset_size(struct cgroup_taskset *tset)
 }
 EXPORT_SYMBOL_GPL(cgroup_taskset_size);
 
+/* entry @i of a taskset built by cgroup_attach_task() */
+static struct task_and_cgroup *cgroup_taskset_tc(struct cgroup_taskset *tset,
+						 int i)
+{
+	return tset->tc_array ? flex_array_get(tset->tc_array, i) :
+				&tset->single;
+}
 
 /*
  * cgroup_task_migrate - move a task from one cgroup to another.
@@ -1958,6 +1965,10 @@ static void cgroup_task_migrate(struct cgroup *oldcgrp,
  *
  * Call holding cgroup_mutex and the group_rwsem of the leader. Will take
  * task_lock of @tsk or each thread in the threadgroup individually in turn.
+ *
+ * Moving a whole threadgroup costs one pass of subsystem callbacks, and
+ * threads that share a css_set, which is nearly all of them, share one
+ * css_set lookup.
  */
 static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 			      bool threadgroup)
@@ -1968,28 +1979,31 @@ static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 	/* threadgroup list cursor and array */
 	struct task_struct *leader = tsk;
 	struct task_and_cgroup *tc;
-	struct flex_array *group;
+	struct flex_array *group = NULL;
 	struct cgroup_taskset tset = { };
+	struct css_set *oldcg = NULL, *newcg = NULL;
 
 	/*
 	 * step 0: in order to do expensive, possibly blocking operations for
 	 * every thread, we cannot iterate the thread group list, since it needs
 	 * rcu or tasklist locked. instead, build an array of all threads in the
 	 * group - group_rwsem prevents new threads from appearing, and if
-	 * threads exit, this will just be an over-estimate.
+	 * threads exit, this will just be an over-estimate.  A single task,
+	 * as written to "tasks", goes in tset.single and needs no array.
 	 */
-	if (threadgroup)
+	if (threadgroup) {
 		group_size = get_nr_threads(tsk);
-	else
+		/* flex_array supports very large thread-groups better than kmalloc. */
+		group = flex_array_alloc(sizeof(*tc), group_size, GFP_KERNEL);
+		if (!group)
+			return -ENOMEM;
+		/* pre-allocate to guarantee space while iterating in rcu read-side. */
+		retval = flex_array_prealloc(group, 0, group_size, GFP_KERNEL);
+		if (retval)
+			goto out_free_group_list;
+	} else {
 		group_size = 1;
-	/* flex_array supports very large thread-groups better than kmalloc. */
-	group = flex_array_alloc(sizeof(*tc), group_size, GFP_KERNEL);
-	if (!group)
-		return -ENOMEM;
-	/* pre-allocate to guarantee space while iterating in rcu read-side. */
-	retval = flex_array_prealloc(group, 0, group_size, GFP_KERNEL);
-	if (retval)
-		goto out_free_group_list;
+	}
 
 	i = 0;
 	/*
@@ -2012,12 +2026,17 @@ static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 		/* nothing to do if this task is already in the cgroup */
 		if (ent.cgrp == cgrp)
 			goto next;
-		/*
-		 * saying GFP_ATOMIC has no effect here because we did prealloc
-		 * earlier, but it's good form to communicate our expectations.
-		 */
-		retval = flex_array_put(group, i, &ent, GFP_ATOMIC);
-		BUG_ON(retval != 0);
+		if (group) {
+			/*
+			 * saying GFP_ATOMIC has no effect here because we did
+			 * prealloc earlier, but it's good form to communicate
+			 * our expectations.
+			 */
+			retval = flex_array_put(group, i, &ent, GFP_ATOMIC);
+			BUG_ON(retval != 0);
+		} else {
+			tset.single = ent;
+		}
 		i++;
 	next:
 		if (!threadgroup)
@@ -2050,14 +2069,23 @@ static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 	/*
 	 * step 2: make sure css_sets exist for all threads to be migrated.
 	 * we use find_css_set, which allocates a new one if necessary.
+	 * Threads coming from the css_set of the previous one take another
+	 * reference on its result instead of looking it up again.
 	 */
 	for (i = 0; i < group_size; i++) {
-		tc = flex_array_get(group, i);
+		tc = cgroup_taskset_tc(&tset, i);
+		if (newcg && tc->task->cgroups == oldcg) {
+			get_css_set(newcg);
+			tc->cg = newcg;
+			continue;
+		}
 		tc->cg = find_css_set(tc->task->cgroups, cgrp);
 		if (!tc->cg) {
 			retval = -ENOMEM;
 			goto out_put_css_set_refs;
 		}
+		oldcg = tc->task->cgroups;
+		newcg = tc->cg;
 	}
 
 	/*
@@ -2066,7 +2094,7 @@ static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 	 * failure cases after here, so this is the commit point.
 	 */
 	for (i = 0; i < group_size; i++) {
-		tc = flex_array_get(group, i);
+		tc = cgroup_taskset_tc(&tset, i);
 		cgroup_task_migrate(tc->cgrp, tc->task, tc->cg);
 	}
 	/* nothing is sensitive to fork() after this point. */
@@ -2086,7 +2114,7 @@ static int cgroup_attach_task(struct cgroup *cgrp, struct task_struct *tsk,
 out_put_css_set_refs:
 	if (retval) {
 		for (i = 0; i < group_size; i++) {
-			tc = flex_array_get(group, i);
+			tc = cgroup_taskset_tc(&tset, i);
 			if (!tc->cg)
 				break;
 			put_css_set(tc->cg);
@@ -2102,7 +2130,8 @@ out_cancel_attach:
 		}
 	}
 out_free_group_list:
-	flex_array_free(group);
+	if (group)
+		flex_array_free(group);
 	return retval;
 }
 
@@ -59,10 +59,6 @@
 #include <asm/pgtable.h>
 #include <asm/mmu_context.h>
 
-#ifdef CONFIG_MT_PRIO_TRACER
-# include <linux/prio_tracer.h>
-#endif
-
 static void exit_mm(struct task_struct * tsk);
 
 static void __unhash_process(struct task_struct *p, bool group_dead)
@@ -724,10 +720,6 @@ void do_exit(long code)
 	end_mtproc_info(tsk);
 #endif
 
-#ifdef CONFIG_MT_PRIO_TRACER
-	delete_prio_tracer(tsk->pid);
-#endif
-
 	WARN_ON(blk_needs_flush_plug(tsk));
 
 	if (unlikely(in_interrupt()))
@@ -1698,6 +1698,10 @@ long do_fork(unsigned long clone_flags,
         /* mt shceduler profiling*/
         save_mtproc_info(p, sched_clock());	
         printk(KERN_DEBUG "[%d:%s] fork [%d:%s]\n", current->pid, current->comm, p->pid, p->comm);
+#endif
+#ifdef CONFIG_MT_PRIO_TRACER
+		create_prio_tracer(p);
+		update_prio_tracer(p, p->prio, p->policy, PTS_KRNL);
 #endif
 		wake_up_new_task(p);
 
@@ -1709,10 +1713,6 @@ long do_fork(unsigned long clone_flags,
 			if (!wait_for_vfork_done(p, &vfork))
 				ptrace_event(PTRACE_EVENT_VFORK_DONE, nr);
 		}
-#ifdef CONFIG_MT_PRIO_TRACER
-		create_prio_tracer(task_pid_nr(p));
-		update_prio_tracer(task_pid_nr(p), p->prio, p->policy, PTS_KRNL);
-#endif
 	} else {
 		nr = PTR_ERR(p);
 		printk("[%d:%s] fork fail:[0x%x, %d]\n", current->pid, current->comm, (unsigned int)p,(int) nr);
@@ -70,8 +70,11 @@ int pm_notifier_call_chain(unsigned long val)
 EXPORT_SYMBOL_GPL(pm_notifier_call_chain);
 
 /* If set, devices may be suspended and resumed asynchronously. */
-//<20130327> <marc.huang> disable async suspend/resume, set pm_async_enabled = 0
-int pm_async_enabled = 0;
+/*
+ * Async was turned off on this platform because nothing ordered the MTK
+ * devices against each other; they now use device_pm_add_dependency().
+ */
+int pm_async_enabled = 1;
 
 static ssize_t pm_async_show(struct kobject *kobj, struct kobj_attribute *attr,
 			     char *buf)
@@ -698,6 +698,7 @@ DEFINE_MEMORY_BITMAP(pageset1_map);
 DEFINE_MEMORY_BITMAP(pageset1_copy_map);
 DEFINE_MEMORY_BITMAP(pageset2_map);
 DEFINE_MEMORY_BITMAP(page_resave_map);
+DEFINE_MEMORY_BITMAP(pageset2_lazy_map);
 DEFINE_MEMORY_BITMAP(io_map);
 DEFINE_MEMORY_BITMAP(nosave_map);
 DEFINE_MEMORY_BITMAP(free_map);
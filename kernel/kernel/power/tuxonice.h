@@ -94,6 +94,7 @@ enum {
 	TOI_NO_PS2_IF_UNNEEDED,
 	TOI_POST_RESUME_BREAKPOINT,
 	TOI_NO_READAHEAD,
+	TOI_LAZY_PAGESET2,
 };
 
 extern unsigned long toi_bootflags_mask;
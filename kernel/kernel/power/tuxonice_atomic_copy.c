@@ -88,7 +88,8 @@ static void free_pbe_list(struct pbe **list, int highmem)
  *	2) Set the status flags.
  *	3) Resume devices.
  *	4) Tell userui so it can redraw & restore settings.
- *	5) Reread the page cache.
+ *	5) Reread the page cache (or, with lazy_pageset2, the part of it
+ *	that can't wait until processes have been thawed).
  **/
 void copyback_post(void)
 {
@@ -102,7 +103,7 @@ void copyback_post(void)
 
 	toi_cond_pause(1, "About to reload secondary pagedir.");
 
-	if (read_pageset2(0))
+	if (toi_lazy_pages ? read_pageset2_lazy() : read_pageset2(0))
 		panic("Unable to successfully reread the page cache.");
   
 	/*
@@ -281,13 +281,37 @@ int tuxonice_calc_checksum(struct page *page, char *checksum_locn)
 				"returned %d.\n", result);
 	return result;
 }
+/*
+ * Next pageset2 pfn in the order the pages were written: with
+ * lazy_pageset2, the hot pages first and then the lazy ones.
+ */
+static unsigned long next_written_pfn(int *lazy_pass)
+{
+	unsigned long pfn;
+
+	if (!*lazy_pass) {
+		do {
+			pfn = memory_bm_next_pfn(pageset2_map);
+		} while (pfn != BM_END_OF_MAP && toi_lazy_pages &&
+				PageLazy(pfn_to_page(pfn)));
+
+		if (pfn != BM_END_OF_MAP || !toi_lazy_pages)
+			return pfn;
+
+		*lazy_pass = 1;
+		memory_bm_position_reset(pageset2_lazy_map);
+	}
+
+	return memory_bm_next_pfn(pageset2_lazy_map);
+}
+
 /*
  * Calculate checksums
  */
 
 void check_checksums(void)
 {
-	int pfn, index = 0, cpu = smp_processor_id();
+	int pfn, index = 0, cpu = smp_processor_id(), lazy_pass = 0;
 	char current_checksum[CHECKSUM_SIZE];
 	struct cpu_context *ctx = &per_cpu(contexts, cpu);
 
@@ -303,8 +327,8 @@ void check_checksums(void)
 
 	toi_message(TOI_IO, TOI_VERBOSE, 0, "Verifying checksums.");
 	memory_bm_position_reset(pageset2_map);
-	for (pfn = memory_bm_next_pfn(pageset2_map); pfn != BM_END_OF_MAP;
-			pfn = memory_bm_next_pfn(pageset2_map)) {
+	for (pfn = next_written_pfn(&lazy_pass); pfn != BM_END_OF_MAP;
+			pfn = next_written_pfn(&lazy_pass)) {
 		int ret;
 		char *pa;
 		struct page *page = pfn_to_page(pfn);
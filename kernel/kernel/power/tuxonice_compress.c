@@ -13,6 +13,7 @@
 #include <linux/highmem.h>
 #include <linux/vmalloc.h>
 #include <linux/crypto.h>
+#include <linux/ktime.h>
 
 #include "tuxonice_builtin.h"
 #include "tuxonice.h"
@@ -21,6 +22,8 @@
 #include "tuxonice_io.h"
 #include "tuxonice_ui.h"
 #include "tuxonice_alloc.h"
+#include "tuxonice_pageflags.h"
+#include "tuxonice_pagedir.h"
 
 static int toi_expected_compression;
 
@@ -31,6 +34,31 @@ static char toi_compressor_name[32] = "lzo";
 
 static DEFINE_MUTEX(stats_lock);
 
+/*
+ * Adaptive selection: before writing each image, time the candidates on a
+ * sample of the pages about to be written and keep the one expected to give
+ * the shortest write plus read, given the storage throughput seen on the
+ * previous cycle.
+ */
+static int toi_compress_adaptive;
+
+static const char * const toi_adaptive_candidates[] = { "lzo", "lz4", "lz4hc" };
+#define TOI_ADAPTIVE_CANDIDATES ARRAY_SIZE(toi_adaptive_candidates)
+#define TOI_ADAPTIVE_SAMPLES 32
+
+/* Estimated microseconds to write and read the sample, per candidate */
+static unsigned long toi_adaptive_cost[TOI_ADAPTIVE_CANDIDATES][2];
+
+/*
+ * KB/s of compressed data moved while writing and reading pageset2 last
+ * time. Recorded outside the atomic copy so the values survive resume.
+ */
+static unsigned long toi_compress_write_kbps, toi_compress_read_kbps;
+
+static int toi_compress_stream;
+static unsigned long toi_compress_stream_start, toi_compress_stream_bytes;
+static unsigned long toi_compress_bytes_read;
+
 struct cpu_context {
 	u8 *page_buffer;
 	struct crypto_comp *transform;
@@ -93,10 +121,205 @@ static int toi_compress_crypto_prepare(void)
 	return 0;
 }
 
+/*
+ * toi_adaptive_sample_pages
+ *
+ * Pick up to TOI_ADAPTIVE_SAMPLES pages spread evenly over pageset2 and
+ * pageset1. Returns the number found.
+ */
+static int toi_adaptive_sample_pages(struct page **pages)
+{
+	struct memory_bitmap *maps[2] = { pageset2_map, pageset1_map };
+	unsigned long sizes[2] = { pagedir2.size, pagedir1.size };
+	int i, found = 0;
+
+	for (i = 0; i < 2; i++) {
+		int want = (TOI_ADAPTIVE_SAMPLES - found) / (2 - i);
+		unsigned long pfn, stride, n = 0;
+
+		if (!sizes[i] || !want)
+			continue;
+
+		stride = max_t(unsigned long, sizes[i] / want, 1);
+		memory_bm_position_reset(maps[i]);
+		for (pfn = memory_bm_next_pfn(maps[i]);
+		     pfn != BM_END_OF_MAP && found < TOI_ADAPTIVE_SAMPLES;
+		     pfn = memory_bm_next_pfn(maps[i]))
+			if (!(n++ % stride) && pfn_valid(pfn))
+				pages[found++] = pfn_to_page(pfn);
+	}
+
+	return found;
+}
+
+/*
+ * toi_adaptive_time_one
+ *
+ * Compress and decompress the sample pages with one algorithm. Returns 0
+ * with the nanoseconds taken and bytes that would be stored, or 1 if the
+ * algorithm isn't available.
+ */
+static int toi_adaptive_time_one(const char *name, struct page **pages,
+		int nr_pages, u8 *out, u8 *check, u64 *comp_ns, u64 *decomp_ns,
+		unsigned long *stored)
+{
+	struct crypto_comp *tfm = crypto_alloc_comp(name, 0, 0);
+	int i;
+
+	if (IS_ERR(tfm))
+		return 1;
+
+	*comp_ns = *decomp_ns = 0;
+	*stored = 0;
+
+	for (i = 0; i < nr_pages; i++) {
+		unsigned int len = OUT_BUF_SIZE, outlen = PAGE_SIZE;
+		u8 *src = kmap(pages[i]);
+		ktime_t start = ktime_get();
+		int ret;
+
+		ret = crypto_comp_compress(tfm, src, PAGE_SIZE, out, &len);
+		*comp_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		kunmap(pages[i]);
+
+		/* Pages that don't shrink are stored and read back as is */
+		if (ret || len >= PAGE_SIZE) {
+			*stored += PAGE_SIZE;
+			continue;
+		}
+
+		*stored += len;
+		start = ktime_get();
+		crypto_comp_decompress(tfm, out, len, check, &outlen);
+		*decomp_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+
+	crypto_free_comp(tfm);
+	return 0;
+}
+
+/*
+ * toi_adaptive_io_us
+ *
+ * Microseconds to move @bytes at @kbps.
+ */
+static unsigned long toi_adaptive_io_us(unsigned long bytes,
+		unsigned long kbps)
+{
+	u64 us = (u64) bytes * 1000000;
+
+	do_div(us, kbps * 1024);
+	return (unsigned long) us;
+}
+
+/*
+ * toi_compress_choose
+ *
+ * Compressing and writing (and reading and decompressing) run in parallel,
+ * so each direction costs whichever of the two is slower. Compression is
+ * spread over the I/O workers; storage is the rate measured last cycle.
+ * That rate was itself limited by the compressor in use then, so it is a
+ * lower bound on the device, which can only favour faster compressors.
+ */
+static void toi_compress_choose(void)
+{
+	int workers = toi_max_workers ? toi_max_workers : num_online_cpus();
+	unsigned long best_cost = ULONG_MAX, read_kbps;
+	struct page **pages;
+	u8 *out = NULL, *check = NULL;
+	int i, nr_pages, best = -1;
+
+	memset(toi_adaptive_cost, 0, sizeof(toi_adaptive_cost));
+
+	if (!toi_compress_write_kbps) {
+		toi_message(TOI_COMPRESS, TOI_LOW, 0,
+			"No I/O speed recorded yet; keeping %s this cycle.",
+			toi_compressor_name);
+		return;
+	}
+
+	read_kbps = toi_compress_read_kbps ? : toi_compress_write_kbps;
+
+	pages = kmalloc(TOI_ADAPTIVE_SAMPLES * sizeof(*pages), GFP_KERNEL);
+	out = vmalloc_32(OUT_BUF_SIZE);
+	check = vmalloc_32(PAGE_SIZE);
+	if (!pages || !out || !check)
+		goto out_free;
+
+	nr_pages = toi_adaptive_sample_pages(pages);
+	if (!nr_pages)
+		goto out_free;
+
+	for (i = 0; i < TOI_ADAPTIVE_CANDIDATES; i++) {
+		unsigned long stored, comp_us, decomp_us, cost;
+		u64 comp_ns, decomp_ns;
+
+		if (toi_adaptive_time_one(toi_adaptive_candidates[i], pages,
+				nr_pages, out, check, &comp_ns, &decomp_ns,
+				&stored))
+			continue;
+
+		do_div(comp_ns, NSEC_PER_USEC * workers);
+		do_div(decomp_ns, NSEC_PER_USEC * workers);
+		comp_us = (unsigned long) comp_ns;
+		decomp_us = (unsigned long) decomp_ns;
+
+		/* +1 so a candidate that was timed never reads as 0 */
+		toi_adaptive_cost[i][0] = max(comp_us,
+			toi_adaptive_io_us(stored, toi_compress_write_kbps)) + 1;
+		toi_adaptive_cost[i][1] = max(decomp_us,
+			toi_adaptive_io_us(stored, read_kbps));
+
+		cost = toi_adaptive_cost[i][0] + toi_adaptive_cost[i][1];
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = i;
+		}
+	}
+
+	if (best >= 0) {
+		strlcpy(toi_compressor_name, toi_adaptive_candidates[best],
+				sizeof(toi_compressor_name));
+		toi_message(TOI_COMPRESS, TOI_LOW, 0,
+			"Chose %s for %lu KB/s write, %lu KB/s read.",
+			toi_compressor_name, toi_compress_write_kbps,
+			read_kbps);
+	}
+
+out_free:
+	vfree(check);
+	vfree(out);
+	kfree(pages);
+}
+
+/*
+ * toi_compress_stream_done
+ *
+ * Record how fast compressed pageset2 data moved, for the next choice.
+ */
+static void toi_compress_stream_done(int writing)
+{
+	unsigned long bytes = (writing ? toi_compress_bytes_out :
+			toi_compress_bytes_read) - toi_compress_stream_bytes;
+	unsigned long ticks = jiffies - toi_compress_stream_start, kbps;
+
+	if (toi_compress_stream != 2 || !ticks || bytes < (1 << 20) ||
+	    test_result_state(TOI_ABORTED))
+		return;
+
+	kbps = div_u64((u64) (bytes >> 10) * HZ, ticks);
+	if (writing)
+		toi_compress_write_kbps = kbps;
+	else
+		toi_compress_read_kbps = kbps;
+}
+
 static int toi_compress_rw_cleanup(int writing)
 {
 	int cpu;
 
+	toi_compress_stream_done(writing);
+
 	for_each_online_cpu(cpu) {
 		struct cpu_context *this = &per_cpu(contexts, cpu);
 		if (this->transform) {
@@ -141,6 +364,14 @@ static int toi_compress_init(int toi_or_resume)
 
 static int toi_compress_rw_init(int rw, int stream_number)
 {
+	if (rw == WRITE && stream_number == 2 && toi_compress_adaptive)
+		toi_compress_choose();
+
+	toi_compress_stream = stream_number;
+	toi_compress_stream_start = jiffies;
+	toi_compress_bytes_read = 0;
+	toi_compress_stream_bytes = rw == WRITE ? toi_compress_bytes_out : 0;
+
 	if (toi_compress_crypto_prepare()) {
 		printk(KERN_ERR "Failed to initialise compression "
 				"algorithm.\n");
@@ -244,6 +475,12 @@ static int toi_compress_read_page(unsigned long *index, int buf_type,
 
 	ret = next_driver->read_page(index, TOI_VIRT, ctx->page_buffer, &len);
 
+	if (!ret) {
+		mutex_lock(&stats_lock);
+		toi_compress_bytes_read += len;
+		mutex_unlock(&stats_lock);
+	}
+
 	buffer_start = kmap(buffer_page);
 
 	/* Error or uncompressed data */
@@ -306,6 +543,22 @@ static int toi_compress_print_debug_stats(char *buffer, int size)
 		  toi_compress_bytes_in,
 		  toi_compress_bytes_out,
 		  (pages_in - pages_out) * 100 / pages_in);
+
+	if (toi_compress_adaptive) {
+		int i;
+
+		len += scnprintf(buffer+len, size - len, "  Adaptive: storage "
+			"%lu KB/s write, %lu KB/s read last cycle.\n",
+			toi_compress_write_kbps, toi_compress_read_kbps);
+		for (i = 0; i < TOI_ADAPTIVE_CANDIDATES; i++)
+			if (toi_adaptive_cost[i][0])
+				len += scnprintf(buffer+len, size - len,
+					"  %-6s est. %lu us write + %lu us "
+					"read for the sample.\n",
+					toi_adaptive_candidates[i],
+					toi_adaptive_cost[i][0],
+					toi_adaptive_cost[i][1]);
+	}
 	return len;
 }
 
@@ -410,6 +663,8 @@ static struct toi_sysfs_data sysfs_params[] = {
 	SYSFS_INT("enabled", SYSFS_RW, &toi_compression_ops.enabled, 0, 1, 0,
 			NULL),
 	SYSFS_STRING("algorithm", SYSFS_RW, toi_compressor_name, 31, 0, NULL),
+	SYSFS_INT("adaptive", SYSFS_RW, &toi_compress_adaptive, 0, 1, 0,
+			NULL),
 };
 
 /*
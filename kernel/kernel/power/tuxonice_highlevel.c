@@ -295,7 +295,8 @@ static int allocate_bitmaps(void)
 	    toi_alloc_bitmap(&io_map) ||
 	    toi_alloc_bitmap(&nosave_map) ||
 	    toi_alloc_bitmap(&free_map) ||
-	    toi_alloc_bitmap(&page_resave_map))
+	    toi_alloc_bitmap(&page_resave_map) ||
+	    toi_alloc_bitmap(&pageset2_lazy_map))
 		return 1;
 
 	return 0;
@@ -326,6 +327,7 @@ static void free_bitmaps(void)
 	toi_free_bitmap(&nosave_map);
 	toi_free_bitmap(&free_map);
 	toi_free_bitmap(&page_resave_map);
+	toi_free_bitmap(&pageset2_lazy_map);
 }
 
 /**
@@ -418,6 +420,27 @@ static int get_toi_debug_info(const char *buffer, int count)
 	return len;
 }
 
+/**
+ * release_image - invalidate the image and free the page state bitmaps
+ *
+ * Unless we've been asked to keep it, the image is no longer needed
+ * once everything has been read back.
+ **/
+static void release_image(void)
+{
+	if (test_action_state(TOI_KEEP_IMAGE) &&
+	    !test_result_state(TOI_ABORTED)) {
+		toi_message(TOI_ANY_SECTION, TOI_LOW, 1,
+			"TuxOnIce: Not invalidating the image due "
+			"to Keep Image being enabled.");
+		set_result_state(TOI_KEPT_IMAGE);
+	} else
+		if (toiActiveAllocator)
+			toiActiveAllocator->remove_image();
+
+	free_bitmaps();
+}
+
 /**
  * do_cleanup - cleanup after attempting to hibernate or resume
  * @get_debug_info:	Whether to allocate and return debugging info.
@@ -427,7 +450,7 @@ static int get_toi_debug_info(const char *buffer, int count)
  **/
 static void do_cleanup(int get_debug_info, int restarting)
 {
-	int i = 0;
+	int i = 0, lazy;
 	char *buffer = NULL;
 
 	trap_non_toi_io = 0;
@@ -466,17 +489,14 @@ static void do_cleanup(int get_debug_info, int restarting)
 	if (!restarting)
 		toi_stop_other_threads();
 
-	if (test_action_state(TOI_KEEP_IMAGE) &&
-	    !test_result_state(TOI_ABORTED)) {
-		toi_message(TOI_ANY_SECTION, TOI_LOW, 1,
-			"TuxOnIce: Not invalidating the image due "
-			"to Keep Image being enabled.");
-		set_result_state(TOI_KEPT_IMAGE);
-	} else
-		if (toiActiveAllocator)
-			toiActiveAllocator->remove_image();
+	/*
+	 * With lazy_pageset2, cold cache pages are still being read from
+	 * the image; it and the bitmaps have to stay until they're in.
+	 */
+	lazy = toi_lazy_stream_pageset2();
+	if (!lazy)
+		release_image();
 
-	free_bitmaps();
 	usermodehelper_enable();
 
 	if (test_toi_state(TOI_NOTIFIERS_PREPARE)) {
@@ -495,6 +515,11 @@ static void do_cleanup(int get_debug_info, int restarting)
 	if (!test_action_state(TOI_LATE_CPU_HOTPLUG))
 		enable_nonboot_cpus();
 
+	if (lazy) {
+		toi_lazy_wait();
+		release_image();
+	}
+
 	if (!restarting)
 		toi_cleanup_console();
 
@@ -1323,6 +1348,8 @@ static struct toi_sysfs_data sysfs_params[] = {
 #endif
 	SYSFS_BIT("no_readahead", SYSFS_RW, &toi_bkd.toi_action,
 			TOI_NO_READAHEAD, 0),
+	SYSFS_BIT("lazy_pageset2", SYSFS_RW, &toi_bkd.toi_action,
+			TOI_LAZY_PAGESET2, 0),
 #ifdef CONFIG_TOI_KEEP_IMAGE
 	SYSFS_BIT("keep_image", SYSFS_RW , &toi_bkd.toi_action, TOI_KEEP_IMAGE,
 			0),
@@ -22,6 +22,8 @@
 #include <linux/fs_struct.h>
 #include <linux/bio.h>
 #include <linux/fs_uuid.h>
+#include <linux/pagemap.h>
+#include <linux/ktime.h>
 #include <asm/tlbflush.h>
 
 #include "tuxonice.h"
@@ -64,6 +66,17 @@ EXPORT_SYMBOL_GPL(toi_io_workers);
 
 static int using_flusher;
 
+/*
+ * Lazy pageset2: the cold page cache pages are written after the rest of
+ * pageset2 so that they can be read back after userspace has been thawed.
+ * These are ordinary variables so they survive the atomic restore.
+ */
+int toi_lazy_hot_pages, toi_lazy_pages;
+static int io_lazy, toi_lazy_pending, toi_lazy_base, toi_lazy_barmax;
+static atomic_t toi_lazy_waited;
+static ktime_t toi_lazy_restored;
+static DECLARE_COMPLETION(toi_lazy_done);
+
 DECLARE_WAIT_QUEUE_HEAD(toi_io_queue_flusher);
 EXPORT_SYMBOL_GPL(toi_io_queue_flusher);
 
@@ -78,6 +91,7 @@ static char *image_version_error = "The image header version is newer than " \
 struct toi_module_ops *first_filter;
 
 static atomic_t toi_num_other_threads;
+static DECLARE_WAIT_QUEUE_HEAD(toi_other_threads_exited);
 static DECLARE_WAIT_QUEUE_HEAD(toi_worker_wait_queue);
 enum toi_worker_commands {
 	TOI_IO_WORKER_STOP,
@@ -548,6 +562,18 @@ static void use_read_page(unsigned long write_pfn, struct page *buffer)
 	kunmap(buffer);
 	memory_bm_clear_bit_index(io_map, write_pfn, cpu);
 	toi_message(TOI_IO, TOI_VERBOSE, 0, "Read %d:%ld", idx, write_pfn);
+
+	if (io_lazy) {
+		/*
+		 * Anyone beyond the page cache (and buffers) holding a
+		 * reference is sleeping in lock_page() for this data.
+		 */
+		if (page_count(final_page) > 1 + page_has_private(final_page))
+			atomic_inc(&toi_lazy_waited);
+		flush_dcache_page(final_page);
+		SetPageUptodate(final_page);
+		unlock_page(final_page);
+	}
 }
 
 static unsigned long status_update(int writing, unsigned long done,
@@ -654,7 +680,11 @@ top:
 				break;
 			}
 
-			if (io_pageset == 1) {
+			/*
+			 * Lazily streamed pages are still in the page cache and
+			 * can be dropped and reread, so don't panic over them.
+			 */
+			if (io_pageset == 1 || io_lazy) {
 				printk(KERN_ERR "\nBreaking out of I/O loop "
 					"because of result code %d.\n", result);
 				break;
@@ -723,8 +753,8 @@ top:
 			goto top;
 	}
 
-	if (thread_num)
-		atomic_dec(&toi_num_other_threads);
+	if (thread_num && atomic_dec_and_test(&toi_num_other_threads))
+		wake_up(&toi_other_threads_exited);
 
 	toi_message(TOI_IO, TOI_LOW, 0, "Thread %d exiting.", thread_num);
 	toi__free_page(28, buffer);
@@ -782,9 +812,10 @@ void toi_stop_other_threads(void)
  * do_rw_loop - main highlevel function for reading or writing pages
  *
  * Create the io_map bitmap and call worker_rw_loop to perform I/O operations.
+ * Pages set in @skip (if given) are left out of the io_map.
  **/
 static int do_rw_loop(int write, int finish_at, struct memory_bitmap *pageflags,
-		int base, int barmax, int pageset)
+		struct memory_bitmap *skip, int base, int barmax, int pageset)
 {
 	int index = 0, cpu, result = 0, workers_started;
 	unsigned long pfn;
@@ -821,9 +852,11 @@ static int do_rw_loop(int write, int finish_at, struct memory_bitmap *pageflags,
 	pfn = memory_bm_next_pfn(pageflags);
 
 	while (pfn != BM_END_OF_MAP && index < finish_at) {
-		memory_bm_set_bit(io_map, pfn);
+		if (!skip || !memory_bm_test_bit(skip, pfn)) {
+			memory_bm_set_bit(io_map, pfn);
+			index++;
+		}
 		pfn = memory_bm_next_pfn(pageflags);
-		index++;
 	}
 
 	BUG_ON(index < finish_at);
@@ -905,6 +938,77 @@ static int do_rw_loop(int write, int finish_at, struct memory_bitmap *pageflags,
 	return io_result ? io_result : result;
 }
 
+/**
+ * toi_lazy_page_is_cold - can this page be loaded after thawing?
+ *
+ * Only clean, unmapped, inactive page cache pages qualify. Their users
+ * find them through the page cache and will sleep on the page lock until
+ * the data is in; anything mapped or anonymous is needed straight away.
+ *
+ * Pages with buffers (or other private data) are excluded, as are block
+ * device pages: buffer users such as sb_bread() trust BH_Uptodate and
+ * never take the page lock, so they would see whatever is in memory.
+ **/
+static int toi_lazy_page_is_cold(struct page *page)
+{
+	struct inode *host;
+
+	if (PageAnon(page) || !page->mapping || page_mapped(page))
+		return 0;
+
+	if (page_has_private(page))
+		return 0;
+
+	host = page->mapping->host;
+	if (!host || S_ISBLK(host->i_mode))
+		return 0;
+
+	if (!PageLRU(page) || PageActive(page) || PageReferenced(page))
+		return 0;
+
+	return PageUptodate(page) && !PageDirty(page) &&
+		!PageWriteback(page) && !PageLocked(page) &&
+		!PageSwapCache(page);
+}
+
+/**
+ * toi_lazy_split_pageset2 - pick the pageset2 pages to load lazily
+ *
+ * Fill pageset2_lazy_map and set toi_lazy_hot_pages / toi_lazy_pages.
+ * The image records nothing extra: the split lives in kernel memory and
+ * is restored along with the rest of it.
+ **/
+static void toi_lazy_split_pageset2(void)
+{
+	unsigned long pfn;
+	int index = 0;
+
+	toi_lazy_pages = 0;
+	toi_lazy_hot_pages = pagedir2.size;
+
+	if (!test_action_state(TOI_LAZY_PAGESET2) || !pageset2_lazy_map)
+		return;
+
+	memory_bm_clear(pageset2_lazy_map);
+	memory_bm_position_reset(pageset2_map);
+
+	for (pfn = memory_bm_next_pfn(pageset2_map);
+			pfn != BM_END_OF_MAP && index < pagedir2.size;
+			pfn = memory_bm_next_pfn(pageset2_map), index++) {
+		struct page *page = pfn_to_page(pfn);
+
+		if (toi_lazy_page_is_cold(page)) {
+			SetPageLazy(page);
+			toi_lazy_pages++;
+		}
+	}
+
+	toi_lazy_hot_pages = pagedir2.size - toi_lazy_pages;
+
+	toi_message(TOI_IO, TOI_LOW, 0, "Pageset2: %d hot, %d lazy pages.",
+			toi_lazy_hot_pages, toi_lazy_pages);
+}
+
 /**
  * write_pageset - write a pageset to disk.
  * @pagedir:	Which pagedir to write.
@@ -941,6 +1045,7 @@ int write_pageset(struct pagedir *pagedir)
         hib_log("start to writing caches...\n");
 		toi_prepare_status(DONT_CLEAR_BAR, "Writing caches...");
 		pageflags = pageset2_map;
+		toi_lazy_split_pageset2();
 	}
 
 	start_time = jiffies;
@@ -951,8 +1056,15 @@ int write_pageset(struct pagedir *pagedir)
 		error = 1;
 	}
 
-	if (!error)
-		error = do_rw_loop(1, finish_at, pageflags, base, barmax,
+	if (!error && pagedir->id == 2 && toi_lazy_pages) {
+		/* Hot pages first, so they can be read back on their own */
+		error = do_rw_loop(1, toi_lazy_hot_pages, pageflags,
+				pageset2_lazy_map, 0, barmax, 2);
+		if (!error)
+			error = do_rw_loop(1, toi_lazy_pages, pageset2_lazy_map,
+					NULL, toi_lazy_hot_pages, barmax, 2);
+	} else if (!error)
+		error = do_rw_loop(1, finish_at, pageflags, NULL, base, barmax,
 				pagedir->id);
 
 	if (rw_cleanup_modules(WRITE) && !error) {
@@ -995,7 +1107,11 @@ static int read_pageset(struct pagedir *pagedir, int overwrittenpagesonly)
 		pageflags = pageset1_map;
 	} else {
 		toi_prepare_status(DONT_CLEAR_BAR, "Reading caches...");
-		if (overwrittenpagesonly) {
+		/*
+		 * A split pageset2 isn't in bitmap order on disk, so the
+		 * overwritten pages aren't just the first ones. Read it all.
+		 */
+		if (overwrittenpagesonly && !toi_lazy_pages) {
 			barmax = min(pagedir1.size, pagedir2.size);
 			finish_at = min(pagedir1.size, pagedir2.size);
 		} else
@@ -1009,7 +1125,7 @@ static int read_pageset(struct pagedir *pagedir, int overwrittenpagesonly)
 		toiActiveAllocator->remove_image();
 		result = 1;
 	} else
-		result = do_rw_loop(0, finish_at, pageflags, base, barmax,
+		result = do_rw_loop(0, finish_at, pageflags, NULL, base, barmax,
 				pagedir->id);
 
 	if (rw_cleanup_modules(READ) && !result) {
@@ -1924,12 +2040,218 @@ int read_pageset2(int overwrittenpagesonly)
 		return 0;
 
 	result = read_pageset(&pagedir2, overwrittenpagesonly);
+	toi_lazy_pages = 0;
 
 	toi_cond_pause(1, "Pagedir 2 read.");
 
 	return result;
 }
 
+/**
+ * toi_lazy_lock_pages - make the cold pages wait for their data
+ *
+ * Lock each lazily loaded page and mark it !uptodate, so that anything
+ * finding it in the page cache sleeps in lock_page() until the streamer
+ * has filled it in. Pages that were resaved in pageset1 are already
+ * correct and are left alone; their copies in pageset2 are discarded.
+ *
+ * Processes are still frozen and the page flags are as they were when
+ * pageset2 was written, so the trylocks are expected to succeed. If one
+ * doesn't, undo the lot and let the caller load everything now.
+ **/
+static int toi_lazy_lock_pages(void)
+{
+	unsigned long pfn, failed = BM_END_OF_MAP;
+
+	memory_bm_position_reset(pageset2_lazy_map);
+	for (pfn = memory_bm_next_pfn(pageset2_lazy_map); pfn != BM_END_OF_MAP;
+			pfn = memory_bm_next_pfn(pageset2_lazy_map)) {
+		struct page *page = pfn_to_page(pfn);
+
+		if (PageResave(page))
+			continue;
+
+		if (!trylock_page(page)) {
+			failed = pfn;
+			break;
+		}
+		ClearPageUptodate(page);
+	}
+
+	if (failed == BM_END_OF_MAP)
+		return 0;
+
+	printk(KERN_INFO "TuxOnIce: Page %ld is locked. Loading all of "
+			"pageset2 now.\n", failed);
+
+	memory_bm_position_reset(pageset2_lazy_map);
+	for (pfn = memory_bm_next_pfn(pageset2_lazy_map); pfn != failed;
+			pfn = memory_bm_next_pfn(pageset2_lazy_map)) {
+		struct page *page = pfn_to_page(pfn);
+
+		if (PageResave(page))
+			continue;
+
+		SetPageUptodate(page);
+		unlock_page(page);
+	}
+
+	return -EBUSY;
+}
+
+/**
+ * read_pageset2_lazy - read the hot part of pageset2 and defer the rest
+ *
+ * Used in place of read_pageset2(0) after the atomic restore when the
+ * image was written with lazy_pageset2 set. The hot pages are read as
+ * usual; the cold page cache pages are locked and left for
+ * toi_lazy_stream_pageset2 to read once userspace has been thawed. The
+ * allocator stays initialised for reading until then.
+ *
+ * Returns: Int
+ *	Zero if no error, otherwise the error value.
+ **/
+int read_pageset2_lazy(void)
+{
+	int result, barmax = pagedir1.size + pagedir2.size;
+
+	toi_lazy_restored = ktime_get();
+
+	toi_prepare_status(DONT_CLEAR_BAR, "Reading caches...");
+
+	if (rw_init_modules(0, 2)) {
+		toiActiveAllocator->remove_image();
+		return 1;
+	}
+
+	result = do_rw_loop(0, toi_lazy_hot_pages, pageset2_map,
+			pageset2_lazy_map, pagedir1.size, barmax, 2);
+
+	if (!result && !toi_lazy_lock_pages()) {
+		toi_lazy_base = pagedir1.size + toi_lazy_hot_pages;
+		toi_lazy_barmax = barmax;
+		atomic_set(&toi_lazy_waited, 0);
+		INIT_COMPLETION(toi_lazy_done);
+		toi_lazy_pending = 1;
+		toi_cond_pause(1, "Pagedir 2 hot pages read.");
+		return 0;
+	}
+
+	if (!result)
+		result = do_rw_loop(0, toi_lazy_pages, pageset2_lazy_map, NULL,
+				pagedir1.size + toi_lazy_hot_pages, barmax, 2);
+
+	if (rw_cleanup_modules(READ) && !result) {
+		abort_hibernate(TOI_FAILED_MODULE_CLEANUP,
+				"Failed to cleanup after reading.");
+		result = 1;
+	}
+
+	toi_lazy_pages = 0;
+
+	return result;
+}
+
+/**
+ * toi_lazy_drop_unread - give up on the cold pages that weren't read
+ *
+ * Called when streaming fails. Every page the streamer didn't fill in is
+ * still locked and !uptodate (and has no buffers; see
+ * toi_lazy_page_is_cold). Drop it from the page cache where possible and
+ * unlock it. A page still in the cache is reread by ->readpage, and
+ * whoever is waiting on it does the same.
+ *
+ * Returns: The number of pages dropped.
+ **/
+static int toi_lazy_drop_unread(void)
+{
+	unsigned long pfn;
+	int dropped = 0;
+
+	memory_bm_position_reset(pageset2_lazy_map);
+	for (pfn = memory_bm_next_pfn(pageset2_lazy_map); pfn != BM_END_OF_MAP;
+			pfn = memory_bm_next_pfn(pageset2_lazy_map)) {
+		struct page *page = pfn_to_page(pfn);
+
+		if (PageResave(page) || PageUptodate(page))
+			continue;
+
+		/* invalidate_inode_page expects the caller's reference */
+		get_page(page);
+		invalidate_inode_page(page);
+		unlock_page(page);
+		put_page(page);
+		dropped++;
+	}
+
+	return dropped;
+}
+
+static int toi_lazy_streamer(void *data)
+{
+	ktime_t thawed = ktime_get();
+	int result;
+
+	/* The I/O threads have been told to exit; this thread reads alone. */
+	wait_event(toi_other_threads_exited,
+			!atomic_read(&toi_num_other_threads));
+
+	io_lazy = 1;
+	result = do_rw_loop(0, toi_lazy_pages, pageset2_lazy_map, NULL,
+			toi_lazy_base, toi_lazy_barmax, 2);
+	io_lazy = 0;
+
+	if (rw_cleanup_modules(READ) && !result)
+		result = 1;
+
+	if (result)
+		printk(KERN_ERR "TuxOnIce: Streaming the page cache failed "
+				"(%d). Dropped %d pages to be reread.\n",
+				result, toi_lazy_drop_unread());
+
+	printk(KERN_INFO "TuxOnIce: Thawed %lld ms after the restore. "
+			"Streamed %d cache pages in %lld ms; %d were waited "
+			"for.\n",
+			ktime_to_ms(ktime_sub(thawed, toi_lazy_restored)),
+			toi_lazy_pages,
+			ktime_to_ms(ktime_sub(ktime_get(), thawed)),
+			atomic_read(&toi_lazy_waited));
+
+	toi_lazy_pages = 0;
+	complete(&toi_lazy_done);
+	return 0;
+}
+
+/**
+ * toi_lazy_stream_pageset2 - start reading the cold pageset2 pages
+ *
+ * Called once processes have been thawed. Returns 1 if a streamer was
+ * started, in which case toi_lazy_wait must be called before the image
+ * is removed or the storage deactivated.
+ **/
+int toi_lazy_stream_pageset2(void)
+{
+	struct task_struct *p;
+
+	if (!toi_lazy_pending)
+		return 0;
+
+	p = kthread_run(toi_lazy_streamer, NULL, "ktoi_lazy");
+	if (IS_ERR(p))
+		toi_lazy_streamer(NULL);
+
+	return 1;
+}
+
+void toi_lazy_wait(void)
+{
+	if (!toi_lazy_pending)
+		return;
+
+	wait_for_completion(&toi_lazy_done);
+	toi_lazy_pending = 0;
+}
+
 /**
  * image_exists_read - has an image been found?
  * @page:	Output buffer
@@ -48,6 +48,10 @@ extern int write_pageset(struct pagedir *pagedir);
 extern int write_image_header(void);
 extern int read_pageset1(void);
 extern int read_pageset2(int overwrittenpagesonly);
+extern int read_pageset2_lazy(void);
+extern int toi_lazy_stream_pageset2(void);
+extern void toi_lazy_wait(void);
+extern int toi_lazy_hot_pages, toi_lazy_pages;
 
 extern int toi_attempt_to_parse_resume_device(int quiet);
 extern void attempt_to_parse_resume_device2(void);
@@ -13,6 +13,7 @@ extern struct memory_bitmap *pageset1_map;
 extern struct memory_bitmap *pageset1_copy_map;
 extern struct memory_bitmap *pageset2_map;
 extern struct memory_bitmap *page_resave_map;
+extern struct memory_bitmap *pageset2_lazy_map;
 extern struct memory_bitmap *io_map;
 extern struct memory_bitmap *nosave_map;
 extern struct memory_bitmap *free_map;
@@ -52,6 +53,11 @@ extern struct memory_bitmap *free_map;
 #define ClearPageResave(page) \
 	(memory_bm_clear_bit(page_resave_map, page_to_pfn(page)))
 
+#define PageLazy(page) (pageset2_lazy_map ? \
+	memory_bm_test_bit(pageset2_lazy_map, page_to_pfn(page)) : 0)
+#define SetPageLazy(page) \
+	(memory_bm_set_bit(pageset2_lazy_map, page_to_pfn(page)))
+
 #define PageNosave(page) (nosave_map ? \
 		memory_bm_test_bit(nosave_map, page_to_pfn(page)) : 0)
 #define SetPageNosave(page) \
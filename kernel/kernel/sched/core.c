@@ -3937,7 +3937,7 @@ void set_user_nice(struct task_struct *p, long nice)
 {
 	set_user_nice_core(p, nice);
 	/* setting nice implies to set a normal sched policy */
-	update_prio_tracer(task_pid_nr(p), NICE_TO_PRIO(nice), 0, PTS_KRNL);
+	update_prio_tracer(p, NICE_TO_PRIO(nice), 0, PTS_KRNL);
 }
 #else /* !CONFIG_MT_PRIO_TRACER */
 void set_user_nice(struct task_struct *p, long nice)
@@ -4347,7 +4347,7 @@ int sched_setscheduler(struct task_struct *p, int policy,
 			prio = __normal_prio(p);
 		else
 			prio = MAX_RT_PRIO-1 - prio;
-		update_prio_tracer(task_pid_nr(p), prio, policy, PTS_KRNL);
+		update_prio_tracer(p, prio, policy, PTS_KRNL);
 	}
 	return retval;
 }
@@ -4391,7 +4391,7 @@ int sched_setscheduler_nocheck(struct task_struct *p, int policy,
 			prio = __normal_prio(p);
 		else
 			prio = MAX_RT_PRIO-1 - prio;
-		update_prio_tracer(task_pid_nr(p), prio, policy, PTS_KRNL);
+		update_prio_tracer(p, prio, policy, PTS_KRNL);
 	}
 	return retval;
 }
@@ -7773,6 +7773,20 @@ void sched_move_task(struct task_struct *tsk)
 
 	rq = task_rq_lock(tsk, &flags);
 
+	tg = container_of(task_subsys_state_check(tsk, cpu_cgroup_subsys_id,
+				lockdep_is_held(&tsk->sighand->siglock)),
+			  struct task_group, css);
+	tg = autogroup_task_group(tsk, tg);
+
+	/*
+	 * Nothing to move if the task group is unchanged, e.g. a root group
+	 * (or autogroup) task exiting: skip the dequeue/enqueue.
+	 */
+	if (tg == tsk->sched_task_group) {
+		task_rq_unlock(rq, tsk, &flags);
+		return;
+	}
+
 	running = task_current(rq, tsk);
 	on_rq = tsk->on_rq;
 
@@ -7781,10 +7795,6 @@ void sched_move_task(struct task_struct *tsk)
 	if (unlikely(running))
 		tsk->sched_class->put_prev_task(rq, tsk);
 
-	tg = container_of(task_subsys_state_check(tsk, cpu_cgroup_subsys_id,
-				lockdep_is_held(&tsk->sighand->siglock)),
-			  struct task_group, css);
-	tg = autogroup_task_group(tsk, tg);
 	tsk->sched_task_group = tg;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
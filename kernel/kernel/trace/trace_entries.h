@@ -331,6 +331,7 @@ FTRACE_ENTRY(mt65xx_mon, mt65xx_mon_entry,
             __field_struct(struct mt_mon_log, field)
             __field(    int, cpu)
             __field(    unsigned int, log)
+            __field(    int, emi)
             ),
         F_printk("mt65xx_mon_entry cpu=%d, log=%d",
             __entry->cpu, __entry->log),
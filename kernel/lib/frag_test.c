@@ -0,0 +1,138 @@
+/*
+ * High-order allocation benchmark.
+ *
+ * Fragments memory by allocating frag_mb worth of order-0 pages and freeing
+ * every other one, optionally gives kcompactd settle_ms to react, then
+ * tries nr_allocs allocations of the given order without retrying or
+ * entering reclaim loops.  Reports the success rate, the allocation
+ * latency and how much direct compaction the allocations had to do, so
+ * runs with different vm.compaction_proactiveness settings can be compared.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+
+static unsigned int order = 3;
+module_param(order, uint, 0444);
+MODULE_PARM_DESC(order, "Allocation order to test");
+
+static unsigned int nr_allocs = 1000;
+module_param(nr_allocs, uint, 0444);
+MODULE_PARM_DESC(nr_allocs, "Number of high-order allocations to attempt");
+
+static unsigned int frag_mb = 64;
+module_param(frag_mb, uint, 0444);
+MODULE_PARM_DESC(frag_mb, "Memory to fragment before testing, in MB");
+
+static unsigned int settle_ms;
+module_param(settle_ms, uint, 0444);
+MODULE_PARM_DESC(settle_ms, "Delay between fragmenting and testing");
+
+static struct page **frag_pages;
+static unsigned long nr_frag;
+static struct page **test_pages;
+
+static void fragment(void)
+{
+	unsigned long i;
+
+	for (nr_frag = 0; nr_frag < ((unsigned long)frag_mb << (20 - PAGE_SHIFT));
+	     nr_frag++) {
+		frag_pages[nr_frag] = alloc_page(GFP_KERNEL | __GFP_NORETRY |
+						 __GFP_NOWARN);
+		if (!frag_pages[nr_frag])
+			break;
+	}
+
+	/* Leave every other page allocated to pin the holes */
+	for (i = 0; i < nr_frag; i += 2) {
+		__free_page(frag_pages[i]);
+		frag_pages[i] = NULL;
+	}
+}
+
+static void unfragment(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_frag; i++)
+		if (frag_pages[i])
+			__free_page(frag_pages[i]);
+}
+
+static int __init frag_test_init(void)
+{
+	unsigned long *before, *after;
+	unsigned int i, ok = 0;
+	s64 delta, total = 0, max = 0;
+	int ret = -ENOMEM;
+
+	if (order >= MAX_ORDER || !nr_allocs)
+		return -EINVAL;
+
+	frag_pages = vzalloc(((unsigned long)frag_mb << (20 - PAGE_SHIFT)) *
+			     sizeof(*frag_pages));
+	test_pages = vzalloc(nr_allocs * sizeof(*test_pages));
+	before = kcalloc(2 * NR_VM_EVENT_ITEMS, sizeof(*before), GFP_KERNEL);
+	if (!frag_pages || !test_pages || !before)
+		goto out;
+	after = before + NR_VM_EVENT_ITEMS;
+
+	fragment();
+	if (settle_ms)
+		msleep(settle_ms);
+
+	all_vm_events(before);
+	for (i = 0; i < nr_allocs; i++) {
+		ktime_t start = ktime_get();
+
+		test_pages[i] = alloc_pages(GFP_KERNEL | __GFP_NORETRY |
+					    __GFP_NOWARN, order);
+		delta = ktime_us_delta(ktime_get(), start);
+		total += delta;
+		if (delta > max)
+			max = delta;
+		if (test_pages[i])
+			ok++;
+	}
+	all_vm_events(after);
+
+	pr_info("frag_test: order %u: %u/%u allocations succeeded "
+		"(%u%%), latency avg %lld us max %lld us\n",
+		order, ok, nr_allocs, ok * 100 / nr_allocs,
+		div_s64(total, nr_allocs), max);
+	pr_info("frag_test: fragmented %lu pages, compact_stall %lu "
+		"compact_success %lu compact_stall_time_us %lu "
+		"compact_daemon_wake %lu\n", nr_frag,
+		after[COMPACTSTALL] - before[COMPACTSTALL],
+		after[COMPACTSUCCESS] - before[COMPACTSUCCESS],
+		after[COMPACTSTALL_TIME] - before[COMPACTSTALL_TIME],
+		after[KCOMPACTD_WAKE] - before[KCOMPACTD_WAKE]);
+
+	for (i = 0; i < nr_allocs; i++)
+		if (test_pages[i])
+			__free_pages(test_pages[i], order);
+	unfragment();
+	ret = -EAGAIN; /* Fail will directly unload the module */
+out:
+	kfree(before);
+	vfree(test_pages);
+	vfree(frag_pages);
+	return ret;
+}
+
+static void __exit frag_test_exit(void)
+{
+}
+
+module_init(frag_test_init)
+module_exit(frag_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("High-order allocation success rate under fragmentation");
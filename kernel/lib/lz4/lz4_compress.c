@@ -0,0 +1,108 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * A greedy single-probe LZ4 block compressor: one hash table of recent
+ * positions, no chains. It trades some ratio for speed close to memcpy.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+#define LZ4_HASHLOG	12
+#define LZ4_HASH_SIZE	(1 << LZ4_HASHLOG)
+
+/* Start skipping ahead after this many misses in a row (log2) */
+#define LZ4_SKIPTRIGGER	6
+
+static inline u32 lz4_hash(u32 seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASHLOG);
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const u8 *ip = src, *anchor = src;
+	const u8 *const iend = src + src_len;
+	const u8 *const mflimit = iend - MFLIMIT;
+	const u8 *const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst, *const oend = dst + *dst_len;
+	u32 *table = wrkmem;
+
+	BUILD_BUG_ON(LZ4_HASH_SIZE * sizeof(u32) > LZ4_MEM_COMPRESS);
+
+	/* Positions are u32 offsets from src, so src_len must fit */
+	if (src_len > 0x7e000000)
+		return -1;
+
+	/* Stale entries would only cost ratio, but keep output deterministic */
+	memset(table, 0, LZ4_HASH_SIZE * sizeof(u32));
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	table[lz4_hash(lz4_read32(ip))] = 0;
+	ip++;
+
+	while (ip < mflimit) {
+		unsigned int attempts = 1 << LZ4_SKIPTRIGGER;
+		const u8 *ref;
+		size_t len;
+		u32 h;
+
+		/* Find a match, skipping faster the longer we find none */
+		for (;;) {
+			unsigned int step = attempts++ >> LZ4_SKIPTRIGGER;
+
+			h = lz4_hash(lz4_read32(ip));
+			ref = src + table[h];
+			table[h] = ip - src;
+			if (ip - ref <= MAX_DISTANCE && ref < ip &&
+			    lz4_read32(ref) == lz4_read32(ip))
+				break;
+			ip += step;
+			if (ip >= mflimit)
+				goto last_literals;
+		}
+
+		/* Extend backwards over literals that also match */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		len = MINMATCH + lz4_count(ip + MINMATCH, ref + MINMATCH,
+					   matchlimit);
+		op = lz4_put_sequence(op, oend, anchor, ip, ref, len);
+		if (!op)
+			return -1;
+
+		ip += len;
+		anchor = ip;
+		if (ip >= mflimit)
+			break;
+
+		/* Remember the position just before the next search */
+		table[lz4_hash(lz4_read32(ip - 2))] = ip - 2 - src;
+	}
+
+last_literals:
+	op = lz4_put_last_literals(op, oend, anchor, iend);
+	if (!op)
+		return -1;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
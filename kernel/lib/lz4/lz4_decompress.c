@@ -0,0 +1,127 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * Decodes blocks written by lz4_compress() and lz4hc_compress(). Every
+ * length and offset is checked against both buffers, so corrupt input
+ * makes it fail rather than read or write out of bounds.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+/* Read a length continuation; returns -1 if it runs off the input */
+static inline int lz4_get_length(const u8 **ip, const u8 *iend, size_t *len)
+{
+	u8 b;
+
+	do {
+		if (*ip >= iend)
+			return -1;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+/*
+ * Decode src into dst. On success returns 0 with *src_len set to the bytes
+ * of input consumed and *dst_len to the bytes produced. If exact is set
+ * the output must fill dst exactly.
+ */
+static int lz4_uncompress(const u8 *src, size_t *src_len, u8 *dst,
+		size_t *dst_len, bool exact)
+{
+	const u8 *ip = src, *const iend = src + *src_len;
+	u8 *op = dst, *const oend = dst + *dst_len;
+
+	for (;;) {
+		const u8 *ref;
+		size_t len, offset;
+		u8 token;
+
+		if (ip >= iend)
+			return -1;
+		token = *ip++;
+
+		/* literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_get_length(&ip, iend, &len))
+			return -1;
+		if (len > (size_t) (iend - ip) || len > (size_t) (oend - op))
+			return -1;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (!offset || offset > (size_t) (op - dst))
+			return -1;
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_get_length(&ip, iend, &len))
+			return -1;
+		len += MINMATCH;
+		if (len > (size_t) (oend - op))
+			return -1;
+
+		/* Offsets under 8 overlap an 8 byte copy; repeat those bytewise */
+		if (offset >= 8) {
+			u8 *cpy = op + len;
+
+			while (op + 8 <= cpy) {
+				put_unaligned(get_unaligned((const u64 *) ref),
+					      (u64 *) op);
+				op += 8;
+				ref += 8;
+			}
+			while (op < cpy)
+				*op++ = *ref++;
+		} else {
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	if (exact && op != oend)
+		return -1;
+
+	*src_len = ip - src;
+	*dst_len = op - dst;
+	return 0;
+}
+
+int lz4_decompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t actual_dest_len)
+{
+	size_t dst_len = actual_dest_len;
+
+	return lz4_uncompress(src, src_len, dest, &dst_len, true);
+}
+EXPORT_SYMBOL(lz4_decompress);
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	return lz4_uncompress(src, &src_len, dest, dest_len, false);
+}
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
@@ -0,0 +1,118 @@
+/*
+ * lz4defs.h -- definitions shared by the LZ4 compressors and decompressor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * A sequence is a token, literal length bytes, the literals, a 16 bit
+ * little endian offset and match length bytes. The token holds the
+ * literal length in its top four bits and the match length less MINMATCH
+ * in the bottom four; either nibble at its maximum is continued by bytes
+ * of 255 and a final byte below 255. The block ends with a sequence of
+ * literals only.
+ */
+#define MINMATCH	4
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	65535
+
+/* The last match must start at least MFLIMIT bytes before the end ... */
+#define MFLIMIT		12
+/* ... and the last LASTLITERALS bytes are always literals. */
+#define LASTLITERALS	5
+
+/* Worst case number of bytes needed to encode a run length */
+#define LZ4_LEN_BYTES(l)	((l) / 255 + 1)
+
+static inline u32 lz4_read32(const u8 *p)
+{
+	return get_unaligned((const u32 *) p);
+}
+
+/* Emit a length continuation (the part beyond the token's nibble) */
+static inline u8 *lz4_put_length(u8 *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (u8) len;
+	return op;
+}
+
+/* Count how many bytes match at ip and ref, up to limit */
+static inline size_t lz4_count(const u8 *ip, const u8 *ref, const u8 *limit)
+{
+	const u8 *start = ip;
+
+	while (ip + 4 <= limit && lz4_read32(ip) == lz4_read32(ref)) {
+		ip += 4;
+		ref += 4;
+	}
+	while (ip < limit && *ip == *ref) {
+		ip++;
+		ref++;
+	}
+
+	return ip - start;
+}
+
+/*
+ * Emit one sequence: the literals from anchor to ip, then a match of
+ * match_len bytes at offset ip - ref. Returns the new output position, or
+ * NULL if it (plus the final literals) won't fit before oend.
+ */
+static inline u8 *lz4_put_sequence(u8 *op, u8 *oend, const u8 *anchor,
+		const u8 *ip, const u8 *ref, size_t match_len)
+{
+	size_t lit_len = ip - anchor, ml = match_len - MINMATCH;
+	u8 *token = op++;
+
+	if (lit_len + LZ4_LEN_BYTES(lit_len) + 2 + LZ4_LEN_BYTES(ml) +
+	    1 + LASTLITERALS > (size_t) (oend - op))
+		return NULL;
+
+	if (lit_len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, lit_len - RUN_MASK);
+	} else
+		*token = lit_len << ML_BITS;
+
+	memcpy(op, anchor, lit_len);
+	op += lit_len;
+
+	put_unaligned_le16((u16) (ip - ref), op);
+	op += 2;
+
+	if (ml >= ML_MASK) {
+		*token |= ML_MASK;
+		op = lz4_put_length(op, ml - ML_MASK);
+	} else
+		*token |= ml;
+
+	return op;
+}
+
+/* Emit the final literal-only sequence */
+static inline u8 *lz4_put_last_literals(u8 *op, u8 *oend, const u8 *anchor,
+		const u8 *iend)
+{
+	size_t lit_len = iend - anchor;
+
+	if (1 + LZ4_LEN_BYTES(lit_len) + lit_len > (size_t) (oend - op))
+		return NULL;
+
+	if (lit_len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, lit_len - RUN_MASK);
+	} else
+		*op++ = lit_len << ML_BITS;
+
+	memcpy(op, anchor, lit_len);
+	return op + lit_len;
+}
@@ -0,0 +1,161 @@
+/*
+ * LZ4 HC - High Compression Mode of LZ4
+ *
+ * Same block format as lz4_compress(), but every position is chained into
+ * a hash table so the longest match within the window can be found, with
+ * one step of lazy evaluation before committing to it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+#define LZ4HC_MAX_HASHLOG	14
+#define LZ4HC_CHAIN_SIZE	65536
+#define LZ4HC_CHAIN_MASK	(LZ4HC_CHAIN_SIZE - 1)
+#define LZ4HC_MAX_ATTEMPTS	256
+
+struct lz4hc_state {
+	const u8 *base;
+	unsigned int hashlog;
+	u32 next;			/* first position not yet inserted */
+	u16 chain[LZ4HC_CHAIN_SIZE];	/* delta back to the previous candidate */
+	u32 table[1 << LZ4HC_MAX_HASHLOG];
+};
+
+static inline u32 lz4hc_hash(const struct lz4hc_state *s, const u8 *p)
+{
+	return (lz4_read32(p) * 2654435761U) >> (32 - s->hashlog);
+}
+
+/* Chain every position up to (not including) ip into its bucket */
+static inline void lz4hc_insert(struct lz4hc_state *s, const u8 *ip)
+{
+	u32 target = ip - s->base;
+
+	while (s->next < target) {
+		u32 pos = s->next++;
+		u32 h = lz4hc_hash(s, s->base + pos);
+		u32 delta = pos - s->table[h];
+
+		/* table[] holds pos + 1 so that 0 means empty */
+		if (!s->table[h] || delta > MAX_DISTANCE)
+			delta = 0;
+		s->chain[pos & LZ4HC_CHAIN_MASK] = delta;
+		s->table[h] = pos + 1;
+	}
+}
+
+static size_t lz4hc_find_longest(struct lz4hc_state *s, const u8 *ip,
+		const u8 *matchlimit, const u8 **match)
+{
+	u32 pos = ip - s->base, cand;
+	unsigned int attempts = LZ4HC_MAX_ATTEMPTS;
+	size_t best = 0;
+
+	lz4hc_insert(s, ip);
+
+	cand = s->table[lz4hc_hash(s, ip)];
+	if (!cand--)
+		return 0;
+
+	while (attempts-- && pos - cand <= MAX_DISTANCE) {
+		const u8 *ref = s->base + cand;
+		u16 delta;
+
+		/* Only a candidate that also matches at ip[best] can beat best */
+		if (ref[best] == ip[best] && lz4_read32(ref) == lz4_read32(ip)) {
+			size_t len = MINMATCH + lz4_count(ip + MINMATCH,
+						ref + MINMATCH, matchlimit);
+
+			if (len > best) {
+				best = len;
+				*match = ref;
+			}
+		}
+
+		delta = s->chain[cand & LZ4HC_CHAIN_MASK];
+		if (!delta || delta > cand)
+			break;
+		cand -= delta;
+	}
+
+	return best;
+}
+
+int lz4hc_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	struct lz4hc_state *s = wrkmem;
+	const u8 *ip = src, *anchor = src;
+	const u8 *const iend = src + src_len;
+	const u8 *const mflimit = iend - MFLIMIT;
+	const u8 *const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst, *const oend = dst + *dst_len;
+
+	BUILD_BUG_ON(sizeof(struct lz4hc_state) > LZ4HC_MEM_COMPRESS);
+
+	if (src_len > 0x7e000000)
+		return -1;
+
+	/*
+	 * Size the hash table to the input: a page needs far fewer buckets
+	 * than the 16K used for large buffers, and clearing them dominates
+	 * for small inputs. chain[] is always written before it is read.
+	 */
+	s->base = src;
+	s->next = 0;
+	s->hashlog = min_t(unsigned int, LZ4HC_MAX_HASHLOG,
+			   max_t(unsigned int, 8, fls(src_len)));
+	memset(s->table, 0, sizeof(u32) << s->hashlog);
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	while (ip < mflimit) {
+		const u8 *ref = NULL, *ref2 = NULL;
+		size_t len, len2;
+
+		len = lz4hc_find_longest(s, ip, matchlimit, &ref);
+		if (!len) {
+			ip++;
+			continue;
+		}
+
+		/* Lazy evaluation: prefer a longer match starting one later */
+		while (ip + 1 < mflimit) {
+			len2 = lz4hc_find_longest(s, ip + 1, matchlimit, &ref2);
+			if (len2 <= len)
+				break;
+			ip++;
+			ref = ref2;
+			len = len2;
+		}
+
+		op = lz4_put_sequence(op, oend, anchor, ip, ref, len);
+		if (!op)
+			return -1;
+
+		ip += len;
+		anchor = ip;
+	}
+
+last_literals:
+	op = lz4_put_last_literals(op, oend, anchor, iend);
+	if (!op)
+		return -1;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4hc_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4HC compressor");
@@ -16,6 +16,10 @@
 #include <linux/sysfs.h>
 #include <linux/balloon_compaction.h>
 #include <linux/page-isolation.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpu.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -833,6 +837,47 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+/*
+ * Proactive compaction keeps the share of free memory that sits in blocks
+ * too small for a COMPACTION_TARGET_ORDER allocation under a target, so
+ * that order-2/3 allocations (kernel stacks, skbs, ion) rarely have to
+ * stall in direct compaction.  vm.compaction_proactiveness picks the
+ * target: kcompactd starts compacting a node once more than
+ * (100 - proactiveness) + 10 percent of its free memory is fragmented and
+ * stops below (100 - proactiveness).  0 disables it.
+ */
+int sysctl_compaction_proactiveness = 20;
+
+#define COMPACTION_TARGET_ORDER		PAGE_ALLOC_COSTLY_ORDER
+#define COMPACTION_HPAGE_WMARK_GAP	10
+
+static unsigned int fragmentation_wmark(bool low)
+{
+	unsigned int wmark_low = 100U - sysctl_compaction_proactiveness;
+
+	return low ? wmark_low :
+		min(wmark_low + COMPACTION_HPAGE_WMARK_GAP, 100U);
+}
+
+/* Percentage of free memory in @zone that is in blocks below @order */
+static unsigned int zone_extfrag(struct zone *zone, unsigned int order)
+{
+	unsigned long free = 0, suitable = 0, blocks;
+	unsigned int o;
+
+	for (o = 0; o < MAX_ORDER; o++) {
+		blocks = zone->free_area[o].nr_free;
+		free += blocks << o;
+		if (o >= order)
+			suitable += blocks << o;
+	}
+
+	if (!free)
+		return 0;
+
+	return div64_u64((u64)(free - suitable) * 100, free);
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -858,10 +903,16 @@ static int compact_finished(struct zone *zone,
 
 	/*
 	 * order == -1 is expected when compacting via
-	 * /proc/sys/vm/compact_memory
+	 * /proc/sys/vm/compact_memory, and for proactive compaction which
+	 * only runs until the zone is below the fragmentation target.
 	 */
-	if (cc->order == -1)
+	if (cc->order == -1) {
+		if (cc->proactive &&
+		    zone_extfrag(zone, COMPACTION_TARGET_ORDER) <=
+		    fragmentation_wmark(true))
+			return COMPACT_PARTIAL;
 		return COMPACT_CONTINUE;
+	}
 
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
@@ -1075,12 +1126,14 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	struct zone *zone;
 	int rc = COMPACT_SKIPPED;
 	int alloc_flags = 0;
+	ktime_t start;
 
 	/* Check if the GFP flags allow compaction */
 	if (!order || !may_enter_fs || !may_perform_io)
 		return rc;
 
 	count_compact_event(COMPACTSTALL);
+	start = ktime_get();
 
 #ifdef CONFIG_CMA
 	if (allocflags_to_migratetype(gfp_mask) == MIGRATE_MOVABLE)
@@ -1101,6 +1154,8 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			break;
 	}
 
+	count_compact_events(COMPACTSTALL_TIME,
+			     ktime_us_delta(ktime_get(), start));
 	return rc;
 }
 
@@ -1194,6 +1249,23 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+int sysctl_compaction_proactiveness_handler(struct ctl_table *table,
+			int write, void __user *buffer, size_t *length,
+			loff_t *ppos)
+{
+	int ret, nid;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	/* kcompactd sleeps without a timeout while this is 0 */
+	for_each_node_state(nid, N_MEMORY)
+		wake_up_interruptible(&NODE_DATA(nid)->kcompactd_wait);
+
+	return 0;
+}
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -1223,6 +1295,324 @@ void compaction_unregister_node(struct node *node)
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
+#define KCOMPACTD_PROACTIVE_INTERVAL	(HZ / 2)
+/* intervals to back off for when proactive compaction made no progress */
+#define KCOMPACTD_PROACTIVE_MAX_DEFER	32
+
+static inline bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat)
+{
+	int zoneid;
+	struct zone *zone;
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_suitable(zone, pgdat->kcompactd_max_order) ==
+					COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_compact_zone(struct zone *zone,
+				   struct compact_control *cc)
+{
+	cc->nr_freepages = 0;
+	cc->nr_migratepages = 0;
+	cc->zone = zone;
+	INIT_LIST_HEAD(&cc->freepages);
+	INIT_LIST_HEAD(&cc->migratepages);
+
+	compact_zone(zone, cc);
+
+	VM_BUG_ON(!list_empty(&cc->freepages));
+	VM_BUG_ON(!list_empty(&cc->migratepages));
+}
+
+/*
+ * Compact the zones a failed, or failing, allocation of kcompactd_max_order
+ * could have come from, the way kswapd used to do inline before going to
+ * sleep.
+ */
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid;
+	struct zone *zone;
+	struct compact_control cc = {
+		.order = pgdat->kcompactd_max_order,
+		.sync = false,
+	};
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone, cc.order))
+			continue;
+
+		if (compaction_suitable(zone, cc.order) != COMPACT_CONTINUE)
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		kcompactd_compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, cc.order, low_wmark_pages(zone),
+				      0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			if (cc.order >= zone->compact_order_failed)
+				zone->compact_order_failed = cc.order + 1;
+		}
+		/*
+		 * An async pass failing says little about what sync direct
+		 * compaction could do, so it does not defer compaction.
+		 */
+	}
+
+	/*
+	 * Regardless of success, we are done until woken up next. But remember
+	 * the requested order/classzone_idx in case it was higher/tighter than
+	 * our current ones
+	 */
+	if (pgdat->kcompactd_max_order <= cc.order)
+		pgdat->kcompactd_max_order = 0;
+	if (pgdat->kcompactd_classzone_idx >= classzone_idx)
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+}
+
+static unsigned int node_extfrag_score(pg_data_t *pgdat)
+{
+	unsigned long score = 0, pages = 0;
+	struct zone *zone;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		score += zone_extfrag(zone, COMPACTION_TARGET_ORDER) *
+			 zone->present_pages;
+		pages += zone->present_pages;
+	}
+
+	return pages ? score / pages : 0;
+}
+
+static bool kcompactd_proactive(pg_data_t *pgdat)
+{
+	if (!sysctl_compaction_proactiveness)
+		return false;
+
+	return node_extfrag_score(pgdat) > fragmentation_wmark(false);
+}
+
+static void kcompactd_proactive_work(pg_data_t *pgdat)
+{
+	struct compact_control cc = {
+		.order = -1,
+		.sync = false,
+		.proactive = true,
+	};
+	struct zone *zone;
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_PROACTIVE);
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		if (zone_extfrag(zone, COMPACTION_TARGET_ORDER) <=
+		    fragmentation_wmark(true))
+			continue;
+
+		kcompactd_compact_zone(zone, &cc);
+	}
+}
+
+/*
+ * The background compaction daemon, started as a kernel thread
+ * from the init process.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int proactive_defer = 0;
+	unsigned int prev_score;
+	long timeout;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+	while (!kthread_should_stop()) {
+		timeout = sysctl_compaction_proactiveness ?
+			KCOMPACTD_PROACTIVE_INTERVAL : MAX_SCHEDULE_TIMEOUT;
+
+		/*
+		 * A sleep without timeout is also ended by proactive
+		 * compaction being switched on, so the interval starts
+		 * applying right away.
+		 */
+		if (wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat) ||
+				(timeout == MAX_SCHEDULE_TIMEOUT &&
+				 sysctl_compaction_proactiveness),
+				timeout) > 0) {
+			if (pgdat->kcompactd_max_order > 0)
+				kcompactd_do_work(pgdat);
+			continue;
+		}
+
+		/* Timed out: see whether the node drifted past the target */
+		if (proactive_defer) {
+			proactive_defer--;
+			continue;
+		}
+
+		if (!kcompactd_proactive(pgdat))
+			continue;
+
+		prev_score = node_extfrag_score(pgdat);
+		kcompactd_proactive_work(pgdat);
+		if (node_extfrag_score(pgdat) >= prev_score)
+			proactive_defer = KCOMPACTD_PROACTIVE_MAX_DEFER;
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - ask kcompactd to make @order pages available
+ * @pgdat: node to compact
+ * @order: order of the allocation that failed or is about to
+ * @classzone_idx: highest zone the allocation may use
+ *
+ * Called by kswapd once it has reclaimed enough for compaction to have a
+ * chance, and from the allocator when a high-order allocation fails.
+ * Safe to call from atomic context.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ * On node-hot-add, kcompactd will moved to proper cpus if cpus are hot-added.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined. Caller must
+ * hold lock_memory_hotplug().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+/*
+ * It's optimal to keep kcompactd on the same CPUs as their memory, but
+ * not required for correctness. So if the last cpu in a node goes
+ * away, we get changed to run anywhere: as the first one comes back,
+ * restore their cpu bindings.
+ */
+static int __cpuinit kcompactd_cpu_callback(struct notifier_block *nfb,
+					    unsigned long action, void *hcpu)
+{
+	int nid;
+
+	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		for_each_node_state(nid, N_MEMORY) {
+			pg_data_t *pgdat = NODE_DATA(nid);
+			const struct cpumask *mask;
+
+			if (!pgdat->kcompactd)
+				continue;
+
+			mask = cpumask_of_node(pgdat->node_id);
+
+			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+				/* One of our CPUs online: restore mask */
+				set_cpus_allowed_ptr(pgdat->kcompactd, mask);
+		}
+	}
+	return NOTIFY_OK;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY)
+		kcompactd_run(nid);
+	hotcpu_notifier(kcompactd_cpu_callback, 0);
+	return 0;
+}
+subsys_initcall(kcompactd_init)
+
 #endif /* CONFIG_COMPACTION */
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -135,6 +135,9 @@ struct compact_control {
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
 	bool contended;			/* True if a lock was contended */
+	bool proactive;			/* kcompactd working towards
+					 * the fragmentation target
+					 */
 };
 
 unsigned long
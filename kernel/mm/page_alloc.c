@@ -2692,6 +2692,10 @@ rebalance:
 	}
 
 nopage:
+	/* Have kcompactd make the next attempt at this order cheaper */
+	if (order)
+		wakeup_kcompactd(preferred_zone->zone_pgdat, order,
+				 zone_idx(preferred_zone));
 	warn_alloc_failed(gfp_mask, order, NULL);
 	return page;
 got_pg:
@@ -4895,6 +4899,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->numabalancing_migrate_next_window = jiffies;
 #endif
 	init_waitqueue_head(&pgdat->kswapd_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	init_waitqueue_head(&pgdat->pfmemalloc_wait);
 	pgdat_page_cgroup_init(pgdat);
 
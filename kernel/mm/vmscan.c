@@ -715,6 +715,11 @@ static enum page_references page_check_references(struct page *page,
 
 /*
  * shrink_page_list() returns the number of reclaimed pages
+ *
+ * @zone may be NULL if the pages on @page_list come from several zones,
+ * in which case no zone is tagged congested.  With @force_reclaim the
+ * referenced checks are skipped and dirty pages are written out as if
+ * they had not been referenced.
  */
 static unsigned long shrink_page_list(struct list_head *page_list,
 				      struct zone *zone,
@@ -739,7 +744,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		struct address_space *mapping;
 		struct page *page;
 		int may_enter_fs;
-		enum page_references references = PAGEREF_RECLAIM_CLEAN;
+		enum page_references references = PAGEREF_RECLAIM;
 
 		cond_resched();
 
@@ -750,7 +755,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			goto keep;
 
 		VM_BUG_ON(PageActive(page));
-		VM_BUG_ON(page_zone(page) != zone);
+		VM_BUG_ON(zone && page_zone(page) != zone);
 
 		sc->nr_scanned++;
 
@@ -996,7 +1001,7 @@ keep:
 	 * back off and wait for congestion to clear because further reclaim
 	 * will encounter the same problem
 	 */
-	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc))
+	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc) && zone)
 		zone_set_flag(zone, ZONE_CONGESTED);
 
 	free_hot_cold_page_list(&free_pages, 1);
@@ -1037,6 +1042,45 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/**
+ * reclaim_pages_from_list - reclaim a list of isolated pages
+ * @page_list: pages isolated with isolate_lru_page(), from any zone
+ *
+ * Used by /proc/<pid>/reclaim to page out one process's memory without
+ * waiting for global memory pressure.  Pages that could not be reclaimed
+ * are put back on their LRU.  Returns the number of pages freed.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	unsigned long nr_reclaimed, dummy1, dummy2;
+	struct page *page;
+
+	list_for_each_entry(page, page_list, lru)
+		ClearPageActive(page);
+
+	nr_reclaimed = shrink_page_list(page_list, NULL, &sc,
+					TTU_UNMAP|TTU_IGNORE_ACCESS,
+					&dummy1, &dummy2, true);
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+
+	count_vm_events(PGRECLAIM_PROC, nr_reclaimed);
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -2947,8 +2991,12 @@ out:
 				zones_need_compaction = 0;
 		}
 
+		/*
+		 * Leave the compaction itself to kcompactd rather than stall
+		 * kswapd, which still has other nodes' reclaim to do.
+		 */
 		if (zones_need_compaction)
-			compact_pgdat(pgdat, order);
+			wakeup_kcompactd(pgdat, order, *classzone_idx);
 	}
 
 	/*
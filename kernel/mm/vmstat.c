@@ -780,6 +780,10 @@ const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+#ifdef CONFIG_PROCESS_RECLAIM
+	"pgreclaim_proc",
+	"pgskip_proc",
+#endif
 
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
@@ -799,6 +803,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_stall_time_us",
+	"compact_daemon_wake",
+	"compact_daemon_proactive",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -20,6 +20,7 @@
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
 #include <linux/ratelimit.h>
+#include <linux/rculist.h>
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
@@ -124,14 +125,19 @@ static const char *iface_stat_fmt_procfilename = "iface_stat_fmt";
 static struct proc_dir_entry *iface_stat_fmt_procfile;
 
 
+/*
+ * iface_stat entries are never freed, so the packet path walks the list
+ * under rcu_read_lock_bh() only. Additions and state changes still go
+ * through iface_stat_list_lock.
+ */
 static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
 static struct rb_root sock_tag_tree = RB_ROOT;
-static DEFINE_SPINLOCK(sock_tag_list_lock);
+static DEFINE_RWLOCK(sock_tag_list_lock);
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
-static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+static DEFINE_RWLOCK(tag_counter_set_list_lock);
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -626,11 +632,11 @@ static int get_active_counter_set(tag_t tag)
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
+	read_lock_bh(&tag_counter_set_list_lock);
 	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (tcs)
 		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	read_unlock_bh(&tag_counter_set_list_lock);
 	return active_set;
 }
 
@@ -658,6 +664,32 @@ done:
 	return iface_entry;
 }
 
+/*
+ * Find the entry for tracking the specified device from the packet path.
+ * Active entries are matched on ifindex, which avoids a strcmp() per entry;
+ * a device that is not tracked as active falls back to the name.
+ * Caller must be within rcu_read_lock_bh().
+ */
+static struct iface_stat *get_iface_entry_rcu(const struct net_device *net_dev)
+{
+	struct iface_stat *iface_entry;
+
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
+		if (ACCESS_ONCE(iface_entry->ifindex) == net_dev->ifindex)
+			return iface_entry;
+	}
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
+		if (!strcmp(net_dev->name, iface_entry->ifname))
+			return iface_entry;
+	}
+	return NULL;
+}
+
+static struct data_counters_slab *dc_slab_alloc(gfp_t gfp)
+{
+	return kcalloc(nr_cpu_ids, sizeof(struct data_counters_slab), gfp);
+}
+
 /* This is for fmt2 only */
 static void pp_iface_stat_header(struct seq_file *m)
 {
@@ -677,9 +709,10 @@ static void pp_iface_stat_header(struct seq_file *m)
 static void pp_iface_stat_line(struct seq_file *m,
 			       struct iface_stat *iface_entry)
 {
-	struct data_counters *cnts;
+	struct data_counters folded;
+	struct data_counters *cnts = &folded;
 	int cnt_set = 0;   /* We only use one set for the device */
-	cnts = &iface_entry->totals_via_skb;
+	dc_slab_fold(cnts, iface_entry->totals_via_skb);
 	seq_printf(m, "%s %llu %llu %llu %llu %llu %llu %llu %llu "
 		   "%llu %llu %llu %llu %llu %llu %llu %llu\n",
 		   iface_entry->ifname,
@@ -832,6 +865,7 @@ static void _iface_stat_set_active(struct iface_stat *entry,
 {
 	if (activate) {
 		entry->net_dev = net_dev;
+		entry->ifindex = net_dev->ifindex;
 		entry->active = true;
 		IF_DEBUG("qtaguid: %s(%s): "
 			 "enable tracking. rfcnt=%d\n", __func__,
@@ -839,6 +873,7 @@ static void _iface_stat_set_active(struct iface_stat *entry,
 			 __this_cpu_read(*net_dev->pcpu_refcnt));
 	} else {
 		entry->active = false;
+		entry->ifindex = 0;
 		entry->net_dev = NULL;
 		IF_DEBUG("qtaguid: %s(%s): "
 			 "disable tracking. rfcnt=%d\n", __func__,
@@ -867,7 +902,15 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
-	spin_lock_init(&new_iface->tag_stat_list_lock);
+	new_iface->totals_via_skb = dc_slab_alloc(GFP_ATOMIC);
+	if (new_iface->totals_via_skb == NULL) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "counters alloc failed\n", net_dev->name);
+		kfree(new_iface->ifname);
+		kfree(new_iface);
+		return NULL;
+	}
+	rwlock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
 	_iface_stat_set_active(new_iface, net_dev, true);
 
@@ -880,6 +923,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		kfree(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -887,7 +931,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1074,9 +1118,9 @@ static struct sock_tag *get_sock_stat(const struct sock *sk)
 	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
 	if (!sk)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
+	read_lock_bh(&sock_tag_list_lock);
 	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
+	read_unlock_bh(&sock_tag_list_lock);
 	return sock_tag_entry;
 }
 
@@ -1101,10 +1145,15 @@ static int ipx_proto(const struct sk_buff *skb,
 	return tproto;
 }
 
+/* Caller must have BHs disabled: only this CPU's slab is touched. */
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct data_counters_slab *slab, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_slab *dcs = &slab[smp_processor_id()];
+	struct data_counters *dc = &dcs->dc;
+
+	u64_stats_update_begin(&dcs->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1118,6 +1167,7 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&dcs->syncp);
 }
 
 /*
@@ -1219,21 +1269,21 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
-	entry = get_iface_entry(el_dev->name);
+	rcu_read_lock_bh();
+	entry = get_iface_entry_rcu(el_dev);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock_bh();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
+	data_counters_update(entry->totals_via_skb, 0, direction, proto,
 			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	rcu_read_unlock_bh();
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
@@ -1245,7 +1295,7 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(tag_entry->counters, active_set, direction,
 			     proto, bytes);
 	if (tag_entry->parent_counters)
 		data_counters_update(tag_entry->parent_counters, active_set,
@@ -1255,7 +1305,7 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 /*
  * Create a new entry for tracking the specified {acct_tag,uid_tag} within
  * the interface.
- * iface_entry->tag_stat_list_lock should be held.
+ * iface_entry->tag_stat_list_lock should be write held.
  */
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 					   tag_t tag)
@@ -1269,38 +1319,45 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->counters = dc_slab_alloc(GFP_ATOMIC);
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
+static void if_tag_stat_update(const struct net_device *net_dev, uid_t uid,
 			       const struct sock *sk, enum ifs_tx_rx direction,
 			       int proto, int bytes)
 {
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct data_counters_slab *uid_tag_counters;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
-		 ifname, uid, sk, direction, proto, bytes);
-
+		 net_dev->name, uid, sk, direction, proto, bytes);
 
-	iface_entry = get_iface_entry(ifname);
+	rcu_read_lock_bh();
+	iface_entry = get_iface_entry_rcu(net_dev);
 	if (!iface_entry) {
 		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
-				   "%s not found\n", ifname);
-		return;
+				   "%s not found\n", net_dev->name);
+		goto out;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
-		 ifname, iface_entry);
+		 net_dev->name, iface_entry);
 
 	/*
 	 * Look for a tagged sock.
@@ -1319,9 +1376,11 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
-
+	/*
+	 * Fast path: the {acct_tag,uid_tag} entry already exists.
+	 * Counters are per-CPU, so the tree only needs to be read locked.
+	 */
+	read_lock_bh(&iface_entry->tag_stat_list_lock);
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
 	if (tag_stat_entry) {
@@ -1330,8 +1389,18 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * {0, uid_tag} will also get updated.
 		 */
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		read_unlock_bh(&iface_entry->tag_stat_list_lock);
+		goto out;
+	}
+	read_unlock_bh(&iface_entry->tag_stat_list_lock);
+
+	write_lock_bh(&iface_entry->tag_stat_list_lock);
+	/* Somebody else might have added it while the lock was dropped. */
+	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					      tag);
+	if (tag_stat_entry) {
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		goto unlock;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1346,9 +1415,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
 			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
@@ -1370,7 +1439,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	}
 	tag_stat_update(new_tag_stat, direction, proto, bytes);
 unlock:
-	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	write_unlock_bh(&iface_entry->tag_stat_list_lock);
+out:
+	rcu_read_unlock_bh();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1643,7 +1714,7 @@ static void account_for_uid(const struct sk_buff *skb,
 			 par->hooknum, el_dev->name, el_dev->type,
 			 par->family, proto);
 
-		if_tag_stat_update(el_dev->name, uid,
+		if_tag_stat_update(el_dev, uid,
 				skb->sk ? skb->sk : alternate_sk,
 				par->in ? IFS_RX : IFS_TX,
 				proto, skb->len);
@@ -1824,16 +1895,16 @@ static void prdebug_full_state(int indent_level, const char *fmt, ...)
 	kfree(buff);
 	va_end(args);
 
-	spin_lock_bh(&sock_tag_list_lock);
+	read_lock_bh(&sock_tag_list_lock);
 	prdebug_sock_tag_tree(indent_level, &sock_tag_tree);
-	spin_unlock_bh(&sock_tag_list_lock);
+	read_unlock_bh(&sock_tag_list_lock);
 
-	spin_lock_bh(&sock_tag_list_lock);
+	read_lock_bh(&sock_tag_list_lock);
 	spin_lock_bh(&uid_tag_data_tree_lock);
 	prdebug_uid_tag_data_tree(indent_level, &uid_tag_data_tree);
 	prdebug_proc_qtu_data_tree(indent_level, &proc_qtu_data_tree);
 	spin_unlock_bh(&uid_tag_data_tree_lock);
-	spin_unlock_bh(&sock_tag_list_lock);
+	read_unlock_bh(&sock_tag_list_lock);
 
 	spin_lock_bh(&iface_stat_list_lock);
 	prdebug_iface_stat_list(indent_level, &iface_stat_list);
@@ -1879,7 +1950,7 @@ static void *qtaguid_ctrl_proc_start(struct seq_file *m, loff_t *pos)
 	struct sock_tag *sock_tag_entry;
 	struct rb_node *node;
 
-	spin_lock_bh(&sock_tag_list_lock);
+	read_lock_bh(&sock_tag_list_lock);
 
 	if (unlikely(module_passive))
 		return NULL;
@@ -1907,7 +1978,7 @@ static void *qtaguid_ctrl_proc_start(struct seq_file *m, loff_t *pos)
 
 static void qtaguid_ctrl_proc_stop(struct seq_file *m, void *v)
 {
-	spin_unlock_bh(&sock_tag_list_lock);
+	read_unlock_bh(&sock_tag_list_lock);
 }
 
 /*
@@ -2022,7 +2093,7 @@ static int ctrl_cmd_delete(const char *input)
 		 input, tag, uid);
 
 	/* Delete socket tags */
-	spin_lock_bh(&sock_tag_list_lock);
+	write_lock_bh(&sock_tag_list_lock);
 	node = rb_first(&sock_tag_tree);
 	while (node) {
 		st_entry = rb_entry(node, struct sock_tag, sock_node);
@@ -2052,12 +2123,12 @@ static int ctrl_cmd_delete(const char *input)
 				list_del(&st_entry->list);
 		}
 	}
-	spin_unlock_bh(&sock_tag_list_lock);
+	write_unlock_bh(&sock_tag_list_lock);
 
 	sock_tag_tree_erase(&st_to_free_tree);
 
 	/* Delete tag counter-sets */
-	spin_lock_bh(&tag_counter_set_list_lock);
+	write_lock_bh(&tag_counter_set_list_lock);
 	/* Counter sets are only on the uid tag, not full tag */
 	tcs_entry = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (tcs_entry) {
@@ -2070,7 +2141,7 @@ static int ctrl_cmd_delete(const char *input)
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
 	}
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	write_unlock_bh(&tag_counter_set_list_lock);
 
 	/*
 	 * If acct_tag is 0, then all entries belonging to uid are
@@ -2078,7 +2149,7 @@ static int ctrl_cmd_delete(const char *input)
 	 */
 	spin_lock_bh(&iface_stat_list_lock);
 	list_for_each_entry(iface_entry, &iface_stat_list, list) {
-		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		write_lock_bh(&iface_entry->tag_stat_list_lock);
 		node = rb_first(&iface_entry->tag_stat_tree);
 		while (node) {
 			ts_entry = rb_entry(node, struct tag_stat, tn.node);
@@ -2099,10 +2170,11 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
+				kfree(ts_entry->counters);
 				kfree(ts_entry);
 			}
 		}
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+		write_unlock_bh(&iface_entry->tag_stat_list_lock);
 	}
 	spin_unlock_bh(&iface_stat_list_lock);
 
@@ -2168,12 +2240,12 @@ static int ctrl_cmd_counter_set(const char *input)
 	}
 
 	tag = make_tag_from_uid(uid);
-	spin_lock_bh(&tag_counter_set_list_lock);
+	write_lock_bh(&tag_counter_set_list_lock);
 	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
 	if (!tcs) {
 		tcs = kzalloc(sizeof(*tcs), GFP_ATOMIC);
 		if (!tcs) {
-			spin_unlock_bh(&tag_counter_set_list_lock);
+			write_unlock_bh(&tag_counter_set_list_lock);
 			pr_err("qtaguid: ctrl_counterset(%s): "
 			       "failed to alloc counter set\n",
 			       input);
@@ -2187,7 +2259,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	write_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
 
@@ -2255,12 +2327,12 @@ static int ctrl_cmd_tag(const char *input)
 	}
 	full_tag = combine_atag_with_uid(acct_tag, uid);
 
-	spin_lock_bh(&sock_tag_list_lock);
+	write_lock_bh(&sock_tag_list_lock);
 	sock_tag_entry = get_sock_stat_nl(el_socket->sk);
 	tag_ref_entry = get_tag_ref(full_tag, &uid_tag_data_entry);
 	if (IS_ERR(tag_ref_entry)) {
 		res = PTR_ERR(tag_ref_entry);
-		spin_unlock_bh(&sock_tag_list_lock);
+		write_unlock_bh(&sock_tag_list_lock);
 		goto err_put;
 	}
 	tag_ref_entry->num_sock_tags++;
@@ -2293,7 +2365,7 @@ static int ctrl_cmd_tag(const char *input)
 			pr_err("qtaguid: ctrl_tag(%s): "
 			       "socket tag alloc failed\n",
 			       input);
-			spin_unlock_bh(&sock_tag_list_lock);
+			write_unlock_bh(&sock_tag_list_lock);
 			res = -ENOMEM;
 			goto err_tag_unref_put;
 		}
@@ -2325,7 +2397,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
-	spin_unlock_bh(&sock_tag_list_lock);
+	write_unlock_bh(&sock_tag_list_lock);
 	/* We keep the ref to the socket (file) until it is untagged */
 	CT_DEBUG("qtaguid: ctrl_tag(%s): done st@%p ...->f_count=%ld\n",
 		 input, sock_tag_entry,
@@ -2377,10 +2449,10 @@ static int ctrl_cmd_untag(const char *input)
 	CT_DEBUG("qtaguid: ctrl_untag(%s): socket->...->f_count=%ld ->sk=%p\n",
 		 input, atomic_long_read(&el_socket->file->f_count),
 		 el_socket->sk);
-	spin_lock_bh(&sock_tag_list_lock);
+	write_lock_bh(&sock_tag_list_lock);
 	sock_tag_entry = get_sock_stat_nl(el_socket->sk);
 	if (!sock_tag_entry) {
-		spin_unlock_bh(&sock_tag_list_lock);
+		write_unlock_bh(&sock_tag_list_lock);
 		res = -EINVAL;
 		goto err_put;
 	}
@@ -2414,7 +2486,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * only during a cmd_delete().
 	 */
 	tag_ref_entry->num_sock_tags--;
-	spin_unlock_bh(&sock_tag_list_lock);
+	write_unlock_bh(&sock_tag_list_lock);
 	/*
 	 * Release the sock_fd that was grabbed at tag time,
 	 * and once more for the sockfd_lookup() here.
@@ -2522,10 +2594,9 @@ static void pp_stats_header(struct seq_file *m)
 }
 
 static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
-			 int cnt_set)
+			 struct data_counters *cnts, int cnt_set)
 {
 	int ret;
-	struct data_counters *cnts;
 	tag_t tag = ts_entry->tn.tag;
 	uid_t stat_uid = get_uid_from_tag(tag);
 	struct proc_print_info *ppi = m->private;
@@ -2541,7 +2612,6 @@ static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
 		return 0;
 	}
 	ppi->item_index++;
-	cnts = &ts_entry->counters;
 	ret = seq_printf(m, "%d %s 0x%llx %u %u "
 		"%llu %llu "
 		"%llu %llu "
@@ -2579,9 +2649,13 @@ static bool pp_sets(struct seq_file *m, struct tag_stat *ts_entry)
 {
 	int ret;
 	int counter_set;
+	struct data_counters cnts;
+
+	/* The only place the per-CPU counters get folded together */
+	dc_slab_fold(&cnts, ts_entry->counters);
 	for (counter_set = 0; counter_set < IFS_MAX_COUNTER_SETS;
 	     counter_set++) {
-		ret = pp_stats_line(m, ts_entry, counter_set);
+		ret = pp_stats_line(m, ts_entry, &cnts, counter_set);
 		if (ret < 0)
 			return false;
 	}
@@ -2603,9 +2677,9 @@ static int qtaguid_stats_proc_iface_stat_ptr_valid(struct iface_stat *ptr)
 
 static void qtaguid_stats_proc_next_iface_entry(struct proc_print_info *ppi)
 {
-	spin_unlock_bh(&ppi->iface_entry->tag_stat_list_lock);
+	read_unlock_bh(&ppi->iface_entry->tag_stat_list_lock);
 	list_for_each_entry_continue(ppi->iface_entry, &iface_stat_list, list) {
-		spin_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
+		read_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
 		return;
 	}
 	ppi->iface_entry = NULL;
@@ -2662,7 +2736,7 @@ static void *qtaguid_stats_proc_start(struct seq_file *m, loff_t *pos)
 			ppi->iface_entry = list_first_entry(&iface_stat_list,
 							    struct iface_stat,
 							    list);
-			spin_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
+			read_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
 		}
 		return SEQ_START_TOKEN;
 	}
@@ -2675,7 +2749,7 @@ static void *qtaguid_stats_proc_start(struct seq_file *m, loff_t *pos)
 		return NULL;
 	}
 
-	spin_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
+	read_lock_bh(&ppi->iface_entry->tag_stat_list_lock);
 
 	if (!ppi->tag_pos) {
 		/* seq_read skipped first next call */
@@ -2705,7 +2779,7 @@ static void qtaguid_stats_proc_stop(struct seq_file *m, void *v)
 {
 	struct proc_print_info *ppi = m->private;
 	if (ppi->iface_entry)
-		spin_unlock_bh(&ppi->iface_entry->tag_stat_list_lock);
+		read_unlock_bh(&ppi->iface_entry->tag_stat_list_lock);
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
@@ -2817,7 +2891,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		 pqd_entry, pqd_entry->pid, utd_entry,
 		 utd_entry->num_active_tags);
 
-	spin_lock_bh(&sock_tag_list_lock);
+	write_lock_bh(&sock_tag_list_lock);
 	spin_lock_bh(&uid_tag_data_tree_lock);
 
 	list_for_each_safe(entry, next, &pqd_entry->sock_tag_list) {
@@ -2864,7 +2938,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 	file->private_data = NULL;
 
 	spin_unlock_bh(&uid_tag_data_tree_lock);
-	spin_unlock_bh(&sock_tag_list_lock);
+	write_unlock_bh(&sock_tag_list_lock);
 
 
 	sock_tag_tree_erase(&st_to_free_tree);
@@ -11,8 +11,11 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -197,6 +200,45 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * Per-CPU slab of data_counters.
+ * The packet path only ever touches the slab of the CPU it runs on (with BHs
+ * disabled), so no lock is needed to bump the counters. Readers fold all the
+ * slabs into a single struct data_counters via dc_slab_fold().
+ * A slab array holds nr_cpu_ids entries and is indexed by smp_processor_id().
+ */
+struct data_counters_slab {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+static inline void dc_slab_fold(struct data_counters *res,
+				struct data_counters_slab *slab)
+{
+	int cpu, set, dir, proto;
+
+	memset(res, 0, sizeof(*res));
+	for_each_possible_cpu(cpu) {
+		struct data_counters_slab *dcs = &slab[cpu];
+		struct data_counters snap;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&dcs->syncp);
+			snap = dcs->dc;
+		} while (u64_stats_fetch_retry_bh(&dcs->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS; proto++) {
+					res->bpc[set][dir][proto].bytes +=
+						snap.bpc[set][dir][proto].bytes;
+					res->bpc[set][dir][proto].packets +=
+						snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
 
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
@@ -206,23 +248,25 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct data_counters_slab *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters_slab *parent_counters;
 };
 
 struct iface_stat {
-	struct list_head list;  /* in iface_stat_list */
+	struct list_head list;  /* in iface_stat_list, RCU protected */
 	char *ifname;
+	/* ifindex of net_dev while active, used for the packet path lookup */
+	int ifindex;
 	bool active;
 	/* net_dev is only valid for active iface_stat */
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	struct data_counters_slab *totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -238,7 +282,12 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
-	spinlock_t tag_stat_list_lock;
+	/*
+	 * Readers (packet path, procfs) only need it to walk the tree;
+	 * the counters themselves are per-CPU.
+	 * Writers insert/erase tag_stats.
+	 */
+	rwlock_t tag_stat_list_lock;
 };
 
 /* This is needed to create proc_dir_entries from atomic context. */
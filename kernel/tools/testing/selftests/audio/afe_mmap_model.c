@@ -0,0 +1,328 @@
+/*
+ * afe_mmap_model - software model of the AFE DL1 mmap playback mode
+ *
+ * A "hardware" thread consumes a ring at the sample rate the way the AFE
+ * DMA does, and raises an "irq" every period. The pointer bookkeeping is a
+ * copy of Auddrv_DL1_Mmap_Update() and the AUDDRV_GET_DL1_POSITION /
+ * AUDDRV_SET_DL1_APPL_PTR handlers in the mt6595 AudDrv_Kernel.c. A
+ * writer thread keeps a fixed amount of audio written ahead of the read
+ * pointer, optionally while other threads load every CPU.
+ *
+ * Every frame carries its own sequence number, so the hardware thread
+ * can tell whether it played exactly what the writer committed. It also
+ * reports how far ahead of the hardware the writer really was.
+ *
+ * Usage: afe_mmap_model [-t seconds] [-a ahead_us] [-w wake_us] [-l load_threads]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RATE		48000
+#define FRAME_BYTES	4		/* 16 bit stereo */
+#define BUFFER_BYTES	0x4000		/* AUDDRV_DL1_MAX_BUFFER_LENGTH */
+#define DMA_TICK_US	250		/* granularity of the modelled DMA */
+#define IRQ_PERIOD_US	10000		/* underrun detection only */
+
+/* ---- model of the driver side, protected by irqstatus_lock ---- */
+
+struct dl1_position {
+	uint32_t buffer_size;
+	uint32_t hw_read_idx;
+	uint64_t hw_consumed;
+	uint64_t appl_written;
+	uint64_t time_stamp;
+	uint32_t underruns;
+};
+
+static pthread_mutex_t irqstatus_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t ring[BUFFER_BYTES / FRAME_BYTES];
+static volatile uint32_t afe_dl1_cur;	/* the DMA read pointer register */
+
+static uint32_t dma_read_idx;
+static uint64_t mmap_hw_consumed;
+static uint64_t mmap_appl_written;
+static uint64_t mmap_time_stamp;
+static uint32_t mmap_underruns;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void dl1_mmap_update(void)
+{
+	uint32_t hw_idx = __atomic_load_n(&afe_dl1_cur, __ATOMIC_ACQUIRE);
+	uint32_t consumed;
+
+	/* an unchanged pointer means nothing consumed, not a full lap */
+	consumed = (hw_idx + BUFFER_BYTES - dma_read_idx) % BUFFER_BYTES;
+	dma_read_idx = hw_idx;
+	mmap_hw_consumed += consumed;
+	mmap_time_stamp = now_ns();
+
+	if (mmap_hw_consumed > mmap_appl_written) {
+		memset(ring, 0, sizeof(ring));
+		mmap_appl_written = mmap_hw_consumed;
+		mmap_underruns++;
+	}
+}
+
+static void dl1_mmap_position(struct dl1_position *pos)
+{
+	pos->buffer_size = BUFFER_BYTES;
+	pos->hw_read_idx = dma_read_idx;
+	pos->hw_consumed = mmap_hw_consumed;
+	pos->appl_written = mmap_appl_written;
+	pos->time_stamp = mmap_time_stamp;
+	pos->underruns = mmap_underruns;
+}
+
+static int dl1_get_position(struct dl1_position *pos)
+{
+	pthread_mutex_lock(&irqstatus_lock);
+	dl1_mmap_update();
+	dl1_mmap_position(pos);
+	pthread_mutex_unlock(&irqstatus_lock);
+	return 0;
+}
+
+static int dl1_set_appl_ptr(struct dl1_position *pos)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&irqstatus_lock);
+	dl1_mmap_update();
+	if (pos->appl_written < mmap_appl_written)
+		ret = -EPIPE;
+	else if (pos->appl_written - mmap_hw_consumed > BUFFER_BYTES)
+		ret = -EINVAL;
+	else
+		mmap_appl_written = pos->appl_written;
+	dl1_mmap_position(pos);
+	pthread_mutex_unlock(&irqstatus_lock);
+	return ret;
+}
+
+/* ---- model of the AFE DMA ---- */
+
+static volatile int stop;
+static unsigned int ahead_us = 2000;
+static unsigned int wake_us = 1000;
+
+static uint64_t frames_played, frames_wrong, frames_silent;
+static uint64_t ahead_sum, ahead_samples;
+static int64_t ahead_min = INT64_MAX, ahead_max;
+
+static void timespec_add_us(struct timespec *ts, unsigned int us)
+{
+	ts->tv_nsec += us * 1000L;
+	while (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+static void *dma_thread(void *arg)
+{
+	const uint32_t tick_frames = RATE / (1000000 / DMA_TICK_US);
+	struct timespec next;
+	uint64_t pos = 0, since_irq = 0;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		timespec_add_us(&next, DMA_TICK_US);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		/*
+		 * Check each frame against what was committed when it is
+		 * fetched. Like the real DMA this does not wait for anyone.
+		 */
+		pthread_mutex_lock(&irqstatus_lock);
+		for (i = 0; i < tick_frames; i++, pos++) {
+			uint32_t v = ring[pos % (BUFFER_BYTES / FRAME_BYTES)];
+
+			if (pos * FRAME_BYTES < mmap_appl_written) {
+				if (v != (uint32_t)pos + 1)
+					frames_wrong++;
+			} else {
+				frames_silent++;
+			}
+		}
+		frames_played += tick_frames;
+
+		ahead_samples++;
+		{
+			int64_t ahead = (int64_t)(mmap_appl_written -
+						  pos * FRAME_BYTES);
+
+			ahead_sum += ahead > 0 ? ahead : 0;
+			if (ahead < ahead_min)
+				ahead_min = ahead;
+			if (ahead > ahead_max)
+				ahead_max = ahead;
+		}
+		pthread_mutex_unlock(&irqstatus_lock);
+
+		__atomic_store_n(&afe_dl1_cur,
+				 (uint32_t)(pos * FRAME_BYTES % BUFFER_BYTES),
+				 __ATOMIC_RELEASE);
+
+		since_irq += DMA_TICK_US;
+		if (since_irq >= IRQ_PERIOD_US) {
+			since_irq = 0;
+			pthread_mutex_lock(&irqstatus_lock);
+			dl1_mmap_update();
+			pthread_mutex_unlock(&irqstatus_lock);
+		}
+	}
+
+	return NULL;
+}
+
+/* ---- the mmap writer, as the audio HAL would do it ---- */
+
+static uint64_t writer_resyncs, writer_wakeups;
+static uint64_t wake_late_max;
+
+static void *writer_thread(void *arg)
+{
+	const uint64_t ahead_bytes =
+		(uint64_t)RATE * ahead_us / 1000000 * FRAME_BYTES;
+	struct dl1_position pos;
+	struct timespec next;
+	uint64_t appl;
+
+	dl1_get_position(&pos);
+	appl = pos.appl_written;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		uint64_t target, late;
+
+		timespec_add_us(&next, wake_us);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		late = now_ns() - ((uint64_t)next.tv_sec * 1000000000ULL +
+				   next.tv_nsec);
+		if (late > wake_late_max)
+			wake_late_max = late;
+		writer_wakeups++;
+
+		dl1_get_position(&pos);
+		if (pos.appl_written > appl) {
+			/* underrun: restart behind the hardware pointer */
+			appl = pos.appl_written;
+			writer_resyncs++;
+		}
+		target = pos.hw_consumed + ahead_bytes;
+		if (target - pos.hw_consumed > BUFFER_BYTES)
+			target = pos.hw_consumed + BUFFER_BYTES;
+
+		/* fill the mapped ring directly, then commit */
+		while (appl < target) {
+			uint64_t frame = appl / FRAME_BYTES;
+
+			ring[frame % (BUFFER_BYTES / FRAME_BYTES)] =
+				(uint32_t)frame + 1;
+			appl += FRAME_BYTES;
+		}
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		pos.appl_written = appl;
+		if (dl1_set_appl_ptr(&pos) == -EPIPE) {
+			appl = pos.appl_written;
+			writer_resyncs++;
+		}
+	}
+
+	return NULL;
+}
+
+static void *load_thread(void *arg)
+{
+	volatile uint64_t x = 0;
+
+	while (!stop)
+		x++;
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int seconds = 5, load = 0, i;
+	pthread_t dma, writer, *loaders;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:a:w:l:")) != -1) {
+		switch (opt) {
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'a':
+			ahead_us = atoi(optarg);
+			break;
+		case 'w':
+			wake_us = atoi(optarg);
+			break;
+		case 'l':
+			load = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-t seconds] [-a ahead_us] [-w wake_us] [-l load_threads]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!wake_us || !ahead_us)
+		return 1;
+
+	loaders = calloc(load ? load : 1, sizeof(*loaders));
+	for (i = 0; i < load; i++)
+		pthread_create(&loaders[i], NULL, load_thread, NULL);
+
+	pthread_create(&dma, NULL, dma_thread, NULL);
+	pthread_create(&writer, NULL, writer_thread, NULL);
+
+	sleep(seconds);
+	stop = 1;
+
+	pthread_join(writer, NULL);
+	pthread_join(dma, NULL);
+	for (i = 0; i < load; i++)
+		pthread_join(loaders[i], NULL);
+	free(loaders);
+
+	printf("ahead %u us, writer wakeup %u us, %u load threads\n",
+	       ahead_us, wake_us, load);
+	printf("  played %llu frames: %llu wrong, %llu silent, %u underruns, %llu resyncs\n",
+	       (unsigned long long)frames_played,
+	       (unsigned long long)frames_wrong,
+	       (unsigned long long)frames_silent,
+	       mmap_underruns, (unsigned long long)writer_resyncs);
+	printf("  write-ahead latency avg %llu us min %lld us max %lld us, writer late max %llu us\n",
+	       (unsigned long long)(ahead_sum / (ahead_samples ? ahead_samples : 1) *
+				    1000000 / (RATE * FRAME_BYTES)),
+	       (long long)(ahead_min * 1000000 / (RATE * FRAME_BYTES)),
+	       (long long)(ahead_max * 1000000 / (RATE * FRAME_BYTES)),
+	       (unsigned long long)(wake_late_max / 1000));
+
+	if (frames_wrong) {
+		printf("afe_mmap_model: [FAIL]\n");
+		return 1;
+	}
+	printf("afe_mmap_model: [PASS]\n");
+	return 0;
+}
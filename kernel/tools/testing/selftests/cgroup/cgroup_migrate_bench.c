@@ -0,0 +1,270 @@
+/*
+ * cgroup_migrate_bench - time moving a process between two cpu cgroups
+ *
+ * Models the foreground/background switch the activity manager does on
+ * every app switch. A child process with N threads is moved back and forth
+ * between two groups under the cpu controller hierarchy, either
+ *
+ *   tasks   one write of each thread id to "tasks", as done today
+ *   procs   a single write of the process id to "cgroup.procs"
+ *
+ * and the average time per switch is printed for each thread count.
+ * Every switch is checked by reading back /proc/<tid>/cgroup.
+ *
+ * Usage: cgroup_migrate_bench [-r rounds] [-m cpu_cgroup_mount]
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_THREADS	256
+
+static const int thread_counts[] = { 1, 10, 50, 100, 200 };
+
+static char mnt[256];
+static char grp[2][300];
+static int mounted_here;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* find a cgroup v1 hierarchy with the cpu controller, or mount one */
+static int find_cpu_hierarchy(void)
+{
+	char dev[64], dir[256], type[64], opts[512];
+	FILE *f = fopen("/proc/mounts", "r");
+
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %255s %63s %511s %*d %*d",
+		      dev, dir, type, opts) == 4) {
+		char *o, *save;
+
+		if (strcmp(type, "cgroup"))
+			continue;
+		for (o = strtok_r(opts, ",", &save); o;
+		     o = strtok_r(NULL, ",", &save)) {
+			if (!strcmp(o, "cpu")) {
+				strcpy(mnt, dir);
+				fclose(f);
+				return 0;
+			}
+		}
+	}
+	fclose(f);
+
+	strcpy(mnt, "/tmp/cgroup_migrate_bench");
+	mkdir(mnt, 0755);
+	if (mount("cgroup", mnt, "cgroup", 0, "cpu")) {
+		rmdir(mnt);
+		return -1;
+	}
+	mounted_here = 1;
+	return 0;
+}
+
+static int write_num(const char *dir, const char *file, long val)
+{
+	char path[512], buf[32];
+	int fd, len, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	len = snprintf(buf, sizeof(buf), "%ld", val);
+	if (write(fd, buf, len) != len)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+static int list_threads(pid_t pid, pid_t *tids)
+{
+	char path[64];
+	struct dirent *de;
+	int n = 0;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "/proc/%d/task", pid);
+	d = opendir(path);
+	if (!d)
+		return -1;
+	while ((de = readdir(d)) && n < MAX_THREADS + 1)
+		if (de->d_name[0] != '.')
+			tids[n++] = atoi(de->d_name);
+	closedir(d);
+	return n;
+}
+
+/* is every thread of @pid in group @g? */
+static int check_group(pid_t *tids, int n, int g)
+{
+	const char *want = grp[g] + strlen(mnt);
+	char path[64], line[512];
+	int i, ok;
+
+	for (i = 0; i < n; i++) {
+		FILE *f;
+
+		snprintf(path, sizeof(path), "/proc/%d/cgroup", tids[i]);
+		f = fopen(path, "r");
+		if (!f)
+			return -1;
+		ok = 0;
+		while (fgets(line, sizeof(line), f)) {
+			char *p = strrchr(line, ':');
+
+			line[strcspn(line, "\n")] = 0;
+			if (strstr(line, "cpu") && p && !strcmp(p + 1, want))
+				ok = 1;
+		}
+		fclose(f);
+		if (!ok)
+			return -1;
+	}
+	return 0;
+}
+
+static void *sleeper(void *arg)
+{
+	for (;;)
+		pause();
+	return NULL;
+}
+
+static pid_t spawn(int nr_threads)
+{
+	pid_t pid = fork();
+	pthread_t t;
+	int i;
+
+	if (pid)
+		return pid;
+	for (i = 1; i < nr_threads; i++)
+		pthread_create(&t, NULL, sleeper, NULL);
+	for (;;)
+		pause();
+}
+
+static int bench(int nr_threads, int rounds, int procs, double *us)
+{
+	pid_t tids[MAX_THREADS + 1];
+	int64_t start, total = 0;
+	int r, i, n, g, ret = 0;
+	pid_t pid;
+
+	pid = spawn(nr_threads);
+	/* wait until all threads are up */
+	for (i = 0; i < 1000; i++) {
+		n = list_threads(pid, tids);
+		if (n >= nr_threads)
+			break;
+		usleep(1000);
+	}
+	if (n != nr_threads) {
+		ret = -1;
+		goto out;
+	}
+
+	for (r = 0; r < rounds; r++) {
+		g = r & 1;
+		start = now_ns();
+		if (procs) {
+			ret = write_num(grp[g], "cgroup.procs", pid);
+		} else {
+			for (i = 0; i < n && !ret; i++)
+				ret = write_num(grp[g], "tasks", tids[i]);
+		}
+		total += now_ns() - start;
+		if (ret || check_group(tids, n, g)) {
+			ret = -1;
+			break;
+		}
+	}
+	*us = total / 1000.0 / rounds;
+
+out:
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = 50, opt, i, ret = 0;
+	double tasks_us, procs_us;
+
+	while ((opt = getopt(argc, argv, "r:m:")) != -1) {
+		switch (opt) {
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'm':
+			snprintf(mnt, sizeof(mnt), "%s", optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-r rounds] [-m cpu_cgroup_mount]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (geteuid()) {
+		fprintf(stderr, "%s must be run as root\n", argv[0]);
+		return 0;
+	}
+	if (!mnt[0] && find_cpu_hierarchy()) {
+		fprintf(stderr, "no cgroup v1 cpu controller available\n");
+		return 0;
+	}
+	if (rounds < 2)
+		rounds = 2;
+
+	snprintf(grp[0], sizeof(grp[0]), "%s/bench_fg", mnt);
+	snprintf(grp[1], sizeof(grp[1]), "%s/bench_bg", mnt);
+	mkdir(grp[0], 0755);
+	mkdir(grp[1], 0755);
+	write_num(grp[1], "cpu.shares", 52);
+
+	printf("%s, %d switches each, usec per switch\n", mnt, rounds);
+	printf("threads     tasks     procs\n");
+	for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+		int n = thread_counts[i];
+
+		if (bench(n, rounds, 0, &tasks_us) ||
+		    bench(n, rounds, 1, &procs_us)) {
+			printf("%7d migration failed\n", n);
+			ret = 1;
+			break;
+		}
+		printf("%7d %9.1f %9.1f\n", n, tasks_us, procs_us);
+	}
+
+	rmdir(grp[0]);
+	rmdir(grp[1]);
+	if (mounted_here) {
+		umount(mnt);
+		rmdir(mnt);
+	}
+
+	printf("cgroup_migrate_bench: %s\n", ret ? "[FAIL]" : "[PASS]");
+	return ret;
+}
@@ -0,0 +1,110 @@
+/*
+ * fsync latency of small random overwrites, the pattern of a database
+ * updating pages of an existing file: rewrite one block at a random
+ * offset and fdatasync (or fsync) it, over and over.  Reports the
+ * latency distribution of the syncs.
+ *
+ * Run it with different /sys/fs/f2fs/<dev>/ipu_policy settings to
+ * compare in-place updates against the log; 0 keeps every write out of
+ * place.
+ *
+ * Usage: fsync_bench <file> [iterations] [file blocks] [full fsync]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define BLOCK	4096
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 1000, blocks = 1024, full = 0;
+	double *lat, start, total = 0;
+	char buf[BLOCK];
+	off_t off;
+	int fd, i, ret;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file> [iterations] [file blocks] "
+			"[full fsync]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		iterations = atoi(argv[2]);
+	if (argc > 3)
+		blocks = atoi(argv[3]);
+	if (argc > 4)
+		full = atoi(argv[4]);
+	if (iterations <= 0 || blocks <= 0)
+		return 1;
+
+	lat = calloc(iterations, sizeof(*lat));
+	if (!lat)
+		return 1;
+
+	fd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	/* Lay the whole file down and get it checkpointed up front */
+	memset(buf, 0, BLOCK);
+	for (i = 0; i < blocks; i++) {
+		if (pwrite(fd, buf, BLOCK, (off_t)i * BLOCK) != BLOCK) {
+			perror("pwrite");
+			return 1;
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		return 1;
+	}
+	sync();
+
+	srand(blocks);
+	for (i = 0; i < iterations; i++) {
+		off = (off_t)(rand() % blocks) * BLOCK;
+		memset(buf, 'a' + i % 26, BLOCK);
+		if (pwrite(fd, buf, BLOCK, off) != BLOCK) {
+			perror("pwrite");
+			return 1;
+		}
+
+		start = now();
+		ret = full ? fsync(fd) : fdatasync(fd);
+		if (ret) {
+			perror("fsync");
+			return 1;
+		}
+		lat[i] = now() - start;
+		total += lat[i];
+	}
+	close(fd);
+
+	qsort(lat, iterations, sizeof(*lat), cmp);
+	printf("%d random overwrites over %d blocks: %s avg %.1f us, "
+	       "p50 %.1f us, p99 %.1f us, max %.1f us, %.0f syncs/s\n",
+	       iterations, blocks, full ? "fsync" : "fdatasync",
+	       total * 1e6 / iterations, lat[iterations / 2] * 1e6,
+	       lat[iterations * 99 / 100] * 1e6, lat[iterations - 1] * 1e6,
+	       iterations / total);
+	return 0;
+}
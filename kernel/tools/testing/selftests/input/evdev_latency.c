@@ -0,0 +1,376 @@
+/*
+ * evdev_latency - replay touch frames through uinput and measure how long
+ * each packet takes to reach an evdev reader.
+ *
+ * The kernel stamps every event with CLOCK_MONOTONIC (EVIOCSCLOCKID) when
+ * it enters the input core; the reader compares that stamp with the time
+ * it sees the SYN_REPORT. Three readers are compared:
+ *
+ *   read    poll() + read() on the evdev node
+ *   mmap    poll() + the shared ring set up with EVIOCSMMAP
+ *   eventfd blocking read() on an eventfd set with EVIOCSEVENTFD + ring
+ *
+ * Usage: evdev_latency [-r rate_hz] [-n frames] [-m mode]
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+
+#ifndef EVIOCSMMAP
+struct input_mmap_ring {
+	__u32 version;
+	__u32 bufsize;
+	__u32 head;
+	__u32 packet_head;
+	__u32 tail;
+	__u32 dropped;
+	__u32 reserved[10];
+	struct input_event buffer[];
+};
+
+#define EVIOCSMMAP		_IOWR('E', 0xa1, __u32)
+#define EVIOCSEVENTFD		_IOW('E', 0xa2, int)
+#endif
+
+#define DEV_NAME	"evdev-latency-replay"
+#define TOUCH_MAX	4095
+
+enum mode { MODE_READ, MODE_MMAP, MODE_EVENTFD };
+
+static const char * const mode_names[] = { "read", "mmap", "eventfd" };
+
+static unsigned int rate = 120;
+static unsigned int frames = 1200;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t event_ns(const struct input_event *ev)
+{
+	return (int64_t)ev->time.tv_sec * 1000000000LL +
+		(int64_t)ev->time.tv_usec * 1000;
+}
+
+static int emit(int fd, int type, int code, int value)
+{
+	struct input_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+	return write(fd, &ev, sizeof(ev)) == sizeof(ev) ? 0 : -1;
+}
+
+static int uinput_create(void)
+{
+	struct uinput_user_dev udev;
+	int fd;
+
+	fd = open("/dev/uinput", O_WRONLY);
+	if (fd < 0) {
+		perror("/dev/uinput");
+		return -1;
+	}
+
+	ioctl(fd, UI_SET_EVBIT, EV_SYN);
+	ioctl(fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(fd, UI_SET_KEYBIT, BTN_TOUCH);
+	ioctl(fd, UI_SET_EVBIT, EV_ABS);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_SLOT);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_TRACKING_ID);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_POSITION_X);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_POSITION_Y);
+	ioctl(fd, UI_SET_PROPBIT, INPUT_PROP_DIRECT);
+
+	memset(&udev, 0, sizeof(udev));
+	snprintf(udev.name, sizeof(udev.name), DEV_NAME);
+	udev.id.bustype = BUS_VIRTUAL;
+	udev.absmax[ABS_MT_SLOT] = 9;
+	udev.absmax[ABS_MT_TRACKING_ID] = 65535;
+	udev.absmax[ABS_MT_POSITION_X] = TOUCH_MAX;
+	udev.absmax[ABS_MT_POSITION_Y] = TOUCH_MAX;
+
+	if (write(fd, &udev, sizeof(udev)) != sizeof(udev) ||
+	    ioctl(fd, UI_DEV_CREATE) < 0) {
+		perror("uinput setup");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int evdev_find(void)
+{
+	char path[280], name[64];
+	struct dirent *de;
+	int tries, fd;
+	DIR *dir;
+
+	/* udev/ueventd may take a moment to create the node. */
+	for (tries = 0; tries < 50; tries++) {
+		dir = opendir("/dev/input");
+		if (!dir)
+			return -1;
+		while ((de = readdir(dir))) {
+			if (strncmp(de->d_name, "event", 5))
+				continue;
+			snprintf(path, sizeof(path), "/dev/input/%s",
+				 de->d_name);
+			fd = open(path, O_RDONLY | O_NONBLOCK);
+			if (fd < 0)
+				continue;
+			if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) > 0 &&
+			    !strcmp(name, DEV_NAME)) {
+				closedir(dir);
+				return fd;
+			}
+			close(fd);
+		}
+		closedir(dir);
+		usleep(20000);
+	}
+
+	return -1;
+}
+
+struct replay {
+	int ufd;
+	volatile int done;
+};
+
+static void *replay_thread(void *arg)
+{
+	struct replay *r = arg;
+	struct timespec next;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	emit(r->ufd, EV_ABS, ABS_MT_SLOT, 0);
+	emit(r->ufd, EV_ABS, ABS_MT_TRACKING_ID, 1);
+	emit(r->ufd, EV_KEY, BTN_TOUCH, 1);
+
+	for (i = 0; i < frames; i++) {
+		next.tv_nsec += 1000000000L / rate;
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		emit(r->ufd, EV_ABS, ABS_MT_POSITION_X, i % TOUCH_MAX);
+		emit(r->ufd, EV_ABS, ABS_MT_POSITION_Y, (i * 7) % TOUCH_MAX);
+		emit(r->ufd, EV_SYN, SYN_REPORT, 0);
+	}
+
+	emit(r->ufd, EV_ABS, ABS_MT_TRACKING_ID, -1);
+	emit(r->ufd, EV_KEY, BTN_TOUCH, 0);
+	emit(r->ufd, EV_SYN, SYN_REPORT, 0);
+	r->done = 1;
+
+	return NULL;
+}
+
+static int cmp_s64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int run(enum mode mode)
+{
+	struct input_mmap_ring *ring = NULL;
+	unsigned int seen = 0, dropped = 0;
+	struct replay r = { 0 };
+	int64_t *lat, sum = 0;
+	pthread_t thread;
+	unsigned int i;
+	int clk = CLOCK_MONOTONIC;
+	__u32 len = 0;
+	int efd = -1, fd, ret = 1;
+
+	lat = calloc(frames + 1, sizeof(*lat));
+	r.ufd = uinput_create();
+	if (!lat || r.ufd < 0)
+		return 1;
+
+	fd = evdev_find();
+	if (fd < 0) {
+		fprintf(stderr, "cannot find %s event node\n", DEV_NAME);
+		goto out_uinput;
+	}
+
+	if (ioctl(fd, EVIOCSCLOCKID, &clk) < 0) {
+		perror("EVIOCSCLOCKID");
+		goto out_evdev;
+	}
+
+	if (mode != MODE_READ) {
+		if (ioctl(fd, EVIOCSMMAP, &len) < 0) {
+			perror("EVIOCSMMAP");
+			goto out_evdev;
+		}
+		ring = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			    fd, 0);
+		if (ring == MAP_FAILED) {
+			perror("mmap");
+			goto out_evdev;
+		}
+	}
+
+	if (mode == MODE_EVENTFD) {
+		efd = eventfd(0, 0);
+		if (efd < 0 || ioctl(fd, EVIOCSEVENTFD, &efd) < 0) {
+			perror("EVIOCSEVENTFD");
+			goto out_unmap;
+		}
+	}
+
+	pthread_create(&thread, NULL, replay_thread, &r);
+
+	while (!r.done || seen < frames) {
+		struct input_event evs[64], *ev;
+		unsigned int n = 0;
+		int64_t t;
+
+		if (mode == MODE_EVENTFD) {
+			struct pollfd pfd = { .fd = efd, .events = POLLIN };
+			uint64_t cnt;
+
+			if (poll(&pfd, 1, 500) <= 0)
+				break;
+			if (read(efd, &cnt, sizeof(cnt)) != sizeof(cnt))
+				break;
+		} else {
+			struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+			if (poll(&pfd, 1, 500) <= 0)
+				break;
+		}
+		t = now_ns();
+
+		if (mode == MODE_READ) {
+			ssize_t rd = read(fd, evs, sizeof(evs));
+
+			if (rd < 0)
+				continue;
+			n = rd / sizeof(evs[0]);
+		} else {
+			__u32 tail = ring->tail;
+			__u32 head = __atomic_load_n(&ring->packet_head,
+						     __ATOMIC_ACQUIRE);
+
+			while (tail != head && n < 64)
+				evs[n++] = ring->buffer[tail++ &
+							(ring->bufsize - 1)];
+			__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		}
+
+		for (i = 0; i < n; i++) {
+			ev = &evs[i];
+			if (ev->type != EV_SYN)
+				continue;
+			if (ev->code == SYN_DROPPED)
+				dropped++;
+			if (ev->code == SYN_REPORT && seen < frames + 1)
+				lat[seen++] = t - event_ns(ev);
+		}
+	}
+
+	pthread_join(thread, NULL);
+
+	if (!seen) {
+		fprintf(stderr, "%s: no packets received\n", mode_names[mode]);
+		goto out_unmap;
+	}
+
+	qsort(lat, seen, sizeof(*lat), cmp_s64);
+	for (i = 0; i < seen; i++)
+		sum += lat[i];
+
+	printf("%-8s %5u packets %3u dropped  avg %6lld us  p50 %6lld us  p99 %6lld us  max %6lld us\n",
+	       mode_names[mode], seen, dropped,
+	       (long long)(sum / seen / 1000),
+	       (long long)(lat[seen / 2] / 1000),
+	       (long long)(lat[seen * 99 / 100] / 1000),
+	       (long long)(lat[seen - 1] / 1000));
+	ret = 0;
+
+out_unmap:
+	if (efd >= 0)
+		close(efd);
+	if (ring)
+		munmap(ring, len);
+out_evdev:
+	close(fd);
+out_uinput:
+	ioctl(r.ufd, UI_DEV_DESTROY);
+	close(r.ufd);
+	free(lat);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = 0, i;
+	int only = -1;
+
+	while ((opt = getopt(argc, argv, "r:n:m:")) != -1) {
+		switch (opt) {
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'm':
+			for (i = 0; i <= MODE_EVENTFD; i++)
+				if (!strcmp(optarg, mode_names[i]))
+					only = i;
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-r rate_hz] [-n frames] [-m read|mmap|eventfd]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!rate || !frames)
+		return 1;
+
+	if (geteuid()) {
+		fprintf(stderr, "%s must be run as root\n", argv[0]);
+		return 0;
+	}
+
+	printf("replaying %u frames at %u Hz\n", frames, rate);
+	for (i = 0; i <= MODE_EVENTFD; i++)
+		if (only < 0 || only == i)
+			ret |= run(i);
+
+	return ret;
+}
@@ -0,0 +1,86 @@
+/*
+ * Tag a UDP socket through /proc/net/xt_qtaguid/ctrl and send datagrams
+ * from it, so that xt_qtaguid accounts them to that tag.
+ *
+ * usage: qtaguid_tag <tag> <uid> <dst-ipv4> <count>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define CTRL_FILE "/proc/net/xt_qtaguid/ctrl"
+
+static int ctrl_write(const char *cmd)
+{
+	int fd, len = strlen(cmd), ret;
+
+	fd = open(CTRL_FILE, O_WRONLY);
+	if (fd < 0) {
+		perror(CTRL_FILE);
+		return -1;
+	}
+	ret = write(fd, cmd, len);
+	if (ret != len)
+		perror("ctrl write");
+	close(fd);
+	return ret == len ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in dst;
+	unsigned long long tag;
+	char cmd[128], payload[64];
+	int sock, count, i, ret = 0;
+
+	if (argc != 5) {
+		fprintf(stderr, "usage: %s <tag> <uid> <dst-ipv4> <count>\n",
+			argv[0]);
+		return 1;
+	}
+
+	/* The accounting tag lives in the top 32 bits. */
+	tag = strtoull(argv[1], NULL, 0) << 32;
+	count = atoi(argv[4]);
+
+	memset(&dst, 0, sizeof(dst));
+	dst.sin_family = AF_INET;
+	dst.sin_port = htons(9);
+	if (inet_pton(AF_INET, argv[3], &dst.sin_addr) != 1) {
+		fprintf(stderr, "bad address %s\n", argv[3]);
+		return 1;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	snprintf(cmd, sizeof(cmd), "t %d %llu %s", sock, tag, argv[2]);
+	if (ctrl_write(cmd)) {
+		close(sock);
+		return 1;
+	}
+
+	memset(payload, 0, sizeof(payload));
+	for (i = 0; i < count; i++) {
+		if (sendto(sock, payload, sizeof(payload), 0,
+			   (struct sockaddr *)&dst, sizeof(dst)) < 0) {
+			perror("sendto");
+			ret = 1;
+			break;
+		}
+	}
+
+	snprintf(cmd, sizeof(cmd), "u %d", sock);
+	ctrl_write(cmd);
+	close(sock);
+	return ret;
+}
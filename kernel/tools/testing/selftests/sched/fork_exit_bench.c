@@ -0,0 +1,172 @@
+/*
+ * fork_exit_bench - thread and process creation rate, as during app launch
+ *
+ * Several workers create short-lived threads (and optionally processes)
+ * in parallel. Every new thread renices itself once, like Android threads
+ * that set their priority right after start. This is the path that
+ * prio_tracer hooks on fork, exit and setpriority.
+ *
+ * If the prio_tracer debugfs switch exists, the run is repeated with the
+ * tracer off and on, so its cost can be read off directly.
+ *
+ * Usage: fork_exit_bench [-w workers] [-t seconds] [-p]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define PTS_ENABLE	"/sys/kernel/debug/prio_tracer/enable"
+
+static struct timespec deadline;
+static int use_fork;
+static unsigned long errors;
+
+static void *child_thread(void *arg)
+{
+	pid_t tid = syscall(SYS_gettid);
+
+	if (setpriority(PRIO_PROCESS, tid, 5) < 0)
+		__sync_fetch_and_add(&errors, 1);
+	return NULL;
+}
+
+/* Each worker watches the clock itself; a busy box may not run main(). */
+static int expired(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec > deadline.tv_sec ||
+	       (now.tv_sec == deadline.tv_sec &&
+		now.tv_nsec >= deadline.tv_nsec);
+}
+
+static void *worker(void *arg)
+{
+	unsigned long *count = arg;
+	pthread_t t;
+	pid_t pid;
+
+	while (!expired()) {
+		if (use_fork) {
+			pid = fork();
+			if (pid == 0) {
+				setpriority(PRIO_PROCESS, 0, 5);
+				_exit(0);
+			}
+			if (pid < 0 || waitpid(pid, NULL, 0) != pid) {
+				__sync_fetch_and_add(&errors, 1);
+				continue;
+			}
+		} else {
+			if (pthread_create(&t, NULL, child_thread, NULL)) {
+				__sync_fetch_and_add(&errors, 1);
+				continue;
+			}
+			pthread_join(t, NULL);
+		}
+		(*count)++;
+	}
+	return NULL;
+}
+
+static double run(unsigned int workers, unsigned int seconds)
+{
+	unsigned long *counts, total = 0;
+	struct timespec t0, t1;
+	pthread_t *threads;
+	unsigned int i;
+	double elapsed;
+
+	counts = calloc(workers, sizeof(*counts));
+	threads = calloc(workers, sizeof(*threads));
+	if (!counts || !threads)
+		exit(1);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	deadline = t0;
+	deadline.tv_sec += seconds;
+	for (i = 0; i < workers; i++)
+		pthread_create(&threads[i], NULL, worker, &counts[i]);
+	for (i = 0; i < workers; i++) {
+		pthread_join(threads[i], NULL);
+		total += counts[i];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	free(counts);
+	free(threads);
+	return total / elapsed;
+}
+
+static int set_tracer(const char *val)
+{
+	FILE *f = fopen(PTS_ENABLE, "w");
+
+	if (!f)
+		return -1;
+	fputs(val, f);
+	return fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int workers = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int seconds = 3;
+	const char *what;
+	double off, on;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:t:p")) != -1) {
+		switch (opt) {
+		case 'w':
+			workers = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'p':
+			use_fork = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w workers] [-t seconds] [-p]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!workers || !seconds)
+		return 1;
+
+	what = use_fork ? "fork+exit" : "thread create+exit";
+	printf("%u workers, %s\n", workers, what);
+
+	if (access(PTS_ENABLE, W_OK) == 0) {
+		set_tracer("0");
+		off = run(workers, seconds);
+		set_tracer("1");
+		on = run(workers, seconds);
+		printf("  prio_tracer off %10.0f /s\n", off);
+		printf("  prio_tracer on  %10.0f /s  (%+.1f%%)\n", on,
+		       off ? (on - off) * 100 / off : 0);
+	} else {
+		printf("  %10.0f /s\n", run(workers, seconds));
+	}
+
+	if (errors) {
+		printf("fork_exit_bench: %lu errors [FAIL]\n", errors);
+		return 1;
+	}
+	printf("fork_exit_bench: [PASS]\n");
+	return 0;
+}
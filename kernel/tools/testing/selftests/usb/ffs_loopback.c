@@ -0,0 +1,450 @@
+/*
+ * FunctionFS bulk throughput over a dummy_hcd loopback, comparing
+ * read(2)/write(2) on the endpoint files against AIO with several
+ * requests in flight.  The gadget side is a FunctionFS function with one
+ * bulk IN and one bulk OUT endpoint (the adb interface), the host side
+ * drives it through usbfs.  Data is checked against a pattern.
+ *
+ * Usage: ffs_loopback <functionfs mount> <vid:pid> [size MB] [chunk KB]
+ *			[aio depth]
+ *
+ * The function must be the one the android gadget enables once the
+ * descriptors are written here; see ffs_loopback_bench.  Toggle
+ * /sys/module/g_android/parameters/ffs_zero_copy to compare the
+ * pinned-page path with the bounce buffers.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <endian.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/aio_abi.h>
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/functionfs.h>
+
+#define MAX_DEPTH	32
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#  define cpu_to_le16(x)  (x)
+#  define cpu_to_le32(x)  (x)
+#else
+#  define cpu_to_le16(x)  ((((x) >> 8) & 0xffu) | (((x) & 0xffu) << 8))
+#  define cpu_to_le32(x)  \
+	((((x) & 0xff000000u) >> 24) | (((x) & 0x00ff0000u) >>  8) | \
+	(((x) & 0x0000ff00u) <<  8) | (((x) & 0x000000ffu) << 24))
+#endif
+
+static const struct {
+	struct usb_functionfs_descs_head header;
+	struct {
+		struct usb_interface_descriptor intf;
+		struct usb_endpoint_descriptor_no_audio source;
+		struct usb_endpoint_descriptor_no_audio sink;
+	} __attribute__((packed)) fs_descs, hs_descs;
+} __attribute__((packed)) descriptors = {
+	.header = {
+		.magic = cpu_to_le32(FUNCTIONFS_DESCRIPTORS_MAGIC),
+		.length = cpu_to_le32(sizeof(descriptors)),
+		.fs_count = cpu_to_le32(3),
+		.hs_count = cpu_to_le32(3),
+	},
+	.fs_descs = {
+		.intf = {
+			.bLength = sizeof(descriptors.fs_descs.intf),
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.bInterfaceSubClass = 0x42,
+			.bInterfaceProtocol = 1,
+			.iInterface = 1,
+		},
+		.source = {
+			.bLength = sizeof(descriptors.fs_descs.source),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(64),
+		},
+		.sink = {
+			.bLength = sizeof(descriptors.fs_descs.sink),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(64),
+		},
+	},
+	.hs_descs = {
+		.intf = {
+			.bLength = sizeof(descriptors.hs_descs.intf),
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.bInterfaceSubClass = 0x42,
+			.bInterfaceProtocol = 1,
+			.iInterface = 1,
+		},
+		.source = {
+			.bLength = sizeof(descriptors.hs_descs.source),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(512),
+		},
+		.sink = {
+			.bLength = sizeof(descriptors.hs_descs.sink),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(512),
+		},
+	},
+};
+
+#define STR_INTERFACE "ADB Interface"
+
+static const struct {
+	struct usb_functionfs_strings_head header;
+	struct {
+		__le16 code;
+		const char str1[sizeof(STR_INTERFACE)];
+	} __attribute__((packed)) lang0;
+} __attribute__((packed)) strings = {
+	.header = {
+		.magic = cpu_to_le32(FUNCTIONFS_STRINGS_MAGIC),
+		.length = cpu_to_le32(sizeof(strings)),
+		.str_count = cpu_to_le32(1),
+		.lang_count = cpu_to_le32(1),
+	},
+	.lang0 = {
+		cpu_to_le16(0x0409), /* en-us */
+		STR_INTERFACE,
+	},
+};
+
+static int usb_fd, ep0_fd, ep_in_fd, ep_out_fd;
+static unsigned host_in, host_out, ifnum;
+static size_t size, chunk;
+static int depth;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static void fill(unsigned char *buf, size_t len, size_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)((off + i) * 7 + ((off + i) >> 12));
+}
+
+static void check(const unsigned char *buf, size_t len, size_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != (unsigned char)((off + i) * 7 + ((off + i) >> 12))) {
+			fprintf(stderr, "data mismatch at offset %zu\n", off + i);
+			exit(1);
+		}
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+/* ep0 events are not interesting here, but keep the queue drained */
+static void *ep0_thread(void *arg)
+{
+	struct usb_functionfs_event event[4];
+
+	while (read(ep0_fd, event, sizeof(event)) > 0)
+		;
+	return NULL;
+}
+
+/* usbfs node of the enumerated gadget */
+static int open_host(unsigned vid, unsigned pid)
+{
+	char path[512];
+	unsigned v, p, bus, dev;
+	struct dirent *d;
+	DIR *dir;
+	FILE *f;
+	int i;
+
+	for (i = 0; i < 100; i++, usleep(100000)) {
+		dir = opendir("/sys/bus/usb/devices");
+		if (!dir)
+			return -1;
+		while ((d = readdir(dir))) {
+			snprintf(path, sizeof(path),
+				 "/sys/bus/usb/devices/%s/uevent", d->d_name);
+			f = fopen(path, "r");
+			if (!f)
+				continue;
+			v = p = bus = dev = 0;
+			while (fgets(path, sizeof(path), f)) {
+				sscanf(path, "PRODUCT=%x/%x", &v, &p);
+				sscanf(path, "BUSNUM=%u", &bus);
+				sscanf(path, "DEVNUM=%u", &dev);
+			}
+			fclose(f);
+			if (v == vid && p == pid && bus && dev) {
+				closedir(dir);
+				snprintf(path, sizeof(path),
+					 "/dev/bus/usb/%03u/%03u", bus, dev);
+				return open(path, O_RDWR);
+			}
+		}
+		closedir(dir);
+	}
+	errno = ENODEV;
+	return -1;
+}
+
+/* find the adb interface and its bulk endpoints on the host side */
+static int find_endpoints(void)
+{
+	unsigned char desc[4096];
+	int len, pos, in_adb = 0;
+
+	len = read(usb_fd, desc, sizeof(desc));
+	if (len < USB_DT_DEVICE_SIZE)
+		return -1;
+	for (pos = USB_DT_DEVICE_SIZE; pos + 2 <= len && desc[pos];
+	     pos += desc[pos]) {
+		if (desc[pos + 1] == USB_DT_INTERFACE) {
+			if (in_adb)
+				break;
+			in_adb = desc[pos + 5] == USB_CLASS_VENDOR_SPEC &&
+				 desc[pos + 6] == 0x42 && desc[pos + 7] == 1;
+			ifnum = desc[pos + 2];
+		} else if (in_adb && desc[pos + 1] == USB_DT_ENDPOINT &&
+			   (desc[pos + 3] & USB_ENDPOINT_XFERTYPE_MASK) ==
+			   USB_ENDPOINT_XFER_BULK) {
+			if (desc[pos + 2] & USB_DIR_IN)
+				host_in = desc[pos + 2];
+			else
+				host_out = desc[pos + 2];
+		}
+	}
+	return host_in && host_out ? 0 : -1;
+}
+
+static int bulk(unsigned ep, void *buf, size_t len)
+{
+	struct usbdevfs_bulktransfer bt = {
+		.ep = ep, .len = len, .timeout = 5000, .data = buf,
+	};
+
+	return ioctl(usb_fd, USBDEVFS_BULK, &bt);
+}
+
+/* gadget side: move size bytes through fd, depth requests at a time */
+static void gadget_io(int fd, int write_dir)
+{
+	aio_context_t ctx = 0;
+	struct iocb iocbs[MAX_DEPTH], *iocbp;
+	struct io_event ev[MAX_DEPTH];
+	unsigned char *bufs[MAX_DEPTH];
+	size_t submitted = 0, done = 0;
+	int i, n, inflight = 0;
+
+	for (i = 0; i < (depth ? depth : 1); i++)
+		if (posix_memalign((void **)&bufs[i], 4096, chunk))
+			die("posix_memalign");
+
+	if (!depth) {
+		for (; done < size; done += chunk) {
+			if (write_dir) {
+				fill(bufs[0], chunk, done);
+				if (write(fd, bufs[0], chunk) != (ssize_t)chunk)
+					die("write");
+			} else {
+				if (read(fd, bufs[0], chunk) != (ssize_t)chunk)
+					die("read");
+				check(bufs[0], chunk, done);
+			}
+		}
+		goto out;
+	}
+
+	if (syscall(__NR_io_setup, depth, &ctx))
+		die("io_setup");
+
+	while (done < size) {
+		for (i = 0; i < depth && inflight < depth && submitted < size;
+		     i++) {
+			struct iocb *cb = &iocbs[(submitted / chunk) % depth];
+
+			memset(cb, 0, sizeof(*cb));
+			cb->aio_fildes = fd;
+			cb->aio_lio_opcode = write_dir ? IOCB_CMD_PWRITE :
+							 IOCB_CMD_PREAD;
+			cb->aio_buf = (unsigned long)
+				bufs[(submitted / chunk) % depth];
+			cb->aio_nbytes = chunk;
+			cb->aio_data = submitted;
+			if (write_dir)
+				fill((unsigned char *)(unsigned long)cb->aio_buf,
+				     chunk, submitted);
+			iocbp = cb;
+			if (syscall(__NR_io_submit, ctx, 1, &iocbp) != 1)
+				die("io_submit");
+			submitted += chunk;
+			inflight++;
+		}
+
+		n = syscall(__NR_io_getevents, ctx, 1, depth, ev, NULL);
+		if (n < 0)
+			die("io_getevents");
+		for (i = 0; i < n; i++) {
+			struct iocb *cb = (struct iocb *)(unsigned long)ev[i].obj;
+
+			if (ev[i].res != (__s64)chunk) {
+				fprintf(stderr, "aio: %lld\n",
+					(long long)ev[i].res);
+				exit(1);
+			}
+			if (!write_dir)
+				check((unsigned char *)(unsigned long)cb->aio_buf,
+				      chunk, ev[i].data);
+		}
+		inflight -= n;
+		done += n * chunk;
+	}
+	syscall(__NR_io_destroy, ctx);
+out:
+	for (i = 0; i < (depth ? depth : 1); i++)
+		free(bufs[i]);
+}
+
+static void *gadget_send(void *arg)
+{
+	gadget_io(ep_in_fd, 1);
+	return NULL;
+}
+
+static void *gadget_receive(void *arg)
+{
+	gadget_io(ep_out_fd, 0);
+	return NULL;
+}
+
+static void run(const char *name)
+{
+	unsigned char *buf = malloc(chunk);
+	double start, cpu;
+	pthread_t thread;
+	size_t done;
+
+	if (!buf)
+		die("malloc");
+
+	start = now();
+	cpu = cpu_time();
+	pthread_create(&thread, NULL, gadget_send, NULL);
+	for (done = 0; done < size; done += chunk) {
+		if (bulk(host_in, buf, chunk) != (int)chunk)
+			die("bulk in");
+		check(buf, chunk, done);
+	}
+	pthread_join(thread, NULL);
+	printf("%-10s device->host %7.1f MB/s, cpu %3.0f%%\n", name,
+	       size / (now() - start) / 1e6,
+	       100 * (cpu_time() - cpu) / (now() - start));
+
+	start = now();
+	cpu = cpu_time();
+	pthread_create(&thread, NULL, gadget_receive, NULL);
+	for (done = 0; done < size; done += chunk) {
+		fill(buf, chunk, done);
+		if (bulk(host_out, buf, chunk) != (int)chunk)
+			die("bulk out");
+	}
+	pthread_join(thread, NULL);
+	printf("%-10s host->device %7.1f MB/s, cpu %3.0f%%\n", name,
+	       size / (now() - start) / 1e6,
+	       100 * (cpu_time() - cpu) / (now() - start));
+	free(buf);
+}
+
+int main(int argc, char **argv)
+{
+	char path[256], name[32];
+	unsigned vid, pid;
+	pthread_t thread;
+	int max_depth;
+
+	if (argc < 3 || sscanf(argv[2], "%x:%x", &vid, &pid) != 2) {
+		fprintf(stderr, "usage: %s <functionfs mount> <vid:pid> "
+			"[size MB] [chunk KB] [aio depth]\n", argv[0]);
+		return 1;
+	}
+	chunk = (argc > 4 ? atol(argv[4]) : 64) << 10;
+	size = (argc > 3 ? atol(argv[3]) : 64) << 20;
+	size -= size % chunk;
+	max_depth = argc > 5 ? atoi(argv[5]) : 8;
+	if (!chunk || !size || max_depth < 1 || max_depth > MAX_DEPTH) {
+		fprintf(stderr, "bad size, chunk or depth\n");
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/ep0", argv[1]);
+	ep0_fd = open(path, O_RDWR);
+	if (ep0_fd < 0)
+		die(path);
+	if (write(ep0_fd, &descriptors, sizeof(descriptors)) < 0)
+		die("write descriptors");
+	if (write(ep0_fd, &strings, sizeof(strings)) < 0)
+		die("write strings");
+	pthread_create(&thread, NULL, ep0_thread, NULL);
+
+	snprintf(path, sizeof(path), "%s/ep1", argv[1]);
+	ep_in_fd = open(path, O_RDWR);
+	snprintf(path, sizeof(path), "%s/ep2", argv[1]);
+	ep_out_fd = open(path, O_RDWR);
+	if (ep_in_fd < 0 || ep_out_fd < 0)
+		die(path);
+
+	usb_fd = open_host(vid, pid);
+	if (usb_fd < 0 || find_endpoints())
+		die("usbfs");
+	if (ioctl(usb_fd, USBDEVFS_CLAIMINTERFACE, &ifnum))
+		die("claim interface");
+
+	depth = 0;
+	run("sync");
+	for (depth = 1; depth <= max_depth; depth *= 2) {
+		snprintf(name, sizeof(name), "aio x%d", depth);
+		run(name);
+	}
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * MTP file transfer throughput over a dummy_hcd loopback: the gadget side
+ * runs MTP_SEND_FILE / MTP_RECEIVE_FILE on /dev/mtp_usb exactly as the MTP
+ * server does, and the host side drives the same interface through usbfs.
+ * Both directions are timed and the data is checked against a pattern.
+ *
+ * Usage: mtp_loopback <usbfs node> <scratch file> [size MB] [chunk KB]
+ *
+ * The usbfs node is /dev/bus/usb/BBB/DDD of the enumerated gadget; see
+ * mtp_loopback_bench for the setup.  Drop the page cache before running
+ * to include the storage read in the device-to-host number.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/f_mtp.h>
+
+static int usb_fd, mtp_fd, file_fd;
+static unsigned ep_in, ep_out, ifnum;
+static size_t size, chunk;
+static long xfer_ret;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(unsigned char *buf, size_t len, size_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)((off + i) * 7 + ((off + i) >> 12));
+}
+
+static int check(const unsigned char *buf, size_t len, size_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != (unsigned char)((off + i) * 7 + ((off + i) >> 12)))
+			return -1;
+	return 0;
+}
+
+/* find the vendor-specific MTP interface and its bulk endpoints */
+static int find_endpoints(void)
+{
+	unsigned char desc[4096];
+	int len, pos, in_mtp = 0;
+
+	len = read(usb_fd, desc, sizeof(desc));
+	if (len < USB_DT_DEVICE_SIZE)
+		return -1;
+	for (pos = USB_DT_DEVICE_SIZE; pos + 2 <= len && desc[pos];
+	     pos += desc[pos]) {
+		if (desc[pos + 1] == USB_DT_INTERFACE) {
+			if (in_mtp)
+				break;
+			in_mtp = desc[pos + 5] == USB_CLASS_VENDOR_SPEC &&
+				 desc[pos + 6] == USB_SUBCLASS_VENDOR_SPEC;
+			ifnum = desc[pos + 2];
+		} else if (in_mtp && desc[pos + 1] == USB_DT_ENDPOINT &&
+			   (desc[pos + 3] & USB_ENDPOINT_XFERTYPE_MASK) ==
+			   USB_ENDPOINT_XFER_BULK) {
+			if (desc[pos + 2] & USB_DIR_IN)
+				ep_in = desc[pos + 2];
+			else
+				ep_out = desc[pos + 2];
+		}
+	}
+	return ep_in && ep_out ? 0 : -1;
+}
+
+static int bulk(unsigned ep, void *buf, size_t len, unsigned timeout)
+{
+	struct usbdevfs_bulktransfer bt = {
+		.ep = ep, .len = len, .timeout = timeout, .data = buf,
+	};
+
+	return ioctl(usb_fd, USBDEVFS_BULK, &bt);
+}
+
+static void *send_file(void *arg)
+{
+	struct mtp_file_range mfr = { .fd = file_fd, .length = size };
+
+	xfer_ret = ioctl(mtp_fd, MTP_SEND_FILE, &mfr);
+	return NULL;
+}
+
+static void *receive_file(void *arg)
+{
+	struct mtp_file_range mfr = { .fd = file_fd, .length = size };
+
+	xfer_ret = ioctl(mtp_fd, MTP_RECEIVE_FILE, &mfr);
+	return NULL;
+}
+
+/* gadget reads the file and sends it, host receives it */
+static double device_to_host(unsigned char *buf)
+{
+	pthread_t thread;
+	double start, end;
+	size_t done = 0;
+	int ret;
+
+	start = now();
+	pthread_create(&thread, NULL, send_file, NULL);
+	while (done < size) {
+		ret = bulk(ep_in, buf, chunk, 5000);
+		if (ret <= 0) {
+			fprintf(stderr, "bulk in: %s\n", strerror(errno));
+			exit(1);
+		}
+		if (check(buf, ret, done)) {
+			fprintf(stderr, "data mismatch near offset %zu\n", done);
+			exit(1);
+		}
+		done += ret;
+	}
+	pthread_join(thread, NULL);
+	end = now();
+	if (xfer_ret) {
+		fprintf(stderr, "MTP_SEND_FILE: %ld\n", xfer_ret);
+		exit(1);
+	}
+	/* swallow the zero length packet that ends an aligned transfer */
+	bulk(ep_in, buf, chunk, 100);
+	return size / (end - start) / 1e6;
+}
+
+/* host sends, gadget receives and writes the file */
+static double host_to_device(unsigned char *buf)
+{
+	pthread_t thread;
+	double start, end;
+	size_t done = 0, len;
+	int ret;
+
+	if (ftruncate(file_fd, 0))
+		return 0;
+	start = now();
+	pthread_create(&thread, NULL, receive_file, NULL);
+	while (done < size) {
+		len = size - done < chunk ? size - done : chunk;
+		fill(buf, len, done);
+		ret = bulk(ep_out, buf, len, 5000);
+		if (ret <= 0) {
+			fprintf(stderr, "bulk out: %s\n", strerror(errno));
+			exit(1);
+		}
+		done += ret;
+	}
+	pthread_join(thread, NULL);
+	fsync(file_fd);
+	end = now();
+	if (xfer_ret) {
+		fprintf(stderr, "MTP_RECEIVE_FILE: %ld\n", xfer_ret);
+		exit(1);
+	}
+
+	for (done = 0; done < size; done += ret) {
+		ret = pread(file_fd, buf, chunk, done);
+		if (ret <= 0 || check(buf, ret, done)) {
+			fprintf(stderr, "file mismatch near offset %zu\n", done);
+			exit(1);
+		}
+	}
+	return size / (end - start) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *buf;
+	size_t off, len;
+
+	if (argc < 3) {
+		fprintf(stderr,
+			"usage: %s <usbfs node> <scratch file> [size MB] [chunk KB]\n",
+			argv[0]);
+		return 1;
+	}
+	size = (argc > 3 ? atol(argv[3]) : 64) << 20;
+	chunk = (argc > 4 ? atol(argv[4]) : 256) << 10;
+
+	usb_fd = open(argv[1], O_RDWR);
+	if (usb_fd < 0 || find_endpoints()) {
+		perror(argv[1]);
+		return 1;
+	}
+	if (ioctl(usb_fd, USBDEVFS_CLAIMINTERFACE, &ifnum)) {
+		perror("claim interface");
+		return 1;
+	}
+	mtp_fd = open("/dev/mtp_usb", O_RDWR);
+	if (mtp_fd < 0) {
+		perror("/dev/mtp_usb");
+		return 1;
+	}
+	file_fd = open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0600);
+	buf = malloc(chunk);
+	if (file_fd < 0 || !buf) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	for (off = 0; off < size; off += len) {
+		len = size - off < chunk ? size - off : chunk;
+		fill(buf, len, off);
+		if (write(file_fd, buf, len) != (ssize_t)len) {
+			perror("write");
+			return 1;
+		}
+	}
+	fsync(file_fd);
+	posix_fadvise(file_fd, 0, 0, POSIX_FADV_DONTNEED);
+
+	printf("device->host %.1f MB/s\n", device_to_host(buf));
+	printf("host->device %.1f MB/s\n", host_to_device(buf));
+
+	unlink(argv[2]);
+	return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Exercise /proc/<pid>/reclaim.
+ *
+ * A child dirties an anonymous buffer and maps a file, the parent asks the
+ * kernel to reclaim the child's anon, file or all pages and reports the
+ * resident set before and after, the pgreclaim_proc/pgskip_proc deltas
+ * from /proc/vmstat and how long it takes the child to fault the pages
+ * back in afterwards.
+ *
+ * Anonymous pages can only be reclaimed with swap (or zram) enabled; the
+ * test still runs without, but only the file pass will show any effect.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MB		(1024 * 1024)
+#define BUF_MB		64
+
+static long page_size;
+
+static long rss_kb(pid_t pid)
+{
+	char path[64];
+	long size, rss = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+		rss = -1;
+	fclose(f);
+	return rss * (page_size / 1024);
+}
+
+static unsigned long vmstat(const char *name)
+{
+	char key[64];
+	unsigned long val;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %lu", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			fclose(f);
+			return val;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+static int reclaim(pid_t pid, const char *type)
+{
+	char path[64];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "/proc/%d/reclaim", pid);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, type, strlen(type));
+	close(fd);
+	return ret < 0 ? -1 : 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * The child touches everything once, then re-touches and reports the time
+ * it took every time the parent pokes it with SIGUSR1.
+ */
+static volatile sig_atomic_t poked;
+
+static void poke(int sig)
+{
+	poked = 1;
+}
+
+static void child(int ready, int done)
+{
+	char tmpl[] = "/tmp/process_reclaimXXXXXX";
+	volatile char *anon, *file;
+	volatile char sum = 0;
+	double start;
+	sigset_t mask, old;
+	long i;
+	int fd;
+
+	fd = mkstemp(tmpl);
+	if (fd < 0 || ftruncate(fd, BUF_MB * MB))
+		exit(1);
+	unlink(tmpl);
+
+	anon = mmap(NULL, BUF_MB * MB, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	file = mmap(NULL, BUF_MB * MB, PROT_READ, MAP_SHARED, fd, 0);
+	if (anon == MAP_FAILED || file == MAP_FAILED)
+		exit(1);
+
+	for (i = 0; i < BUF_MB * MB; i += page_size) {
+		anon[i] = i;
+		sum += file[i];
+	}
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &mask, &old);
+	signal(SIGUSR1, poke);
+	if (write(ready, "r", 1) != 1)
+		exit(1);
+
+	for (;;) {
+		while (!poked)
+			sigsuspend(&old);
+		poked = 0;
+
+		start = now();
+		for (i = 0; i < BUF_MB * MB; i += page_size)
+			sum += anon[i] + file[i];
+		start = now() - start;
+		if (write(done, &start, sizeof(start)) != sizeof(start))
+			exit(1);
+	}
+}
+
+int main(void)
+{
+	static const char *types[] = { "file", "anon", "all" };
+	unsigned long reclaimed, skipped;
+	int ready[2], done[2];
+	double rewarm;
+	long before, after;
+	unsigned int i;
+	pid_t pid;
+	char c;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (access("/proc/self/reclaim", W_OK)) {
+		printf("process_reclaim: /proc/<pid>/reclaim not available [SKIP]\n");
+		return 0;
+	}
+
+	if (pipe(ready) || pipe(done))
+		return 1;
+
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (!pid)
+		child(ready[1], done[1]);
+
+	if (read(ready[0], &c, 1) != 1) {
+		printf("process_reclaim: child failed to set up [FAIL]\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		/* fault everything back in so each pass starts fully resident */
+		kill(pid, SIGUSR1);
+		if (read(done[0], &rewarm, sizeof(rewarm)) != sizeof(rewarm))
+			break;
+
+		reclaimed = vmstat("pgreclaim_proc");
+		skipped = vmstat("pgskip_proc");
+		before = rss_kb(pid);
+		if (reclaim(pid, types[i])) {
+			printf("process_reclaim: write %s failed [FAIL]\n",
+			       types[i]);
+			break;
+		}
+		after = rss_kb(pid);
+		reclaimed = vmstat("pgreclaim_proc") - reclaimed;
+		skipped = vmstat("pgskip_proc") - skipped;
+
+		kill(pid, SIGUSR1);
+		if (read(done[0], &rewarm, sizeof(rewarm)) != sizeof(rewarm))
+			break;
+
+		printf("%-4s: rss %ld kB -> %ld kB, reclaimed %lu skipped %lu "
+		       "pages, re-warm %.1f ms (%.2f us/page)\n",
+		       types[i], before, after, reclaimed, skipped,
+		       rewarm * 1e3,
+		       rewarm * 1e6 / (2.0 * BUF_MB * MB / page_size));
+	}
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	return 0;
+}
@@ -1937,6 +1937,8 @@ static int hif_sdio_probe (
         HIF_SDIO_ERR_FUNC("sdio_enable_func failed!\n");
         goto out;
     }
+    /* the card and msdc host above are still ordered as our parents */
+    device_enable_async_suspend(&func->dev);
     if (0 == _hif_sdio_is_autok_support(func))
     {
         //_hif_sdio_do_autok(func);
@@ -0,0 +1,276 @@
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/pmprof.h>
+#include <asm/uaccess.h>
+
+/*
+ * Per-device suspend/resume timing of the last system sleep cycle.
+ * drivers/base/power/main.c logs every callback it runs and the length
+ * of every phase; /proc/pmprof prints them slowest first. Userspace can
+ * write a marker (e.g. "screen on") to see how long after the end of
+ * device resume it happened.
+ */
+
+#define PM_NAME_SIZE 32
+#define PM_LOG_NUM 512
+#define PM_PHASE_NUM 16
+#define PM_MARK_NUM 8
+
+struct pm_dev_log {
+    char name[PM_NAME_SIZE];
+    char driver[PM_NAME_SIZE];
+    const char *info;
+    int event;
+    u32 start_us;       /* since pmprof_start() */
+    u32 dur_us;
+    int error;
+    int cpu;
+    bool async;
+};
+
+struct pm_phase_log {
+    const char *info;
+    int event;
+    u32 dur_us;
+};
+
+struct pm_mark_log {
+    char event[PM_NAME_SIZE];
+    u32 after_us;       /* since the end of device resume */
+};
+
+static struct pm_dev_log mt_pmprof[PM_LOG_NUM];
+static struct pm_phase_log mt_pmprof_phase[PM_PHASE_NUM];
+static struct pm_mark_log mt_pmprof_mark[PM_MARK_NUM];
+static int pm_log_count, pm_log_lost, pm_phase_count, pm_mark_count;
+static ktime_t pm_cycle_start, pm_resume_done;
+
+static DEFINE_SPINLOCK(mt_pmprof_lock);
+static int mt_pmprof_enabled = 1;
+
+static const char *pmprof_verb(int event)
+{
+    switch (event) {
+    case PM_EVENT_SUSPEND:
+        return "suspend";
+    case PM_EVENT_RESUME:
+        return "resume";
+    case PM_EVENT_FREEZE:
+        return "freeze";
+    case PM_EVENT_HIBERNATE:
+        return "hibernate";
+    case PM_EVENT_THAW:
+        return "thaw";
+    case PM_EVENT_RESTORE:
+        return "restore";
+    case PM_EVENT_RECOVER:
+        return "recover";
+    default:
+        return "?";
+    }
+}
+
+static u32 pmprof_us(ktime_t from, ktime_t to)
+{
+    s64 us = ktime_to_us(ktime_sub(to, from));
+
+    return us < 0 ? 0 : (u32)us;
+}
+
+void pmprof_start(void)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&mt_pmprof_lock, flags);
+    pm_log_count = 0;
+    pm_log_lost = 0;
+    pm_phase_count = 0;
+    pm_mark_count = 0;
+    pm_cycle_start = ktime_get();
+    pm_resume_done = ktime_set(0, 0);
+    spin_unlock_irqrestore(&mt_pmprof_lock, flags);
+}
+
+/* Called for every callback, possibly from several async threads at once */
+void log_pm_dev(struct device *dev, pm_message_t state, const char *info,
+                ktime_t start, ktime_t end, int error)
+{
+    struct pm_dev_log *log;
+    unsigned long flags;
+
+    if (!mt_pmprof_enabled)
+        return;
+
+    spin_lock_irqsave(&mt_pmprof_lock, flags);
+    if (pm_log_count >= PM_LOG_NUM)
+    {
+        pm_log_lost++;
+        spin_unlock_irqrestore(&mt_pmprof_lock, flags);
+        return;
+    }
+    log = &mt_pmprof[pm_log_count++];
+    strlcpy(log->name, dev_name(dev), PM_NAME_SIZE);
+    strlcpy(log->driver, dev->driver ? dev->driver->name : "", PM_NAME_SIZE);
+    log->info = info ? info : "";
+    log->event = state.event;
+    log->start_us = pmprof_us(pm_cycle_start, start);
+    log->dur_us = pmprof_us(start, end);
+    log->error = error;
+    log->cpu = raw_smp_processor_id();
+    log->async = dev->power.async_suspend;
+    spin_unlock_irqrestore(&mt_pmprof_lock, flags);
+}
+
+void log_pm_phase(pm_message_t state, const char *info, ktime_t start,
+                  ktime_t end)
+{
+    unsigned long flags;
+
+    if (!mt_pmprof_enabled)
+        return;
+
+    spin_lock_irqsave(&mt_pmprof_lock, flags);
+    if (pm_phase_count < PM_PHASE_NUM)
+    {
+        mt_pmprof_phase[pm_phase_count].info = info ? info : "";
+        mt_pmprof_phase[pm_phase_count].event = state.event;
+        mt_pmprof_phase[pm_phase_count].dur_us = pmprof_us(start, end);
+        pm_phase_count++;
+    }
+    /* The plain resume phase is the last one to run devices */
+    if (!info && (state.event == PM_EVENT_RESUME ||
+                  state.event == PM_EVENT_RESTORE))
+        pm_resume_done = end;
+    spin_unlock_irqrestore(&mt_pmprof_lock, flags);
+}
+
+static void log_pm_mark(const char *str)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&mt_pmprof_lock, flags);
+    if (pm_mark_count < PM_MARK_NUM && ktime_to_ns(pm_resume_done))
+    {
+        strlcpy(mt_pmprof_mark[pm_mark_count].event, str, PM_NAME_SIZE);
+        mt_pmprof_mark[pm_mark_count].after_us =
+            pmprof_us(pm_resume_done, ktime_get());
+        pm_mark_count++;
+    }
+    spin_unlock_irqrestore(&mt_pmprof_lock, flags);
+}
+
+static ssize_t mt_pmprof_write(struct file *filp, const char *ubuf,
+       size_t cnt, loff_t *data)
+{
+    char buf[PM_NAME_SIZE];
+    size_t copy_size = cnt;
+
+    if (cnt >= sizeof(buf))
+        copy_size = PM_NAME_SIZE - 1;
+
+    if (copy_from_user(&buf, ubuf, copy_size))
+        return -EFAULT;
+
+    buf[copy_size] = 0;
+    if (copy_size && buf[copy_size - 1] == '\n')
+        buf[copy_size - 1] = 0;
+
+    if (!strcmp(buf, "0"))
+        mt_pmprof_enabled = 0;
+    else if (!strcmp(buf, "1"))
+        mt_pmprof_enabled = 1;
+    else if (buf[0])
+        log_pm_mark(buf);
+
+    return cnt;
+}
+
+static int pmprof_cmp(const void *a, const void *b)
+{
+    const struct pm_dev_log *x = *(const struct pm_dev_log **)a;
+    const struct pm_dev_log *y = *(const struct pm_dev_log **)b;
+
+    return x->dur_us < y->dur_us ? 1 : (x->dur_us > y->dur_us ? -1 : 0);
+}
+
+static int mt_pmprof_show(struct seq_file *m, void *v)
+{
+    struct pm_dev_log **order;
+    struct pm_dev_log *log;
+    char callback[PM_NAME_SIZE];
+    int i, count;
+
+    /*
+     * Userspace is frozen for the whole transition, so nothing logs
+     * while this runs.
+     */
+    count = pm_log_count;
+    order = kmalloc(PM_LOG_NUM * sizeof(*order), GFP_KERNEL);
+    if (!order)
+        return -ENOMEM;
+
+    seq_printf(m, "----------------------------------------\n");
+    seq_printf(m, "%d	    PM PROF (unit:usec)\n", mt_pmprof_enabled);
+    seq_printf(m, "----------------------------------------\n");
+
+    for (i = 0; i < pm_phase_count; i++)
+        seq_printf(m, "%10u : %s%s%s\n", mt_pmprof_phase[i].dur_us,
+            mt_pmprof_phase[i].info, mt_pmprof_phase[i].info[0] ? " " : "",
+            pmprof_verb(mt_pmprof_phase[i].event));
+    for (i = 0; i < pm_mark_count; i++)
+        seq_printf(m, "%10u : resume done -> %s\n",
+            mt_pmprof_mark[i].after_us, mt_pmprof_mark[i].event);
+    if (pm_log_lost)
+        seq_printf(m, "%10d : callbacks not logged, table full\n", pm_log_lost);
+
+    for (i = 0; i < count; i++)
+        order[i] = &mt_pmprof[i];
+    sort(order, count, sizeof(*order), pmprof_cmp, NULL);
+
+    seq_printf(m, "----------------------------------------\n");
+    seq_printf(m, "%10s %10s %3s %5s %4s  %-24s %s\n", "dur", "start",
+        "cpu", "async", "err", "callback", "device (driver)");
+    for (i = 0; i < count; i++) {
+        log = order[i];
+        snprintf(callback, sizeof(callback), "%s%s", log->info,
+            pmprof_verb(log->event));
+        seq_printf(m, "%10u %10u %3d %5s %4d  %-24s %s (%s)\n",
+            log->dur_us, log->start_us, log->cpu,
+            log->async ? "yes" : "no", log->error, callback,
+            log->name, log->driver);
+    }
+    seq_printf(m, "----------------------------------------\n");
+
+    kfree(order);
+    return 0;
+}
+
+static int mt_pmprof_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, mt_pmprof_show, inode->i_private);
+}
+
+static const struct file_operations mt_pmprof_fops = {
+    .open = mt_pmprof_open,
+    .write = mt_pmprof_write,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int __init init_pm_prof(void)
+{
+    struct proc_dir_entry *pe;
+
+    pe = proc_create("pmprof", 0664, NULL, &mt_pmprof_fops);
+    if (!pe)
+        return -ENOMEM;
+    return 0;
+}
+__initcall(init_pm_prof);
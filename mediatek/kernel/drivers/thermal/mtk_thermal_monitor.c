@@ -1019,8 +1019,9 @@ static void _mtm_update_sysinfo(struct work_struct *work)
 
     cancel_delayed_work(&_mtm_sysinfo_poll_queue);
 
+    /* Land on the same second boundary as the thermal core's poll batch. */
     if (_mtm_interval != 0)
-        queue_delayed_work(system_freezable_wq, &_mtm_sysinfo_poll_queue, msecs_to_jiffies(_mtm_interval));
+        queue_delayed_work(system_freezable_wq, &_mtm_sysinfo_poll_queue, round_jiffies_relative(msecs_to_jiffies(_mtm_interval)));
 }
 
 static void _mtm_decide_new_delay(void)
@@ -1058,6 +1059,29 @@ static void _mtm_decide_new_delay(void)
 //************************************
 
 /* Read */
+static void mtkthermal_read_poll_stats(struct seq_file *m)
+{
+    unsigned long batches, reads, nominal, elapsed_ms, saved;
+
+    seq_printf(m, "\r\n[Thermal zone polling]\r\n");
+    seq_printf(m, "=========================================\r\n" );
+
+    if (!thermal_poll_get_stats(&batches, &reads, &nominal, &elapsed_ms))
+    {
+        seq_printf(m, "coalesced polling disabled\r\n");
+        return;
+    }
+
+    /* nominal is in 1/1000 wakeups, elapsed in ms: the ratio is per second */
+    saved = (nominal > batches * 1000) ? nominal - batches * 1000 : 0;
+    elapsed_ms = elapsed_ms ? elapsed_ms : 1;
+
+    seq_printf(m, "zone reads = %lu\r\n", reads);
+    seq_printf(m, "batch wakeups = %lu\r\n", batches);
+    seq_printf(m, "unbatched wakeups = %lu\r\n", nominal / 1000);
+    seq_printf(m, "wakeups/s saved = %lu.%03lu\r\n", saved / elapsed_ms, (saved % elapsed_ms) * 1000 / elapsed_ms);
+}
+
 static int mtkthermal_read(struct seq_file *m, void *v)
 {
     seq_printf(m, "\r\n[Thermal Monitor debug flag]\r\n");
@@ -1066,6 +1090,8 @@ static int mtkthermal_read(struct seq_file *m, void *v)
     seq_printf(m, "enable_ThermalMonitorXlog = %d\r\n", enable_ThermalMonitorXlog);
     seq_printf(m, "g_nStartRealTime = %d\r\n", g_nStartRealTime);
 
+    mtkthermal_read_poll_stats(m);
+
     xlog_printk(ANDROID_LOG_INFO, "THERMAL/MONITOR", "[mtkthermal_monitor] enable_ThermalMonitor:%d\n", enable_ThermalMonitor);
 
     return 0;
@@ -1799,7 +1825,7 @@ static int __init mtkthermal_init(void)
     md32_register_notify(&mtk_thermal_ext_nb);
 #endif
 
-    INIT_DELAYED_WORK(&_mtm_sysinfo_poll_queue, _mtm_update_sysinfo);
+    INIT_DEFERRABLE_WORK(&_mtm_sysinfo_poll_queue, _mtm_update_sysinfo);
     _mtm_update_sysinfo(NULL);
 
     return err;
@@ -0,0 +1,28 @@
+/*
+  device suspend/resume logger: drivers/misc/mtprof/pmprof
+  interface: /proc/pmprof
+*/
+#ifndef _PMPROF_H
+#define _PMPROF_H
+
+#include <linux/ktime.h>
+#include <linux/pm.h>
+
+struct device;
+
+#ifdef CONFIG_PM_SLEEP
+extern void pmprof_start(void);
+extern void log_pm_dev(struct device *dev, pm_message_t state, const char *info,
+                       ktime_t start, ktime_t end, int error);
+extern void log_pm_phase(pm_message_t state, const char *info,
+                         ktime_t start, ktime_t end);
+#else
+static inline void pmprof_start(void){}
+static inline void log_pm_dev(struct device *dev, pm_message_t state,
+                              const char *info, ktime_t start, ktime_t end,
+                              int error){}
+static inline void log_pm_phase(pm_message_t state, const char *info,
+                                ktime_t start, ktime_t end){}
+#endif
+
+#endif
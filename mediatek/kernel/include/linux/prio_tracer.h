@@ -9,10 +9,10 @@
 #define PTS_KRNL 1
 #define PTS_BNDR 2
 
-extern void create_prio_tracer(pid_t tid);
-extern void delete_prio_tracer(pid_t tid);
+extern void create_prio_tracer(struct task_struct *p);
 
-extern void update_prio_tracer(pid_t tid, int prio, int policy, int kernel);
+extern void update_prio_tracer(struct task_struct *p, int prio, int policy,
+			       int kernel);
 
 extern void set_user_nice_syscall(struct task_struct *p, long nice);
 extern void set_user_nice_binder(struct task_struct *p, long nice);
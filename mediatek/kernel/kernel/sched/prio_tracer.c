@@ -12,32 +12,32 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/module.h>
-#include <linux/rbtree.h>
-#include <linux/spinlock.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/uaccess.h>
 
-DEFINE_SPINLOCK(pts_lock);
-
-static struct rb_root priority_tracers;
 static struct dentry *pts_debugfs_dir_root;
-static struct dentry *pts_debugfs_dir_proc;
-static const struct file_operations pts_proc_fops;
 static unsigned long pts_enable;
 
+/*
+ * Each thread keeps its own tracer in task_struct, so fork, exit and the
+ * priority setters never share a lock or search a tree. A setting packs
+ * prio and policy in one word; 0 means nothing recorded yet, which is what
+ * create_prio_tracer() leaves behind.
+ */
+#define PTS_PACK(prio, policy)	((((u32)(policy) + 1) << 16) | ((prio) & 0xffff))
+#define PTS_PRIO(v)		((int)((v) & 0xffff))
+#define PTS_POLICY(v)		((int)((v) >> 16) - 1)
+
 struct prio_set {
 	int prio;
 	int policy;
 };
 
-struct prio_tracer {
-	pid_t tid;
-	struct rb_node rb_node;
-	struct dentry *debugfs_entry;
-
+/* consistent copy of a task's tracer, taken by the debugfs reader */
+struct prio_snapshot {
 	unsigned int count_usr;
 	unsigned int count_ker;
 	unsigned int change_usr;
@@ -62,8 +62,6 @@ static inline int __normal_prio(struct task_struct *p)
  * syscall and kernel respectively. the record will be saved like the
  * followings. syscall uses the first 2, while kernel takes the rest 2.
  *
- *     MUST hold pts_lock.
- *
  * count:    1   2   3   4   5 ...
  *   set:   t1  t0  t1  t0  t1 ...
  *
@@ -72,165 +70,102 @@ static inline int __normal_prio(struct task_struct *p)
  *   odd |  t0  |   t1
  *  even |  t1  |   t0
  *
+ * @count:	number of settings recorded so far on this side.
  * @next:	2 meanings while set. one is to find the next to overwrite.
  *		and, the other is to point to the second latest.
  * @kernel:	0 for user, 1 for kernel. 2 for binder, but here we treat it
  *		as kernel does .
  */ 
-static struct prio_set *select_set(struct prio_tracer *pt, int next, int kernel)
-{
-	int count = kernel ? pt->count_ker : pt->count_usr;
-	int i;
-	
-	i = (((count % 2) == (!!next)) ? 0 : 1) + (kernel ? 2 : 0);
-	return &pt->ps[i];
-}
-
-/**
- * query_prio_tracer -
- * note: called under @pts_lock protected
- */
-static struct prio_tracer *query_prio_tracer(pid_t tid)
+static int select_set(unsigned int count, int next, int kernel)
 {
-	struct rb_node *n = priority_tracers.rb_node;
-	struct prio_tracer *pt;
-
-	while (n) {
-		pt = rb_entry(n, struct prio_tracer, rb_node);
-
-		if (tid < pt->tid)
-			n = n->rb_left;
-		else if (tid > pt->tid)
-			n = n->rb_right;
-		else {
-			return pt;
-		}
-	}
-	return NULL;
+	return (((count % 2) == (!!next)) ? 0 : 1) + (kernel ? 2 : 0);
 }
 
 /**
  * update_prio_tracer -
  * @prio:	equivalent to prio of task structure.
+ *
+ * Lock-free. Concurrent updates of the same thread each reserve their own
+ * count first; @done tells readers when all of them have landed.
  */
-void update_prio_tracer(pid_t tid, int prio, int policy, int kernel)
+void update_prio_tracer(struct task_struct *p, int prio, int policy, int kernel)
 {
-	struct prio_tracer *pt;
-	struct prio_set *ps, *ps_latest;
-	unsigned long flags;
+	struct prio_tracer *pt = &p->prio_tracer;
+	unsigned int count;
+	u32 v = PTS_PACK(prio, policy);
+	int k = !!kernel;
 
 	if (!pts_enable) return;
 
-	spin_lock_irqsave(&pts_lock, flags);
-	pt = query_prio_tracer(tid);
-	if (!pt) {
-		spin_unlock_irqrestore(&pts_lock, flags);
-		return;
-	}
-
-	ps = select_set(pt, 1, kernel);
-	ps->prio = prio;
-	ps->policy = policy;
+	count = atomic_inc_return(&pt->count[k]) - 1;
 
-	ps_latest = select_set(pt, 0, kernel);
-	if (ps_latest->prio != prio || ps_latest->policy != policy)
-		kernel ? pt->change_ker++ : pt->change_usr++;
-
-	kernel ? pt->count_ker++ : pt->count_usr++;
+	if (ACCESS_ONCE(pt->ps[select_set(count, 0, k)]) != v)
+		atomic_inc(&pt->change[k]);
+	ACCESS_ONCE(pt->ps[select_set(count, 1, k)]) = v;
 
 	/* binder priority inherit */
 	if (kernel == PTS_BNDR)
-		pt->prio_binder = prio;
-	spin_unlock_irqrestore(&pts_lock, flags);
+		ACCESS_ONCE(pt->prio_binder) = prio + 1;
+
+	smp_mb__before_atomic_inc();
+	atomic_inc(&pt->done);
 }
 
-void create_prio_tracer(pid_t tid)
+/*
+ * Called for the child before it first runs; drop what dup_task_struct()
+ * copied from the parent.
+ */
+void create_prio_tracer(struct task_struct *p)
 {
-	struct rb_node **p = &priority_tracers.rb_node;
-	struct rb_node *parent = NULL;
-	struct prio_tracer *new_pt, *pt;
-	struct dentry *d = NULL;
-	unsigned long flags;
-	int i;
-
-	new_pt = kzalloc(sizeof(struct prio_tracer), GFP_KERNEL);
-	if (!new_pt) {
-		printk(KERN_ERR "%s: alloc failed\n", __func__);
-		return;
-	}
-
-	if (pts_debugfs_dir_proc) {
-		char strbuf[11];
-		snprintf(strbuf, sizeof(strbuf), "%u", tid);
-		/* debugfs involves mutex... */
-		d = debugfs_create_file(strbuf,
-					S_IRUGO, pts_debugfs_dir_proc,
-					new_pt, &pts_proc_fops);
-	}
-
-	spin_lock_irqsave(&pts_lock, flags);
-	while (*p) {
-		parent = *p;
-		pt = rb_entry(parent, struct prio_tracer, rb_node);
-
-		if (tid < pt->tid)
-			p = &(*p)->rb_left;
-		else if (tid > pt->tid)
-			p = &(*p)->rb_right;
-		else {
-			spin_unlock_irqrestore(&pts_lock, flags);
-			debugfs_remove(d);
-			kfree(new_pt);
-			printk(KERN_ERR "%s: find same pid\n", __func__);
-			return;
-		}
-	}
-
-	new_pt->tid = tid;
-	for (i = 0; i < 4; i++)
-		new_pt->ps[i].policy = -1;
-	new_pt->prio_binder = PTS_DEFAULT_PRIO;
-	new_pt->debugfs_entry = d;
-
-	rb_link_node(&new_pt->rb_node, parent, p);
-	rb_insert_color(&new_pt->rb_node, &priority_tracers);
-	spin_unlock_irqrestore(&pts_lock, flags);
+	memset(&p->prio_tracer, 0, sizeof(p->prio_tracer));
 }
 
-void delete_prio_tracer(pid_t tid)
+/**
+ * snapshot_prio_tracer - copy @pt once no update is half done
+ *
+ * Gives up after a few tries on a thread whose priority is being changed
+ * non-stop; the copy is then at worst one setting behind.
+ */
+static void snapshot_prio_tracer(struct prio_tracer *pt,
+				 struct prio_snapshot *s)
 {
-	struct prio_tracer *pt;
-	struct dentry *d;
-	unsigned long flags;
-
-	spin_lock_irqsave(&pts_lock, flags);
-	pt = query_prio_tracer(tid);
-	if (!pt) {
-		spin_unlock_irqrestore(&pts_lock, flags);
-		return;
-	}
-	d = pt->debugfs_entry;
-	spin_unlock_irqrestore(&pts_lock, flags);
-
-	/* debugfs involves mutex... */
-	debugfs_remove(d);
-
-	spin_lock_irqsave(&pts_lock, flags);
-	rb_erase(&pt->rb_node, &priority_tracers);
-	kfree(pt);
-	spin_unlock_irqrestore(&pts_lock, flags);
+	unsigned int done;
+	int i, retry = 8;
+	u32 v;
+
+	do {
+		done = atomic_read(&pt->done);
+		smp_rmb();
+		s->count_usr = atomic_read(&pt->count[PTS_USER]);
+		s->count_ker = atomic_read(&pt->count[PTS_KRNL]);
+		s->change_usr = atomic_read(&pt->change[PTS_USER]);
+		s->change_ker = atomic_read(&pt->change[PTS_KRNL]);
+		for (i = 0; i < 2; i++) {
+			v = ACCESS_ONCE(pt->ps[select_set(s->count_usr, i, 0)]);
+			s->ps[i].prio = PTS_PRIO(v);
+			s->ps[i].policy = PTS_POLICY(v);
+			v = ACCESS_ONCE(pt->ps[select_set(s->count_ker, i, 1)]);
+			s->ps[i + 2].prio = PTS_PRIO(v);
+			s->ps[i + 2].policy = PTS_POLICY(v);
+		}
+		s->prio_binder = ACCESS_ONCE(pt->prio_binder) - 1;
+		if (s->prio_binder < 0)
+			s->prio_binder = PTS_DEFAULT_PRIO;
+		smp_rmb();
+	} while ((s->count_usr + s->count_ker != done ||
+		  atomic_read(&pt->done) != done) && --retry);
 }
 
 void set_user_nice_syscall(struct task_struct *p, long nice)
 {
 	set_user_nice_core(p, nice);
-	update_prio_tracer(task_pid_nr(p), NICE_TO_PRIO(nice), 0, PTS_USER);
+	update_prio_tracer(p, NICE_TO_PRIO(nice), 0, PTS_USER);
 }
 
 void set_user_nice_binder(struct task_struct *p, long nice)
 {
 	set_user_nice_core(p, nice);
-	update_prio_tracer(task_pid_nr(p), NICE_TO_PRIO(nice), 0, PTS_BNDR);
+	update_prio_tracer(p, NICE_TO_PRIO(nice), 0, PTS_BNDR);
 }
 
 int sched_setscheduler_syscall(struct task_struct *p, int policy,
@@ -245,7 +180,7 @@ int sched_setscheduler_syscall(struct task_struct *p, int policy,
 			prio = __normal_prio(p);
 		else
 			prio = MAX_RT_PRIO-1 - prio;
-		update_prio_tracer(task_pid_nr(p), prio, policy, PTS_USER);
+		update_prio_tracer(p, prio, policy, PTS_USER);
 	}
 	return retval;
 }
@@ -262,7 +197,7 @@ int sched_setscheduler_nocheck_binder(struct task_struct *p, int policy,
 			prio = __normal_prio(p);
 		else
 			prio = MAX_RT_PRIO-1 - prio;
-		update_prio_tracer(task_pid_nr(p), prio, policy, PTS_BNDR);
+		update_prio_tracer(p, prio, policy, PTS_BNDR);
 	}
 	return retval;
 }
@@ -284,45 +219,44 @@ static void pts_proc_print(struct seq_file *m, struct prio_set *ps)
 	seq_printf(m, " %d ", ps->policy);
 }
 
-static int pts_proc_show(struct seq_file *m, void *unused)
+static void pts_proc_show_one(struct seq_file *m, struct task_struct *p)
 {
-	struct prio_tracer *pt = m->private;
-	struct prio_set ps_copy[4];
-	unsigned int count_usr, count_ker;
-	unsigned int change_usr, change_ker;
+	struct prio_snapshot s;
 	int prio_binder;
-	int i, j;
-	unsigned long flags;
-
-	spin_lock_irqsave(&pts_lock, flags);
-	count_usr   = pt->count_usr;
-	count_ker   = pt->count_ker;
-	change_usr  = pt->change_usr;
-	change_ker  = pt->change_ker;
-	prio_binder = pt->prio_binder;
-
-	for (i = 0; i < 2; i++) {
-		for (j = 0; j < 2; j++) {
-			memcpy(&ps_copy[((i*2)+j)], select_set(pt, j, i),
-			       sizeof(struct prio_set));
-		}
-	}
-	spin_unlock_irqrestore(&pts_lock, flags);
+	int i;
 
-	seq_printf(m, "%u %u ", count_usr, change_usr);
+	snapshot_prio_tracer(&p->prio_tracer, &s);
+
+	seq_printf(m, "%d %u %u ", task_pid_nr(p), s.count_usr, s.change_usr);
 	for (i = 0; i < 2; i++)
-		pts_proc_print(m, &ps_copy[i]);
+		pts_proc_print(m, &s.ps[i]);
 
-	seq_printf(m, " %u %u ", count_ker, change_ker);
+	seq_printf(m, " %u %u ", s.count_ker, s.change_ker);
 	for (i = 2; i < 4; i++)
-		pts_proc_print(m, &ps_copy[i]);
+		pts_proc_print(m, &s.ps[i]);
 
+	prio_binder = s.prio_binder;
 	if (prio_binder != PTS_DEFAULT_PRIO) {
 		int tmp = prio_binder;
 		prio_binder = rt_prio(tmp) ? (tmp - MAX_RT_PRIO) :
 					     USER_PRIO(tmp);
 	}
 	seq_printf(m, " %d\n", prio_binder);
+}
+
+/*
+ * One line per thread: the tid, then what used to be in proc/<tid>. The
+ * copies are only taken here, while reading.
+ */
+static int pts_proc_show(struct seq_file *m, void *unused)
+{
+	struct task_struct *g, *p;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		pts_proc_show_one(m, p);
+	} while_each_thread(g, p);
+	rcu_read_unlock();
 	return 0;
 }
 
@@ -499,8 +433,9 @@ static int __init prio_tracer_init(void)
 	pts_debugfs_dir_root = debugfs_create_dir("prio_tracer", NULL);
 
 	if (pts_debugfs_dir_root) {
-		pts_debugfs_dir_proc = debugfs_create_dir("proc",
-						pts_debugfs_dir_root);
+		debugfs_create_file("proc", S_IRUGO,
+				    pts_debugfs_dir_root,
+				    NULL, &pts_proc_fops);
 
 		debugfs_create_file("enable",
 				    (S_IRUGO | S_IWUSR | S_IWGRP),
@@ -5,7 +5,12 @@
 #include <linux/uaccess.h>
 #include <linux/ftrace.h>
 #include <trace/events/mt65xx_mon_trace.h>
-#include <linux/workqueue.h>
+#include <linux/cpu.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/version.h>
 
 #include "kernel/trace/trace.h"
@@ -20,43 +25,119 @@ static DEFINE_SPINLOCK(mt65xx_mon_spinlock);
 
 static int mt65xx_mon_stopped = 1;
 
-int timer_initialized; /* default value: 0 */
-
 static MonitorMode monitor_mode = MODE_SCHED_SWITCH;
 static long mon_period_ns = 1000000L;	/* 1ms */
 static unsigned int is_manual_start;
 
-static struct hrtimer timer;
 static struct mtk_monitor *mtk_mon;
 
+/*
+ * In periodic mode every CPU samples its own counters from a pinned
+ * hrtimer and logs them to its own ring buffer; collecting all CPUs from
+ * one timer needs mtk_smp_call_function, which cannot be called from the
+ * hrtimer ISR. The EMI monitors are global and sampled by mon_emi_cpu only.
+ */
+static DEFINE_PER_CPU(struct hrtimer, mon_timer);
+static int mon_emi_cpu;
+static atomic_t mon_timers_running = ATOMIC_INIT(0);
+
+struct mon_timer_stats {
+	u64 samples;
+	u64 total_ns;
+	u64 max_ns;
+	u64 max_late_ns;
+};
+static DEFINE_PER_CPU(struct mon_timer_stats, mon_stats);
 
-/************************************************************/
-/* Add work queue here to prevent the deadlock which        */
-/* will occur when we call the mtk_smp_call_function        */
-/* in hrtimer ISR                                           */
-/************************************************************/
-static struct workqueue_struct *queue;
-static struct work_struct work;
+static void tracing_mt65xx_mon_sample(struct hrtimer *hrtimer);
 
-static void work_handler(struct work_struct *data)
+static enum hrtimer_restart timer_isr(struct hrtimer *hrtimer)
 {
-	trace_mt65xx_mon_periodic(NULL, NULL);
+	/* a timer migrated off a CPU going down stops; CPU_ONLINE restarts it */
+	if (mt65xx_mon_stopped || hrtimer != this_cpu_ptr(&mon_timer))
+		return HRTIMER_NORESTART;
+
+	tracing_mt65xx_mon_sample(hrtimer);
+	hrtimer_forward_now(hrtimer, ns_to_ktime(mon_period_ns));
+	return HRTIMER_RESTART;
 }
 
-enum hrtimer_restart timer_isr(struct hrtimer *hrtimer)
+static void mon_timer_start_local(void *enable)
 {
-	ktime_t kt;
+	if (enable)
+		mtk_mon->enable_local();
+	hrtimer_start(this_cpu_ptr(&mon_timer), ns_to_ktime(mon_period_ns),
+		      HRTIMER_MODE_REL_PINNED);
+}
 
-	if (mt65xx_mon_stopped == 0) {
-		/* trace_mt65xx_mon_periodic(NULL, NULL); */
-		schedule_work(&work);
-		kt = ktime_set(0, mon_period_ns);
-		return hrtimer_forward_now(&timer, kt);
-	}
+/* called with mt65xx_mon_mutex held */
+static void mon_timers_start(void)
+{
+	int cpu;
+
+	if (atomic_read(&mon_timers_running) || mt65xx_mon_stopped ||
+	    monitor_mode != MODE_PERIODIC)
+		return;
+
+	get_online_cpus();
+	mon_emi_cpu = cpumask_first(cpu_online_mask);
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&mon_stats, cpu), 0,
+		       sizeof(struct mon_timer_stats));
+	atomic_set(&mon_timers_running, 1);
+	on_each_cpu(mon_timer_start_local, NULL, 1);
+	put_online_cpus();
+}
+
+/* called with mt65xx_mon_mutex held */
+static void mon_timers_stop(void)
+{
+	int cpu;
+
+	if (!atomic_read(&mon_timers_running))
+		return;
+
+	get_online_cpus();
+	atomic_set(&mon_timers_running, 0);
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(per_cpu_ptr(&mon_timer, cpu));
+	put_online_cpus();
+}
 
-	return HRTIMER_NORESTART;
+static int mon_cpu_callback(struct notifier_block *nfb,
+			    unsigned long action, void *hcpu)
+{
+	int cpu = (long)hcpu;
+
+	/*
+	 * mon_timers_start/stop change it under get_online_cpus(), which
+	 * excludes this notifier; mt65xx_mon_mutex can't be taken here, as
+	 * it is held across get_online_cpus().
+	 */
+	if (!atomic_read(&mon_timers_running))
+		return NOTIFY_OK;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+		smp_call_function_single(cpu, mon_timer_start_local,
+					 (void *)1, 1);
+		break;
+	case CPU_DOWN_PREPARE:
+		hrtimer_cancel(per_cpu_ptr(&mon_timer, cpu));
+		if (cpu == mon_emi_cpu)
+			mon_emi_cpu = cpumask_any_but(cpu_online_mask, cpu);
+		break;
+	case CPU_DOWN_FAILED:
+		smp_call_function_single(cpu, mon_timer_start_local, NULL, 1);
+		break;
+	}
+	return NOTIFY_OK;
 }
 
+static struct notifier_block mon_cpu_notifier = {
+	.notifier_call = mon_cpu_callback,
+};
+
 void set_mt65xx_mon_period(long time_ns)
 {
 	mon_period_ns = time_ns;
@@ -92,30 +173,18 @@ MonitorMode get_mt65xx_mon_mode(void)
 
 void set_mt65xx_mon_mode(MonitorMode mode)
 {
-	ktime_t kt;
-
 	pr_info("set_mt65xx_mon_mode (mode = %d)\n", (int)mode);
 
-	mutex_lock(&mt65xx_mon_mutex);
-
 	if ((mode != MODE_SCHED_SWITCH) && (mode != MODE_PERIODIC) && (mode != MODE_MANUAL_TRACER))
 		return;
 
+	mutex_lock(&mt65xx_mon_mutex);
+
 	monitor_mode = mode;
-	if ((monitor_mode == MODE_PERIODIC)) {
-		if (timer_initialized == 0) {
-			hrtimer_init(&timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
-			timer.function = timer_isr;
-			kt = ktime_set(0, mon_period_ns);
-			hrtimer_start(&timer, kt, HRTIMER_MODE_REL);
-			timer_initialized++;
-		} else {
-			hrtimer_restart(&timer);
-		}
-	} else if ((monitor_mode == MODE_SCHED_SWITCH) || (monitor_mode == MODE_MANUAL_TRACER)) {
-		if (timer_initialized > 0)
-			hrtimer_cancel(&timer);
-	}
+	if (monitor_mode == MODE_PERIODIC)
+		mon_timers_start();
+	else
+		mon_timers_stop();
 
 	mutex_unlock(&mt65xx_mon_mutex);
 
@@ -149,6 +218,7 @@ tracing_mt65xx_mon_function(struct trace_array *tr,
 	mtk_mon->disable();
 	entry->log = idx = mtk_mon->mon_log((void *)&entry->field);
 	entry->cpu = raw_smp_processor_id();
+	entry->emi = 1;
 	mtk_mon->enable();
 
 
@@ -195,6 +265,60 @@ probe_mt65xx_mon_tracepoint(void *ignore, struct task_struct *prev, struct task_
 	/* local_irq_restore(flags); */
 }
 
+/*
+ * Periodic sample from this CPU's mon_timer, straight into this CPU's ring
+ * buffer. Unlike the probe above, this takes no global lock and sends no
+ * IPIs: only the local PMU is read and restarted.
+ */
+static void tracing_mt65xx_mon_sample(struct hrtimer *hrtimer)
+{
+	struct mon_timer_stats *stats = this_cpu_ptr(&mon_stats);
+	struct ring_buffer_event *event;
+	struct mt65xx_mon_entry *entry;
+	struct trace_array_cpu *data;
+	struct ring_buffer *buffer;
+	int cpu = smp_processor_id();
+	u64 start = local_clock(), ns;
+	s64 late;
+	unsigned long flags;
+	int pc;
+
+	if (unlikely(!mt65xx_mon_ref) || !mt65xx_mon_enabled || !mtk_mon)
+		return;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 10, 0)
+	buffer = mt65xx_mon_trace->buffer;
+	data = mt65xx_mon_trace->data[cpu];
+#else
+	buffer = mt65xx_mon_trace->trace_buffer.buffer;
+	data = per_cpu_ptr(mt65xx_mon_trace->trace_buffer.data, cpu);
+#endif
+	if (unlikely(atomic_read(&data->disabled)))
+		return;
+
+	pc = preempt_count();
+	local_save_flags(flags);
+	event = trace_buffer_lock_reserve(buffer, TRACE_MT65XX_MON_TYPE, sizeof(*entry), flags, pc);
+	if (!event)
+		return;
+
+	entry = ring_buffer_event_data(event);
+	entry->emi = (cpu == mon_emi_cpu);
+	entry->log = mtk_mon->mon_log_local((void *)&entry->field, entry->emi);
+	entry->cpu = cpu;
+	trace_buffer_unlock_commit(buffer, event, flags, pc);
+
+	late = ktime_to_ns(ktime_sub(hrtimer_cb_get_time(hrtimer),
+				     hrtimer_get_expires(hrtimer)));
+	ns = local_clock() - start;
+	stats->samples++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	if (late > 0 && (u64)late > stats->max_late_ns)
+		stats->max_late_ns = late;
+}
+
 void tracing_mt65xx_mon_manual_stop(struct trace_array *tr, unsigned long flags, int pc)
 {
 #if 0
@@ -220,6 +344,7 @@ void tracing_mt65xx_mon_manual_stop(struct trace_array *tr, unsigned long flags,
 
 	entry->log = idx = mtk_mon->mon_log((void *)&entry->field);
 	entry->cpu = raw_smp_processor_id();
+	entry->emi = 1;
 #if 0
 	if (!filter_check_discard(call, entry, buffer, event))
 #endif
@@ -354,8 +479,6 @@ static void mt65xx_mon_trace_reset(struct trace_array *tr)
 
 static void mt65xx_mon_trace_start(struct trace_array *tr)
 {
-	ktime_t kt;
-
 	int ret;
 	ret = register_monitor(&mtk_mon, monitor_mode);
 
@@ -366,20 +489,20 @@ static void mt65xx_mon_trace_start(struct trace_array *tr)
 	pr_info("MTK Monitor Register OK\n");
 	mtk_mon->init();
 
-	mt65xx_mon_stopped = 0;
-	if ((monitor_mode == MODE_PERIODIC) && (timer_initialized > 0)) {
-		kt = ktime_set(0, mon_period_ns);
-		hrtimer_restart(&timer);
-	}
 	mtk_mon->enable();
+
+	mutex_lock(&mt65xx_mon_mutex);
+	mt65xx_mon_stopped = 0;
+	mon_timers_start();
+	mutex_unlock(&mt65xx_mon_mutex);
 }
 
 static void mt65xx_mon_trace_stop(struct trace_array *tr)
 {
+	mutex_lock(&mt65xx_mon_mutex);
 	mt65xx_mon_stopped = 1;
-
-	if ((monitor_mode == MODE_PERIODIC) && (timer_initialized > 0))
-		hrtimer_cancel(&timer);
+	mon_timers_stop();
+	mutex_unlock(&mt65xx_mon_mutex);
 
 	if (mtk_mon == NULL) {
 		pr_info("MTK Monitor doesnt register!!!\n");
@@ -401,12 +524,55 @@ static struct tracer mt65xx_mon_tracer __read_mostly = {
 #endif
 };
 
+static int mon_stats_show(struct seq_file *m, void *v)
+{
+	int cpu;
+
+	seq_printf(m, "period %ld ns, EMI sampled on cpu%d\n",
+		   mon_period_ns, mon_emi_cpu);
+	seq_puts(m, "cpu  samples   avg_ns   max_ns  max_late_ns\n");
+	for_each_possible_cpu(cpu) {
+		struct mon_timer_stats *st = per_cpu_ptr(&mon_stats, cpu);
+
+		if (!st->samples)
+			continue;
+		seq_printf(m, "%3d %8llu %8llu %8llu %12llu\n", cpu,
+			   st->samples, div64_u64(st->total_ns, st->samples),
+			   st->max_ns, st->max_late_ns);
+	}
+	return 0;
+}
+
+static int mon_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mon_stats_show, NULL);
+}
+
+static const struct file_operations mon_stats_fops = {
+	.open = mon_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static __init int init_mt65xx_mon_trace(void)
 {
-	queue = create_singlethread_workqueue("trace mon");
-	if (!queue)
-		pr_info("create monitor work queue error\n");
-	INIT_WORK(&work, work_handler);
+	struct dentry *d_tracer;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct hrtimer *t = per_cpu_ptr(&mon_timer, cpu);
+
+		hrtimer_init(t, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		t->function = timer_isr;
+	}
+	register_cpu_notifier(&mon_cpu_notifier);
+
+	d_tracer = tracing_init_dentry();
+	if (d_tracer)
+		trace_create_file("mt65xx_mon_stats", 0444, d_tracer, NULL,
+				  &mon_stats_fops);
+
 	return register_tracer(&mt65xx_mon_tracer);
 }
 device_initcall(init_mt65xx_mon_trace);
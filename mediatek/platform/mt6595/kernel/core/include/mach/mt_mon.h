@@ -84,6 +84,8 @@ struct mtk_monitor {
     int            	(*enable)(void);
     int            	(*disable)(void);
         unsigned int	(*mon_log)(void *);
+    int             (*enable_local)(void);
+    unsigned int    (*mon_log_local)(void *, int emi);
     void 			(*set_pmu)(struct pmu_cfg *p_cfg);
     void 			(*get_pmu)(struct pmu_cfg *p_cfg);
     void 			(*set_l2c)(struct l2c_cfg *l_cfg);
@@ -43,6 +43,9 @@ struct arm_pmu {
     void            (*start)(void);
     void            (*stop)(void);
     void            (*reset)(void);
+    /* this CPU only, safe from hardirq context on every CPU at once */
+    void            (*enable_local)(void);
+    void            (*read_reset_local)(u32 *val);
     int             num_events;
     struct pmu_data perf_data;
     struct pmu_cfg  perf_cfg;
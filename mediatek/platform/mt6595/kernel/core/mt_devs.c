@@ -2076,6 +2076,7 @@ __init int mt_board_init(void)
 			if (retval != 0){
 				return retval;
 			}
+			device_enable_async_suspend(&mt_device_msdc[i].dev);
 		}
 #endif
 
@@ -2085,6 +2086,7 @@ __init int mt_board_init(void)
     if (retval != 0){
        return retval;
     }
+    device_enable_async_suspend(&AudDrv_device.dev);
 
 	retval = platform_device_register(&AudDrv_device2);
 	printk("[%s]: AudioMTKBTCVSD AudDrv_device2, retval=%d\n!", __func__, retval);
@@ -2092,6 +2094,7 @@ __init int mt_board_init(void)
 		 printk("AudioMTKBTCVSD AudDrv_device2 Fail:%d \n", retval);
 		return retval;
 	}
+	device_enable_async_suspend(&AudDrv_device2.dev);
 
 #endif
 
@@ -2140,6 +2143,10 @@ __init int mt_board_init(void)
     {
         return retval;
     }
+    /* display goes through SMI/M4U and CMDQ; keep them up around it */
+    if (!device_pm_add_dependency(&disp_device.dev, &mtk_smi_dev.dev) &&
+        !device_pm_add_dependency(&disp_device.dev, &mtk_cmdq_dev.dev))
+        device_enable_async_suspend(&disp_device.dev);
 #endif
 
 
@@ -2539,6 +2546,7 @@ retval = platform_device_register(&dummychar_device);
     if (retval != 0) {
         return retval;
     }
+    device_enable_async_suspend(&thermal_pdev.dev);
 #endif
 
 #if 1
@@ -2692,6 +2700,7 @@ retval = platform_device_register(&dummychar_device);
 		printk("[ccci/ctl] (0)cldma modem platform device register fail(%d)\n", retval);
 		return retval;
 	}
+	device_enable_async_suspend(&ccci_cldma_device.dev);
 #endif
 
     retval = platform_device_register(&hotplug_mechanism_pdev);
@@ -2,6 +2,7 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/cpu.h>
+#include <linux/cpuidle.h>
 
 #include <linux/types.h>
 #include <linux/string.h>
@@ -1053,6 +1054,104 @@ void arch_idle(void)
     }
 }
 
+#ifdef CONFIG_CPU_IDLE
+/************************************************
+ * cpuidle driver part
+ ************************************************/
+
+/*
+ * The same states as arch_idle(), shallowest first, for a cpuidle
+ * governor to choose from.  A state whose conditions do not hold falls
+ * back to the next shallower one, and the state really entered is
+ * returned so that usage, residency and miss counts land on it.
+ */
+static int (*cpuidle_handlers[NR_TYPES])(int) = {
+    rgidle_handler,
+    slidle_handler,
+    mcidle_handler,
+    soidle_handler,
+    dpidle_handler,
+};
+
+static int mt_cpuidle_enter(struct cpuidle_device *dev,
+        struct cpuidle_driver *drv, int index)
+{
+    int cpu = dev->cpu;
+
+    mcidle_idle_pre_handler(cpu);
+
+    for (; index > 0; index--) {
+        if (cpuidle_handlers[index](cpu))
+            return index;
+    }
+
+    go_to_rgidle(cpu);
+    return 0;
+}
+
+/* local timer ticks at 13MHz */
+#define IDLE_TICKS_TO_US(ticks)  ((ticks) / 13)
+
+/*
+ * Target residencies follow the timer criteria the *_can_enter() checks
+ * apply; deep idle needs at least what SODI does.  Exit latencies and
+ * power are board estimates, the power only feeds the governor's trace
+ * replay.
+ */
+static struct cpuidle_driver mt_cpuidle_driver = {
+    .name = "mt_idle",
+    .owner = THIS_MODULE,
+    .states = {
+        {
+            .enter = mt_cpuidle_enter,
+            .exit_latency = 1,
+            .target_residency = 1,
+            .power_usage = 100,
+            .flags = CPUIDLE_FLAG_TIME_VALID,
+            .name = "rgidle",
+            .desc = "WFI",
+        },
+        {
+            .enter = mt_cpuidle_enter,
+            .exit_latency = 5,
+            .target_residency = 20,
+            .power_usage = 80,
+            .flags = CPUIDLE_FLAG_TIME_VALID,
+            .name = "slidle",
+            .desc = "WFI, bus DCM",
+        },
+        {
+            .enter = mt_cpuidle_enter,
+            .exit_latency = 300,
+            .target_residency = IDLE_TICKS_TO_US(39000),
+            .power_usage = 40,
+            .flags = CPUIDLE_FLAG_TIME_VALID,
+            .name = "mcidle",
+            .desc = "multi-core idle, core power down",
+        },
+        {
+            .enter = mt_cpuidle_enter,
+            .exit_latency = 800,
+            .target_residency = IDLE_TICKS_TO_US(150000),
+            .power_usage = 15,
+            .flags = CPUIDLE_FLAG_TIME_VALID,
+            .name = "soidle",
+            .desc = "screen-on idle, SPM",
+        },
+        {
+            .enter = mt_cpuidle_enter,
+            .exit_latency = 1200,
+            .target_residency = IDLE_TICKS_TO_US(150000) + 1,
+            .power_usage = 5,
+            .flags = CPUIDLE_FLAG_TIME_VALID,
+            .name = "dpidle",
+            .desc = "deep idle, SPM",
+        },
+    },
+    .state_count = NR_TYPES,
+};
+#endif /* CONFIG_CPU_IDLE */
+
 #define idle_attr(_name)                         \
 static struct kobj_attribute _name##_attr = {   \
     .attr = {                                   \
@@ -1425,6 +1524,14 @@ void mt_idle_init(void)
         idle_info("[%s]fail to request cpuxgpt\n", __func__);
     }
 
+#ifdef CONFIG_CPU_IDLE
+    /* arch_idle() stays the fallback if cpuidle is off */
+    err = cpuidle_register(&mt_cpuidle_driver, NULL);
+    if (err) {
+        idle_err("[%s]: fail to register cpuidle driver\n", __func__);
+    }
+#endif
+
     err = sysfs_create_file(power_kobj, &idle_state_attr.attr);
     err |= sysfs_create_file(power_kobj, &soidle_state_attr.attr);
     err |= sysfs_create_file(power_kobj, &mcidle_state_attr.attr);
@@ -6,6 +6,7 @@
 #include <linux/device.h>
 #include <linux/platform_device.h>
 #include <linux/vmalloc.h>
+#include <linux/percpu.h>
 
 
 #include "asm/hardware/cache-l2x0.h"
@@ -35,6 +36,7 @@ static unsigned int mon_manual_evt;
 struct mt_mon_log *mt_mon_log_buff; //this buffer is allocated for MODE_MANUAL_USER & MODE_MANUAL_KERNEL only
 unsigned int mt_mon_log_buff_index;
 unsigned int mt_kernel_ring_buff_index;
+static DEFINE_PER_CPU(unsigned int, mt_kernel_local_index);
 
 struct arm_pmu *p_pmu;
 struct mtk_monitor mtk_mon;
@@ -159,6 +161,48 @@ static inline int get_cpumask(unsigned int index, volatile unsigned long *p)
 	
 	return res;
 }
+/*
+ * mt65xx_mon_log_emi: Copy the EMI bus monitor and DRAMC counters into @mon_buff.
+ */
+static void mt65xx_mon_log_emi(struct mt_mon_log *mon_buff)
+{
+    mon_buff->BM_BCNT = BM_GetBusCycCount();
+    mon_buff->BM_TACT = BM_GetTransAllCount();
+    mon_buff->BM_TSCT = BM_GetTransCount(1);
+    mon_buff->BM_WACT = BM_GetWordAllCount();
+    mon_buff->BM_WSCT = BM_GetWordCount(1);
+    mon_buff->BM_BACT = BM_GetBandwidthWordCount();
+    mon_buff->BM_BSCT = BM_GetOverheadWordCount();
+    mon_buff->BM_TSCT2 = BM_GetTransCount(2);
+    mon_buff->BM_WSCT2 = BM_GetWordCount(2);
+    mon_buff->BM_TSCT3 = BM_GetTransCount(3);
+    mon_buff->BM_WSCT3 = BM_GetWordCount(3);
+    mon_buff->BM_WSCT4 = BM_GetWordCount(4);
+    mon_buff->BM_TTYPE1 = BM_GetLatencyCycle(1);
+    mon_buff->BM_TTYPE2 = BM_GetLatencyCycle(2);
+    mon_buff->BM_TTYPE3 = BM_GetLatencyCycle(3);
+    mon_buff->BM_TTYPE4 = BM_GetLatencyCycle(4);
+    mon_buff->BM_TTYPE5 = BM_GetLatencyCycle(5);
+    mon_buff->BM_TTYPE6 = BM_GetLatencyCycle(6);
+    mon_buff->BM_TTYPE7 = BM_GetLatencyCycle(7);
+    
+    mon_buff->BM_TTYPE9 = BM_GetLatencyCycle(9);
+    mon_buff->BM_TTYPE10 = BM_GetLatencyCycle(10);
+    mon_buff->BM_TTYPE11 = BM_GetLatencyCycle(11);
+    mon_buff->BM_TTYPE12 = BM_GetLatencyCycle(12);
+    mon_buff->BM_TTYPE13 = BM_GetLatencyCycle(13);
+    mon_buff->BM_TTYPE14 = BM_GetLatencyCycle(14);
+    mon_buff->BM_TTYPE15 = BM_GetLatencyCycle(15);
+
+    //mon_buff->BM_TPCT1 = BM_GetTransTypeCount(1); //not used now
+    
+
+    mon_buff->DRAMC_PageHit = DRAMC_GetPageHitCount(DRAMC_ALL);
+    mon_buff->DRAMC_PageMiss = DRAMC_GetPageMissCount(DRAMC_ALL);
+    mon_buff->DRAMC_Interbank = DRAMC_GetInterbankCount(DRAMC_ALL);
+    mon_buff->DRAMC_Idle = DRAMC_GetIdleCount();
+}
+
 /*
  * mt65xx_mon_log: Get the current log from hardware monitors.
  * Return a index to the curret log entry in the log buffer.
@@ -196,49 +240,56 @@ static unsigned int mt65xx_mon_log(void* log_buff)
                 mon_buff->cpu_cyc[cpu] =  pmu_data->cnt_val[cpu][ARMV7_CYCLE_COUNTER];
             }
 			
-#if 1
-            mon_buff->BM_BCNT = BM_GetBusCycCount();
-            mon_buff->BM_TACT = BM_GetTransAllCount();
-            mon_buff->BM_TSCT = BM_GetTransCount(1);
-            mon_buff->BM_WACT = BM_GetWordAllCount();
-            mon_buff->BM_WSCT = BM_GetWordCount(1);
-            mon_buff->BM_BACT = BM_GetBandwidthWordCount();
-            mon_buff->BM_BSCT = BM_GetOverheadWordCount();
-            mon_buff->BM_TSCT2 = BM_GetTransCount(2);
-            mon_buff->BM_WSCT2 = BM_GetWordCount(2);
-            mon_buff->BM_TSCT3 = BM_GetTransCount(3);
-            mon_buff->BM_WSCT3 = BM_GetWordCount(3);
-            mon_buff->BM_WSCT4 = BM_GetWordCount(4);
-            mon_buff->BM_TTYPE1 = BM_GetLatencyCycle(1);
-            mon_buff->BM_TTYPE2 = BM_GetLatencyCycle(2);
-            mon_buff->BM_TTYPE3 = BM_GetLatencyCycle(3);
-            mon_buff->BM_TTYPE4 = BM_GetLatencyCycle(4);
-            mon_buff->BM_TTYPE5 = BM_GetLatencyCycle(5);
-            mon_buff->BM_TTYPE6 = BM_GetLatencyCycle(6);
-            mon_buff->BM_TTYPE7 = BM_GetLatencyCycle(7);
-            
-            mon_buff->BM_TTYPE9 = BM_GetLatencyCycle(9);
-            mon_buff->BM_TTYPE10 = BM_GetLatencyCycle(10);
-            mon_buff->BM_TTYPE11 = BM_GetLatencyCycle(11);
-            mon_buff->BM_TTYPE12 = BM_GetLatencyCycle(12);
-            mon_buff->BM_TTYPE13 = BM_GetLatencyCycle(13);
-            mon_buff->BM_TTYPE14 = BM_GetLatencyCycle(14);
-            mon_buff->BM_TTYPE15 = BM_GetLatencyCycle(15);
-
-            //mon_buff->BM_TPCT1 = BM_GetTransTypeCount(1); //not used now
-            
-
-            mon_buff->DRAMC_PageHit = DRAMC_GetPageHitCount(DRAMC_ALL);
-            mon_buff->DRAMC_PageMiss = DRAMC_GetPageMissCount(DRAMC_ALL);
-            mon_buff->DRAMC_Interbank = DRAMC_GetInterbankCount(DRAMC_ALL);
-            mon_buff->DRAMC_Idle = DRAMC_GetIdleCount();        
-#endif
+            mt65xx_mon_log_emi(mon_buff);
         }
 
     memset(pmu_data->cnt_val[0], 0, sizeof(struct pmu_data));
     return cur;
 }
 
+/*
+ * mt65xx_mon_enable_local: Program and start this CPU's performance monitors.
+ * Return 0.
+ */
+static int mt65xx_mon_enable_local(void)
+{
+    p_pmu->enable_local();
+    return 0;
+}
+
+/*
+ * mt65xx_mon_log_local: Log this CPU's counters, and the EMI monitors if
+ * @emi is set, into @log_buff and restart them. Only this CPU's PMU is
+ * touched, so every CPU can log from its own hrtimer at the same time.
+ * Only one CPU may pass @emi.
+ * Return this CPU's log sequence number.
+ */
+static unsigned int mt65xx_mon_log_local(void *log_buff, int emi)
+{
+    struct mt_mon_log *mon_buff = (struct mt_mon_log *)log_buff;
+    unsigned int cpu = smp_processor_id();
+    u32 val[ARMV7_CYCLE_COUNTER + 1];    // event counters, then PMCCNTR
+
+    p_pmu->read_reset_local(val);
+
+    memset(mon_buff, 0, sizeof(*mon_buff));
+    mon_buff->cpu_cnt0[cpu] = val[0];
+    mon_buff->cpu_cnt1[cpu] = val[1];
+    mon_buff->cpu_cnt2[cpu] = val[2];
+    mon_buff->cpu_cnt3[cpu] = val[3];
+    mon_buff->cpu_cyc[cpu] = val[ARMV7_CYCLE_COUNTER];
+
+    if (emi) {
+        BM_Pause();
+        mt65xx_mon_log_emi(mon_buff);
+        // stopping EMI monitors will reset all counters
+        BM_Enable(0);
+        BM_Enable(1);
+    }
+
+    return __this_cpu_inc_return(mt_kernel_local_index) - 1;
+}
+
 extern unsigned int mt_get_emi_freq(void);
 
 enum print_line_t mt65xx_mon_print_entry(struct mt65xx_mon_entry *entry, struct trace_iterator *iter){
@@ -261,7 +312,8 @@ enum print_line_t mt65xx_mon_print_entry(struct mt65xx_mon_entry *entry, struct
         trace_seq_printf(s, "EMI_CLOCK = %d, ", mt_get_emi_freq());
     }
     
-        if(mon_mode_evt != MODE_SCHED_SWITCH){
+        /* SCHED_SWITCH and PERIODIC entries are logged by each CPU for itself */
+        if(mon_mode_evt != MODE_SCHED_SWITCH && mon_mode_evt != MODE_PERIODIC){
           for_each_present_cpu(cpu)
           {
             trace_seq_printf(
@@ -279,7 +331,7 @@ enum print_line_t mt65xx_mon_print_entry(struct mt65xx_mon_entry *entry, struct
               				log_entry->cpu_cnt3[cpu]);
           }
         }
-        else /*SCHED_SWITCH - only print self cpu*/
+        else /*SCHED_SWITCH/PERIODIC - only print self cpu*/
         {
           trace_seq_printf(
               				s,
@@ -296,6 +348,12 @@ enum print_line_t mt65xx_mon_print_entry(struct mt65xx_mon_entry *entry, struct
               				log_entry->cpu_cnt3[cpu]);
         }
 
+        /* only the CPU that sampled the EMI monitors logs them */
+        if (!entry->emi) {
+            trace_seq_printf(s, "\n");
+            return 0;
+        }
+
         trace_seq_printf(
             s,
             "BM_BCNT = %d, BM_TACT = %d, BM_TSCT = %d, ",
@@ -665,6 +723,8 @@ struct mtk_monitor mtk_mon = {
         .enable			= mt65xx_mon_enable,
         .disable		= mt65xx_mon_disable,
         .mon_log		= mt65xx_mon_log,
+        .enable_local		= mt65xx_mon_enable_local,
+        .mon_log_local		= mt65xx_mon_log_local,
         .set_pmu		= mt65xx_mon_set_pmu,
         .get_pmu		= mt65xx_mon_get_pmu,
         .set_l2c		= mt65xx_mon_set_l2c,
@@ -732,11 +792,14 @@ static DEFINE_SPINLOCK(reg_mon_lock);
 int register_monitor(struct mtk_monitor **p_mon, MonitorMode mode)
 {
 	int ret = 0;
+	int cpu;
 	
 	spin_lock(&reg_mon_lock);
 	
   mt_kernel_ring_buff_index = 0;
   mt_mon_log_buff_index = 0;
+  for_each_possible_cpu(cpu)
+      per_cpu(mt_kernel_local_index, cpu) = 0;
 	
 	if(register_mode != MODE_FREE) {
         goto _err;
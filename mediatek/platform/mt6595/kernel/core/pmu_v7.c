@@ -9,6 +9,8 @@ static void smp_pmu_start(void);
 static void smp_pmu_reset(void);
 static void smp_pmu_enable_event(void);
 static void smp_pmu_read_counter(void);
+static void armv7pmu_enable_local(void);
+static void armv7pmu_read_reset_local(u32 *val);
 static u32 __init armv7_read_num_pmnc_events(void);
 
 static int event_mask = 0x8000003f;
@@ -19,6 +21,8 @@ struct arm_pmu armv7pmu = {
         .start                  = smp_pmu_start,
         .stop                   = smp_pmu_stop,
         .reset                  = smp_pmu_reset,
+        .enable_local           = armv7pmu_enable_local,
+        .read_reset_local       = armv7pmu_read_reset_local,
         .num_events             = (u32)armv7_read_num_pmnc_events,
         .id                     = ARM_PMU_ID_CA7,
         .name                   = "ARMv7 Cortex-A7",
@@ -477,6 +481,31 @@ static void armv7pmu_read_all_counter(void *info)
    	p_data->overflow[cpu] = armv7_pmnc_get_overflow_status();
 }
 
+/*
+ * armv7pmu_enable_local: program and start this CPU's counters
+ */
+static void armv7pmu_enable_local(void)
+{
+	armv7pmu_enable(NULL);
+	armv7pmu_start(NULL);
+}
+
+/*
+ * armv7pmu_read_reset_local: read this CPU's counters, including PMCCNTR,
+ * into @val and restart them from zero. Other CPUs are not touched.
+ * @val: ARMV7_CYCLE_COUNTER + 1 entries, indexed by counter
+ */
+static void armv7pmu_read_reset_local(u32 *val)
+{
+	int idx;
+
+	armv7pmu_stop(NULL);
+	for (idx = 0; idx <= ARMV7_CYCLE_COUNTER; idx++)
+		val[idx] = armv7pmu_read_counter(idx);
+	armv7pmu_reset(NULL);
+	armv7pmu_start(NULL);
+}
+
 static void smp_pmu_stop(void)
 {
 #ifdef CONFIG_SMP
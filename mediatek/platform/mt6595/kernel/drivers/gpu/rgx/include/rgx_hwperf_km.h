@@ -310,6 +310,39 @@ RGX_FW_STRUCT_SIZE_ASSERT(RGX_HWPERF_HW_DATA_FIELDS)
 RGX_FW_STRUCT_SIZE_ASSERT(RGX_HWPERF_CONFIG_CNTBLK)
 
 
+/******************************************************************************
+ * 	Zero-copy (mmap) consumer interface
+ *****************************************************************************/
+
+/*! Version of RGX_HWPERF_MMAP_CTRL, stored in ui32Version */
+#define RGX_HWPERF_MMAP_VERSION		1
+
+/*! Control page shared between the KM driver and the single zero-copy
+ * consumer of the FW HWPerf buffer. On Linux the control page is mapped
+ * read-write at offset 0 of /dev/pvr_hwperf and the FW buffer read-only at
+ * an offset of one page; poll() reports POLLIN while there are packets
+ * between the read and write indexes.
+ *
+ * Packets are read in place: from ui32ReadIdx up to ui32WriteIdx or, when
+ * ui32WriteIdx is behind ui32ReadIdx, up to ui32WrapIdx and then on from
+ * offset 0. The consumer only ever writes ui32ReadIdx, once it has finished
+ * with every packet before it; the space is handed back to the FW the next
+ * time the driver services HWPerf. Setting ui32ReadIdx to ui32WrapIdx
+ * means the same as setting it to 0.
+ */
+typedef struct
+{
+	IMG_UINT32 ui32Version;          /*!< RGX_HWPERF_MMAP_VERSION */
+	IMG_UINT32 ui32BufSize;          /*!< Size of the data mapping in bytes */
+	volatile IMG_UINT32 ui32WriteIdx; /*!< Head, written by the driver */
+	volatile IMG_UINT32 ui32WrapIdx;  /*!< End of data when the head has wrapped */
+	volatile IMG_UINT32 ui32ReadIdx;  /*!< Tail, written by the consumer */
+	volatile IMG_UINT32 ui32Seq;      /*!< Incremented each time the head moves */
+	volatile IMG_UINT32 ui32BadReadIdx; /*!< Read index updates the driver ignored */
+	IMG_UINT32 ui32Reserved;
+} RGX_HWPERF_MMAP_CTRL;
+
+
 #if defined (__cplusplus)
 }
 #endif
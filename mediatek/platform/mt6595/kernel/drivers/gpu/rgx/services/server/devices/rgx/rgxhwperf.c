@@ -67,6 +67,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 /* Defined to ensure HWPerf packets are not delayed */
 #define SUPPORT_TL_PROODUCER_CALLBACK 1
 
+/* Zero-copy consumer of the FW L1 buffer, see RGXHWPerfMMapAttach().
+ * Protected by hLockHWPerfStream. */
+static RGX_HWPERF_MMAP_CTRL*		gpsHWPerfMMapCtrl = IMG_NULL;
+static PFN_RGX_HWPERF_MMAP_NOTIFY	gpfnHWPerfMMapNotify = IMG_NULL;
+static IMG_VOID*					gpvHWPerfMMapNotifyData = IMG_NULL;
+
 
 /******************************************************************************
  *
@@ -222,6 +228,64 @@ static INLINE IMG_UINT32 RGXHWPerfAdvanceRIdx(
 }
 
 
+/*
+	RGXHWPerfMMapUpdate
+
+	Service the zero-copy consumer instead of copying to the TL stream: give
+	the space it has read back to the FW and publish the new FW write index.
+*/
+static IMG_VOID RGXHWPerfMMapUpdate(PVRSRV_RGXDEV_INFO *psDevInfo)
+{
+	RGXFWIF_TRACEBUF		*psRGXFWIfTraceBufCtl = psDevInfo->psRGXFWIfTraceBuf;
+	RGX_HWPERF_MMAP_CTRL	*psCtrl = gpsHWPerfMMapCtrl;
+	IMG_UINT32				ui32BufSize = psDevInfo->ui32RGXFWIfHWPerfBufSize;
+	IMG_UINT32				ui32SrcRIdx, ui32SrcWIdx, ui32SrcWrapCount;
+	IMG_UINT32				ui32ReadIdx;
+
+	/* The read index comes from user space: anything that is not a packet
+	 * boundary inside the mapping is ignored rather than handed to the FW. */
+	ui32ReadIdx = psCtrl->ui32ReadIdx;
+	ui32SrcRIdx = psRGXFWIfTraceBufCtl->ui32HWPerfRIdx;
+	if ((ui32ReadIdx & 7) != 0 ||
+		ui32ReadIdx > ui32BufSize + RGXFW_HWPERF_L1_PADDING_DEFAULT)
+	{
+		psCtrl->ui32BadReadIdx++;
+		ui32ReadIdx = ui32SrcRIdx;
+	}
+	else if (ui32ReadIdx >= ui32BufSize)
+	{
+		/* Consumer reached the wrap point */
+		ui32ReadIdx = 0;
+	}
+
+	if (ui32ReadIdx != ui32SrcRIdx)
+	{
+		/* The read index only moves back when the consumer has wrapped, at
+		 * which point the FW may use the whole buffer again. */
+		if (ui32ReadIdx < ui32SrcRIdx)
+		{
+			psRGXFWIfTraceBufCtl->ui32HWPerfWrapCount = ui32BufSize;
+		}
+		psRGXFWIfTraceBufCtl->ui32HWPerfRIdx = ui32ReadIdx;
+	}
+
+	ui32SrcWIdx = psRGXFWIfTraceBufCtl->ui32HWPerfWIdx;
+	OSMemoryBarrier();
+	ui32SrcWrapCount = psRGXFWIfTraceBufCtl->ui32HWPerfWrapCount;
+
+	if (ui32SrcWIdx != psCtrl->ui32WriteIdx)
+	{
+		/* Wrap index must be visible before the head that depends on it */
+		psCtrl->ui32WrapIdx = ui32SrcWrapCount;
+		OSMemoryBarrier();
+		psCtrl->ui32WriteIdx = ui32SrcWIdx;
+		psCtrl->ui32Seq++;
+
+		gpfnHWPerfMMapNotify(gpvHWPerfMMapNotifyData);
+	}
+}
+
+
 /*
 	RGXHWPerfDataStore
 */
@@ -239,6 +303,14 @@ static IMG_UINT32 RGXHWPerfDataStore(PVRSRV_RGXDEV_INFO	*psDevInfo)
 
 	/* Caller should check this member is valid before calling */
 	PVR_ASSERT(psDevInfo->hHWPerfStream);
+
+	/* While a zero-copy consumer is attached it owns the FW read index and
+	 * nothing goes to the TL stream. */
+	if (gpsHWPerfMMapCtrl != IMG_NULL)
+	{
+		RGXHWPerfMMapUpdate(psDevInfo);
+		PVR_DPF_RETURN_VAL(0);
+	}
 	
  	/* Get a copy of the current
 	 *   read (first packet to read) 
@@ -493,6 +565,12 @@ IMG_VOID RGXHWPerfDeinit(void)
 {
 	PVR_DPF_ENTERED;
 
+	/* A zero-copy consumer should have gone by now, but never leave the
+	 * data store calling back into it */
+	gpsHWPerfMMapCtrl = IMG_NULL;
+	gpfnHWPerfMMapNotify = IMG_NULL;
+	gpvHWPerfMMapNotifyData = IMG_NULL;
+
 	/* Clean up the stream and lock objects if allocated
 	 */
 	if (gpsRgxDevInfo && gpsRgxDevInfo->hHWPerfStream)
@@ -515,6 +593,171 @@ IMG_VOID RGXHWPerfDeinit(void)
 }
 
 
+/******************************************************************************
+ * RGX HW Performance Zero-copy Consumer
+ *****************************************************************************/
+/*
+	RGXHWPerfMMapAttach
+
+	Make psCtrl the single consumer of the FW L1 buffer. From here on the
+	data store only publishes the FW write index to psCtrl and calls
+	pfnNotify, and the FW read index follows psCtrl->ui32ReadIdx, so the
+	packets are read where the FW wrote them. The caller maps the buffer
+	returned in ppbBuffer (pui32BufSize bytes, including the wrap padding)
+	into the consumer.
+*/
+PVRSRV_ERROR RGXHWPerfMMapAttach(
+		RGX_HWPERF_MMAP_CTRL*		psCtrl,
+		PFN_RGX_HWPERF_MMAP_NOTIFY	pfnNotify,
+		IMG_VOID*					pvNotifyData,
+		IMG_BYTE**					ppbBuffer,
+		IMG_UINT32*					pui32BufSize)
+{
+	RGXFWIF_TRACEBUF*	psRGXFWIfTraceBufCtl;
+
+	PVR_DPF_ENTERED;
+
+	PVR_ASSERT(psCtrl);
+	PVR_ASSERT(pfnNotify);
+
+	if (!gpsRgxDevInfo || !gpsRgxDevInfo->hHWPerfStream)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "HWPerf not initialised or not enabled"));
+		PVR_DPF_RETURN_RC(PVRSRV_ERROR_INVALID_DEVICE);
+	}
+	psRGXFWIfTraceBufCtl = gpsRgxDevInfo->psRGXFWIfTraceBuf;
+
+	OSLockAcquire(gpsRgxDevInfo->hLockHWPerfStream);
+	if (gpsHWPerfMMapCtrl != IMG_NULL)
+	{
+		OSLockRelease(gpsRgxDevInfo->hLockHWPerfStream);
+		PVR_DPF_RETURN_RC(PVRSRV_ERROR_ALREADY_OPEN);
+	}
+
+	psCtrl->ui32Version = RGX_HWPERF_MMAP_VERSION;
+	psCtrl->ui32BufSize = gpsRgxDevInfo->ui32RGXFWIfHWPerfBufSize + RGXFW_HWPERF_L1_PADDING_DEFAULT;
+	psCtrl->ui32ReadIdx = psRGXFWIfTraceBufCtl->ui32HWPerfRIdx;
+	psCtrl->ui32WriteIdx = psRGXFWIfTraceBufCtl->ui32HWPerfWIdx;
+	OSMemoryBarrier();
+	psCtrl->ui32WrapIdx = psRGXFWIfTraceBufCtl->ui32HWPerfWrapCount;
+	psCtrl->ui32Seq = 0;
+	psCtrl->ui32BadReadIdx = 0;
+
+	gpfnHWPerfMMapNotify = pfnNotify;
+	gpvHWPerfMMapNotifyData = pvNotifyData;
+	gpsHWPerfMMapCtrl = psCtrl;
+	OSLockRelease(gpsRgxDevInfo->hLockHWPerfStream);
+
+	*ppbBuffer = gpsRgxDevInfo->psRGXFWIfHWPerfBuf;
+	*pui32BufSize = psCtrl->ui32BufSize;
+
+	PVR_DPF_RETURN_OK;
+}
+
+
+/*
+	RGXHWPerfMMapDetach
+
+	Hand the FW buffer back to the TL stream. Once this returns the notify
+	callback will not be called again. The FW read index is left where the
+	consumer put it.
+*/
+IMG_VOID RGXHWPerfMMapDetach(IMG_VOID)
+{
+	PVR_DPF_ENTERED;
+
+	if (gpsRgxDevInfo && gpsRgxDevInfo->hLockHWPerfStream)
+	{
+		OSLockAcquire(gpsRgxDevInfo->hLockHWPerfStream);
+		gpsHWPerfMMapCtrl = IMG_NULL;
+		gpfnHWPerfMMapNotify = IMG_NULL;
+		gpvHWPerfMMapNotifyData = IMG_NULL;
+		OSLockRelease(gpsRgxDevInfo->hLockHWPerfStream);
+	}
+
+	PVR_DPF_RETURN;
+}
+
+
+#if defined(NO_HARDWARE)
+/*
+	RGXHWPerfGenPackets
+
+	Stand in for the FW, which does not run in NO_HARDWARE builds: write
+	ui32Count HW kick packets into the L1 buffer the way the FW does
+	(stopping when the buffer is full, wrapping through the padding) and
+	then run the data store as the MISR would, so whichever consumer is
+	attached sees them.
+*/
+PVRSRV_ERROR RGXHWPerfGenPackets(IMG_UINT32 ui32Count, IMG_UINT32 *pui32Written)
+{
+	static IMG_UINT32	ui32Ordinal;
+	RGXFWIF_TRACEBUF*	psRGXFWIfTraceBufCtl;
+	const IMG_UINT32	ui32PktSize = RGX_HWPERF_MAKE_SIZE_FIXED(RGX_HWPERF_HW_DATA_FIELDS);
+	IMG_UINT32			ui32BufSize;
+	IMG_UINT32			i;
+
+	PVR_DPF_ENTERED;
+
+	if (!gpsRgxDevInfo || !gpsRgxDevInfo->hHWPerfStream)
+	{
+		PVR_DPF_RETURN_RC(PVRSRV_ERROR_INVALID_DEVICE);
+	}
+	psRGXFWIfTraceBufCtl = gpsRgxDevInfo->psRGXFWIfTraceBuf;
+	ui32BufSize = gpsRgxDevInfo->ui32RGXFWIfHWPerfBufSize;
+
+	OSLockAcquire(gpsRgxDevInfo->hLockHWPerfStream);
+	for (i = 0; i < ui32Count; i++)
+	{
+		IMG_UINT32 ui32RIdx = psRGXFWIfTraceBufCtl->ui32HWPerfRIdx;
+		IMG_UINT32 ui32WIdx = psRGXFWIfTraceBufCtl->ui32HWPerfWIdx;
+		RGX_HWPERF_V2_PACKET_HDR *psHdr;
+		RGX_HWPERF_HW_DATA_FIELDS *psData;
+
+		/* Full: the FW drops the packet in this case. A write that wraps
+		 * must not land on the read index or the buffer would look empty. */
+		if (ui32WIdx < ui32RIdx)
+		{
+			if (ui32WIdx + ui32PktSize >= ui32RIdx)
+			{
+				break;
+			}
+		}
+		else if (ui32WIdx + ui32PktSize >= ui32BufSize && ui32RIdx == 0)
+		{
+			break;
+		}
+
+		psHdr = RGX_HWPERF_GET_PACKET(gpsRgxDevInfo->psRGXFWIfHWPerfBuf + ui32WIdx);
+		psHdr->ui32Sig = HWPERF_PACKET_V2_SIG;
+		psHdr->ui32Size = ui32PktSize;
+		psHdr->eTypeId = RGX_HWPERF_MAKE_TYPEID(RGX_HWPERF_HW_TAKICK, 0);
+		psHdr->ui32Ordinal = ui32Ordinal++;
+		psHdr->ui64RGXTimer = OSClockns64();
+
+		psData = (RGX_HWPERF_HW_DATA_FIELDS *) RGX_HWPERF_GET_PACKET_DATA_BYTES(psHdr);
+		OSMemSet(psData, 0, sizeof(*psData));
+		psData->ui32FrameNum = psHdr->ui32Ordinal;
+		psData->ui32PID = OSGetCurrentProcessIDKM();
+
+		ui32WIdx += ui32PktSize;
+		if (ui32WIdx >= ui32BufSize)
+		{
+			psRGXFWIfTraceBufCtl->ui32HWPerfWrapCount = ui32WIdx;
+			ui32WIdx = 0;
+		}
+		OSMemoryBarrier();
+		psRGXFWIfTraceBufCtl->ui32HWPerfWIdx = ui32WIdx;
+	}
+	OSLockRelease(gpsRgxDevInfo->hLockHWPerfStream);
+
+	*pui32Written = i;
+
+	PVR_DPF_RETURN_RC(RGXHWPerfDataStoreCB(gpsRgxDevNode));
+}
+#endif /* defined(NO_HARDWARE) */
+
+
 /******************************************************************************
  * RGX HW Performance Profiling Server API(s)
  *****************************************************************************/
@@ -63,6 +63,26 @@ PVRSRV_ERROR RGXHWPerfInit(PVRSRV_DEVICE_NODE *psRgxDevInfo, IMG_BOOL bEnable);
 IMG_VOID RGXHWPerfDeinit(void);
 
 
+/******************************************************************************
+ * RGX HW Performance Zero-copy Consumer
+ *****************************************************************************/
+
+typedef IMG_VOID (*PFN_RGX_HWPERF_MMAP_NOTIFY)(IMG_VOID *pvData);
+
+PVRSRV_ERROR RGXHWPerfMMapAttach(
+		RGX_HWPERF_MMAP_CTRL*		psCtrl,
+		PFN_RGX_HWPERF_MMAP_NOTIFY	pfnNotify,
+		IMG_VOID*					pvNotifyData,
+		IMG_BYTE**					ppbBuffer,
+		IMG_UINT32*					pui32BufSize);
+
+IMG_VOID RGXHWPerfMMapDetach(IMG_VOID);
+
+#if defined(NO_HARDWARE)
+PVRSRV_ERROR RGXHWPerfGenPackets(IMG_UINT32 ui32Count, IMG_UINT32 *pui32Written);
+#endif
+
+
 /******************************************************************************
  * RGX HW Performance Profiling API(s)
  *****************************************************************************/
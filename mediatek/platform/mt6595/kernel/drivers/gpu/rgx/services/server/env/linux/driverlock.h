@@ -51,6 +51,37 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 extern PVRSRV_LINUX_MUTEX gPVRSRVLock;
 
+/*
+ * A few hot bridge calls run under the shared side of the bridge lock plus
+ * a per-connection and a per-resource mutex instead of gPVRSRVLock.
+ * Whoever holds gPVRSRVLock excludes them all.
+ */
+typedef enum _PVRSRV_BRIDGE_LOCK_CLASS_
+{
+	PVRSRV_BRIDGE_LOCK_GLOBAL = 0,	/* gPVRSRVLock */
+	PVRSRV_BRIDGE_LOCK_KICK,	/* kicks and the sync prim ops they race with */
+	PVRSRV_BRIDGE_LOCK_SYNC_QUERY,	/* read-only sync state queries */
+	PVRSRV_BRIDGE_LOCK_CACHE,	/* CPU cache maintenance */
+	PVRSRV_BRIDGE_LOCK_CLASS_COUNT
+} PVRSRV_BRIDGE_LOCK_CLASS;
+
+struct _ENV_CONNECTION_DATA_;
+
+IMG_VOID LinuxBridgeLockShared(IMG_VOID);
+IMG_VOID LinuxBridgeUnlockShared(IMG_VOID);
+
+PVRSRV_BRIDGE_LOCK_CLASS LinuxBridgeLockClass(IMG_UINT32 ui32BridgeID);
+IMG_VOID LinuxBridgeLock(struct _ENV_CONNECTION_DATA_ *psEnvConnection,
+						 PVRSRV_BRIDGE_LOCK_CLASS eClass);
+IMG_VOID LinuxBridgeUnlock(struct _ENV_CONNECTION_DATA_ *psEnvConnection,
+						   PVRSRV_BRIDGE_LOCK_CLASS eClass);
+
+#if defined(NO_HARDWARE)
+/* <debugfs>/pvr/bridge_stress, see pvr_bridge_stress.c */
+int PVRBridgeStressInit(void);
+void PVRBridgeStressDeInit(void);
+#endif
+
 #endif /* __DRIVERLOCK_H__ */
 /*****************************************************************************
  End of file (driverlock.h)
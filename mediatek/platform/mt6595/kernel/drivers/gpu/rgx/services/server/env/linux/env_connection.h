@@ -45,6 +45,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define _ENV_CONNECTION_H_
 
 #include <linux/list.h>
+#include <linux/mutex.h>
 
 #include "handle.h"
 #include "pvr_debug.h"
@@ -84,6 +85,10 @@ typedef struct _ENV_CONNECTION_DATA_
 #if defined(SUPPORT_DRM)
 	IMG_BOOL bAuthenticated;
 #endif
+	/* Serialises bridge calls on this connection that run without gPVRSRVLock */
+	struct mutex sBridgeLock;
+	/* Marshalling buffer for those calls, protected by sBridgeLock */
+	IMG_VOID *pvBridgeData;
 } ENV_CONNECTION_DATA;
 
 #if defined(SUPPORT_ION)
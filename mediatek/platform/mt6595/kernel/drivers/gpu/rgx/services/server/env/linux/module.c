@@ -102,6 +102,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "sysinfo.h"
 #include "pvrsrv.h"
 #include "process_stats.h"
+#include "pvr_hwperf_mmap.h"
 
 #if defined(SUPPORT_SYSTEM_INTERRUPT_HANDLING) || defined(SUPPORT_DRM)
 #include "syscommon.h"
@@ -888,6 +889,8 @@ check_auth_exit:
           this interface */
 PVRSRV_ERROR LinuxBridgeInit(IMG_VOID);
 IMG_VOID LinuxBridgeDeInit(IMG_VOID);
+int PhysmemOSDebugFSInit(void);
+void PhysmemOSDebugFSDeInit(void);
 
 static int __init PVRCore_Init(void)
 {
@@ -1054,6 +1057,18 @@ static int __init PVRCore_Init(void)
 		PVR_DPF((PVR_DBG_WARNING, "PVRCore_Init: failed to create default debugfs entries (%d)", error));
 	}
 
+	error = PhysmemOSDebugFSInit();
+	if (error != 0)
+	{
+		PVR_DPF((PVR_DBG_WARNING, "PVRCore_Init: failed to create physmem debugfs entry (%d)", error));
+	}
+
+	error = PVRHWPerfMMapInit();
+	if (error != 0)
+	{
+		PVR_DPF((PVR_DBG_WARNING, "PVRCore_Init: failed to create HWPerf mmap device (%d)", error));
+	}
+
 #if defined(SUPPORT_GPUTRACE_EVENTS)
 	error = PVRGpuTraceInit();
 	if (error != 0)
@@ -1157,6 +1172,10 @@ static void __exit PVRCore_Cleanup(void)
 	PVRGpuTraceDeInit();
 #endif
 
+	PVRHWPerfMMapDeInit();
+
+	PhysmemOSDebugFSDeInit();
+
 	PVRDebugRemoveDebugFSEntries();
 
 #if defined(SUPPORT_DRM_AUTH_IMPORT)
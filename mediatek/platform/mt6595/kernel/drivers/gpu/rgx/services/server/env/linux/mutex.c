@@ -47,6 +47,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <asm/semaphore.h>
 #endif
 #include <linux/module.h>
+#include <linux/rwsem.h>
 
 #include <img_defs.h>
 
@@ -57,13 +58,25 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 /*#define DEBUG_BRIDGE_LOCK_CALLS 1 */
 #undef DEBUG_BRIDGE_LOCK_CALLS 
 
-/* bridge lock */
-#if defined(DEBUG_BRIDGE_LOCK_CALLS)
-extern PVRSRV_LINUX_MUTEX gPVRSRVLock;
-#endif
-
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,15))
 
+/*
+ * Holding gPVRSRVLock also holds the write side of the bridge semaphore,
+ * so that bridge calls running under the shared side (see pvr_bridge_k.c)
+ * are excluded by everyone who expects the driver to be single threaded.
+ */
+static DECLARE_RWSEM(gsPVRSRVBridgeSem);
+
+IMG_VOID LinuxBridgeLockShared(IMG_VOID)
+{
+    down_read(&gsPVRSRVBridgeSem);
+}
+
+IMG_VOID LinuxBridgeUnlockShared(IMG_VOID)
+{
+    up_read(&gsPVRSRVBridgeSem);
+}
+
 #if !defined(CONFIG_PROVE_LOCKING)
 IMG_VOID LinuxInitMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 {
@@ -89,6 +102,10 @@ IMG_VOID LinuxLockMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 #endif
 
     mutex_lock(&psPVRSRVMutex->sMutex);
+    if (&gPVRSRVLock == psPVRSRVMutex)
+    {
+        down_write(&gsPVRSRVBridgeSem);
+    }
     psPVRSRVMutex->hHeldBy = current->pid;
 }
 
@@ -107,6 +124,10 @@ PVRSRV_ERROR LinuxLockMutexInterruptible(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
     }
     else
     {
+        if (&gPVRSRVLock == psPVRSRVMutex)
+        {
+            down_write(&gsPVRSRVBridgeSem);
+        }
     	psPVRSRVMutex->hHeldBy = current->pid;
         return PVRSRV_OK;
     }
@@ -123,6 +144,11 @@ IMG_INT32 LinuxTryLockMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 
 	if (mutex_trylock(&psPVRSRVMutex->sMutex) == 1)
 	{
+        if (&gPVRSRVLock == psPVRSRVMutex && !down_write_trylock(&gsPVRSRVBridgeSem))
+        {
+            mutex_unlock(&psPVRSRVMutex->sMutex);
+            return 0;
+        }
     	psPVRSRVMutex->hHeldBy = current->pid;
         return 1;
 	}
@@ -142,6 +168,10 @@ IMG_VOID LinuxUnLockMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 #endif
 
 	psPVRSRVMutex->hHeldBy = 0;
+    if (&gPVRSRVLock == psPVRSRVMutex)
+    {
+        up_write(&gsPVRSRVBridgeSem);
+    }
     mutex_unlock(&psPVRSRVMutex->sMutex);
 
 #if defined(LINUX_DEBUG_MUTEX_CALLS)
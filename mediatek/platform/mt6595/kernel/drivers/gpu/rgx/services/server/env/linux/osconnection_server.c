@@ -44,6 +44,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "osconnection_server.h"
 
 #include "env_connection.h"
+#include "env_data.h"
 #include "allocmem.h"
 #include "pvr_debug.h"
 
@@ -89,6 +90,17 @@ PVRSRV_ERROR OSConnectionPrivateDataInit(IMG_HANDLE *phOsPrivateData, IMG_PVOID
 
 	/* Save the pointer to our struct file */
 	psEnvConnection->psFile = pvOSData;
+	mutex_init(&psEnvConnection->sBridgeLock);
+
+	psEnvConnection->pvBridgeData = OSAllocMem(PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE);
+	if (psEnvConnection->pvBridgeData == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: OSAllocMem failed", __FUNCTION__));
+		mutex_destroy(&psEnvConnection->sBridgeLock);
+		OSFreeMem(psEnvConnection);
+		*phOsPrivateData = IMG_NULL;
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
 
 #if defined(SUPPORT_ION)
 	psIonConnection = (ENV_ION_CONNECTION_DATA *)OSAllocMem(sizeof(ENV_ION_CONNECTION_DATA));
@@ -133,6 +145,8 @@ PVRSRV_ERROR OSConnectionPrivateDataDeInit(IMG_HANDLE hOsPrivateData)
 	EnvDataIonClientRelease(psEnvConnection->psIonData);
 #endif
 
+	OSFreeMem(psEnvConnection->pvBridgeData);
+	mutex_destroy(&psEnvConnection->sBridgeLock);
 	OSFreeMem(hOsPrivateData);
 	/*not nulling pointer, copy on stack*/
 
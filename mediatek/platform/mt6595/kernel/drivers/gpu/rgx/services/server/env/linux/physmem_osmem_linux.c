@@ -60,6 +60,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 /* ourselves */
 #include "physmem_osmem.h"
+#include "pvr_debugfs.h"
 
 #if defined(PVRSRV_ENABLE_PROCESS_STATS) && defined(PVRSRV_ENABLE_MEMORY_STATS)
 #include "process_stats.h"
@@ -77,6 +78,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <linux/vmalloc.h>
 #include <linux/gfp.h>
 #include <linux/sched.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
 #include <asm/io.h>
 #if defined(CONFIG_X86)
 #include <asm/cacheflush.h>
@@ -149,25 +153,59 @@ _FreeOSPage(IMG_UINT32 ui32CPUCacheFlags,
 			IMG_BOOL bUnsetMemoryType,
 			IMG_BOOL bFreeToOS,
 			struct page *psPage);
+
+/*
+	Chunk orders we allocate and pool, highest first.  Chunks above
+	order 0 are split with split_page() as soon as they are allocated so
+	that every page in them can still be freed on its own, but they are
+	kept together in the pool so the next allocation gets the same
+	contiguity (and a single cache operation per chunk) back.
+*/
+#define PAGE_POOL_ORDER_COUNT	3
+static const IMG_UINT32 g_aui32PagePoolOrders[PAGE_POOL_ORDER_COUNT] = { 4, 2, 0 };
+
+static IMG_UINT32 gPVRPhysmemHighOrder = 1;
+module_param(gPVRPhysmemHighOrder, uint, 0644);
+MODULE_PARM_DESC(gPVRPhysmemHighOrder, "Opportunistically allocate OS pages in high order chunks (default 1)");
  
 typedef	struct
 {
 	/* Linkage for page pool LRU list */
 	struct list_head sPagePoolItem;
 
+	/* First page of a physically contiguous run of 1 << uiOrder pages */
 	struct page *psPage;
+	IMG_UINT32 uiOrder;
 } LinuxPagePoolEntry;
 
-/* Track what is live */
-static IMG_UINT32 g_ui32PagePoolEntryCount = 0;
+/* Track what is live.  The pool is accounted in pages, not entries. */
+static IMG_UINT32 g_ui32PagePoolPageCount = 0;
 static IMG_UINT32 g_ui32PagePoolMaxEntries = PVR_LINUX_PYSMEM_MAX_POOL_PAGES;
 static IMG_UINT32 g_ui32LiveAllocs = 0;
 
-/* Global structures we use to manage the page pool */
+/* Global structures we use to manage the page pool, one list per order */
 static struct kmem_cache *g_psLinuxPagePoolCache = IMG_NULL;
-static LIST_HEAD(g_sPagePoolList);
+static struct list_head g_asPagePoolList[PAGE_POOL_ORDER_COUNT] =
+{
+	LIST_HEAD_INIT(g_asPagePoolList[0]),
+	LIST_HEAD_INIT(g_asPagePoolList[1]),
+	LIST_HEAD_INIT(g_asPagePoolList[2]),
+};
 static DEFINE_MUTEX(g_sPagePoolMutex);
-static LIST_HEAD(g_sUncachedPagePoolList);
+static struct list_head g_asUncachedPagePoolList[PAGE_POOL_ORDER_COUNT] =
+{
+	LIST_HEAD_INIT(g_asUncachedPagePoolList[0]),
+	LIST_HEAD_INIT(g_asUncachedPagePoolList[1]),
+	LIST_HEAD_INIT(g_asUncachedPagePoolList[2]),
+};
+
+/* Allocation statistics, reported through debugfs */
+#define PHYSMEM_LATENCY_BUCKETS	16
+static atomic_t g_asAllocLatency[PHYSMEM_LATENCY_BUCKETS];	/* log2 us */
+static atomic_t g_asChunksFromPool[PAGE_POOL_ORDER_COUNT];
+static atomic_t g_asChunksFromOS[PAGE_POOL_ORDER_COUNT];
+static atomic_t g_asChunkFallbacks[PAGE_POOL_ORDER_COUNT];
+static struct dentry *gpsPhysmemPoolDebugFSEntry;
 
 static inline int
 _PagePoolTrylock(void)
@@ -193,8 +231,29 @@ _LinuxPagePoolEntryAlloc(IMG_VOID)
     return kmem_cache_zalloc(g_psLinuxPagePoolCache, GFP_KERNEL);
 }
 
-static inline IMG_BOOL _GetPoolListHead(IMG_UINT32 ui32CPUCacheFlags, struct list_head **ppsPoolHead)
+static inline IMG_UINT32 _GetPoolOrderIndex(IMG_UINT32 uiOrder)
+{
+	IMG_UINT32 uiOrderIndex;
+
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
+	{
+		if (g_aui32PagePoolOrders[uiOrderIndex] == uiOrder)
+		{
+			break;
+		}
+	}
+	return uiOrderIndex;
+}
+
+static inline IMG_BOOL _GetPoolListHead(IMG_UINT32 ui32CPUCacheFlags,
+										IMG_UINT32 uiOrderIndex,
+										struct list_head **ppsPoolHead)
 {
+	if (uiOrderIndex >= PAGE_POOL_ORDER_COUNT)
+	{
+		return IMG_FALSE;
+	}
+
 	switch(ui32CPUCacheFlags)
 	{
 		case PVRSRV_MEMALLOCFLAG_CPU_UNCACHED:
@@ -204,13 +263,13 @@ static inline IMG_BOOL _GetPoolListHead(IMG_UINT32 ui32CPUCacheFlags, struct lis
 	setting which cares about this difference.
 */
 #if defined(CONFIG_X86)
-			*ppsPoolHead = &g_sUncachedPagePoolList;
+			*ppsPoolHead = &g_asUncachedPagePoolList[uiOrderIndex];
 			break;
 #else
 			/* Fall-through */
 #endif
 		case PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE:
-			*ppsPoolHead = &g_sPagePoolList;
+			*ppsPoolHead = &g_asPagePoolList[uiOrderIndex];
 			break;
 		default:
 			return IMG_FALSE;
@@ -225,12 +284,12 @@ _LinuxPagePoolEntryFree(LinuxPagePoolEntry *psPagePoolEntry)
 }
 
 static inline IMG_BOOL
-_AddEntryToPool(struct page *psPage, IMG_UINT32 ui32CPUCacheFlags)
+_AddEntryToPool(struct page *psPage, IMG_UINT32 uiOrder, IMG_UINT32 ui32CPUCacheFlags)
 {
 	LinuxPagePoolEntry *psEntry;
 	struct list_head *psPoolHead = IMG_NULL;
 
-	if (!_GetPoolListHead(ui32CPUCacheFlags, &psPoolHead))
+	if (!_GetPoolListHead(ui32CPUCacheFlags, _GetPoolOrderIndex(uiOrder), &psPoolHead))
 	{
 		return IMG_FALSE;
 	}
@@ -242,9 +301,10 @@ _AddEntryToPool(struct page *psPage, IMG_UINT32 ui32CPUCacheFlags)
 	}
 
 	psEntry->psPage = psPage;
+	psEntry->uiOrder = uiOrder;
 	_PagePoolLock();
 	list_add_tail(&psEntry->sPagePoolItem, psPoolHead);
-	g_ui32PagePoolEntryCount++;
+	g_ui32PagePoolPageCount += 1U << uiOrder;
 	_PagePoolUnlock();
 
 	return IMG_TRUE;
@@ -254,17 +314,17 @@ static inline void
 _RemoveEntryFromPoolUnlocked(LinuxPagePoolEntry *psPagePoolEntry)
 {
 	list_del(&psPagePoolEntry->sPagePoolItem);
-	g_ui32PagePoolEntryCount--;
+	g_ui32PagePoolPageCount -= 1U << psPagePoolEntry->uiOrder;
 }
 
 static inline struct page *
-_RemoveFirstEntryFromPool(IMG_UINT32 ui32CPUCacheFlags)
+_RemoveFirstEntryFromPool(IMG_UINT32 ui32CPUCacheFlags, IMG_UINT32 uiOrderIndex)
 {
 	LinuxPagePoolEntry *psPagePoolEntry;
 	struct page *psPage;
 	struct list_head *psPoolHead = IMG_NULL;
 
-	if (!_GetPoolListHead(ui32CPUCacheFlags, &psPoolHead))
+	if (!_GetPoolListHead(ui32CPUCacheFlags, uiOrderIndex, &psPoolHead))
 	{
 		return NULL;
 	}
@@ -276,7 +336,7 @@ _RemoveFirstEntryFromPool(IMG_UINT32 ui32CPUCacheFlags)
 		return NULL;
 	}
 
-	PVR_ASSERT(g_ui32PagePoolEntryCount > 0);
+	PVR_ASSERT(g_ui32PagePoolPageCount > 0);
 	psPagePoolEntry = list_first_entry(psPoolHead, LinuxPagePoolEntry, sPagePoolItem);
 	_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
 	psPage = psPagePoolEntry->psPage;
@@ -286,6 +346,48 @@ _RemoveFirstEntryFromPool(IMG_UINT32 ui32CPUCacheFlags)
 	return psPage;
 }
 
+/*
+	Give the entries on one pool list back to the OS, oldest first, until
+	at least uiNumToFree pages have gone.  Must be called with the pool
+	lock held.  Returns the number of pages freed.
+*/
+static unsigned long
+_EvictPoolListUnlocked(struct list_head *psPoolHead,
+					   IMG_UINT32 ui32CPUCacheFlags,
+					   unsigned long uiNumToFree)
+{
+	LinuxPagePoolEntry *psPagePoolEntry, *psTempPoolEntry;
+	unsigned long uiNumFreed = 0;
+
+	list_for_each_entry_safe(psPagePoolEntry, psTempPoolEntry, psPoolHead, sPagePoolItem)
+	{
+		if (uiNumFreed >= uiNumToFree)
+		{
+			break;
+		}
+
+		_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
+
+		/*
+		  We don't want to save the cache type and is we need to unset the
+		  memory type as it would double the page pool structure and the
+		  values are always going to be the same anyway which is why the
+		  page is in the pool (well the page could be UNCACHED or
+		  WRITE_COMBINE but we don't even need the cache type for freeing
+		  back to the OS).
+		*/
+		_FreeOSPage(ui32CPUCacheFlags,
+			    psPagePoolEntry->uiOrder,
+			    IMG_TRUE,
+			    IMG_TRUE,
+			    psPagePoolEntry->psPage);
+		uiNumFreed += 1UL << psPagePoolEntry->uiOrder;
+		_LinuxPagePoolEntryFree(psPagePoolEntry);
+	}
+
+	return uiNumFreed;
+}
+
 #if defined(PHYSMEM_SUPPORTS_SHRINKER)
 static struct shrinker g_sShrinker;
 
@@ -301,7 +403,7 @@ _CountObjectsInPagePool(struct shrinker *psShrinker, struct shrink_control *psSh
 	/* In order to avoid possible deadlock use mutex_trylock in place of mutex_lock */
 	if (_PagePoolTrylock() == 0)
 			return 0;
-	remain = g_ui32PagePoolEntryCount;
+	remain = g_ui32PagePoolPageCount;
 	_PagePoolUnlock();
 
 	return remain;
@@ -311,7 +413,8 @@ static unsigned long
 _ScanObjectsInPagePool(struct shrinker *psShrinker, struct shrink_control *psShrinkControl)
 {
 	unsigned long uNumToScan = psShrinkControl->nr_to_scan;
-	LinuxPagePoolEntry *psPagePoolEntry, *psTempPoolEntry;
+	unsigned long uNumFreed = 0;
+	IMG_UINT32 uiOrderIndex;
 	int remain;
 
 	PVR_ASSERT(psShrinker == &g_sShrinker);
@@ -320,67 +423,30 @@ _ScanObjectsInPagePool(struct shrinker *psShrinker, struct shrink_control *psShr
 	/* In order to avoid possible deadlock use mutex_trylock in place of mutex_lock */
 	if (_PagePoolTrylock() == 0)
 			return SHRINK_STOP;
-	list_for_each_entry_safe(psPagePoolEntry, psTempPoolEntry, &g_sPagePoolList, sPagePoolItem)
-	{
-		_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
-
-		/*
-		  We don't want to save the cache type and is we need to unset the
-		  memory type as it would double the page pool structure and the
-		  values are always going to be the same anyway which is why the
-		  page is in the pool (well the page could be UNCACHED or
-		  WRITE_COMBINE but we don't even need the cache type for freeing
-		  back to the OS).
-		*/
-		_FreeOSPage(PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE,
-			    0,
-			    IMG_TRUE,
-			    IMG_TRUE,
-			    psPagePoolEntry->psPage);
-		_LinuxPagePoolEntryFree(psPagePoolEntry);
-
-		if (--uNumToScan == 0)
-		{
-			break;
-		}
-	}
 
 	/*
-	  Note:
-	  For anything other then x86 this list will be empty but we want to
-	  keep differences between compiled code to a minimum and so
-	  this isn't wrapped in #if defined(CONFIG_X86)
+	  Hand back single pages before chunks: the contiguous chunks are the
+	  ones that are expensive to get again.
 	*/
-	list_for_each_entry_safe(psPagePoolEntry, psTempPoolEntry, &g_sUncachedPagePoolList, sPagePoolItem)
+	uiOrderIndex = PAGE_POOL_ORDER_COUNT;
+	while (uiOrderIndex-- > 0 && uNumFreed < uNumToScan)
 	{
-		_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
+		uNumFreed += _EvictPoolListUnlocked(&g_asPagePoolList[uiOrderIndex],
+											PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE,
+											uNumToScan - uNumFreed);
 
 		/*
-		  We don't want to save the cache type and is we need to unset the
-		  memory type as it would double the page pool structure and the
-		  values are always going to be the same anyway which is why the
-		  page is in the pool (well the page could be UNCACHED or
-		  WRITE_COMBINE but we don't even need the cache type for freeing
-		  back to the OS).
+		  Note:
+		  For anything other then x86 this list will be empty but we want to
+		  keep differences between compiled code to a minimum and so
+		  this isn't wrapped in #if defined(CONFIG_X86)
 		*/
-		_FreeOSPage(PVRSRV_MEMALLOCFLAG_CPU_UNCACHED,
-			    0,
-			    IMG_TRUE,
-			    IMG_TRUE,
-			    psPagePoolEntry->psPage);
-		_LinuxPagePoolEntryFree(psPagePoolEntry);
-
-		if (--uNumToScan == 0)
-		{
-			break;
-		}
+		uNumFreed += _EvictPoolListUnlocked(&g_asUncachedPagePoolList[uiOrderIndex],
+											PVRSRV_MEMALLOCFLAG_CPU_UNCACHED,
+											uNumToScan - uNumFreed);
 	}
 
-	if (list_empty(&g_sPagePoolList) && list_empty(&g_sUncachedPagePoolList))
-	{
-		PVR_ASSERT(g_ui32PagePoolEntryCount == 0);
-	}
-	remain = g_ui32PagePoolEntryCount;
+	remain = g_ui32PagePoolPageCount;
 	_PagePoolUnlock();
 
 	return remain;
@@ -450,57 +516,28 @@ static IMG_VOID _InitPagePool(IMG_VOID)
 
 static IMG_VOID _DeinitPagePool(IMG_VOID)
 {
-	LinuxPagePoolEntry *psPagePoolEntry, *psTempPoolEntry;
+	IMG_UINT32 uiOrderIndex;
 
 	_PagePoolLock();
 	/* Evict all the pages from the pool */
-	list_for_each_entry_safe(psPagePoolEntry, psTempPoolEntry, &g_sPagePoolList, sPagePoolItem)
-	{
-		_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
-
-		/*
-			We don't want to save the cache type and is we need to unset the
-			memory type as it would double the page pool structure and the
-			values are always going to be the same anyway which is why the
-			page is in the pool (well the page could be UNCACHED or
-			WRITE_COMBINE but we don't even need the cache type for freeing
-			back to the OS).
-		*/
-		_FreeOSPage(PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE,
-					0,
-					IMG_TRUE,
-					IMG_TRUE,
-					psPagePoolEntry->psPage);
-		_LinuxPagePoolEntryFree(psPagePoolEntry);
-	}
-	
-	/*
-		Note:
-		For anything other then x86 this will be a no-op but we want to
-		keep differences between compiled code to a minimum and so
-		this isn't wrapped in #if defined(CONFIG_X86)
-	*/
-	list_for_each_entry_safe(psPagePoolEntry, psTempPoolEntry, &g_sUncachedPagePoolList, sPagePoolItem)
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
 	{
-		_RemoveEntryFromPoolUnlocked(psPagePoolEntry);
+		_EvictPoolListUnlocked(&g_asPagePoolList[uiOrderIndex],
+							   PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE,
+							   ~0UL);
 
 		/*
-			We don't want to save the cache type and is we need to unset the
-			memory type as it would double the page pool structure and the
-			values are always going to be the same anyway which is why the
-			page is in the pool (well the page could be UNCACHED or
-			WRITE_COMBINE but we don't even need the cache type for freeing
-			back to the OS).
+			Note:
+			For anything other then x86 this will be a no-op but we want to
+			keep differences between compiled code to a minimum and so
+			this isn't wrapped in #if defined(CONFIG_X86)
 		*/
-		_FreeOSPage(PVRSRV_MEMALLOCFLAG_CPU_UNCACHED,
-					0,
-					IMG_TRUE,
-					IMG_TRUE,
-					psPagePoolEntry->psPage);
-		_LinuxPagePoolEntryFree(psPagePoolEntry);
+		_EvictPoolListUnlocked(&g_asUncachedPagePoolList[uiOrderIndex],
+							   PVRSRV_MEMALLOCFLAG_CPU_UNCACHED,
+							   ~0UL);
 	}
 
-	PVR_ASSERT(g_ui32PagePoolEntryCount == 0);
+	PVR_ASSERT(g_ui32PagePoolPageCount == 0);
 
 	/* Free the page cache */
 	kmem_cache_destroy(g_psLinuxPagePoolCache);
@@ -627,30 +664,117 @@ e_freed_pvdata:
 
 }
 
+#if defined (__arm__) || defined (__metag__)
+static inline IMG_VOID
+_CPUCacheOpRange(IMG_PVOID pvVirtStart,
+				 IMG_PVOID pvVirtEnd,
+				 IMG_CPU_PHYADDR sCPUPhysAddrStart,
+				 IMG_CPU_PHYADDR sCPUPhysAddrEnd,
+				 IMG_BOOL bFlush)
+{
+	/* If we're zeroing, we need to make sure the cleared memory is pushed out
+		of the cache before the cache lines are invalidated */
+	if (bFlush)
+	{
+		OSFlushCPUCacheRangeKM(pvVirtStart,
+							   pvVirtEnd,
+							   sCPUPhysAddrStart,
+							   sCPUPhysAddrEnd);
+	}
+	else
+	{
+		OSInvalidateCPUCacheRangeKM(pvVirtStart,
+									pvVirtEnd,
+									sCPUPhysAddrStart,
+									sCPUPhysAddrEnd);
+	}
+}
+
+/*
+	Flush or invalidate a physically contiguous run of pages.  Lowmem runs
+	are covered by the linear mapping, and on ARM 3.7+ the range operations
+	only use the physical range, so either way the run is done with one
+	call.  Only highmem on older kernels has to be mapped a page at a time.
+*/
+static IMG_VOID
+_CPUCacheOpPages(struct page *psPage, IMG_UINT32 uiNumPages, IMG_BOOL bFlush)
+{
+	IMG_CPU_PHYADDR sCPUPhysAddrStart, sCPUPhysAddrEnd;
+	IMG_PVOID pvPageVAddr;
+	IMG_SIZE_T uiSize = (IMG_SIZE_T)uiNumPages << PAGE_SHIFT;
+
+	sCPUPhysAddrStart.uiAddr = page_to_phys(psPage);
+	sCPUPhysAddrEnd.uiAddr = sCPUPhysAddrStart.uiAddr + uiSize;
+
+	if (!PageHighMem(psPage))
+	{
+		pvPageVAddr = page_address(psPage);
+		_CPUCacheOpRange(pvPageVAddr, pvPageVAddr + uiSize,
+						 sCPUPhysAddrStart, sCPUPhysAddrEnd, bFlush);
+		return;
+	}
+
+#if defined(__arm__) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0))
+	_CPUCacheOpRange(IMG_NULL, IMG_NULL,
+					 sCPUPhysAddrStart, sCPUPhysAddrEnd, bFlush);
+#else
+	{
+		IMG_UINT32 uiPage;
+
+		for (uiPage = 0; uiPage < uiNumPages; uiPage++)
+		{
+			pvPageVAddr = kmap(psPage + uiPage);
+			sCPUPhysAddrStart.uiAddr = page_to_phys(psPage + uiPage);
+			sCPUPhysAddrEnd.uiAddr = sCPUPhysAddrStart.uiAddr + PAGE_SIZE;
+			_CPUCacheOpRange(pvPageVAddr, pvPageVAddr + PAGE_SIZE,
+							 sCPUPhysAddrStart, sCPUPhysAddrEnd, bFlush);
+			kunmap(psPage + uiPage);
+		}
+	}
+#endif
+}
+#endif /* defined (__arm__) || defined (__metag__) */
+
+/*
+	Allocate the next run of pages for a PMR, no more than uiMaxPages long,
+	and return it split into order 0 pages in ppsPageArray.  The pool is
+	tried first, largest chunk first.  On a miss the OS is asked for a
+	high order chunk only if one is free right now (no reclaim, no
+	compaction, no retries) and we fall back an order at a time, so a
+	fragmented system costs a failed fast path attempt, not a stall.
+*/
 static PVRSRV_ERROR
-_AllocOSPage(IMG_UINT32 ui32CPUCacheFlags,
-			 unsigned int gfp_flags,
-			 IMG_BOOL bFlush,
-			 IMG_UINT32 uiOrder,
-			 IMG_BOOL *pbUnsetMemoryType,
-			 struct page **ppsPage)
+_AllocOSChunk(IMG_UINT32 ui32CPUCacheFlags,
+			  unsigned int gfp_flags,
+			  IMG_BOOL bFlush,
+			  IMG_UINT32 uiMaxPages,
+			  IMG_BOOL *pbUnsetMemoryType,
+			  IMG_UINT32 *puiOrder,
+			  struct page **ppsPageArray)
 {
 	PVRSRV_ERROR eError = PVRSRV_OK;
 	IMG_BOOL bFromPagePool = IMG_FALSE;
-#if defined (CONFIG_X86) || defined(__arm__) || defined (__metag__)
-	IMG_PVOID pvPageVAddr;
-#endif
+	IMG_UINT32 uiOrderIndex;
+	IMG_UINT32 uiOrder = 0;
+	IMG_UINT32 uiNumPages;
+	IMG_UINT32 uiPage;
 	struct page *psPage = IMG_NULL;
 
 	*pbUnsetMemoryType = IMG_FALSE;
 
-	/* Does the requested page contiguity match the CPU page size? */
-	if (uiOrder == 0)
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
 	{
-		psPage = _RemoveFirstEntryFromPool(ui32CPUCacheFlags);
+		uiOrder = g_aui32PagePoolOrders[uiOrderIndex];
+		if ((1U << uiOrder) > uiMaxPages)
+		{
+			continue;
+		}
+
+		psPage = _RemoveFirstEntryFromPool(ui32CPUCacheFlags, uiOrderIndex);
 		if (psPage != IMG_NULL)
 		{
 			bFromPagePool = IMG_TRUE;
+			atomic_inc(&g_asChunksFromPool[uiOrderIndex]);
 			/*
 				Unset memory type is set to true as although in the "normal" case
 				(where we free the page back to the pool) we don't want to unset
@@ -658,19 +782,52 @@ _AllocOSPage(IMG_UINT32 ui32CPUCacheFlags,
 				and thus we have to give the page back to the OS.
 			*/
 			*pbUnsetMemoryType = IMG_TRUE;
+			break;
 		}
 	}
 
 	/* 
-		Did we check the page pool and/or was it a page pool miss,
-		either the pool was empty or it was for a cached page so we
-		must ask the OS and do the cache management as required.
+		Was it a page pool miss, either the pool was empty or it was for
+		a cached page so we must ask the OS and do the cache management
+		as required.
 	*/
 	if (!bFromPagePool)
 	{
-        DisableOOMKiller();
-        psPage = alloc_pages(gfp_flags, uiOrder);
-        EnableOOMKiller();
+		for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
+		{
+			unsigned int chunk_gfp_flags = gfp_flags;
+
+			uiOrder = g_aui32PagePoolOrders[uiOrderIndex];
+			if ((1U << uiOrder) > uiMaxPages)
+			{
+				continue;
+			}
+
+			if (uiOrder > 0)
+			{
+				if (!gPVRPhysmemHighOrder)
+				{
+					continue;
+				}
+				chunk_gfp_flags = (gfp_flags & ~__GFP_WAIT) | __GFP_NORETRY | __GFP_NO_KSWAPD;
+			}
+
+			DisableOOMKiller();
+			psPage = alloc_pages(chunk_gfp_flags, uiOrder);
+			EnableOOMKiller();
+
+			if (psPage != IMG_NULL)
+			{
+				atomic_inc(&g_asChunksFromOS[uiOrderIndex]);
+				if (uiOrder > 0)
+				{
+					split_page(psPage, uiOrder);
+				}
+				break;
+			}
+			atomic_inc(&g_asChunkFallbacks[uiOrderIndex]);
+		}
+		uiNumPages = 1U << uiOrder;
 
 #if defined (CONFIG_X86)
 		if (psPage != IMG_NULL)
@@ -679,32 +836,20 @@ _AllocOSPage(IMG_UINT32 ui32CPUCacheFlags,
 				On X86 if we already have a mapping we need to change the mode of
 				current mapping before we map it ourselves
 			*/
-			pvPageVAddr = page_address(psPage);
+			IMG_PVOID pvPageVAddr = page_address(psPage);
 			if (pvPageVAddr != NULL)
 			{
-				int ret;
+				int ret = 0;
 
 				switch (ui32CPUCacheFlags)
 				{
 					case PVRSRV_MEMALLOCFLAG_CPU_UNCACHED:
-							ret = set_memory_uc((unsigned long)pvPageVAddr, 1);
-							if (ret)
-							{
-								eError = PVRSRV_ERROR_UNABLE_TO_SET_CACHE_MODE;
-								 __free_pages(psPage, uiOrder);
-								 psPage = IMG_NULL;
-							}
+							ret = set_memory_uc((unsigned long)pvPageVAddr, uiNumPages);
 							*pbUnsetMemoryType = IMG_TRUE;
 							break;
 
 					case PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE:
-							ret = set_memory_wc((unsigned long)pvPageVAddr, 1);
-							if (ret)
-							{
-								eError = PVRSRV_ERROR_UNABLE_TO_SET_CACHE_MODE;
-								 __free_pages(psPage, uiOrder);
-								psPage = IMG_NULL;
-							}
+							ret = set_memory_wc((unsigned long)pvPageVAddr, uiNumPages);
 							*pbUnsetMemoryType = IMG_TRUE;
 							break;
 
@@ -714,6 +859,16 @@ _AllocOSPage(IMG_UINT32 ui32CPUCacheFlags,
 					default:
 							break;
 				}
+
+				if (ret)
+				{
+					eError = PVRSRV_ERROR_UNABLE_TO_SET_CACHE_MODE;
+					for (uiPage = 0; uiPage < uiNumPages; uiPage++)
+					{
+						__free_page(psPage + uiPage);
+					}
+					psPage = IMG_NULL;
+				}
 			}
 		}
 #endif
@@ -728,90 +883,129 @@ _AllocOSPage(IMG_UINT32 ui32CPUCacheFlags,
 		This still seems to be true if we request cold pages, it's just less
 		likely to be in the cache.
 		*/
-		if (psPage != IMG_NULL)
+		if (psPage != IMG_NULL &&
+			ui32CPUCacheFlags != PVRSRV_MEMALLOCFLAG_CPU_CACHED)
 		{
-			pvPageVAddr = kmap(psPage);
-
-			if (ui32CPUCacheFlags != PVRSRV_MEMALLOCFLAG_CPU_CACHED)
-			{
-				IMG_CPU_PHYADDR sCPUPhysAddrStart, sCPUPhysAddrEnd;
-
-				sCPUPhysAddrStart.uiAddr = page_to_phys(psPage);
-				sCPUPhysAddrEnd.uiAddr = sCPUPhysAddrStart.uiAddr + PAGE_SIZE;
-
-				/* If we're zeroing, we need to make sure the cleared memory is pushed out
-					of the cache before the cache lines are invalidated */
-				if (bFlush)
-				{
-					OSFlushCPUCacheRangeKM(pvPageVAddr,
-												pvPageVAddr + PAGE_SIZE,
-												sCPUPhysAddrStart,
-												sCPUPhysAddrEnd);
-				}
-				else
-				{
-					OSInvalidateCPUCacheRangeKM(pvPageVAddr,
-												pvPageVAddr + PAGE_SIZE,
-												sCPUPhysAddrStart,
-												sCPUPhysAddrEnd);
-				}
-			}
-			kunmap(psPage);
+			_CPUCacheOpPages(psPage, uiNumPages, bFlush);
 		}
 #endif
 	}
 	else
 	{
+		uiNumPages = 1U << uiOrder;
+
 		/*
 			The kernel will zero the page for us when we allocate it, but if it
 			comes from the pool then we must do this ourselves.
 		*/
-		if (psPage != IMG_NULL  &&  gfp_flags & __GFP_ZERO)
+		if (gfp_flags & __GFP_ZERO)
 		{
-			pvPageVAddr = kmap(psPage);
-			memset(pvPageVAddr, 0, PAGE_SIZE);
+			for (uiPage = 0; uiPage < uiNumPages; uiPage++)
+			{
+				IMG_PVOID pvPageVAddr = kmap(psPage + uiPage);
+				memset(pvPageVAddr, 0, PAGE_SIZE);
+				kunmap(psPage + uiPage);
+			}
 
 #if defined (__arm__) || defined (__metag__)
 			if (ui32CPUCacheFlags != PVRSRV_MEMALLOCFLAG_CPU_CACHED)
 			{
-				IMG_CPU_PHYADDR sCPUPhysAddrStart, sCPUPhysAddrEnd;
-
-				sCPUPhysAddrStart.uiAddr = page_to_phys(psPage);
-				sCPUPhysAddrEnd.uiAddr = sCPUPhysAddrStart.uiAddr + PAGE_SIZE;
-
-				if (bFlush)
-				{
-					OSFlushCPUCacheRangeKM(pvPageVAddr,
-												pvPageVAddr + PAGE_SIZE,
-												sCPUPhysAddrStart,
-												sCPUPhysAddrEnd);
-				}
-				else
-				{
-					OSInvalidateCPUCacheRangeKM(pvPageVAddr,
-												pvPageVAddr + PAGE_SIZE,
-												sCPUPhysAddrStart,
-												sCPUPhysAddrEnd);
-				}
+				_CPUCacheOpPages(psPage, uiNumPages, bFlush);
 			}
 #endif
-
-			kunmap(psPage);
 		}
 	}
 
-	if(IMG_NULL == (*ppsPage = psPage)){
-		return PVRSRV_ERROR_OUT_OF_MEMORY; 
+	if (psPage == IMG_NULL)
+	{
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+
+	for (uiPage = 0; uiPage < uiNumPages; uiPage++)
+	{
+		ppsPageArray[uiPage] = psPage + uiPage;
 	}
+	*puiOrder = uiOrder;
+
 	return eError;
 }
 
+/*
+	Allocate one minimum contiguity unit of 1 << uiOrder host pages for a
+	PMR whose page size is larger than the host page.  The unit must stay
+	physically contiguous, so it is neither split nor pooled.
+*/
+static PVRSRV_ERROR
+_AllocOSHigherOrderPage(IMG_UINT32 ui32CPUCacheFlags,
+						unsigned int gfp_flags,
+						IMG_BOOL bFlush,
+						IMG_UINT32 uiOrder,
+						IMG_BOOL *pbUnsetMemoryType,
+						struct page **ppsPage)
+{
+	struct page *psPage;
+
+	*pbUnsetMemoryType = IMG_FALSE;
+
+	DisableOOMKiller();
+	psPage = alloc_pages(gfp_flags, uiOrder);
+	EnableOOMKiller();
+
+	if (psPage == IMG_NULL)
+	{
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+
+#if defined (CONFIG_X86)
+	{
+		IMG_PVOID pvPageVAddr = page_address(psPage);
+		int ret = 0;
+
+		switch (ui32CPUCacheFlags)
+		{
+			case PVRSRV_MEMALLOCFLAG_CPU_UNCACHED:
+					ret = set_memory_uc((unsigned long)pvPageVAddr, 1U << uiOrder);
+					*pbUnsetMemoryType = IMG_TRUE;
+					break;
+
+			case PVRSRV_MEMALLOCFLAG_CPU_WRITE_COMBINE:
+					ret = set_memory_wc((unsigned long)pvPageVAddr, 1U << uiOrder);
+					*pbUnsetMemoryType = IMG_TRUE;
+					break;
+
+			default:
+					break;
+		}
+
+		if (ret)
+		{
+			__free_pages(psPage, uiOrder);
+			return PVRSRV_ERROR_UNABLE_TO_SET_CACHE_MODE;
+		}
+	}
+#endif
+#if defined (__arm__) || defined (__metag__)
+	if (ui32CPUCacheFlags != PVRSRV_MEMALLOCFLAG_CPU_CACHED)
+	{
+		_CPUCacheOpPages(psPage, 1U << uiOrder, bFlush);
+	}
+#else
+	PVR_UNREFERENCED_PARAMETER(bFlush);
+#endif
+
+	*ppsPage = psPage;
+	return PVRSRV_OK;
+}
+
 
 /*
 	Note:
 	We must _only_ check bUnsetMemoryType in the case where we need to free
 	the page back to the OS since we may have to revert the cache properties
 	of the page to the default as given by the OS when it was allocated.
+
+	psPage is the first of a physically contiguous run of 1 << uiOrder
+	order 0 pages.
 */
 static IMG_VOID
 _FreeOSPage(IMG_UINT32 ui32CPUCacheFlags,
@@ -821,20 +1015,20 @@ _FreeOSPage(IMG_UINT32 ui32CPUCacheFlags,
 			struct page *psPage)
 {
 	IMG_BOOL bAddedToPool = IMG_FALSE;
+	IMG_UINT32 uiPage;
 #if defined (CONFIG_X86)
     IMG_PVOID pvPageVAddr;
 #endif
 
-	/* Only zero order pages can be managed in the pool */
-	if ((uiOrder == 0) && (!bFreeToOS))
+	if (!bFreeToOS)
 	{
 		_PagePoolLock();
-		bAddedToPool = g_ui32PagePoolEntryCount < g_ui32PagePoolMaxEntries;
+		bAddedToPool = (g_ui32PagePoolPageCount + (1U << uiOrder)) <= g_ui32PagePoolMaxEntries;
 		_PagePoolUnlock();
 
 		if (bAddedToPool)
 		{
-			if (!_AddEntryToPool(psPage, ui32CPUCacheFlags))
+			if (!_AddEntryToPool(psPage, uiOrder, ui32CPUCacheFlags))
 			{
 				bAddedToPool = IMG_FALSE;
 			}
@@ -849,15 +1043,120 @@ _FreeOSPage(IMG_UINT32 ui32CPUCacheFlags,
 		{
 			int ret;
 
-			ret = set_memory_wb((unsigned long)pvPageVAddr, 1);
+			ret = set_memory_wb((unsigned long)pvPageVAddr, 1U << uiOrder);
 			if (ret)
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Failed to reset page attribute", __FUNCTION__));
 			}
 		}
 #endif
-		__free_pages(psPage, uiOrder);
+		/* Chunks were split when allocated, so each page goes back on its own */
+		for (uiPage = 0; uiPage < (1U << uiOrder); uiPage++)
+		{
+			__free_page(psPage + uiPage);
+		}
+	}
+}
+
+/*
+	Find the largest pool order for which the pages at ppsPageArray form a
+	naturally aligned, physically contiguous run.
+*/
+static IMG_UINT32
+_GetPageRunOrder(struct page **ppsPageArray, IMG_UINT32 uiMaxPages)
+{
+	unsigned long ulPFN = page_to_pfn(ppsPageArray[0]);
+	IMG_UINT32 uiOrderIndex;
+	IMG_UINT32 uiPage;
+
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
+	{
+		IMG_UINT32 uiNumPages = 1U << g_aui32PagePoolOrders[uiOrderIndex];
+
+		if (uiNumPages > uiMaxPages || (ulPFN & (uiNumPages - 1)) != 0)
+		{
+			continue;
+		}
+
+		for (uiPage = 1; uiPage < uiNumPages; uiPage++)
+		{
+			if (page_to_pfn(ppsPageArray[uiPage]) != ulPFN + uiPage)
+			{
+				break;
+			}
+		}
+
+		if (uiPage == uiNumPages)
+		{
+			return g_aui32PagePoolOrders[uiOrderIndex];
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Free an array of pages in the largest runs we can find, so chunks that
+	were allocated together go back to the pool (or the OS) together.
+*/
+static IMG_VOID
+_FreeOSPageRuns(IMG_UINT32 ui32CPUCacheFlags,
+				IMG_BOOL bUnsetMemoryType,
+				struct page **ppsPageArray,
+				IMG_UINT32 uiNumPages)
+{
+	IMG_UINT32 uiPageIndex = 0;
+
+	while (uiPageIndex < uiNumPages)
+	{
+		IMG_UINT32 uiOrder = _GetPageRunOrder(&ppsPageArray[uiPageIndex],
+											  uiNumPages - uiPageIndex);
+
+		_FreeOSPage(ui32CPUCacheFlags,
+					uiOrder,
+					bUnsetMemoryType,
+					IMG_FALSE,
+					ppsPageArray[uiPageIndex]);
+		uiPageIndex += 1U << uiOrder;
+	}
+}
+
+static IMG_VOID
+_FreeOSHigherOrderPages(IMG_BOOL bUnsetMemoryType,
+						IMG_UINT32 uiOrder,
+						struct page **ppsPageArray,
+						IMG_UINT32 uiNumPages)
+{
+	IMG_UINT32 uiPageIndex;
+
+	for (uiPageIndex = 0; uiPageIndex < uiNumPages; uiPageIndex++)
+	{
+#if defined(CONFIG_X86)
+		if (bUnsetMemoryType == IMG_TRUE &&
+			set_memory_wb((unsigned long)page_address(ppsPageArray[uiPageIndex]), 1U << uiOrder))
+		{
+			PVR_DPF((PVR_DBG_ERROR, "%s: Failed to reset page attribute", __FUNCTION__));
+		}
+#else
+		PVR_UNREFERENCED_PARAMETER(bUnsetMemoryType);
+#endif
+		__free_pages(ppsPageArray[uiPageIndex], uiOrder);
+	}
+}
+
+static IMG_VOID
+_RecordAllocLatency(IMG_UINT64 ui64DurationNs)
+{
+	IMG_UINT32 ui32Remainder;
+	IMG_UINT64 ui64Us = OSDivide64r64(ui64DurationNs, 1000, &ui32Remainder);
+	IMG_UINT32 uiBucket;
+
+	uiBucket = (ui64Us >> 32) ? PHYSMEM_LATENCY_BUCKETS - 1 : fls((IMG_UINT32)ui64Us);
+	if (uiBucket >= PHYSMEM_LATENCY_BUCKETS)
+	{
+		uiBucket = PHYSMEM_LATENCY_BUCKETS - 1;
 	}
+	atomic_inc(&g_asAllocLatency[uiBucket]);
 }
 
 static PVRSRV_ERROR
@@ -869,6 +1168,7 @@ _AllocOSPages(struct _PMR_OSPAGEARRAY_DATA_ **ppsPageArrayDataPtr)
     IMG_UINT32 uiOrder;
     IMG_UINT32 uiPageIndex;
 	IMG_UINT32 ui32CPUCacheFlags;
+	IMG_UINT64 ui64StartNs;
 
     struct _PMR_OSPAGEARRAY_DATA_ *psPageArrayData = *ppsPageArrayDataPtr;
     struct page **ppsPageArray = psPageArrayData->pagearray;
@@ -899,28 +1199,41 @@ _AllocOSPages(struct _PMR_OSPAGEARRAY_DATA_ **ppsPageArrayDataPtr)
         gfp_flags |= __GFP_ZERO;
     }
 
-    /* Allocate pages one at a time.  Note that the _device_ memory
-       page size may be different from the _host_ cpu page size - we
-       have a concept of a minimum contiguity requirement, which must
-       be sufficient to meet the requirement of both device and host
-       page size (and possibly other devices or other external
-       constraints).  We are allocating ONE "minimum contiguity unit"
-       (in practice, generally a _device_ page, but not necessarily)
-       at a time, by asking the OS for 2**uiOrder _host_ pages at a
-       time. */
-    for (uiPageIndex = 0;
-         uiPageIndex < psPageArrayData->uiNumPages;
-         uiPageIndex++)
+    /* Note that the _device_ memory page size may be different from
+       the _host_ cpu page size - we have a concept of a minimum
+       contiguity requirement, which must be sufficient to meet the
+       requirement of both device and host page size (and possibly
+       other devices or other external constraints).  When that
+       minimum is one host page we ask for the pages in the largest
+       chunks the pool or the OS can give us cheaply, which saves a
+       call into the page allocator and a cache operation per page.
+       Otherwise we allocate ONE "minimum contiguity unit" at a time,
+       by asking the OS for 2**uiOrder _host_ pages at a time. */
+    ui64StartNs = OSClockns64();
+    uiPageIndex = 0;
+    while (uiPageIndex < psPageArrayData->uiNumPages)
     {
-        /* For now we don't support compound pages */
-        PVR_ASSERT(uiOrder == 0);
-        
-		eError = _AllocOSPage(ui32CPUCacheFlags,
-							  gfp_flags,
-							  psPageArrayData->bZero,
-							  uiOrder,
-							  &psPageArrayData->bUnsetMemoryType,
-							  &ppsPageArray[uiPageIndex]);
+        IMG_UINT32 uiChunkOrder = 0;
+
+        if (uiOrder == 0)
+        {
+            eError = _AllocOSChunk(ui32CPUCacheFlags,
+                                   gfp_flags,
+                                   psPageArrayData->bZero,
+                                   psPageArrayData->uiNumPages - uiPageIndex,
+                                   &psPageArrayData->bUnsetMemoryType,
+                                   &uiChunkOrder,
+                                   &ppsPageArray[uiPageIndex]);
+        }
+        else
+        {
+            eError = _AllocOSHigherOrderPage(ui32CPUCacheFlags,
+                                             gfp_flags,
+                                             psPageArrayData->bZero,
+                                             uiOrder,
+                                             &psPageArrayData->bUnsetMemoryType,
+                                             &ppsPageArray[uiPageIndex]);
+        }
 
         if (eError != PVRSRV_OK)
         {
@@ -929,18 +1242,31 @@ _AllocOSPages(struct _PMR_OSPAGEARRAY_DATA_ **ppsPageArrayDataPtr)
                      uiPageIndex,
                      psPageArrayData->uiNumPages,
                      PVRSRVGetErrorStringKM(eError)));
-            for(--uiPageIndex;uiPageIndex < psPageArrayData->uiNumPages;--uiPageIndex)
+            if (uiOrder == 0)
             {
-				_FreeOSPage(ui32CPUCacheFlags,
-							uiOrder,
-							psPageArrayData->bUnsetMemoryType,
-							IMG_FALSE,
-							ppsPageArray[uiPageIndex]);
+                _FreeOSPageRuns(ui32CPUCacheFlags,
+                                psPageArrayData->bUnsetMemoryType,
+                                ppsPageArray,
+                                uiPageIndex);
+            }
+            else
+            {
+                _FreeOSHigherOrderPages(psPageArrayData->bUnsetMemoryType,
+                                        uiOrder,
+                                        ppsPageArray,
+                                        uiPageIndex);
             }
             eError = PVRSRV_ERROR_PMR_FAILED_TO_ALLOC_PAGES;
             goto e_freed_pages;
         }
 
+        uiPageIndex += 1U << uiChunkOrder;
+    }
+
+    for (uiPageIndex = 0;
+         uiPageIndex < psPageArrayData->uiNumPages;
+         uiPageIndex++)
+    {
         /* Can't ask us to zero it and poison it */
         PVR_ASSERT(!psPageArrayData->bZero || !psPageArrayData->bPoisonOnAlloc);
 
@@ -959,14 +1285,15 @@ _AllocOSPages(struct _PMR_OSPAGEARRAY_DATA_ **ppsPageArrayDataPtr)
 			IMG_CPU_PHYADDR sCPUPhysAddr;
 			sCPUPhysAddr.uiAddr = page_to_phys(ppsPageArray[uiPageIndex]);
 			PVRSRVStatsAddMemAllocRecord(PVRSRV_MEM_ALLOC_TYPE_ALLOC_UMA_PAGES,
-									 IMG_NULL,
-									 sCPUPhysAddr,
-									 PAGE_SIZE,
-									 IMG_NULL);
+										 IMG_NULL,
+										 sCPUPhysAddr,
+										 PAGE_SIZE,
+										 IMG_NULL);
 		}
 #endif
 #endif
     }
+    _RecordAllocLatency(OSClockns64() - ui64StartNs);
 
     /* OS Pages have been allocated */
     psPageArrayData->bHasOSPages = IMG_TRUE;
@@ -1035,12 +1362,21 @@ _FreeOSPages(struct _PMR_OSPAGEARRAY_DATA_ *psPageArrayData)
 		}
 #endif
 #endif
+	}
 
-		_FreeOSPage(psPageArrayData->ui32CPUCacheFlags,
-					uiOrder,
-					psPageArrayData->bUnsetMemoryType,
-					IMG_FALSE,
-					ppsPageArray[uiPageIndex]);
+	if (uiOrder == 0)
+	{
+		_FreeOSPageRuns(psPageArrayData->ui32CPUCacheFlags,
+						psPageArrayData->bUnsetMemoryType,
+						ppsPageArray,
+						uiNumPages);
+	}
+	else
+	{
+		_FreeOSHigherOrderPages(psPageArrayData->bUnsetMemoryType,
+								uiOrder,
+								ppsPageArray,
+								uiNumPages);
 	}
 
     eError = PVRSRV_OK;
@@ -1454,3 +1790,109 @@ PhysmemNewOSRamBackedPMR(PVRSRV_DEVICE_NODE *psDevNode,
                                uiFlags,
                                ppsPMRPtr);
 }
+
+static void *PhysmemPoolSeqStart(struct seq_file *psSeqFile, loff_t *puiPosition)
+{
+	return (*puiPosition == 0) ? SEQ_START_TOKEN : NULL;
+}
+
+static void PhysmemPoolSeqStop(struct seq_file *psSeqFile, void *pvData)
+{
+}
+
+static void *PhysmemPoolSeqNext(struct seq_file *psSeqFile,
+								void *pvData,
+								loff_t *puiPosition)
+{
+	(*puiPosition)++;
+	return NULL;
+}
+
+static int PhysmemPoolSeqShow(struct seq_file *psSeqFile, void *pvData)
+{
+	IMG_UINT32 aui32Pooled[PAGE_POOL_ORDER_COUNT];
+	IMG_UINT32 ui32PageCount;
+	IMG_UINT32 uiOrderIndex;
+	IMG_UINT32 uiBucket;
+
+	_PagePoolLock();
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
+	{
+		struct list_head *psEntry;
+
+		aui32Pooled[uiOrderIndex] = 0;
+		list_for_each(psEntry, &g_asPagePoolList[uiOrderIndex])
+		{
+			aui32Pooled[uiOrderIndex]++;
+		}
+		list_for_each(psEntry, &g_asUncachedPagePoolList[uiOrderIndex])
+		{
+			aui32Pooled[uiOrderIndex]++;
+		}
+	}
+	ui32PageCount = g_ui32PagePoolPageCount;
+	_PagePoolUnlock();
+
+	seq_printf(psSeqFile, "Pool: %u of %u pages, high order allocation %s\n\n",
+			   ui32PageCount, g_ui32PagePoolMaxEntries,
+			   gPVRPhysmemHighOrder ? "on" : "off");
+
+	seq_printf(psSeqFile, "%-6s %10s %12s %12s %12s\n",
+			   "Order", "Pooled", "From pool", "From OS", "OS misses");
+	for (uiOrderIndex = 0; uiOrderIndex < PAGE_POOL_ORDER_COUNT; uiOrderIndex++)
+	{
+		seq_printf(psSeqFile, "%-6u %10u %12u %12u %12u\n",
+				   g_aui32PagePoolOrders[uiOrderIndex],
+				   aui32Pooled[uiOrderIndex],
+				   atomic_read(&g_asChunksFromPool[uiOrderIndex]),
+				   atomic_read(&g_asChunksFromOS[uiOrderIndex]),
+				   atomic_read(&g_asChunkFallbacks[uiOrderIndex]));
+	}
+
+	seq_printf(psSeqFile, "\n%-20s %12s\n", "PMR alloc time (us)", "Count");
+	for (uiBucket = 0; uiBucket < PHYSMEM_LATENCY_BUCKETS; uiBucket++)
+	{
+		if (uiBucket == 0)
+		{
+			seq_printf(psSeqFile, "%-20s", "< 1");
+		}
+		else if (uiBucket == PHYSMEM_LATENCY_BUCKETS - 1)
+		{
+			seq_printf(psSeqFile, ">= %-17u", 1U << (uiBucket - 1));
+		}
+		else
+		{
+			seq_printf(psSeqFile, "%8u - %-9u", 1U << (uiBucket - 1), (1U << uiBucket) - 1);
+		}
+		seq_printf(psSeqFile, " %12u\n", atomic_read(&g_asAllocLatency[uiBucket]));
+	}
+
+	return 0;
+}
+
+static struct seq_operations gsPhysmemPoolReadOps =
+{
+	.start = PhysmemPoolSeqStart,
+	.stop = PhysmemPoolSeqStop,
+	.next = PhysmemPoolSeqNext,
+	.show = PhysmemPoolSeqShow,
+};
+
+int PhysmemOSDebugFSInit(void)
+{
+	return PVRDebugFSCreateEntry("physmem_pool",
+								 NULL,
+								 &gsPhysmemPoolReadOps,
+								 NULL,
+								 NULL,
+								 &gpsPhysmemPoolDebugFSEntry);
+}
+
+void PhysmemOSDebugFSDeInit(void)
+{
+	if (gpsPhysmemPoolDebugFSEntry != NULL)
+	{
+		PVRDebugFSRemoveEntry(gpsPhysmemPoolDebugFSEntry);
+		gpsPhysmemPoolDebugFSEntry = NULL;
+	}
+}
@@ -41,6 +41,9 @@ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
 IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */ /**************************************************************************/
+#include <linux/module.h>
+#include <linux/spinlock.h>
+
 #include "img_defs.h"
 #include "pvr_bridge.h"
 #include "connection_server.h"
@@ -50,6 +53,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pvr_debugfs.h"
 #include "private_data.h"
 #include "linkage.h"
+#include "driverlock.h"
+#include "env_connection.h"
+#include "env_data.h"
+#include "pvrsrv.h"
 
 #if defined(SUPPORT_DRM)
 #include <drm/drmP.h>
@@ -66,7 +73,16 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "srvcore.h"
 #include "common_srvcore_bridge.h"
+#include "common_sync_bridge.h"
 #include "cache_defines.h"
+#if defined(SUPPORT_RGX)
+#include "common_rgxta3d_bridge.h"
+#include "common_rgxtq_bridge.h"
+#include "common_rgxcmp_bridge.h"
+#endif
+#if (CACHEFLUSH_TYPE == CACHEFLUSH_GENERIC)
+#include "common_cachegeneric_bridge.h"
+#endif
 
 #if defined(MODULE_TEST)
 /************************************************************************/
@@ -146,6 +162,230 @@ LinuxBridgeInit(IMG_VOID);
 IMG_VOID
 LinuxBridgeDeInit(IMG_VOID);
 
+/*
+ * Bridge lock classes.
+ *
+ * Every bridge call used to run under gPVRSRVLock, so kicks from the UI
+ * thread, sync queries from the compositor and cache maintenance for
+ * uploads all serialised.  Calls in a non-global class instead take the
+ * shared side of the bridge lock, then the calling connection's mutex
+ * (handle lookups in the connection's handle base are not thread safe),
+ * then the mutex of their class (the server objects they touch are not
+ * thread safe either, so same-class calls still serialise across
+ * connections).  Calls of different classes, and calls that only wait,
+ * now overlap.
+ *
+ * A call may only be moved out of the global class if neither it nor
+ * anything it calls takes gPVRSRVLock, creates or destroys handles, or
+ * frees server objects.
+ *
+ * BridgedDispatchKM marshals through the single bridge buffer in ENV_DATA,
+ * so it only ever runs under gPVRSRVLock.  Non-global calls are marshalled
+ * by LinuxBridgedDispatchFine through the calling connection's own buffer
+ * instead, which the connection mutex makes exclusive.
+ */
+static IMG_UINT32 gPVRBridgeFineLocking = 1;
+module_param(gPVRBridgeFineLocking, uint, 0644);
+MODULE_PARM_DESC(gPVRBridgeFineLocking, "Run hot bridge calls without the global bridge lock (default 1)");
+
+static IMG_UINT8 gaui8BridgeLockClass[BRIDGE_DISPATCH_TABLE_ENTRY_COUNT];
+static struct mutex gasBridgeClassLock[PVRSRV_BRIDGE_LOCK_CLASS_COUNT];
+
+static IMG_VOID SetBridgeLockClass(IMG_UINT32 ui32BridgeID,
+								   PVRSRV_BRIDGE_LOCK_CLASS eClass)
+{
+	ui32BridgeID = PVRSRV_GET_BRIDGE_ID(ui32BridgeID);
+
+	PVR_ASSERT(ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT);
+	gaui8BridgeLockClass[ui32BridgeID] = (IMG_UINT8)eClass;
+}
+
+static IMG_VOID LinuxBridgeLockInit(IMG_VOID)
+{
+	IMG_UINT32 i;
+
+	for (i = 0; i < PVRSRV_BRIDGE_LOCK_CLASS_COUNT; i++)
+	{
+		mutex_init(&gasBridgeClassLock[i]);
+	}
+
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SYNCPRIMSET, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SERVERSYNCPRIMSET, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SERVERSYNCQUEUEHWOP, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SYNCPRIMOPTAKE, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SYNCPRIMOPCOMPLETE, PVRSRV_BRIDGE_LOCK_KICK);
+#if defined(SUPPORT_RGX)
+	SetBridgeLockClass(PVRSRV_BRIDGE_RGXTA3D_RGXKICKTA3D, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_RGXTQ_RGXSUBMITTRANSFER, PVRSRV_BRIDGE_LOCK_KICK);
+	SetBridgeLockClass(PVRSRV_BRIDGE_RGXCMP_RGXKICKCDM, PVRSRV_BRIDGE_LOCK_KICK);
+#endif
+
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SERVERSYNCGETSTATUS, PVRSRV_BRIDGE_LOCK_SYNC_QUERY);
+	SetBridgeLockClass(PVRSRV_BRIDGE_SYNC_SYNCPRIMOPREADY, PVRSRV_BRIDGE_LOCK_SYNC_QUERY);
+
+#if (CACHEFLUSH_TYPE == CACHEFLUSH_GENERIC)
+	SetBridgeLockClass(PVRSRV_BRIDGE_CACHEGENERIC_CACHEOPQUEUE, PVRSRV_BRIDGE_LOCK_CACHE);
+#endif
+}
+
+PVRSRV_BRIDGE_LOCK_CLASS LinuxBridgeLockClass(IMG_UINT32 ui32BridgeID)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,15))
+	/* Before init succeeds BridgedDispatchKM has init-server checks to make */
+	if (gPVRBridgeFineLocking && ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT &&
+		PVRSRVGetInitServerState(PVRSRV_INIT_SERVER_SUCCESSFUL))
+	{
+		return (PVRSRV_BRIDGE_LOCK_CLASS)gaui8BridgeLockClass[ui32BridgeID];
+	}
+#endif
+	return PVRSRV_BRIDGE_LOCK_GLOBAL;
+}
+
+IMG_VOID LinuxBridgeLock(ENV_CONNECTION_DATA *psEnvConnection,
+						 PVRSRV_BRIDGE_LOCK_CLASS eClass)
+{
+	if (eClass == PVRSRV_BRIDGE_LOCK_GLOBAL)
+	{
+		LinuxLockMutex(&gPVRSRVLock);
+		return;
+	}
+
+	LinuxBridgeLockShared();
+	mutex_lock(&psEnvConnection->sBridgeLock);
+	mutex_lock(&gasBridgeClassLock[eClass]);
+}
+
+IMG_VOID LinuxBridgeUnlock(ENV_CONNECTION_DATA *psEnvConnection,
+						   PVRSRV_BRIDGE_LOCK_CLASS eClass)
+{
+	if (eClass == PVRSRV_BRIDGE_LOCK_GLOBAL)
+	{
+		LinuxUnLockMutex(&gPVRSRVLock);
+		return;
+	}
+
+	mutex_unlock(&gasBridgeClassLock[eClass]);
+	mutex_unlock(&psEnvConnection->sBridgeLock);
+	LinuxBridgeUnlockShared();
+}
+
+#if defined(DEBUG_BRIDGE_KM)
+/*
+ * BridgedDispatchKM updates the stats under gPVRSRVLock, which excludes
+ * every non-global call.  Non-global calls of different classes still
+ * overlap each other, so their updates take this.
+ */
+static DEFINE_SPINLOCK(gsBridgeStatsLock);
+#endif
+
+/* Called with the connection and class locks of a non-global call held */
+static IMG_INT LinuxBridgedDispatchFine(CONNECTION_DATA *psConnection,
+										ENV_CONNECTION_DATA *psEnvConnection,
+										PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM)
+{
+	IMG_UINT32 ui32BridgeID = psBridgePackageKM->ui32BridgeID;
+	IMG_VOID *psBridgeIn = psEnvConnection->pvBridgeData;
+	IMG_VOID *psBridgeOut = (IMG_PVOID)((IMG_PBYTE)psBridgeIn + PVRSRV_MAX_BRIDGE_IN_SIZE);
+	BridgeWrapperFunction pfBridgeHandler;
+	IMG_INT err = -EFAULT;
+
+	PVR_ASSERT(ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT);
+
+#if defined(DEBUG_BRIDGE_KM)
+	spin_lock(&gsBridgeStatsLock);
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+	spin_unlock(&gsBridgeStatsLock);
+#endif
+
+	if (psBridgePackageKM->ui32InBufferSize > PVRSRV_MAX_BRIDGE_IN_SIZE ||
+		psBridgePackageKM->ui32OutBufferSize > PVRSRV_MAX_BRIDGE_OUT_SIZE)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Bridge buffer too large for call %u",
+				 __FUNCTION__, ui32BridgeID));
+		return err;
+	}
+
+	pfBridgeHandler = (BridgeWrapperFunction)g_BridgeDispatchTable[ui32BridgeID].pfFunction;
+	if (pfBridgeHandler == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: No dispatch table entry for call %u",
+				 __FUNCTION__, ui32BridgeID));
+		return err;
+	}
+
+	if (psBridgePackageKM->ui32InBufferSize > 0)
+	{
+		if (!OSAccessOK(PVR_VERIFY_READ,
+						psBridgePackageKM->pvParamIn,
+						psBridgePackageKM->ui32InBufferSize) ||
+			OSCopyFromUser(IMG_NULL,
+						   psBridgeIn,
+						   psBridgePackageKM->pvParamIn,
+						   psBridgePackageKM->ui32InBufferSize) != PVRSRV_OK)
+		{
+			return err;
+		}
+	}
+
+	err = pfBridgeHandler(ui32BridgeID, psBridgeIn, psBridgeOut, psConnection);
+	if (err < 0)
+	{
+		return err;
+	}
+
+	if (psBridgePackageKM->ui32OutBufferSize > 0)
+	{
+		if (!OSAccessOK(PVR_VERIFY_WRITE,
+						psBridgePackageKM->pvParamOut,
+						psBridgePackageKM->ui32OutBufferSize) ||
+			OSCopyToUser(IMG_NULL,
+						 psBridgePackageKM->pvParamOut,
+						 psBridgeOut,
+						 psBridgePackageKM->ui32OutBufferSize) != PVRSRV_OK)
+		{
+			return -EFAULT;
+		}
+	}
+
+#if defined(DEBUG_BRIDGE_KM)
+	spin_lock(&gsBridgeStatsLock);
+	g_BridgeDispatchTable[ui32BridgeID].ui32CopyFromUserTotalBytes += psBridgePackageKM->ui32InBufferSize;
+	g_BridgeDispatchTable[ui32BridgeID].ui32CopyToUserTotalBytes += psBridgePackageKM->ui32OutBufferSize;
+	g_BridgeGlobalStats.ui32TotalCopyFromUserBytes += psBridgePackageKM->ui32InBufferSize;
+	g_BridgeGlobalStats.ui32TotalCopyToUserBytes += psBridgePackageKM->ui32OutBufferSize;
+	spin_unlock(&gsBridgeStatsLock);
+#endif
+
+	return 0;
+}
+
+/*
+ * Dispatch a bridge call whose package is already in kernel memory, under
+ * the locks of eClass.  The parameter buffers are only copied in once
+ * those locks are held.
+ */
+IMG_INT LinuxBridgeDispatch(CONNECTION_DATA *psConnection,
+							PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+							PVRSRV_BRIDGE_LOCK_CLASS eClass)
+{
+	ENV_CONNECTION_DATA *psEnvConnection = PVRSRVConnectionPrivateData(psConnection);
+	IMG_INT err;
+
+	LinuxBridgeLock(psEnvConnection, eClass);
+	if (eClass == PVRSRV_BRIDGE_LOCK_GLOBAL)
+	{
+		err = BridgedDispatchKM(psConnection, psBridgePackageKM);
+	}
+	else
+	{
+		err = LinuxBridgedDispatchFine(psConnection, psEnvConnection, psBridgePackageKM);
+	}
+	LinuxBridgeUnlock(psEnvConnection, eClass);
+
+	return err;
+}
+
 PVRSRV_ERROR
 LinuxBridgeInit(IMG_VOID)
 {
@@ -165,6 +405,15 @@ LinuxBridgeInit(IMG_VOID)
 	}
 #endif
 
+	LinuxBridgeLockInit();
+
+#if defined(NO_HARDWARE)
+	if (PVRBridgeStressInit() != 0)
+	{
+		PVR_DPF((PVR_DBG_WARNING, "%s: Failed to create bridge_stress entry", __FUNCTION__));
+	}
+#endif
+
 	eError = RegisterSRVCOREFunctions();
 	if (eError != PVRSRV_OK)
 	{
@@ -343,6 +592,9 @@ LinuxBridgeInit(IMG_VOID)
 IMG_VOID
 LinuxBridgeDeInit(IMG_VOID)
 {
+#if defined(NO_HARDWARE)
+	PVRBridgeStressDeInit();
+#endif
 #if defined(DEBUG_BRIDGE_KM)
 	PVRDebugFSRemoveEntry(gpsPVRDebugFSBridgeStatsEntry);
 	gpsPVRDebugFSBridgeStatsEntry = NULL;
@@ -457,8 +709,6 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 	CONNECTION_DATA *psConnection = LinuxConnectionFromFile(pFile);
 	IMG_INT err = -EFAULT;
 
-	LinuxLockMutex(&gPVRSRVLock);
-
 #if defined(SUPPORT_DRM)
 	PVR_UNREFERENCED_PARAMETER(dev);
 
@@ -476,7 +726,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments",
 				 __FUNCTION__));
 
-		goto unlock_and_return;
+		goto return_err;
 	}
 	
 	/* FIXME - Currently the CopyFromUserWrapper which collects stats about
@@ -488,7 +738,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 					  sizeof(PVRSRV_BRIDGE_PACKAGE))
 	  != PVRSRV_OK)
 	{
-		goto unlock_and_return;
+		goto return_err;
 	}
 #endif
 
@@ -505,11 +755,11 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 		psBridgePackageKM->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
 #endif
 
-	err = BridgedDispatchKM(psConnection, psBridgePackageKM);
+	err = LinuxBridgeDispatch(psConnection, psBridgePackageKM,
+							  LinuxBridgeLockClass(psBridgePackageKM->ui32BridgeID));
 
 #if !defined(SUPPORT_DRM)
-unlock_and_return:
+return_err:
 #endif
-	LinuxUnLockMutex(&gPVRSRVLock);
 	return err;
 }
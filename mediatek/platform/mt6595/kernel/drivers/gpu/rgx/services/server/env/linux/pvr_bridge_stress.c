@@ -0,0 +1,454 @@
+/*************************************************************************/ /*!
+@File           pvr_bridge_stress.c
+@Title          Bridge dispatch stress test for NO_HARDWARE builds
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+/*
+ * Writing a duration in ms to <debugfs>/pvr/bridge_stress issues real
+ * bridge calls from 1, 2, 4 and 8 threads, first with every call under
+ * gPVRSRVLock and then with the lock class PVRSRV_BridgeDispatchKM would
+ * pick (one call in 32 still goes global, as a client's allocations would).
+ * Each thread owns a connection and alternates between the sync-query and
+ * cache classes.  Every call's output is checked against what that thread
+ * passed in, so marshalling cross-talk between concurrent calls shows up
+ * as bad results.  Reading the file shows bridge calls/sec and bad results
+ * for each run.
+ *
+ * The calls touch no sync objects and queue no cache operation, so they
+ * also run in a NO_HARDWARE build.
+ */
+
+#include <linux/version.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/uaccess.h>
+
+#include "img_defs.h"
+#include "pvr_bridge.h"
+#include "connection_server.h"
+#include "mutex.h"
+#include "driverlock.h"
+#include "env_connection.h"
+#include "pvr_debug.h"
+#include "pvr_debugfs.h"
+#include "common_sync_bridge.h"
+#include "cache_defines.h"
+#if (CACHEFLUSH_TYPE == CACHEFLUSH_GENERIC)
+#include "common_cachegeneric_bridge.h"
+#endif
+
+#if defined(NO_HARDWARE)
+
+#define BRIDGE_STRESS_MAX_THREADS	8
+#define BRIDGE_STRESS_RUNS			4	/* 1, 2, 4, 8 threads */
+#define BRIDGE_STRESS_GLOBAL_EVERY	32	/* one allocation-like call in 32 */
+#define BRIDGE_STRESS_TAGS			4
+
+typedef struct _BRIDGE_STRESS_THREAD_
+{
+	CONNECTION_DATA			*psConnection;
+	IMG_UINT32				ui32Index;
+	IMG_BOOL				bFine;
+	unsigned long			ulDeadline;
+	IMG_UINT64				ui64Calls;
+	IMG_UINT64				ui64Errors;
+	/* Addresses the sync query must echo back, never written */
+	IMG_UINT32				aui32Tag[BRIDGE_STRESS_TAGS];
+	struct completion		sDone;
+} BRIDGE_STRESS_THREAD;
+
+typedef struct _BRIDGE_STRESS_RESULT_
+{
+	IMG_UINT32	ui32Threads;
+	IMG_UINT64	ui64GlobalRate;
+	IMG_UINT64	ui64GlobalErrors;
+	IMG_UINT64	ui64FineRate;
+	IMG_UINT64	ui64FineErrors;
+} BRIDGE_STRESS_RESULT;
+
+/* pvr_bridge_k.c */
+IMG_INT LinuxBridgeDispatch(CONNECTION_DATA *psConnection,
+							PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+							PVRSRV_BRIDGE_LOCK_CLASS eClass);
+
+static DEFINE_MUTEX(gsBridgeStressLock);
+static BRIDGE_STRESS_RESULT gasBridgeStressResult[BRIDGE_STRESS_RUNS];
+static IMG_UINT32 gui32BridgeStressDurationMs;
+static struct dentry *gpsBridgeStressEntry;
+
+static IMG_INT BridgeStressCall(BRIDGE_STRESS_THREAD *psThread,
+								IMG_UINT32 ui32BridgeID,
+								IMG_VOID *pvIn, IMG_UINT32 ui32InSize,
+								IMG_VOID *pvOut, IMG_UINT32 ui32OutSize)
+{
+	PVRSRV_BRIDGE_PACKAGE sPackage;
+	PVRSRV_BRIDGE_LOCK_CLASS eClass = PVRSRV_BRIDGE_LOCK_GLOBAL;
+
+	ui32BridgeID = PVRSRV_GET_BRIDGE_ID(ui32BridgeID);
+	if (psThread->bFine &&
+		(psThread->ui64Calls % BRIDGE_STRESS_GLOBAL_EVERY) != 0)
+	{
+		eClass = LinuxBridgeLockClass(ui32BridgeID);
+	}
+
+	sPackage.ui32BridgeID = ui32BridgeID;
+	sPackage.ui32Size = sizeof(sPackage);
+	sPackage.pvParamIn = pvIn;
+	sPackage.ui32InBufferSize = ui32InSize;
+	sPackage.pvParamOut = pvOut;
+	sPackage.ui32OutBufferSize = ui32OutSize;
+
+	return LinuxBridgeDispatch(psThread->psConnection, &sPackage, eClass);
+}
+
+static IMG_BOOL BridgeStressSyncQuery(BRIDGE_STRESS_THREAD *psThread)
+{
+	PVRSRV_BRIDGE_IN_SERVERSYNCGETSTATUS sIn;
+	PVRSRV_BRIDGE_OUT_SERVERSYNCGETSTATUS sOut;
+	IMG_UINT32 ui32Tag = (IMG_UINT32)psThread->ui64Calls;
+
+	/* With no syncs the call only echoes the output array pointers */
+	memset(&sIn, 0, sizeof(sIn));
+	sIn.ui32SyncCount = 0;
+	sIn.pui32UID = &psThread->aui32Tag[ui32Tag++ % BRIDGE_STRESS_TAGS];
+	sIn.pui32FWAddr = &psThread->aui32Tag[ui32Tag++ % BRIDGE_STRESS_TAGS];
+	sIn.pui32CurrentOp = &psThread->aui32Tag[ui32Tag++ % BRIDGE_STRESS_TAGS];
+	sIn.pui32NextOp = &psThread->aui32Tag[ui32Tag % BRIDGE_STRESS_TAGS];
+	memset(&sOut, 0, sizeof(sOut));
+	sOut.eError = PVRSRV_ERROR_INVALID_PARAMS;
+
+	if (BridgeStressCall(psThread, PVRSRV_BRIDGE_SYNC_SERVERSYNCGETSTATUS,
+						 &sIn, sizeof(sIn), &sOut, sizeof(sOut)) != 0)
+	{
+		return IMG_FALSE;
+	}
+
+	return sOut.eError == PVRSRV_OK &&
+		   sOut.pui32UID == sIn.pui32UID &&
+		   sOut.pui32FWAddr == sIn.pui32FWAddr &&
+		   sOut.pui32CurrentOp == sIn.pui32CurrentOp &&
+		   sOut.pui32NextOp == sIn.pui32NextOp;
+}
+
+static IMG_BOOL BridgeStressCacheOp(BRIDGE_STRESS_THREAD *psThread)
+{
+#if (CACHEFLUSH_TYPE == CACHEFLUSH_GENERIC)
+	PVRSRV_BRIDGE_IN_CACHEOPQUEUE sIn;
+	PVRSRV_BRIDGE_OUT_CACHEOPQUEUE sOut;
+
+	sIn.iuCacheOp = PVRSRV_CACHE_OP_NONE;
+	sOut.eError = PVRSRV_ERROR_INVALID_PARAMS;
+
+	if (BridgeStressCall(psThread, PVRSRV_BRIDGE_CACHEGENERIC_CACHEOPQUEUE,
+						 &sIn, sizeof(sIn), &sOut, sizeof(sOut)) != 0)
+	{
+		return IMG_FALSE;
+	}
+
+	return sOut.eError == PVRSRV_OK;
+#else
+	return BridgeStressSyncQuery(psThread);
+#endif
+}
+
+static int BridgeStressThread(void *pvData)
+{
+	BRIDGE_STRESS_THREAD *psThread = pvData;
+	mm_segment_t sOldFs = get_fs();
+	IMG_BOOL bOK;
+
+	/* The call buffers live on this stack, not in user memory */
+	set_fs(KERNEL_DS);
+
+	while (time_before(jiffies, psThread->ulDeadline))
+	{
+		if ((psThread->ui32Index + psThread->ui64Calls) & 1)
+		{
+			bOK = BridgeStressCacheOp(psThread);
+		}
+		else
+		{
+			bOK = BridgeStressSyncQuery(psThread);
+		}
+
+		if (!bOK)
+		{
+			psThread->ui64Errors++;
+		}
+		psThread->ui64Calls++;
+		cond_resched();
+	}
+
+	set_fs(sOldFs);
+
+	complete(&psThread->sDone);
+	return 0;
+}
+
+static IMG_UINT64 BridgeStressRun(BRIDGE_STRESS_THREAD *pasThread,
+								  IMG_UINT32 ui32Threads,
+								  IMG_BOOL bFine,
+								  IMG_UINT32 ui32DurationMs,
+								  IMG_UINT64 *pui64Errors)
+{
+	unsigned long ulDeadline = jiffies + msecs_to_jiffies(ui32DurationMs);
+	IMG_UINT64 ui64Calls = 0;
+	IMG_UINT32 i;
+
+	*pui64Errors = 0;
+
+	for (i = 0; i < ui32Threads; i++)
+	{
+		BRIDGE_STRESS_THREAD *psThread = &pasThread[i];
+		struct task_struct *psTask;
+
+		psThread->ui32Index = i;
+		psThread->bFine = bFine;
+		psThread->ulDeadline = ulDeadline;
+		psThread->ui64Calls = 0;
+		psThread->ui64Errors = 0;
+		init_completion(&psThread->sDone);
+
+		psTask = kthread_run(BridgeStressThread, psThread, "pvr_bstress/%u", i);
+		if (IS_ERR(psTask))
+		{
+			/* Account for the thread so the wait below does not hang */
+			complete(&psThread->sDone);
+		}
+	}
+
+	for (i = 0; i < ui32Threads; i++)
+	{
+		wait_for_completion(&pasThread[i].sDone);
+		ui64Calls += pasThread[i].ui64Calls;
+		*pui64Errors += pasThread[i].ui64Errors;
+	}
+
+	return div_u64(ui64Calls * 1000, ui32DurationMs);
+}
+
+static IMG_VOID BridgeStressDisconnect(BRIDGE_STRESS_THREAD *pasThread)
+{
+	IMG_UINT32 i;
+
+	LinuxLockMutex(&gPVRSRVLock);
+	for (i = 0; i < BRIDGE_STRESS_MAX_THREADS; i++)
+	{
+		if (pasThread[i].psConnection != IMG_NULL)
+		{
+			PVRSRVConnectionDisconnect(pasThread[i].psConnection);
+			pasThread[i].psConnection = IMG_NULL;
+		}
+	}
+	LinuxUnLockMutex(&gPVRSRVLock);
+}
+
+static PVRSRV_ERROR BridgeStressConnect(BRIDGE_STRESS_THREAD *pasThread)
+{
+	PVRSRV_ERROR eError = PVRSRV_OK;
+	IMG_UINT32 i;
+
+	LinuxLockMutex(&gPVRSRVLock);
+	for (i = 0; i < BRIDGE_STRESS_MAX_THREADS; i++)
+	{
+		IMG_PVOID pvConnectionData;
+
+		eError = PVRSRVConnectionConnect(&pvConnectionData, IMG_NULL);
+		if (eError != PVRSRV_OK)
+		{
+			break;
+		}
+		pasThread[i].psConnection = pvConnectionData;
+	}
+	LinuxUnLockMutex(&gPVRSRVLock);
+
+	if (eError != PVRSRV_OK)
+	{
+		BridgeStressDisconnect(pasThread);
+	}
+	return eError;
+}
+
+static ssize_t BridgeStressWrite(const char __user *pszBuffer,
+								 size_t uiCount,
+								 loff_t uiPosition,
+								 void *pvData)
+{
+	BRIDGE_STRESS_THREAD *pasThread;
+	IMG_CHAR acBuf[16];
+	IMG_UINT32 ui32DurationMs;
+	IMG_UINT32 i;
+
+	PVR_UNREFERENCED_PARAMETER(uiPosition);
+	PVR_UNREFERENCED_PARAMETER(pvData);
+
+	if (uiCount == 0 || uiCount >= sizeof(acBuf))
+	{
+		return -EINVAL;
+	}
+	if (copy_from_user(acBuf, pszBuffer, uiCount))
+	{
+		return -EFAULT;
+	}
+	acBuf[uiCount] = '\0';
+
+	if (kstrtouint(strim(acBuf), 0, &ui32DurationMs) || ui32DurationMs == 0 ||
+		ui32DurationMs > 60000)
+	{
+		return -EINVAL;
+	}
+
+	pasThread = kzalloc(sizeof(*pasThread) * BRIDGE_STRESS_MAX_THREADS, GFP_KERNEL);
+	if (pasThread == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	if (BridgeStressConnect(pasThread) != PVRSRV_OK)
+	{
+		kfree(pasThread);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&gsBridgeStressLock);
+	for (i = 0; i < BRIDGE_STRESS_RUNS; i++)
+	{
+		BRIDGE_STRESS_RESULT *psResult = &gasBridgeStressResult[i];
+
+		psResult->ui32Threads = 1 << i;
+		psResult->ui64GlobalRate = BridgeStressRun(pasThread, psResult->ui32Threads,
+												   IMG_FALSE, ui32DurationMs,
+												   &psResult->ui64GlobalErrors);
+		psResult->ui64FineRate = BridgeStressRun(pasThread, psResult->ui32Threads,
+												 IMG_TRUE, ui32DurationMs,
+												 &psResult->ui64FineErrors);
+		if (psResult->ui64GlobalErrors != 0 || psResult->ui64FineErrors != 0)
+		{
+			PVR_DPF((PVR_DBG_ERROR, "%s: %u threads: %llu/%llu bad bridge results (global/per-class)",
+					 __FUNCTION__, psResult->ui32Threads,
+					 psResult->ui64GlobalErrors, psResult->ui64FineErrors));
+		}
+	}
+	gui32BridgeStressDurationMs = ui32DurationMs;
+	mutex_unlock(&gsBridgeStressLock);
+
+	BridgeStressDisconnect(pasThread);
+	kfree(pasThread);
+	return uiCount;
+}
+
+static void *BridgeStressSeqStart(struct seq_file *psSeqFile, loff_t *puiPosition)
+{
+	mutex_lock(&gsBridgeStressLock);
+
+	return (*puiPosition == 0) ? SEQ_START_TOKEN : NULL;
+}
+
+static void BridgeStressSeqStop(struct seq_file *psSeqFile, void *pvData)
+{
+	mutex_unlock(&gsBridgeStressLock);
+}
+
+static void *BridgeStressSeqNext(struct seq_file *psSeqFile,
+								 void *pvData,
+								 loff_t *puiPosition)
+{
+	(*puiPosition)++;
+	return NULL;
+}
+
+static int BridgeStressSeqShow(struct seq_file *psSeqFile, void *pvData)
+{
+	IMG_UINT32 i;
+
+	if (gui32BridgeStressDurationMs == 0)
+	{
+		seq_printf(psSeqFile, "No run yet: write a duration in ms to start one\n");
+		return 0;
+	}
+
+	seq_printf(psSeqFile, "%u ms per run\n%-8s %16s %12s %18s %12s\n",
+			   gui32BridgeStressDurationMs, "Threads",
+			   "Global calls/s", "Global bad", "Per-class calls/s", "Per-class bad");
+	for (i = 0; i < BRIDGE_STRESS_RUNS; i++)
+	{
+		seq_printf(psSeqFile, "%-8u %16llu %12llu %18llu %12llu\n",
+				   gasBridgeStressResult[i].ui32Threads,
+				   gasBridgeStressResult[i].ui64GlobalRate,
+				   gasBridgeStressResult[i].ui64GlobalErrors,
+				   gasBridgeStressResult[i].ui64FineRate,
+				   gasBridgeStressResult[i].ui64FineErrors);
+	}
+
+	return 0;
+}
+
+static struct seq_operations gsBridgeStressReadOps =
+{
+	.start = BridgeStressSeqStart,
+	.stop = BridgeStressSeqStop,
+	.next = BridgeStressSeqNext,
+	.show = BridgeStressSeqShow,
+};
+
+int PVRBridgeStressInit(void)
+{
+	return PVRDebugFSCreateEntry("bridge_stress",
+								 NULL,
+								 &gsBridgeStressReadOps,
+								 BridgeStressWrite,
+								 NULL,
+								 &gpsBridgeStressEntry);
+}
+
+void PVRBridgeStressDeInit(void)
+{
+	if (gpsBridgeStressEntry != NULL)
+	{
+		PVRDebugFSRemoveEntry(gpsBridgeStressEntry);
+		gpsBridgeStressEntry = NULL;
+	}
+}
+
+#endif /* defined(NO_HARDWARE) */
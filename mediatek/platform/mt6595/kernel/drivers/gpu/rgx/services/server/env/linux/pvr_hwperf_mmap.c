@@ -0,0 +1,354 @@
+/*************************************************************************/ /*!
+@File           pvr_hwperf_mmap.c
+@Title          Zero-copy HWPerf consumer device
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+/*
+ * /dev/pvr_hwperf gives one process the FW HWPerf buffer in place, see
+ * RGX_HWPERF_MMAP_CTRL in rgx_hwperf_km.h:
+ *
+ *   mmap offset 0, one page, read-write   the control page
+ *   mmap offset one page, read-only       the FW L1 buffer
+ *   poll()                                POLLIN while there are packets
+ *
+ * While the device is open the data store no longer copies packets into
+ * the TL stream; it only moves the FW read index to wherever the consumer
+ * has read up to and publishes the FW write index, once per MISR.
+ *
+ * NO_HARDWARE builds have no FW to produce packets, so writing a packet
+ * count to <debugfs>/pvr/hwperf_gen writes them into the buffer instead.
+ */
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/seq_file.h>
+#include <linux/wait.h>
+#include <linux/uaccess.h>
+
+#include "img_defs.h"
+#include "pvr_debug.h"
+#include "rgxhwperf.h"
+#include "pvr_hwperf_mmap.h"
+#if defined(NO_HARDWARE)
+#include "pvr_debugfs.h"
+#endif
+
+#define PVR_HWPERF_MMAP_MODNAME	"pvr_hwperf"
+
+typedef struct _PVR_HWPERF_MMAP_
+{
+	RGX_HWPERF_MMAP_CTRL	*psCtrl;
+	IMG_BYTE				*pbBuffer;
+	IMG_UINT32				ui32BufSize;
+} PVR_HWPERF_MMAP;
+
+static DECLARE_WAIT_QUEUE_HEAD(gsHWPerfMMapWaitQueue);
+
+/* Called from the MISR with the HWPerf stream lock held */
+static IMG_VOID HWPerfMMapNotify(IMG_VOID *pvData)
+{
+	PVR_UNREFERENCED_PARAMETER(pvData);
+
+	wake_up_interruptible(&gsHWPerfMMapWaitQueue);
+}
+
+static int HWPerfMMapOpen(struct inode *psInode, struct file *psFile)
+{
+	PVR_HWPERF_MMAP *psMMap;
+	PVRSRV_ERROR eError;
+
+	psMMap = kzalloc(sizeof(*psMMap), GFP_KERNEL);
+	if (psMMap == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	psMMap->psCtrl = (RGX_HWPERF_MMAP_CTRL *)get_zeroed_page(GFP_KERNEL);
+	if (psMMap->psCtrl == NULL)
+	{
+		kfree(psMMap);
+		return -ENOMEM;
+	}
+
+	eError = RGXHWPerfMMapAttach(psMMap->psCtrl,
+								 HWPerfMMapNotify,
+								 IMG_NULL,
+								 &psMMap->pbBuffer,
+								 &psMMap->ui32BufSize);
+	if (eError != PVRSRV_OK)
+	{
+		free_page((unsigned long)psMMap->psCtrl);
+		kfree(psMMap);
+		return (eError == PVRSRV_ERROR_ALREADY_OPEN) ? -EBUSY : -ENODEV;
+	}
+
+	psFile->private_data = psMMap;
+	return 0;
+}
+
+static int HWPerfMMapRelease(struct inode *psInode, struct file *psFile)
+{
+	PVR_HWPERF_MMAP *psMMap = psFile->private_data;
+
+	RGXHWPerfMMapDetach();
+
+	/* Any mapping of the control page holds its own reference */
+	free_page((unsigned long)psMMap->psCtrl);
+	kfree(psMMap);
+	return 0;
+}
+
+static unsigned int HWPerfMMapPoll(struct file *psFile, poll_table *psWait)
+{
+	PVR_HWPERF_MMAP *psMMap = psFile->private_data;
+	IMG_UINT32 ui32ReadIdx, ui32WriteIdx;
+
+	poll_wait(psFile, &gsHWPerfMMapWaitQueue, psWait);
+
+	ui32ReadIdx = psMMap->psCtrl->ui32ReadIdx;
+	ui32WriteIdx = psMMap->psCtrl->ui32WriteIdx;
+
+	/* A read index parked on the wrap point is the same as 0 */
+	if (ui32ReadIdx == psMMap->psCtrl->ui32WrapIdx)
+	{
+		ui32ReadIdx = 0;
+	}
+
+	return (ui32ReadIdx != ui32WriteIdx) ? (POLLIN | POLLRDNORM) : 0;
+}
+
+static int HWPerfMMapMMap(struct file *psFile, struct vm_area_struct *psVMA)
+{
+	PVR_HWPERF_MMAP *psMMap = psFile->private_data;
+	unsigned long ulSize = psVMA->vm_end - psVMA->vm_start;
+	unsigned long ulOffset;
+	int iErr;
+
+	psVMA->vm_flags |= VM_DONTEXPAND;
+
+	if (psVMA->vm_pgoff == 0)
+	{
+		if (ulSize != PAGE_SIZE)
+		{
+			return -EINVAL;
+		}
+		return vm_insert_page(psVMA, psVMA->vm_start, virt_to_page(psMMap->psCtrl));
+	}
+
+	if (psVMA->vm_pgoff != 1 || ulSize > PAGE_ALIGN(psMMap->ui32BufSize))
+	{
+		return -EINVAL;
+	}
+	if (psVMA->vm_flags & VM_WRITE)
+	{
+		return -EPERM;
+	}
+	psVMA->vm_flags &= ~VM_MAYWRITE;
+
+	/* Only whole pages of the FW buffer may be handed out */
+	if (((unsigned long)psMMap->pbBuffer & ~PAGE_MASK) != 0)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: HWPerf buffer is not page aligned", __func__));
+		return -ENXIO;
+	}
+
+	/* The FW buffer is allocated CPU uncached, map it the same way */
+	psVMA->vm_page_prot = pgprot_noncached(psVMA->vm_page_prot);
+
+	for (ulOffset = 0; ulOffset < ulSize; ulOffset += PAGE_SIZE)
+	{
+		IMG_BYTE *pbPage = psMMap->pbBuffer + ulOffset;
+		struct page *psPage;
+
+		psPage = is_vmalloc_addr(pbPage) ? vmalloc_to_page(pbPage) : virt_to_page(pbPage);
+		if (psPage == NULL)
+		{
+			return -ENXIO;
+		}
+
+		iErr = vm_insert_page(psVMA, psVMA->vm_start + ulOffset, psPage);
+		if (iErr)
+		{
+			return iErr;
+		}
+	}
+
+	return 0;
+}
+
+static const struct file_operations gsHWPerfMMapFOps =
+{
+	.owner          = THIS_MODULE,
+	.open           = HWPerfMMapOpen,
+	.release        = HWPerfMMapRelease,
+	.poll           = HWPerfMMapPoll,
+	.mmap           = HWPerfMMapMMap,
+};
+
+static struct miscdevice gsHWPerfMMapDev =
+{
+	.minor          = MISC_DYNAMIC_MINOR,
+	.name           = PVR_HWPERF_MMAP_MODNAME,
+	.fops           = &gsHWPerfMMapFOps,
+};
+
+#if defined(NO_HARDWARE)
+static struct dentry *gpsHWPerfGenEntry;
+static IMG_UINT32 gui32HWPerfGenWritten;
+static IMG_UINT32 gui32HWPerfGenRequested;
+
+static ssize_t HWPerfGenWrite(const char __user *pszBuffer,
+							  size_t uiCount,
+							  loff_t uiPosition,
+							  void *pvData)
+{
+	IMG_CHAR acBuf[16];
+	IMG_UINT32 ui32Count;
+	PVRSRV_ERROR eError;
+
+	PVR_UNREFERENCED_PARAMETER(uiPosition);
+	PVR_UNREFERENCED_PARAMETER(pvData);
+
+	if (uiCount == 0 || uiCount >= sizeof(acBuf))
+	{
+		return -EINVAL;
+	}
+	if (copy_from_user(acBuf, pszBuffer, uiCount))
+	{
+		return -EFAULT;
+	}
+	acBuf[uiCount] = '\0';
+
+	if (kstrtouint(strim(acBuf), 0, &ui32Count) || ui32Count == 0)
+	{
+		return -EINVAL;
+	}
+
+	eError = RGXHWPerfGenPackets(ui32Count, &gui32HWPerfGenWritten);
+	if (eError != PVRSRV_OK)
+	{
+		return -ENODEV;
+	}
+	gui32HWPerfGenRequested = ui32Count;
+
+	return uiCount;
+}
+
+static void *HWPerfGenSeqStart(struct seq_file *psSeqFile, loff_t *puiPosition)
+{
+	return (*puiPosition == 0) ? SEQ_START_TOKEN : NULL;
+}
+
+static void HWPerfGenSeqStop(struct seq_file *psSeqFile, void *pvData)
+{
+}
+
+static void *HWPerfGenSeqNext(struct seq_file *psSeqFile,
+							  void *pvData,
+							  loff_t *puiPosition)
+{
+	(*puiPosition)++;
+	return NULL;
+}
+
+static int HWPerfGenSeqShow(struct seq_file *psSeqFile, void *pvData)
+{
+	seq_printf(psSeqFile, "Last run: %u of %u packets written\n",
+			   gui32HWPerfGenWritten, gui32HWPerfGenRequested);
+	return 0;
+}
+
+static struct seq_operations gsHWPerfGenReadOps =
+{
+	.start = HWPerfGenSeqStart,
+	.stop = HWPerfGenSeqStop,
+	.next = HWPerfGenSeqNext,
+	.show = HWPerfGenSeqShow,
+};
+#endif /* defined(NO_HARDWARE) */
+
+int PVRHWPerfMMapInit(void)
+{
+	int iErr;
+
+	iErr = misc_register(&gsHWPerfMMapDev);
+	if (iErr)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Failed to register %s device (%d)",
+				 __func__, PVR_HWPERF_MMAP_MODNAME, iErr));
+		return iErr;
+	}
+
+#if defined(NO_HARDWARE)
+	iErr = PVRDebugFSCreateEntry("hwperf_gen",
+								 NULL,
+								 &gsHWPerfGenReadOps,
+								 HWPerfGenWrite,
+								 NULL,
+								 &gpsHWPerfGenEntry);
+	if (iErr)
+	{
+		misc_deregister(&gsHWPerfMMapDev);
+		return iErr;
+	}
+#endif
+
+	return 0;
+}
+
+void PVRHWPerfMMapDeInit(void)
+{
+#if defined(NO_HARDWARE)
+	if (gpsHWPerfGenEntry != NULL)
+	{
+		PVRDebugFSRemoveEntry(gpsHWPerfGenEntry);
+		gpsHWPerfGenEntry = NULL;
+	}
+#endif
+
+	misc_deregister(&gsHWPerfMMapDev);
+}
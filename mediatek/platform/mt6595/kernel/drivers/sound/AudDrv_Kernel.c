@@ -87,6 +87,7 @@
 #include <linux/string.h>
 #include <linux/mutex.h>
 #include <linux/xlog.h>
+#include <linux/ktime.h>
 #include <mach/irqs.h>
 #include <asm/uaccess.h>
 #include <asm/irq.h>
@@ -164,6 +165,18 @@ DECLARE_WAIT_QUEUE_HEAD(DL1_Wait_Queue);
 static kal_uint32 DL1_Interrupt_Interval = 0;
 static kal_uint32 DL1_Interrupt_Interval_Limit = 0;
 
+// DL1 mmap mode, protected by auddrv_irqstatus_lock
+static bool       DL1_Mmap_Mode = false;
+static kal_uint64 DL1_Mmap_HwConsumed = 0;
+static kal_uint64 DL1_Mmap_ApplWritten = 0;
+static kal_uint64 DL1_Mmap_TimeStamp = 0;
+static kal_uint32 DL1_Mmap_Underruns = 0;
+
+// live userspace mappings of the DL1 ring, protected by DL1_Mmap_mutex.
+// The ring must not be freed or reallocated while any exist.
+static kal_uint32 DL1_Mmap_Count = 0;
+static DEFINE_MUTEX(DL1_Mmap_mutex);
+
 // wait queue flag
 static kal_uint32 DL2_wait_queue_flag  = 0;
 DECLARE_WAIT_QUEUE_HEAD(DL2_Wait_Queue);
@@ -200,6 +213,7 @@ void Auddrv_Check_Irq(void);
 int PMIC_IMM_GetOneChannelValue(int dwChannel, int deCount, int trimd);
 static void CheckInterruptTiming(void);
 static void ClearInterruptTiming(void);
+static int AudDrv_DL1_Set_Mmap_Mode(bool bEnable);
 //here is counter of clock , user extern , clock counter is maintain in auddrv_clk
 
 extern int        Aud_Core_Clk_cntr ;
@@ -751,6 +765,72 @@ void Auddrv_UL_Interrupt_Handler(void)  // irq2 ISR handler
     spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
 }
 
+/*****************************************************************************
+ * FUNCTION
+ *  Auddrv_DL1_Mmap_Update
+ *
+ * DESCRIPTION
+ *  sample the DL1 hardware pointer for mmap mode and detect underrun,
+ *  called with auddrv_irqstatus_lock held
+ *
+ *****************************************************************************
+ */
+static void Auddrv_DL1_Mmap_Update(AFE_BLOCK_T *Afe_Block)
+{
+    kal_int32 Afe_consumed_bytes = 0;
+    kal_int32 HW_memory_index = 0;
+    kal_int32 HW_Cur_ReadIdx = 0;
+
+    HW_Cur_ReadIdx = Afe_Get_Reg(AFE_DL1_CUR);
+    if (HW_Cur_ReadIdx == 0)
+    {
+        HW_Cur_ReadIdx = Afe_Block->pucPhysBufAddr;
+    }
+    HW_memory_index = (HW_Cur_ReadIdx - Afe_Block->pucPhysBufAddr);
+    if (HW_memory_index < 0 || HW_memory_index >= Afe_Block->u4BufferSize)
+    {
+        PRINTK_AUDDRV("[Auddrv] DL1 mmap HW_Cur_ReadIdx out of range 0x%x\n", HW_Cur_ReadIdx);
+        return;
+    }
+
+    // position queries may come before the hardware moved, so an unchanged
+    // pointer means nothing consumed rather than a full lap
+    Afe_consumed_bytes = HW_memory_index - Afe_Block->u4DMAReadIdx;
+    if (Afe_consumed_bytes < 0)
+    {
+        Afe_consumed_bytes += Afe_Block->u4BufferSize;
+    }
+
+    Afe_Block->u4DMAReadIdx = HW_memory_index;
+    DL1_Mmap_HwConsumed += Afe_consumed_bytes;
+    DL1_Mmap_TimeStamp = ktime_to_ns(ktime_get());
+
+    if (DL1_Mmap_HwConsumed > DL1_Mmap_ApplWritten)
+    {
+        // hardware is playing data userspace never committed, silence the
+        // ring and restart userspace right behind the read pointer
+        memset(Afe_Block->pucVirtBufAddr, 0, Afe_Block->u4BufferSize);
+        PRINTK_AUDDRV("DL1 mmap underrun HwConsumed:%llu ApplWritten:%llu\n",
+                      DL1_Mmap_HwConsumed, DL1_Mmap_ApplWritten);
+        DL1_Mmap_ApplWritten = DL1_Mmap_HwConsumed;
+        DL1_Mmap_Underruns++;
+    }
+
+    Afe_Block->u4DataRemained = (kal_int32)(DL1_Mmap_ApplWritten - DL1_Mmap_HwConsumed);
+    Afe_Block->u4WriteIdx = (Afe_Block->u4DMAReadIdx + Afe_Block->u4DataRemained) % Afe_Block->u4BufferSize;
+}
+
+static void Auddrv_DL1_Mmap_Position(AFE_BLOCK_T *Afe_Block, AudDrv_DL1_Position *pPosition)
+{
+    pPosition->u4BufferSize = Afe_Block->u4BufferSize;
+    pPosition->u4HwReadIdx = Afe_Block->u4DMAReadIdx;
+    pPosition->u8HwConsumed = DL1_Mmap_HwConsumed;
+    pPosition->u8ApplWritten = DL1_Mmap_ApplWritten;
+    pPosition->u8TimeStamp = DL1_Mmap_TimeStamp;
+    pPosition->u4Underruns = DL1_Mmap_Underruns;
+    pPosition->u4Reserved = 0;
+}
+
 /*****************************************************************************
  * FUNCTION
  *  Auddrv_DL1_Interrupt_Handler
@@ -776,6 +856,14 @@ void Auddrv_DL_Interrupt_Handler(void)  // irq1 ISR handler
     //spin lock with interrupt disable
     spin_lock_irqsave(&auddrv_irqstatus_lock, flags);
 
+    // in mmap mode there is no writer to wake, the irq only catches underrun
+    if (DL1_Mmap_Mode)
+    {
+        Auddrv_DL1_Mmap_Update(Afe_Block);
+        spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+        return;
+    }
+
     HW_Cur_ReadIdx = Afe_Get_Reg(AFE_DL1_CUR);
     if (HW_Cur_ReadIdx == 0)
     {
@@ -2371,8 +2459,10 @@ void Auddrv_Set_MemIF_Fp(struct file *fp, unsigned long arg)
     }
 
 #if defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
+    // a mapped DL1 ring must stay where it is, so leave it in EMI
+    mutex_lock(&DL1_Mmap_mutex);
     spin_lock(&auddrv_lock);
-    if (Aud_Int_Mem_Flag == 0) //SRAM is not occupied, use SRAM
+    if (Aud_Int_Mem_Flag == 0 && !(arg == MEM_DL1 && DL1_Mmap_Count != 0)) //SRAM is not occupied, use SRAM
     {
         AudDrv_Reassign_Buffer_In_SRAM(fp, arg);
         Aud_Int_Mem_Flag |= (1 << ((int)arg));
@@ -2387,6 +2477,7 @@ void Auddrv_Set_MemIF_Fp(struct file *fp, unsigned long arg)
         Aud_Ext_Mem_Flag |= (1 << ((int)arg));
     }
     spin_unlock(&auddrv_lock);
+    mutex_unlock(&DL1_Mmap_mutex);
 #endif
     pAfe_MEM_ConTrol->flip = fp;
     pAfe_MEM_ConTrol->bRunning = true;
@@ -2489,20 +2580,27 @@ void AudDrv_Mem_Reset(void)
 {
     int i = 0;
     PRINTK_AUDDRV("AudDrv_Mem_Reset\n");
-#if !defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
-    AudDrv_Force_Free_DL1_Buffer();
-    for (i = MEM_DL2 ; i < NUM_OF_MEM_INTERFACE ; i++)
+    // a DL1 ring that is still mapped stays allocated until it is unmapped
+    mutex_lock(&DL1_Mmap_mutex);
+    if (DL1_Mmap_Count != 0)
     {
-        // sequence free memory
-        AudDrv_Force_Free_Buffer(i);
+        xlog_printk(ANDROID_LOG_ERROR, "Sound", "AudDrv_Mem_Reset DL1 ring still mapped %d times\n", DL1_Mmap_Count);
     }
+    else
+    {
+        AudDrv_DL1_Set_Mmap_Mode(false);
+#if !defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
+        AudDrv_Force_Free_DL1_Buffer();
 #else
-    for (i = MEM_DL1 ; i < NUM_OF_MEM_INTERFACE ; i++)
+        AudDrv_Force_Free_Buffer(MEM_DL1);
+#endif
+    }
+    mutex_unlock(&DL1_Mmap_mutex);
+    for (i = MEM_DL2 ; i < NUM_OF_MEM_INTERFACE ; i++)
     {
         // sequence free memory
         AudDrv_Force_Free_Buffer(i);
     }
-#endif
 }
 
 
@@ -2598,6 +2696,107 @@ int AudDrv_GET_DL1_REMAIN_TIME(struct file *fp)
 }
 
 
+/*****************************************************************************
+ * FUNCTION
+ *  AudDrv_DL1_Set_Mmap_Mode / AudDrv_DL1_Get_Position / AudDrv_DL1_Set_Appl_Ptr
+ *
+ * DESCRIPTION
+ *  DL1 mmap mode: userspace fills the mmap()ed DL1 ring itself, queries
+ *  the hardware read pointer and commits how far it has written
+ *
+ ******************************************************************************/
+static int AudDrv_DL1_Set_Mmap_Mode(bool bEnable)
+{
+    AFE_BLOCK_T *Afe_Block = &(AFE_dL1_Control_context.rBlock);
+    unsigned long flags;
+
+    if (bEnable && Afe_Block->u4BufferSize == 0)
+    {
+        PRINTK_AUDDRV("AudDrv_DL1_Set_Mmap_Mode DL1 buffer not allocated\n");
+        return -EINVAL;
+    }
+
+    spin_lock_irqsave(&auddrv_irqstatus_lock, flags);
+    // anything already queued by write() counts as committed
+    DL1_Mmap_HwConsumed = 0;
+    DL1_Mmap_ApplWritten = bEnable ? Afe_Block->u4DataRemained : 0;
+    DL1_Mmap_TimeStamp = ktime_to_ns(ktime_get());
+    DL1_Mmap_Underruns = 0;
+    DL1_Mmap_Mode = bEnable;
+    spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+
+    PRINTK_AUDDRV("AudDrv_DL1_Set_Mmap_Mode %d\n", bEnable);
+    return 0;
+}
+
+static int AudDrv_DL1_Get_Position(void __user *arg)
+{
+    AFE_BLOCK_T *Afe_Block = &(AFE_dL1_Control_context.rBlock);
+    AudDrv_DL1_Position Position;
+    unsigned long flags;
+
+    spin_lock_irqsave(&auddrv_irqstatus_lock, flags);
+    if (!DL1_Mmap_Mode)
+    {
+        spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+        return -EINVAL;
+    }
+    Auddrv_DL1_Mmap_Update(Afe_Block);
+    Auddrv_DL1_Mmap_Position(Afe_Block, &Position);
+    spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+
+    if (copy_to_user(arg, &Position, sizeof(Position)))
+    {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static int AudDrv_DL1_Set_Appl_Ptr(void __user *arg)
+{
+    AFE_BLOCK_T *Afe_Block = &(AFE_dL1_Control_context.rBlock);
+    AudDrv_DL1_Position Position;
+    unsigned long flags;
+    int ret = 0;
+
+    if (copy_from_user(&Position, arg, sizeof(Position)))
+    {
+        return -EFAULT;
+    }
+
+    spin_lock_irqsave(&auddrv_irqstatus_lock, flags);
+    if (!DL1_Mmap_Mode)
+    {
+        spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+        return -EINVAL;
+    }
+    Auddrv_DL1_Mmap_Update(Afe_Block);
+
+    if (Position.u8ApplWritten < DL1_Mmap_ApplWritten)
+    {
+        // an underrun moved the pointer forward, userspace has to resync
+        ret = -EPIPE;
+    }
+    else if (Position.u8ApplWritten - DL1_Mmap_HwConsumed > Afe_Block->u4BufferSize)
+    {
+        ret = -EINVAL;
+    }
+    else
+    {
+        DL1_Mmap_ApplWritten = Position.u8ApplWritten;
+        Afe_Block->u4DataRemained = (kal_int32)(DL1_Mmap_ApplWritten - DL1_Mmap_HwConsumed);
+        Afe_Block->u4WriteIdx = (Afe_Block->u4DMAReadIdx + Afe_Block->u4DataRemained) % Afe_Block->u4BufferSize;
+    }
+    Auddrv_DL1_Mmap_Position(Afe_Block, &Position);
+    spin_unlock_irqrestore(&auddrv_irqstatus_lock, flags);
+
+    if (copy_to_user(arg, &Position, sizeof(Position)))
+    {
+        return -EFAULT;
+    }
+    return ret;
+}
+
 /*****************************************************************************
  * FUNCTION
  *  AudDrv_GET_UL_REMAIN_TIME
@@ -2802,6 +3001,16 @@ static long AudDrv_ioctl(struct file *fp, unsigned int cmd, unsigned long arg)
         }
         case ALLOCATE_MEMIF_DL1:
         {
+            mutex_lock(&DL1_Mmap_mutex);
+            if (DL1_Mmap_Count != 0)
+            {
+                PRINTK_AUDDRV("ALLOCATE_MEMIF_DL1 ring still mapped %d times\n", DL1_Mmap_Count);
+                mutex_unlock(&DL1_Mmap_mutex);
+                ret = -EBUSY;
+                break;
+            }
+            // a new ring starts in write() mode, whatever the last owner left
+            AudDrv_DL1_Set_Mmap_Mode(false);
             AudDrv_Clk_On();
             spin_lock(&auddrv_lock);
 #if !defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
@@ -2811,10 +3020,20 @@ static long AudDrv_ioctl(struct file *fp, unsigned int cmd, unsigned long arg)
 #endif
             spin_unlock(&auddrv_lock);
             AudDrv_Clk_Off();
+            mutex_unlock(&DL1_Mmap_mutex);
             break;
         }
         case FREE_MEMIF_DL1:
         {
+            mutex_lock(&DL1_Mmap_mutex);
+            if (DL1_Mmap_Count != 0)
+            {
+                PRINTK_AUDDRV("FREE_MEMIF_DL1 ring still mapped %d times\n", DL1_Mmap_Count);
+                mutex_unlock(&DL1_Mmap_mutex);
+                ret = -EBUSY;
+                break;
+            }
+            AudDrv_DL1_Set_Mmap_Mode(false);
             AudDrv_Clk_On();
             spin_lock(&auddrv_lock);
 #if !defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
@@ -2824,6 +3043,7 @@ static long AudDrv_ioctl(struct file *fp, unsigned int cmd, unsigned long arg)
 #endif
             spin_unlock(&auddrv_lock);
             AudDrv_Clk_Off();
+            mutex_unlock(&DL1_Mmap_mutex);
             break;
         }
         case ALLOCATE_MEMIF_DL2:
@@ -3305,6 +3525,21 @@ static long AudDrv_ioctl(struct file *fp, unsigned int cmd, unsigned long arg)
             ret = AudDrv_GET_UL_REMAIN_TIME(fp);
             break;
         }
+        case AUDDRV_DL1_MMAP_MODE:
+        {
+            ret = AudDrv_DL1_Set_Mmap_Mode(arg != 0);
+            break;
+        }
+        case AUDDRV_GET_DL1_POSITION:
+        {
+            ret = AudDrv_DL1_Get_Position((void __user *)arg);
+            break;
+        }
+        case AUDDRV_SET_DL1_APPL_PTR:
+        {
+            ret = AudDrv_DL1_Set_Appl_Ptr((void __user *)arg);
+            break;
+        }
         default:
         {
             PRINTK_AUD_ERROR("AudDrv Fail IOCTL command no such ioctl cmd = %x \n", cmd);
@@ -3353,6 +3588,12 @@ static ssize_t AudDrv_write(struct file *fp, const char __user *data, size_t cou
         msleep(60);
         return written_size;
     }
+
+    // DL1 ring is owned by the mmap writer
+    if (pAfe_MEM_ConTrol->MemIfNum == MEM_DL1 && DL1_Mmap_Mode)
+    {
+        return -EBUSY;
+    }
     // handle for buffer management
     /*
     PRINTK_AUDDRV("AudDrv_write WriteIdx=%x, ReadIdx=%x, DataRemained=%x \n",
@@ -3830,21 +4071,25 @@ static int AudDrv_flush(struct file *flip, fl_owner_t id)
  */
 void AudDrv_vma_open(struct vm_area_struct *vma)
 {
+    mutex_lock(&DL1_Mmap_mutex);
+    DL1_Mmap_Count++;
+    mutex_unlock(&DL1_Mmap_mutex);
     PRINTK_AUDDRV("AudDrv_vma_open virt:%lx, phys:%lx, length:%lx \n", vma->vm_start, vma->vm_pgoff << PAGE_SHIFT, vma->vm_end - vma->vm_start);
 }
 
 void AudDrv_vma_close(struct vm_area_struct *vma)
 {
+    mutex_lock(&DL1_Mmap_mutex);
+    DL1_Mmap_Count--;
+    mutex_unlock(&DL1_Mmap_mutex);
     PRINTK_AUDDRV("AudDrv_vma_close virt");
 }
 
-/*
 static struct vm_operations_struct AudDrv_remap_vm_ops =
 {
    .open  = AudDrv_vma_open,
    .close = AudDrv_vma_close
 };
-*/
 
 /*****************************************************************************
  * FUNCTION
@@ -3866,19 +4111,68 @@ static struct vm_operations_struct AudDrv_remap_vm_ops =
 
 static int AudDrv_remap_mmap(struct file *flip, struct vm_area_struct *vma)
 {
+    AFE_BLOCK_T *Afe_Block = &(AFE_dL1_Control_context.rBlock);
+    unsigned long size = vma->vm_end - vma->vm_start;
+    int ret = 0;
+
     PRINTK_AUDDRV("AudDrv_remap_mmap \n");
-    /*
-    vma->vm_pgoff =( AFE_dl_Control->rBlock.pucPhysBufAddr)>>PAGE_SHIFT;
-    if(remap_pfn_range(vma , vma->vm_start , vma->vm_pgoff ,
-        vma->vm_end - vma->vm_start , vma->vm_page_prot) < 0)
+
+    // the ring cannot be freed or reallocated while DL1_Mmap_mutex is held
+    mutex_lock(&DL1_Mmap_mutex);
+
+    // only the DL1 ring can be mapped, for AUDDRV_DL1_MMAP_MODE
+    if (Afe_Block->pucPhysBufAddr == 0 || (Afe_Block->pucPhysBufAddr & ~PAGE_MASK) ||
+        vma->vm_pgoff != 0 || size > PAGE_ALIGN(Afe_Block->u4BufferSize))
     {
-        xlog_printk(ANDROID_LOG_ERROR, "Sound","AudDrv_remap_mmap remap_pfn_range Fail \n");
-        return -EIO;
+        xlog_printk(ANDROID_LOG_ERROR, "Sound", "AudDrv_remap_mmap invalid phys:0x%x size:%lu buffer:%d\n",
+                    Afe_Block->pucPhysBufAddr, size, Afe_Block->u4BufferSize);
+        ret = -EINVAL;
+        goto out;
     }
+
+#if defined(MTK_AUDIO_DYNAMIC_SRAM_SUPPORT)
+    // SRAM is handed back to EMI on release, which would move the ring under the mapping
+    spin_lock(&auddrv_lock);
+    if (Aud_Int_Mem_Flag & (1 << MEM_DL1))
+    {
+        ret = -EBUSY;
+    }
+    spin_unlock(&auddrv_lock);
+    if (ret < 0)
+    {
+        xlog_printk(ANDROID_LOG_ERROR, "Sound", "AudDrv_remap_mmap DL1 ring is in dynamic SRAM\n");
+        goto out;
+    }
+#endif
+
+    if (Afe_Block->pucPhysBufAddr >= AFE_INTERNAL_SRAM_PHY_BASE &&
+        Afe_Block->pucPhysBufAddr < AFE_INTERNAL_SRAM_PHY_BASE + AFE_INTERNAL_SRAM_SIZE)
+    {
+        vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+        ret = remap_pfn_range(vma , vma->vm_start , Afe_Block->pucPhysBufAddr >> PAGE_SHIFT ,
+                              size , vma->vm_page_prot);
+    }
+    else
+    {
+        // dma_alloc_coherent memory, mapped with its own attributes
+        ret = dma_mmap_coherent(0, vma, Afe_Block->pucVirtBufAddr, Afe_Block->pucPhysBufAddr,
+                                Afe_Block->u4BufferSize);
+    }
+    if (ret < 0)
+    {
+        xlog_printk(ANDROID_LOG_ERROR, "Sound", "AudDrv_remap_mmap map Fail %d\n", ret);
+        ret = -EIO;
+        goto out;
+    }
+
+    // vm_ops->open is not called for the first mapping
     vma->vm_ops = &AudDrv_remap_vm_ops;
-    AudDrv_vma_open(vma);
-    */
-    return 0;
+    DL1_Mmap_Count++;
+    PRINTK_AUDDRV("AudDrv_remap_mmap virt:%lx, phys:%x, length:%lx count:%d\n",
+                  vma->vm_start, Afe_Block->pucPhysBufAddr, size, DL1_Mmap_Count);
+out:
+    mutex_unlock(&DL1_Mmap_mutex);
+    return ret;
 }
 
 /*****************************************************************************
@@ -54,6 +54,12 @@
 #define AUDDRV_GET_DL1_REMAINDATA_TIME  _IOWR(AUD_DRV_IOC_MAGIC, 0x0A, int)
 #define AUDDRV_GET_UL_REMAINDATA_TIME   _IOWR(AUD_DRV_IOC_MAGIC, 0x0B, int)
 
+// DL1 mmap mode: userspace writes the mmap()ed DL1 buffer directly and
+// tracks the hardware read pointer instead of calling write()
+#define AUDDRV_DL1_MMAP_MODE          _IOWR(AUD_DRV_IOC_MAGIC, 0x0C, int)
+#define AUDDRV_GET_DL1_POSITION       _IOWR(AUD_DRV_IOC_MAGIC, 0x0D, AudDrv_DL1_Position*)
+#define AUDDRV_SET_DL1_APPL_PTR       _IOWR(AUD_DRV_IOC_MAGIC, 0x0E, AudDrv_DL1_Position*)
+
 
 // Allocate mean allocate buffer and set stream into ready state.
 #define ALLOCATE_MEMIF_DL1           _IOWR(AUD_DRV_IOC_MAGIC, 0x10,unsigned int)
@@ -169,6 +175,18 @@ typedef struct
     int bAudioPlay;
 } SPH_Control;
 
+// byte counters are free-running, ring offset = counter % u4BufferSize
+typedef struct
+{
+    uint32 u4BufferSize;    // DL1 ring size in bytes
+    uint32 u4HwReadIdx;     // hardware read offset in the ring
+    uint64 u8HwConsumed;    // bytes fetched by hardware since mmap mode start
+    uint64 u8ApplWritten;   // bytes committed by userspace since mmap mode start
+    uint64 u8TimeStamp;     // CLOCK_MONOTONIC ns when u4HwReadIdx was sampled
+    uint32 u4Underruns;     // times the hardware caught up with u8ApplWritten
+    uint32 u4Reserved;
+} AudDrv_DL1_Position;
+
 /*****************************************************************************
 *                        F U N C T I O N   D E F I N I T I O N
 ******************************************************************************